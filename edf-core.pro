@@ -0,0 +1,16 @@
+#-------------------------------------------------
+#
+# Static library with the Qt-free core of the detector.
+#
+#-------------------------------------------------
+
+CONFIG -= qt
+CONFIG += staticlib
+
+TARGET = edf-core
+TEMPLATE = lib
+
+include(libs/core.pri)
+
+SOURCES += $$CORE_SOURCES
+HEADERS += $$CORE_HEADERS
@@ -0,0 +1,17 @@
+#-------------------------------------------------
+#
+# Headless build - core library and command-line tools, no Qt needed.
+# qmake edf-headless.pro && make
+#
+#-------------------------------------------------
+
+TEMPLATE = subdirs
+CONFIG += ordered
+
+SUBDIRS = edf-core.pro \
+    tools/edf-detect.pro \
+    tools/edf-bench.pro \
+    tools/edf-verify.pro \
+    tools/edf-sweep.pro \
+    tools/edf-propagation.pro \
+    tools/edf-waveforms.pro
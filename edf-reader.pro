@@ -12,36 +12,25 @@ CONFIG += c++11
 TARGET = edf-reader
 TEMPLATE = app
 
+# the Qt-free core of the detector - the same sources, defines and libraries as edf-core.pro and the tools
+include(libs/core.pri)
+
+SOURCES += $$CORE_SOURCES
+HEADERS += $$CORE_HEADERS
+
 SOURCES += main.cpp\
         mainwindow.cpp \
          libs/qcustomplot.cpp \
-    libs/edflib.c \
     globals.cpp \
     channelselector.cpp \
     spikeselector.cpp \
     about.cpp \
     header.cpp \
-    libs/lib/Alglib/alglibinternal.cpp \
-    libs/lib/Alglib/alglibmisc.cpp \
-    libs/lib/Alglib/ap.cpp \
-    libs/lib/Alglib/dataanalysis.cpp \
-    libs/lib/Alglib/diffequations.cpp \
-    libs/lib/Alglib/fasttransforms.cpp \
-    libs/lib/Alglib/integration.cpp \
-    libs/lib/Alglib/interpolation.cpp \
-    libs/lib/Alglib/linalg.cpp \
-    libs/lib/Alglib/optimization.cpp \
-    libs/lib/Alglib/solvers.cpp \
-    libs/lib/Alglib/specialfunctions.cpp \
-    libs/lib/Alglib/statistics.cpp \
-    libs/CDSP.cpp \
-    libs/CInputEDF.cpp \
-    libs/CSpikeDetector.cpp \
+    libs/CAnnotationIndex.cpp \
     help.cpp
 
 HEADERS  += mainwindow.h \
          libs/qcustomplot.h \
-    libs/edflib.h \
     globals.h \
     channelselector.h \
     spikeselector.h \
@@ -317,10 +306,7 @@ HEADERS  += mainwindow.h \
     libs/lib/Eigen/src/UmfPackSupport/UmfPackSupport.h \
     libs/lib/edflib.h \
     libs/lib/samplerate.h \
-    libs/CDSP.h \
-    libs/CInputEDF.h \
-    libs/CSpikeDetector.h \
-    libs/Definitions.h \
+    libs/CAnnotationIndex.h \
     help.h
 
 FORMS    += mainwindow.ui \
@@ -330,10 +316,6 @@ FORMS    += mainwindow.ui \
     header.ui \
     help.ui
 
-QMAKE_CXXFLAGS += -fopenmp
-LIBS += -fopenmp
-LIBS += -L"C:\Users\Pedro Henrique\Desktop\support\support\libraries" -lsamplerate
-
 DISTFILES += \
     images/logo-ic-unicamp.png \
     images/logo-unicamp.png \
@@ -3,6 +3,8 @@
 #include <QStringList>
 #include <QMap>
 #include "libs/edflib.h"
+#include "libs/CAnnotationIndex.h"
+#include "libs/CDetectionCache.h"
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
 
@@ -13,7 +15,7 @@ double start_time = 0 ; /* start reading x seconds from start of file */
 double end_time = 10;  /* end reading x seconds from start of file */
 int totalGraphs = 0;
 double time_interval = 0.005;
-int nsamples = (end_time - start_time)/time_interval;
+long long nsamples = (end_time - start_time)/time_interval;
 struct edf_hdr_struct hdr;
 QVector<double> xspike;
 QVector<double> yspike;
@@ -25,6 +27,8 @@ QString spike;
 QString header;
 QMap<QString, int> labelchannel;
 QMap<QString, int> labelposition;
+CAnnotationIndex annotationIndex;
+CDetectionCache detectionCache(DETECTOR_SETTINGS(10, 60, 3.65, 3.65, 0, 5, 4, 300, 50, 0.005, 0.12, 200)); // default settings
 MainWindow *ui;
 
 
@@ -5,6 +5,8 @@
 #include <QMap.h>
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
+#include "libs/CAnnotationIndex.h"
+#include "libs/CDetectionCache.h"
 
 
 // ALL THE GLOBAL DECLARATIONS
@@ -20,7 +22,7 @@
 extern int hdl;
 extern double start_time;
 extern double end_time;
-extern int nsamples;
+extern long long nsamples;
 extern int totalGraphs;
 extern double time_interval;
 extern QString filenameg; //stores the location of the file (g stands for global)
@@ -32,6 +34,8 @@ extern QString header;
 extern struct edf_hdr_struct hdr;
 extern QMap<QString, int> labelchannel;
 extern QMap<QString, int> labelposition;
+extern CAnnotationIndex annotationIndex;
+extern CDetectionCache detectionCache;
 extern MainWindow *ui;
 
 #endif // GLOBALS_H
@@ -0,0 +1,178 @@
+#include "CAnnotationIndex.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+using namespace std;
+
+/// Ordering of annotations by onset.
+static bool annotationBefore(const ANNOTATION& a, const ANNOTATION& b)
+{
+	return a.m_onset < b.m_onset;
+}
+
+/// A constructor.
+CAnnotationIndex::CAnnotationIndex()
+	: m_countParsed(0), m_stop(false), m_handle(-1), m_datarecords(0), m_recordDuration(1), m_plus(false)
+{
+	/* empty */
+}
+
+/// A virtual destructor.
+CAnnotationIndex::~CAnnotationIndex()
+{
+	Detach();
+}
+
+/// Attach an open file.
+void CAnnotationIndex::Attach(const int& handle, const struct edf_hdr_struct& hdr)
+{
+	Detach();
+
+	lock_guard<mutex> lock(m_mutex);
+
+	m_handle = handle;
+	m_datarecords = hdr.datarecords_in_file;
+	m_recordDuration = hdr.datarecord_duration / (double)EDFLIB_TIME_DIMENSION;
+	m_plus = (hdr.filetype == EDFLIB_FILETYPE_EDFPLUS || hdr.filetype == EDFLIB_FILETYPE_BDFPLUS);
+
+	if (m_recordDuration <= 0)
+		m_recordDuration = 1;
+
+	m_parsed.resize((m_datarecords + ANNOTATION_BLOCK_RECORDS - 1) / ANNOTATION_BLOCK_RECORDS, 0);
+}
+
+/// Stop the background parsing and forget the file handle.
+void CAnnotationIndex::Detach()
+{
+	m_stop = true;
+	if (m_thread.joinable())
+		m_thread.join();
+	m_stop = false;
+
+	lock_guard<mutex> lock(m_mutex);
+	m_handle = -1;
+}
+
+/// Remove all parsed annotations.
+void CAnnotationIndex::Clear()
+{
+	Detach();
+
+	lock_guard<mutex> lock(m_mutex);
+	m_annotations.clear();
+	m_parsed.clear();
+	m_countParsed = 0;
+}
+
+/// Start parsing of all remaining blocks in a background thread.
+void CAnnotationIndex::StartBackground(const function<void()>& done)
+{
+	if (m_thread.joinable() || m_handle < 0 || IsComplete())
+		return;
+
+	m_done = done;
+	m_stop = false;
+	m_thread = thread(&CAnnotationIndex::backgroundRun, this);
+}
+
+/// Return annotations with onset in the range [t0, t1].
+void CAnnotationIndex::Query(const double& t0, const double& t1, vector<ANNOTATION>& out)
+{
+	long long firstBlock, lastBlock, block;
+
+	out.clear();
+	if (t1 < t0)
+		return;
+
+	// blocks covering the range, one datarecord margin on both sides
+	firstBlock = ((long long)floor(t0 / m_recordDuration) - 1) / ANNOTATION_BLOCK_RECORDS;
+	lastBlock = ((long long)floor(t1 / m_recordDuration) + 1) / ANNOTATION_BLOCK_RECORDS;
+	if (firstBlock < 0) firstBlock = 0;
+
+	for (block = firstBlock; block <= lastBlock && block < (long long)m_parsed.size(); block++)
+		parseBlock(block);
+
+	lock_guard<mutex> lock(m_mutex);
+
+	vector<ANNOTATION>::iterator b = lower_bound(m_annotations.begin(), m_annotations.end(), ANNOTATION(t0, 0, ""), annotationBefore);
+	vector<ANNOTATION>::iterator e = upper_bound(b, m_annotations.end(), ANNOTATION(t1, 0, ""), annotationBefore);
+
+	out.assign(b, e);
+}
+
+/// Returns true when all blocks of the file are parsed.
+bool CAnnotationIndex::IsComplete() const
+{
+	return m_countParsed == (long long)m_parsed.size();
+}
+
+/// Returns count of annotations parsed so far.
+size_t CAnnotationIndex::GetCount()
+{
+	lock_guard<mutex> lock(m_mutex);
+	return m_annotations.size();
+}
+
+/// Parse one block of datarecords and merge its annotations to the sorted store.
+void CAnnotationIndex::parseBlock(const long long& block)
+{
+	vector<ANNOTATION> found;
+	int                handle;
+	size_t             middle;
+
+	{
+		lock_guard<mutex> lock(m_mutex);
+		if (m_handle < 0 || m_parsed.at(block))
+			return;
+		handle = m_handle;
+	}
+
+	// plain EDF/BDF files do not contain annotations
+	if (m_plus)
+	{
+		if (edfread_annotations(handle, block * ANNOTATION_BLOCK_RECORDS, ANNOTATION_BLOCK_RECORDS, collect, &found) < 0)
+			found.clear();
+	}
+
+	stable_sort(found.begin(), found.end(), annotationBefore);
+
+	lock_guard<mutex> lock(m_mutex);
+
+	// parsed meanwhile by the other thread
+	if (m_parsed.at(block))
+		return;
+
+	middle = m_annotations.size();
+	m_annotations.insert(m_annotations.end(), found.begin(), found.end());
+	inplace_merge(m_annotations.begin(), m_annotations.begin() + middle, m_annotations.end(), annotationBefore);
+
+	m_parsed.at(block) = 1;
+	m_countParsed++;
+}
+
+/// Entry point of the background thread.
+void CAnnotationIndex::backgroundRun()
+{
+	long long block;
+	long long countBlocks = m_parsed.size();
+
+	for (block = 0; block < countBlocks && !m_stop; block++)
+		parseBlock(block);
+
+	if (!m_stop && IsComplete() && m_done)
+		m_done();
+}
+
+/// edflib callback - collects annotations of one block.
+void CAnnotationIndex::collect(const struct edf_annotation_struct * annot, void * userdata)
+{
+	vector<ANNOTATION> * found = (vector<ANNOTATION> *)userdata;
+	double 				 duration = -1;
+
+	if (annot->duration[0] != 0)
+		duration = atof(annot->duration);
+
+	found->push_back(ANNOTATION(annot->onset / (double)EDFLIB_TIME_DIMENSION, duration, annot->annotation));
+}
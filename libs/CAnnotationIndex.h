@@ -0,0 +1,147 @@
+#ifndef CAnnotationIndex_H
+#define CAnnotationIndex_H
+
+#include <vector>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <functional>
+
+#include "edflib.h"
+
+/// Count of datarecords parsed at once - the granularity of the lazy loading.
+#define ANNOTATION_BLOCK_RECORDS 256
+
+/**
+ * One EDF+ / BDF+ annotation.
+ */
+typedef struct annotation
+{
+public:
+	/// onset of the event (second, relative to the start of the file)
+	double 		m_onset;
+	/// duration of the event (second), -1 if the annotation has no duration
+	double 		m_duration;
+	/// description of the event (UTF-8)
+	std::string m_text;
+
+	/// A constructor
+	annotation(const double& onset, const double& duration, const std::string& text)
+		: m_onset(onset), m_duration(duration), m_text(text)
+	{
+		/* empty */
+	}
+} ANNOTATION;
+
+/**
+ * Sorted, time-indexed store of the annotations of one file.
+ * The file is opened with EDFLIB_DO_NOT_READ_ANNOTATIONS (instantly), the annotations are parsed
+ * later in blocks of \ref ANNOTATION_BLOCK_RECORDS datarecords - on demand for the queried time range
+ * or by a background thread for the whole file.
+ *
+ * The lazy query expects an annotation to be stored in the datarecord (or its neighbour) which
+ * contains its onset, as recording equipment does. Files written by edflib pack the annotations
+ * to the first datarecords, these are found by the background parsing, which starts at the beginning
+ * of the file. When the background parsing is complete the queries are exact.
+ */
+class CAnnotationIndex
+{
+// methods
+public:
+	/**
+	 * A constructor.
+	 */
+	CAnnotationIndex();
+
+	/**
+	 * A virtual desctructor. Stops the background parsing.
+	 */
+	virtual ~CAnnotationIndex();
+
+	/**
+	 * Attach an open file. The parsed annotations are kept, call \ref Clear when a new file is opened.
+	 * @param handle edflib handle of the file
+	 * @param hdr header of the file
+	 */
+	void Attach(const int& handle, const struct edf_hdr_struct& hdr);
+
+	/**
+	 * Stop the background parsing and forget the file handle (before closing the file).
+	 */
+	void Detach();
+
+	/**
+	 * Remove all parsed annotations.
+	 */
+	void Clear();
+
+	/**
+	 * Start parsing of all remaining blocks in a background thread.
+	 * @param done called from the background thread when all blocks are parsed (optional)
+	 */
+	void StartBackground(const std::function<void()>& done = std::function<void()>());
+
+	/**
+	 * Return annotations with onset in the range [t0, t1], sorted by onset.
+	 * Blocks which cover the range and are not parsed yet are parsed first. O(log n + k) when parsed.
+	 * @param t0 start of the range (second)
+	 * @param t1 end of the range (second)
+	 * @param out output vector
+	 */
+	void Query(const double& t0, const double& t1, std::vector<ANNOTATION>& out);
+
+	/**
+	 * Returns true when all blocks of the file are parsed.
+	 */
+	bool IsComplete() const;
+
+	/**
+	 * Returns count of annotations parsed so far.
+	 */
+	size_t GetCount();
+
+private:
+	/**
+	 * Parse one block of datarecords and merge its annotations to the sorted store.
+	 * @param block number of the block
+	 */
+	void parseBlock(const long long& block);
+
+	/**
+	 * Entry point of the background thread.
+	 */
+	void backgroundRun();
+
+	/**
+	 * edflib callback - collects annotations of one block.
+	 */
+	static void collect(const struct edf_annotation_struct * annot, void * userdata);
+
+// variables
+private:
+	/// annotations sorted by onset
+	std::vector<ANNOTATION> m_annotations;
+	/// parsed flag for every block
+	std::vector<char>       m_parsed;
+	/// count of parsed blocks
+	std::atomic<long long>  m_countParsed;
+	/// guards m_annotations and m_parsed
+	std::mutex              m_mutex;
+	/// background parsing thread
+	std::thread             m_thread;
+	/// request to stop the background thread
+	std::atomic<bool>       m_stop;
+	/// called when the background parsing is complete
+	std::function<void()>   m_done;
+	/// edflib handle, -1 if no file is attached
+	int                     m_handle;
+	/// count of datarecords in the file
+	long long               m_datarecords;
+	/// duration of one datarecord (second)
+	double                  m_recordDuration;
+	/// EDF+ / BDF+ file - only these contain annotations
+	bool                    m_plus;
+};
+
+#endif
@@ -0,0 +1,439 @@
+#include "CBatchScheduler.h"
+#include "CProfiler.h"
+
+#include <thread>
+
+using namespace std;
+
+/// A constructor.
+CBatchScheduler::CBatchScheduler(const DETECTOR_SETTINGS& detector, const BATCH_SETTINGS& settings)
+	: m_detectorSettings(detector), m_settings(settings), m_files(NULL), m_channels(NULL), m_nextFile(0), m_openFiles(0),
+	  m_opening(0), m_memoryUsed(0), m_memoryBase(0), m_peakMemory(0), m_runningTasks(0), m_peakTasks(0), m_pendingTasks(0),
+	  m_wallTime(0), m_countWorkers(0)
+{
+	/* empty */
+}
+
+/// A virtual desctructor.
+CBatchScheduler::~CBatchScheduler()
+{
+	clear();
+}
+
+/// Remove results of the last run.
+void CBatchScheduler::clear()
+{
+	unsigned i, j;
+
+	for (i = 0; i < m_fileJobs.size(); i++)
+	{
+		// files which can not be opened
+		if (m_fileJobs[i] == NULL)
+			continue;
+
+		for (j = 0; j < m_fileJobs[i]->m_channels.size(); j++)
+			delete m_fileJobs[i]->m_channels[j];
+		delete m_fileJobs[i]->m_model;
+		delete m_fileJobs[i];
+	}
+	m_fileJobs.clear();
+	m_results.clear();
+
+	for (i = 0; i < m_queues.size(); i++)
+		delete m_queues[i];
+	m_queues.clear();
+
+	m_fileErrors.clear();
+	m_timings.clear();
+}
+
+/// Run the detection.
+void CBatchScheduler::Run(const vector<string>& files, const vector<int>& channels)
+{
+	vector<thread> threads;
+	int            i;
+	unsigned       j, k;
+
+	clear();
+
+	m_files = &files;
+	m_channels = &channels;
+	m_nextFile = 0;
+	m_openFiles = 0;
+	m_opening = 0;
+	m_memoryUsed = 0;
+	m_memoryBase = CProfiler::GetCurrentRSS();
+	m_peakMemory = 0;
+	m_runningTasks = 0;
+	m_peakTasks = 0;
+	m_pendingTasks = 0;
+	m_fileJobs.assign(files.size(), NULL);
+
+	m_countWorkers = m_settings.m_workers;
+	if (m_countWorkers <= 0)
+		m_countWorkers = thread::hardware_concurrency();
+	if (m_countWorkers <= 0)
+		m_countWorkers = 1;
+
+	for (i = 0; i < m_countWorkers; i++)
+	{
+		m_queues.push_back(new workerQueue());
+		m_queues.back()->m_busy = 0;
+		m_queues.back()->m_steals = 0;
+	}
+
+	m_startTime = chrono::steady_clock::now();
+
+	for (i = 0; i < m_countWorkers; i++)
+		threads.push_back(thread(&CBatchScheduler::workerRun, this, i));
+	for (i = 0; i < m_countWorkers; i++)
+		threads[i].join();
+
+	m_wallTime = now();
+
+	// deterministic assembly - order of files and channels, timings in order of segments
+	for (i = 0; i < (int)m_fileJobs.size(); i++)
+	{
+		if (m_fileJobs[i] == NULL)
+			continue;
+
+		for (j = 0; j < m_fileJobs[i]->m_channels.size(); j++)
+		{
+			channelJob * channel = m_fileJobs[i]->m_channels[j];
+
+			BATCH_CHANNEL_RESULT result;
+			result.m_file = i;
+			result.m_channel = channel->m_channel;
+			result.m_label = channel->m_label;
+			result.m_buffering = channel->m_settings.m_buffering;
+			result.m_out = std::move(channel->m_out);
+			result.m_discharges = std::move(channel->m_discharges);
+			result.m_error = channel->m_error;
+			m_results.push_back(std::move(result));
+
+			for (k = 0; k < channel->m_timings.size(); k++)
+				m_timings.push_back(channel->m_timings[k]);
+		}
+	}
+
+	m_files = NULL;
+	m_channels = NULL;
+}
+
+/// Returns utilization of the workers.
+double CBatchScheduler::GetUtilization() const
+{
+	double busy = 0;
+	unsigned i;
+
+	if (m_wallTime <= 0 || m_queues.empty())
+		return 0;
+
+	for (i = 0; i < m_queues.size(); i++)
+		busy += m_queues[i]->m_busy;
+
+	return busy / (m_wallTime * m_queues.size());
+}
+
+/// Returns the memory budget of one worker.
+long long CBatchScheduler::taskBudget() const
+{
+	long long available = m_settings.m_memoryBudget - m_memoryBase;
+
+	if (available <= 0 || m_countWorkers <= 0)
+		return 1;
+
+	return available / m_countWorkers / BATCH_HEAP_OVERHEAD;
+}
+
+/// Returns count of stolen tasks.
+int CBatchScheduler::GetCountSteals() const
+{
+	int steals = 0;
+	unsigned i;
+
+	for (i = 0; i < m_queues.size(); i++)
+		steals += m_queues[i]->m_steals;
+
+	return steals;
+}
+
+/// Main loop of one worker.
+void CBatchScheduler::workerRun(const int worker)
+{
+	task t;
+	bool stolen;
+
+	while (getTask(worker, t, stolen))
+		runTask(worker, t, stolen);
+}
+
+/// Find a task.
+bool CBatchScheduler::getTask(const int worker, task& t, bool& stolen)
+{
+	int i, victim;
+
+	while (true)
+	{
+		// own deque - the newest task
+		{
+			workerQueue * own = m_queues[worker];
+			lock_guard<mutex> lock(own->m_mutex);
+			if (!own->m_tasks.empty())
+			{
+				t = own->m_tasks.back();
+				own->m_tasks.pop_back();
+				stolen = false;
+				return true;
+			}
+		}
+
+		// steal the oldest task of other worker
+		for (i = 1; i < m_countWorkers; i++)
+		{
+			victim = (worker + i) % m_countWorkers;
+			workerQueue * other = m_queues[victim];
+			lock_guard<mutex> lock(other->m_mutex);
+			if (!other->m_tasks.empty())
+			{
+				t = other->m_tasks.front();
+				other->m_tasks.pop_front();
+				m_queues[worker]->m_steals++;
+				stolen = true;
+				return true;
+			}
+		}
+
+		// new work - the next file
+		if (openNextFile(worker))
+			continue;
+
+		unique_lock<mutex> lock(m_mutex);
+		if (m_pendingTasks == 0 && m_opening == 0 && m_nextFile >= (int)m_files->size())
+		{
+			m_wake.notify_all();
+			return false;
+		}
+
+		// tasks are pushed without the lock, do not wait for ever
+		m_wake.wait_for(lock, chrono::milliseconds(10));
+	}
+}
+
+/// Open the next file and push its tasks.
+bool CBatchScheduler::openNextFile(const int worker)
+{
+	int          fileIndex, i, segment, count;
+	int          countTasks = 0;
+	fileJob *    job;
+	vector<task> tasks;
+
+	{
+		lock_guard<mutex> lock(m_mutex);
+		if (m_nextFile >= (int)m_files->size() || m_openFiles >= m_settings.m_maxOpenFiles)
+			return false;
+
+		fileIndex = m_nextFile++;
+		m_openFiles++;
+		m_opening++;
+	}
+
+	job = new fileJob();
+	job->m_index = fileIndex;
+	job->m_model = new CInputEDF();
+
+	try
+	{
+		job->m_model->OpenFile(m_files->at(fileIndex).c_str());
+
+		// the channels of the file are the derivations, the tasks of the file share its pages
+		if (!m_settings.m_montage.empty())
+		{
+			shared_ptr<CMontage> montage(new CMontage());
+			montage->Parse(m_settings.m_montage, job->m_model->GetHeader());
+			job->m_model->SetMontage(montage);
+		}
+	}
+	catch (const char * error)
+	{
+		delete job->m_model;
+		delete job;
+
+		lock_guard<mutex> lock(m_mutex);
+		m_fileErrors.push_back(m_files->at(fileIndex) + ": " + error);
+		m_openFiles--;
+		m_opening--;
+		m_wake.notify_all();
+		return true;
+	}
+
+	// channels and their segments
+	count = m_channels->empty() ? job->m_model->GetCountChannels() : m_channels->size();
+	for (i = 0; i < count; i++)
+	{
+		int channelNumber = m_channels->empty() ? i : m_channels->at(i);
+		if (channelNumber >= job->m_model->GetCountChannels())
+			continue;
+
+		channelJob * channel = new channelJob(m_detectorSettings);
+		channel->m_file = job;
+		channel->m_channel = channelNumber;
+		channel->m_label = job->m_model->GetLabel(channelNumber);
+		channel->m_label.erase(channel->m_label.find_last_not_of(' ') + 1);
+		job->m_channels.push_back(channel);
+
+		if (job->m_model->GetFS(channelNumber) <= 0)
+		{
+			channel->m_error = "Invalid sample rate.";
+			continue;
+		}
+
+		// every worker can run one segment
+		if (m_settings.m_memoryBudget > 0)
+			channel->m_settings.m_buffering = CSpikeDetector::GetBufferingForMemory(taskBudget(), job->m_model->GetFS(channelNumber),
+																					channel->m_settings);
+
+		channel->m_detector = new CSpikeDetector(job->m_model, &channel->m_settings);
+		channel->m_detector->GetSegments(channelNumber, channel->m_indexStart, channel->m_indexStop);
+
+		int countSegments = channel->m_indexStop.size();
+		channel->m_subOut.resize(countSegments);
+		channel->m_subDischarges.resize(countSegments);
+		channel->m_timings.resize(countSegments);
+		channel->m_remaining = countSegments;
+		countTasks += countSegments;
+	}
+
+	job->m_remaining = countTasks;
+
+	// the first segment of the first channel on the back - the owner starts with it, thieves take the end of the file
+	for (i = job->m_channels.size() - 1; i >= 0; i--)
+	{
+		channelJob * channel = job->m_channels[i];
+		for (segment = (int)channel->m_indexStop.size() - 1; segment >= 0; segment--)
+		{
+			task t;
+			t.m_channel = channel;
+			t.m_segment = segment;
+			t.m_memory = BATCH_HEAP_OVERHEAD * CSpikeDetector::EstimateSegmentMemory(channel->m_indexStop[segment] - channel->m_indexStart[segment],
+																					  job->m_model->GetFS(channel->m_channel), channel->m_settings);
+			tasks.push_back(t);
+		}
+	}
+
+	{
+		lock_guard<mutex> lock(m_mutex);
+		m_fileJobs[fileIndex] = job;
+		m_pendingTasks += countTasks;
+	}
+
+	{
+		lock_guard<mutex> lock(m_queues[worker]->m_mutex);
+		m_queues[worker]->m_tasks.insert(m_queues[worker]->m_tasks.end(), tasks.begin(), tasks.end());
+	}
+
+	lock_guard<mutex> lock(m_mutex);
+	m_opening--;
+
+	// a file without channels is closed at once
+	if (countTasks == 0)
+	{
+		job->m_model->CloseFile();
+		m_openFiles--;
+	}
+
+	m_wake.notify_all();
+	return true;
+}
+
+/// Run one task.
+void CBatchScheduler::runTask(const int worker, const task& t, const bool stolen)
+{
+	channelJob *        channel = t.m_channel;
+	fileJob *           file = channel->m_file;
+	BATCH_TASK_TIMING & timing = channel->m_timings[t.m_segment];
+
+	// memory budget, one task is always allowed
+	{
+		unique_lock<mutex> lock(m_mutex);
+		if (m_settings.m_memoryBudget > 0)
+		{
+			while (m_memoryUsed > 0 && m_memoryUsed + t.m_memory > m_settings.m_memoryBudget - m_memoryBase)
+				m_wake.wait(lock);
+		}
+
+		m_memoryUsed += t.m_memory;
+		m_runningTasks++;
+		if (m_memoryUsed > m_peakMemory)
+			m_peakMemory = m_memoryUsed;
+		if (m_runningTasks > m_peakTasks)
+			m_peakTasks = m_runningTasks;
+	}
+
+	timing.m_file = file->m_index;
+	timing.m_channel = channel->m_channel;
+	timing.m_segment = t.m_segment;
+	timing.m_worker = worker;
+	timing.m_stolen = stolen;
+	timing.m_samples = channel->m_indexStop[t.m_segment] - channel->m_indexStart[t.m_segment];
+	timing.m_start = now();
+
+	try
+	{
+		if (!channel->m_detector->AnalyseSegment(channel->m_channel, channel->m_indexStart, channel->m_indexStop, t.m_segment,
+												 channel->m_subOut[t.m_segment], channel->m_subDischarges[t.m_segment]))
+		{
+			lock_guard<mutex> lock(channel->m_errorMutex);
+			channel->m_error = "Error reading samples from file!";
+		}
+	}
+	catch (const char * error)
+	{
+		lock_guard<mutex> lock(channel->m_errorMutex);
+		channel->m_error = error;
+	}
+
+	timing.m_end = now();
+	m_queues[worker]->m_busy += timing.m_end - timing.m_start;
+
+	if (--channel->m_remaining == 0)
+		finishChannel(channel);
+
+	bool closeFile = (--file->m_remaining == 0);
+	if (closeFile)
+		file->m_model->CloseFile();
+
+	lock_guard<mutex> lock(m_mutex);
+	m_memoryUsed -= t.m_memory;
+	m_runningTasks--;
+	if (closeFile)
+		m_openFiles--;
+	m_pendingTasks--;
+	m_wake.notify_all();
+}
+
+/// Assemble the results of the segments of the channel.
+void CBatchScheduler::finishChannel(channelJob * channel)
+{
+	if (channel->m_error.empty())
+	{
+		channel->m_out.reset(new CDetectorOutput());
+		channel->m_discharges.reset(new CDischarges(1));
+
+		// k-way merge of the sorted segments
+		CDetectorOutput::Merge(channel->m_subOut, *channel->m_out);
+		CDischarges::Merge(channel->m_subDischarges, *channel->m_discharges);
+	}
+
+	channel->m_subOut.clear();
+	channel->m_subDischarges.clear();
+
+	delete channel->m_detector;
+	channel->m_detector = NULL;
+}
+
+/// Returns seconds since the start of the batch.
+double CBatchScheduler::now() const
+{
+	return chrono::duration<double>(chrono::steady_clock::now() - m_startTime).count();
+}
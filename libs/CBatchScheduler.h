@@ -0,0 +1,350 @@
+#ifndef CBatchScheduler_H
+#define CBatchScheduler_H
+
+#include <vector>
+#include <memory>
+#include <deque>
+#include <string>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+
+#include "CInputEDF.h"
+#include "CSpikeDetector.h"
+
+/// The heap of concurrent tasks holds more than the sum of their estimates (per-thread arenas, fragmentation), measured 1.25.
+#define BATCH_HEAP_OVERHEAD 1.3
+
+/**
+ * Settings of the batch.
+ */
+typedef struct batchSettings
+{
+public:
+	/// count of worker threads, 0 - count of cores
+	int       m_workers;
+	/// maximal count of files open at the same time
+	int       m_maxOpenFiles;
+	/// memory budget - the target resident set size of the process (byte), 0 - unlimited
+	long long m_memoryBudget;
+	/// montage of every file (\ref CMontage::Parse), empty - the signals of the files
+	std::string m_montage;
+
+	/// A constructor
+	batchSettings(const int& workers = 0, const int& maxOpenFiles = 16, const long long& memoryBudget = 0, const std::string& montage = "")
+		: m_workers(workers), m_maxOpenFiles(maxOpenFiles), m_memoryBudget(memoryBudget), m_montage(montage)
+	{
+		/* empty */
+	}
+} BATCH_SETTINGS;
+
+/**
+ * Timing of one task - one segment of one channel.
+ */
+typedef struct batchTaskTiming
+{
+public:
+	/// index of the file in the input list
+	int         m_file;
+	/// channel number
+	int         m_channel;
+	/// segment number
+	int         m_segment;
+	/// worker which run the task
+	int         m_worker;
+	/// true if the task was stolen from the deque of other worker
+	bool        m_stolen;
+	/// count of samples of the segment
+	SAMPLEINDEX m_samples;
+	/// start of the task (second from the start of the batch)
+	double      m_start;
+	/// end of the task (second from the start of the batch)
+	double      m_end;
+} BATCH_TASK_TIMING;
+
+/**
+ * Results of one channel of one file.
+ */
+typedef struct batchChannelResult
+{
+public:
+	/// index of the file in the input list
+	int               m_file;
+	/// channel number
+	int               m_channel;
+	/// label of the channel (without padding)
+	std::string       m_label;
+	/// length of the segments without the overlaps (second)
+	int               m_buffering;
+	/// detections, empty if failed
+	std::unique_ptr<CDetectorOutput> m_out;
+	/// discharges, empty if failed
+	std::unique_ptr<CDischarges>     m_discharges;
+	/// error message, empty on success
+	std::string       m_error;
+} BATCH_CHANNEL_RESULT;
+
+/**
+ * Batch spike detection over many files and channels.
+ *
+ * The work is split to tasks (file, channel, segment), the segments come from \ref CSpikeDetector::GetSegments.
+ * Every worker thread has its own deque of tasks - it takes the tasks from the back of its deque and steals from the front
+ * of the deques of other workers when its deque is empty. A worker without work opens the next file (up to
+ * \ref BATCH_SETTINGS::m_maxOpenFiles files are open) and pushes its tasks to its deque, a file is closed as soon as all its
+ * tasks are done.
+ *
+ * With a memory budget the budget less the resident set at the start of the run is shared by the tasks: the segments are
+ * shortened until every worker can run one (\ref CSpikeDetector::GetBufferingForMemory) and a task is started only if
+ * the estimated memory of the running tasks (\ref CSpikeDetector::EstimateSegmentMemory) fits to the budget - one task
+ * is always allowed to run, so the count of tasks running at once drops when the shortest segments do not fit.
+ *
+ * The results of the segments are assembled in the order of the segments, the results are sorted by file and channel
+ * - the output does not depend on the scheduling.
+ */
+class CBatchScheduler
+{
+// methods
+public:
+	/**
+	 * A constructor.
+	 * @param detector settings of the detector, copied for every channel
+	 * @param settings settings of the batch
+	 */
+	CBatchScheduler(const DETECTOR_SETTINGS& detector, const BATCH_SETTINGS& settings);
+
+	/**
+	 * A virtual desctructor.
+	 */
+	virtual ~CBatchScheduler();
+
+	/**
+	 * Run the detection, returns when all tasks are done.
+	 * @param files input files
+	 * @param channels channels to analyse, all channels if empty
+	 */
+	void Run(const std::vector<std::string>& files, const std::vector<int>& channels);
+
+	/**
+	 * Returns results sorted by file and channel. The results are owned by the scheduler.
+	 */
+	inline const std::vector<BATCH_CHANNEL_RESULT>& GetResults() const
+	{
+		return m_results;
+	}
+
+	/**
+	 * Returns errors of files which can not be opened, one message per file.
+	 */
+	inline const std::vector<std::string>& GetFileErrors() const
+	{
+		return m_fileErrors;
+	}
+
+	/**
+	 * Returns timing of all tasks, sorted by file, channel and segment.
+	 */
+	inline const std::vector<BATCH_TASK_TIMING>& GetTimings() const
+	{
+		return m_timings;
+	}
+
+	/**
+	 * Returns wall time of the last run (second).
+	 */
+	inline double GetWallTime() const
+	{
+		return m_wallTime;
+	}
+
+	/**
+	 * Returns count of workers of the last run.
+	 */
+	inline int GetCountWorkers() const
+	{
+		return m_countWorkers;
+	}
+
+	/**
+	 * Returns utilization of the workers - time spent in tasks / (wall time * count of workers).
+	 */
+	double GetUtilization() const;
+
+	/**
+	 * Returns count of stolen tasks.
+	 */
+	int GetCountSteals() const;
+
+	/**
+	 * Returns the largest estimated memory of the tasks running at once in the last run (byte).
+	 */
+	inline long long GetPeakTaskMemory() const
+	{
+		return m_peakMemory;
+	}
+
+	/**
+	 * Returns the largest count of tasks running at once in the last run.
+	 */
+	inline int GetPeakTasks() const
+	{
+		return m_peakTasks;
+	}
+
+	/**
+	 * Returns the resident set size at the start of the last run (byte), the part of the budget not available to the tasks.
+	 */
+	inline long long GetBaseMemory() const
+	{
+		return m_memoryBase;
+	}
+
+private:
+	/// One open file.
+	struct fileJob;
+
+	/// One channel of one open file.
+	struct channelJob
+	{
+		fileJob *                       m_file;
+		int                             m_channel;
+		std::string                     m_label;
+		DETECTOR_SETTINGS               m_settings;
+		CSpikeDetector *                m_detector;
+		std::vector<SAMPLEINDEX>        m_indexStart;
+		std::vector<SAMPLEINDEX>        m_indexStop;
+		std::vector<std::unique_ptr<CDetectorOutput> > m_subOut;
+		std::vector<std::unique_ptr<CDischarges> >     m_subDischarges;
+		std::vector<BATCH_TASK_TIMING>  m_timings;
+		std::atomic<int>                m_remaining;
+		std::string                     m_error;
+		std::mutex                      m_errorMutex;
+		std::unique_ptr<CDetectorOutput> m_out;
+		std::unique_ptr<CDischarges>     m_discharges;
+
+		channelJob(const DETECTOR_SETTINGS& settings)
+			: m_file(NULL), m_channel(0), m_settings(settings), m_detector(NULL), m_remaining(0)
+		{
+			/* empty */
+		}
+
+		~channelJob()
+		{
+			delete m_detector;
+		}
+	};
+
+	struct fileJob
+	{
+		int                        m_index;
+		CInputEDF *                m_model;
+		std::vector<channelJob*>   m_channels;
+		std::atomic<int>           m_remaining;
+
+		fileJob()
+			: m_index(0), m_model(NULL), m_remaining(0)
+		{
+			/* empty */
+		}
+	};
+
+	/// One task - one segment of one channel.
+	struct task
+	{
+		channelJob * m_channel;
+		int          m_segment;
+		long long    m_memory;
+	};
+
+	/// A deque of one worker.
+	struct workerQueue
+	{
+		std::deque<task> m_tasks;
+		std::mutex       m_mutex;
+		double           m_busy;
+		int              m_steals;
+	};
+
+	/**
+	 * Main loop of one worker.
+	 */
+	void workerRun(const int worker);
+
+	/**
+	 * Find a task - own deque, stealing, opening of the next file.
+	 * @return false when there is no work left
+	 */
+	bool getTask(const int worker, task& t, bool& stolen);
+
+	/**
+	 * Open the next file and push its tasks to the deque of the worker.
+	 * @return false if all files are open or the limit of open files is reached
+	 */
+	bool openNextFile(const int worker);
+
+	/**
+	 * Run one task and finish the channel and the file when it is the last one.
+	 */
+	void runTask(const int worker, const task& t, const bool stolen);
+
+	/**
+	 * Assemble the results of the segments of the channel.
+	 */
+	void finishChannel(channelJob * channel);
+
+	/**
+	 * Returns the memory budget of one worker - the budget less the resident set at the start, shared by the workers.
+	 */
+	long long taskBudget() const;
+
+	/**
+	 * Returns seconds since the start of the batch.
+	 */
+	double now() const;
+
+	/**
+	 * Remove results of the last run.
+	 */
+	void clear();
+
+// variables
+private:
+	DETECTOR_SETTINGS                     m_detectorSettings;
+	BATCH_SETTINGS                        m_settings;
+
+	/// input of the current run
+	const std::vector<std::string> *      m_files;
+	const std::vector<int> *              m_channels;
+
+	/// one deque per worker
+	std::vector<workerQueue*>             m_queues;
+
+	/// guards opening of the files, the memory budget and waiting
+	std::mutex                            m_mutex;
+	std::condition_variable               m_wake;
+	int                                   m_nextFile;
+	int                                   m_openFiles;
+	/// count of files being opened (their tasks are not pushed yet)
+	int                                   m_opening;
+	/// estimated memory of the running tasks
+	long long                             m_memoryUsed;
+	/// resident set size at the start of the run
+	long long                             m_memoryBase;
+	long long                             m_peakMemory;
+	/// count of running tasks
+	int                                   m_runningTasks;
+	int                                   m_peakTasks;
+	/// count of tasks pushed and not finished
+	int                                   m_pendingTasks;
+
+	std::vector<fileJob*>                 m_fileJobs;
+	std::vector<BATCH_CHANNEL_RESULT>     m_results;
+	std::vector<std::string>              m_fileErrors;
+	std::vector<BATCH_TASK_TIMING>        m_timings;
+
+	std::chrono::steady_clock::time_point m_startTime;
+	double                                m_wallTime;
+	int                                   m_countWorkers;
+};
+
+#endif
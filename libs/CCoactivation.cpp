@@ -0,0 +1,186 @@
+#include "CCoactivation.h"
+#include "CProfiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace std;
+
+/// A constructor.
+CCoactivation::CCoactivation(const int& countChannels, const vector<double>& tolerances)
+	: m_countChannels(countChannels), m_tolerances(tolerances), m_cellWidth(0)
+{
+	size_t i;
+
+	if (countChannels <= 0 || tolerances.empty())
+		throw "invalid settings of the co-activation";
+
+	for (i = 0; i < tolerances.size(); i++)
+	{
+		if (!(tolerances[i] > 0))
+			throw "the tolerances of the co-activation must be positive";
+		m_cellWidth = max(m_cellWidth, tolerances[i]);
+	}
+
+	Clear();
+}
+
+/// A virtual destructor.
+CCoactivation::~CCoactivation()
+{
+	/* empty */
+}
+
+/// Remove all spikes and counts.
+void CCoactivation::Clear()
+{
+	lock_guard<mutex> lock(m_mutex);
+
+	m_streams.assign(m_countChannels, vector<double>());
+	m_cells.clear();
+	m_matrices.assign(m_tolerances.size(), Eigen::SparseMatrix<int, Eigen::RowMajor>(m_countChannels, m_countChannels));
+	m_pending.assign(m_tolerances.size(), vector<Eigen::Triplet<int> >());
+}
+
+/// Add detections of one channel.
+void CCoactivation::Add(const int& channel, const CDetectorOutput& output)
+{
+	Add(channel, output.m_pos);
+}
+
+/// Add spikes of one channel, the new close pairs are counted against all spikes added before.
+void CCoactivation::Add(const int& channel, const vector<double>& positions)
+{
+	PROFILE_SCOPE("CCoactivation::Add");
+
+	if (channel < 0 || channel >= m_countChannels)
+		throw "channel of the co-activation out of range";
+
+	vector<double>                  spikes(positions);
+	vector<pair<double, int> >      candidates;
+	vector<double>                  nearest(m_countChannels, numeric_limits<double>::infinity());
+	vector<int>                     touched;
+	size_t                          countTolerances = m_tolerances.size();
+	size_t                          i, j, d;
+	long long                       cell, c;
+
+	sort(spikes.begin(), spikes.end());
+
+	lock_guard<mutex> lock(m_mutex);
+
+	const vector<double>& old = m_streams[channel];
+
+	for (i = 0; i < spikes.size(); i++)
+	{
+		const double& p = spikes[i];
+
+		// spikes of the other channels within the largest tolerance - the own and the neighbouring cells
+		candidates.clear();
+		cell = (long long)floor(p / m_cellWidth);
+		for (c = cell - 1; c <= cell + 1; c++)
+		{
+			unordered_map<long long, vector<pair<double, int> > >::const_iterator it = m_cells.find(c);
+			if (it == m_cells.end())
+				continue;
+
+			for (j = 0; j < it->second.size(); j++)
+			{
+				if (it->second[j].second != channel && fabs(it->second[j].first - p) <= m_cellWidth)
+					candidates.push_back(it->second[j]);
+			}
+		}
+
+		for (j = 0; j < candidates.size(); j++)
+		{
+			const double& q = candidates[j].first;
+			const int&    other = candidates[j].second;
+			double        distance = fabs(q - p);
+			double        previous = i > 0 ? fabs(q - spikes[i - 1]) : numeric_limits<double>::infinity();
+			double        closest = numeric_limits<double>::infinity();
+
+			if (nearest[other] == numeric_limits<double>::infinity())
+				touched.push_back(other);
+			nearest[other] = min(nearest[other], distance);
+
+			// the old spike of the other channel - the nearest spike of this channel before this batch
+			vector<double>::const_iterator below = lower_bound(old.begin(), old.end(), q);
+			if (below != old.end())
+				closest = *below - q;
+			if (below != old.begin())
+				closest = min(closest, q - *(below - 1));
+
+			for (d = 0; d < countTolerances; d++)
+			{
+				// the previous spike of the batch is the nearest earlier one, it already counted the spike
+				if (distance <= m_tolerances[d] && previous > m_tolerances[d] && closest > m_tolerances[d])
+					m_pending[d].push_back(Eigen::Triplet<int>(other, channel, 1));
+			}
+		}
+
+		// the new spike once per channel
+		for (j = 0; j < touched.size(); j++)
+		{
+			for (d = 0; d < countTolerances; d++)
+			{
+				if (nearest[touched[j]] <= m_tolerances[d])
+					m_pending[d].push_back(Eigen::Triplet<int>(channel, touched[j], 1));
+			}
+			nearest[touched[j]] = numeric_limits<double>::infinity();
+		}
+		touched.clear();
+
+		for (d = 0; d < countTolerances; d++)
+		{
+			if (m_pending[d].size() >= COACTIVATION_FOLD_TRIPLETS)
+				fold(d);
+		}
+	}
+
+	// the batch joins the grid and the stream of the channel
+	for (i = 0; i < spikes.size(); i++)
+		m_cells[(long long)floor(spikes[i] / m_cellWidth)].push_back(pair<double, int>(spikes[i], channel));
+
+	vector<double>& stream = m_streams[channel];
+	size_t countOld = stream.size();
+	stream.insert(stream.end(), spikes.begin(), spikes.end());
+	inplace_merge(stream.begin(), stream.begin() + countOld, stream.end());
+}
+
+/// Returns the matrix of the tolerance.
+Eigen::SparseMatrix<int, Eigen::RowMajor> CCoactivation::GetMatrix(const int& tolerance)
+{
+	lock_guard<mutex> lock(m_mutex);
+
+	if (tolerance < 0 || tolerance >= (int)m_tolerances.size())
+		throw "tolerance of the co-activation out of range";
+
+	fold(tolerance);
+	return m_matrices[tolerance];
+}
+
+/// Returns count of the spikes of the channel.
+long long CCoactivation::GetCountSpikes(const int& channel)
+{
+	lock_guard<mutex> lock(m_mutex);
+
+	if (channel < 0 || channel >= m_countChannels)
+		throw "channel of the co-activation out of range";
+
+	return m_streams[channel].size();
+}
+
+/// Add the pending triplets of the tolerance to its matrix, the duplicates are summed.
+void CCoactivation::fold(const int& tolerance)
+{
+	PROFILE_SCOPE("CCoactivation::fold");
+
+	if (m_pending[tolerance].empty())
+		return;
+
+	Eigen::SparseMatrix<int, Eigen::RowMajor> counts(m_countChannels, m_countChannels);
+	counts.setFromTriplets(m_pending[tolerance].begin(), m_pending[tolerance].end());
+	m_matrices[tolerance] += counts;
+
+	m_pending[tolerance].clear();
+}
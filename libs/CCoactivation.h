@@ -0,0 +1,119 @@
+#ifndef CCoactivation_H
+#define CCoactivation_H
+
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+
+#include "lib/Eigen/Sparse"
+#include "CSpikeDetector.h"
+
+/// The pending counts are added to the matrices when one tolerance collects this count of triplets.
+#define COACTIVATION_FOLD_TRIPLETS (1 << 20)
+
+/**
+ * Co-activation of the channels - the entry (i, j) of the matrix of the tolerance dt counts the spikes of the channel i
+ * with a spike of the channel j at most dt seconds apart. The matrix is not symmetric, the diagonal is empty
+ * (\ref GetCountSpikes).
+ *
+ * The spikes are added incrementally - by channel, by segment, in any order (\ref Add). Every channel keeps its sorted
+ * stream of spikes, all spikes are also in a grid of cells of the largest tolerance. A new spike looks only into its own
+ * and the neighbouring cells, so the work grows with the count of the spikes and of the close pairs, not with the count
+ * of channels squared. A new close pair is counted for every tolerance at once:
+ * - the new spike of the channel i once per channel j with any spike within dt,
+ * - the old spike of the channel j if it had no spike of the channel i within dt before (the nearest old spike of i
+ *   from its sorted stream, the previous spike of the same batch).
+ * The counts are collected as triplets and added to the sparse matrices by \ref COACTIVATION_FOLD_TRIPLETS. The
+ * counts do not depend on the order of the batches.
+ *
+ * The methods can be called from more threads at once (the segments of more channels detected in parallel).
+ */
+class CCoactivation
+{
+// methods
+public:
+	/**
+	 * A constructor.
+	 * @param countChannels count of channels
+	 * @param tolerances the tolerances dt of the matrices (second)
+	 */
+	CCoactivation(const int& countChannels, const std::vector<double>& tolerances);
+
+	/**
+	 * A virtual desctructor.
+	 */
+	virtual ~CCoactivation();
+
+	/**
+	 * Remove all spikes and counts.
+	 */
+	void Clear();
+
+	/**
+	 * Add detections of one channel, e.g. one segment of \ref CSpikeDetector::AnalyseChannel (\ref CSpikeDetector::SetSegmentDone).
+	 * @param channel number of the channel
+	 * @param output detections of the channel, positions in the file
+	 */
+	void Add(const int& channel, const CDetectorOutput& output);
+
+	/**
+	 * Add spikes of one channel.
+	 * @param channel number of the channel
+	 * @param positions positions of the spikes (second)
+	 */
+	void Add(const int& channel, const std::vector<double>& positions);
+
+	/**
+	 * Returns the matrix of the tolerance, rows and columns are the channels.
+	 * @param tolerance index of the tolerance
+	 */
+	Eigen::SparseMatrix<int, Eigen::RowMajor> GetMatrix(const int& tolerance);
+
+	/**
+	 * Returns count of the spikes of the channel.
+	 */
+	long long GetCountSpikes(const int& channel);
+
+	/**
+	 * Returns count of channels.
+	 */
+	inline int GetCountChannels() const
+	{
+		return m_countChannels;
+	}
+
+	/**
+	 * Returns the tolerances of the matrices (second).
+	 */
+	inline const std::vector<double>& GetTolerances() const
+	{
+		return m_tolerances;
+	}
+
+private:
+	/**
+	 * Add the pending triplets of the tolerance to its matrix.
+	 */
+	void fold(const int& tolerance);
+
+// variables
+private:
+	/// count of channels
+	int                                                           m_countChannels;
+	/// the tolerances (second)
+	std::vector<double>                                           m_tolerances;
+	/// width of the cells of the grid - the largest tolerance
+	double                                                        m_cellWidth;
+	/// sorted spikes of every channel
+	std::vector<std::vector<double> >                             m_streams;
+	/// the spikes in the cells of the grid - position and channel
+	std::unordered_map<long long, std::vector<std::pair<double, int> > > m_cells;
+	/// counts of the tolerances
+	std::vector<Eigen::SparseMatrix<int, Eigen::RowMajor> >       m_matrices;
+	/// counts of the tolerances not added to the matrices
+	std::vector<std::vector<Eigen::Triplet<int> > >               m_pending;
+	/// guards all members
+	std::mutex                                                    m_mutex;
+};
+
+#endif
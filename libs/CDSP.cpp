@@ -1,12 +1,26 @@
 #include "CDSP.h"
+#include "CProfiler.h"
 
 using namespace Eigen;
 using namespace std;
 
+atomic<int> CDSP::m_fastPaths(0);
+
+/// Switch the fast implementations of the kernels on.
+void CDSP::SetFastPaths(const int& mask)
+{
+    m_fastPaths = mask;
+}
+
 // Digital signal resampling ----------------------------------------------------------------------
 /// Method for digital signal resampling - In this program is used for decimating.
 void CDSP::ResampleOneChannel(vector<SIGNALTYPE>*& data, const int& actualFS, const int& requiredFS)
 {
+    PROFILE_SCOPE("CDSP::ResampleOneChannel");
+    PROFILE_COUNT("CDSP::ResampleOneChannel", data->size(), data->size() * sizeof(SIGNALTYPE));
+    PROFILE_MEMORY("CDSP::ResampleOneChannel", data->size() * (long long)(sizeof(SIGNALTYPE) + sizeof(float))
+                   + data->size() * (long long)requiredFS / actualFS * sizeof(SIGNALTYPE));
+
     int    i, j, outputSize;
     double val;
     int    expectedOutputSize = ceil(data->size() * (double)requiredFS/(double)actualFS);
@@ -14,7 +28,7 @@ void CDSP::ResampleOneChannel(vector<SIGNALTYPE>*& data, const int& actualFS, co
     int err, ret;
     float * out = new float[data->size()];
 
-    SRC_STATE* state = src_new(SRC_SINC_BEST_QUALITY, 1, &err);
+    SRC_STATE* state = src_new(IsFast(DSP_FAST_RESAMPLE) ? SRC_SINC_MEDIUM_QUALITY : SRC_SINC_BEST_QUALITY, 1, &err);
     SRC_DATA*  src_data = new SRC_DATA();
 
     src_data->data_in = &data->front();
@@ -60,6 +74,16 @@ void CDSP::ResampleOneChannel(vector<SIGNALTYPE>*& data, const int& actualFS, co
 /// Calculation of the absolute values of the Hilbert transform
 void CDSP::AbsHilbert(vector<SIGNALTYPE>& data)
 {
+	PROFILE_SCOPE("CDSP::AbsHilbert");
+	PROFILE_COUNT("CDSP::AbsHilbert", data.size(), data.size() * sizeof(SIGNALTYPE));
+	PROFILE_MEMORY("CDSP::AbsHilbert", data.size() * (long long)(sizeof(SIGNALTYPE) + 2 * sizeof(double) + sizeof(int)));
+
+	if (IsFast(DSP_FAST_HILBERT))
+	{
+		absHilbertFast(data);
+		return;
+	}
+
 	int i, sizeInput;
 	alglib::complex_1d_array in;
 	
@@ -112,11 +136,52 @@ void CDSP::AbsHilbert(vector<SIGNALTYPE>& data)
     }
 }
 
+/// Fast path of AbsHilbert - the spectrum of the analytic signal from the FFT of the real input.
+void CDSP::absHilbertFast(vector<SIGNALTYPE>& data)
+{
+	int i, sizeInput = data.size();
+	alglib::real_1d_array    in;
+	alglib::complex_1d_array spectrum;
+
+	if (sizeInput == 0)
+		return;
+
+	in.setlength(sizeInput);
+	for (i = 0; i < sizeInput; i++)
+		in[i] = data[i];
+
+	// the full spectrum, the negative frequencies are conjugated positive ones
+	alglib::fftr1d(in, spectrum);
+
+	// H - 1 for DC (and Nyquist of even length), 2 for the positive, 0 for the negative frequencies
+	for (i = 1; i < (sizeInput+1)/2; i++)
+	{
+		spectrum[i].x *= 2;
+		spectrum[i].y *= 2;
+	}
+	for (i = sizeInput/2 + 1; i < sizeInput; i++)
+	{
+		spectrum[i].x = 0;
+		spectrum[i].y = 0;
+	}
+
+	alglib::fftc1dinv(spectrum);
+
+	for (i = 0; i < sizeInput; i++)
+	{
+		complex<SIGNALTYPE> tmp(spectrum[i].x, spectrum[i].y);
+		data[i] = abs(tmp);
+	}
+}
+
 // Filtering ------------------------------------------------------------------------------------------
 
 /// Digital signal filtering 10-60Hz
 void CDSP::Filtering(vector<SIGNALTYPE>* data, const int& countChannels, const int& fs, const BANDWIDTH& bandwidth)
 {
+    PROFILE_SCOPE("CDSP::Filtering");
+    PROFILE_COUNT("CDSP::Filtering", (long long)countChannels * data[0].size(), (long long)countChannels * data[0].size() * sizeof(SIGNALTYPE));
+
 	int 			 i;
     vector<double>   a, b;
     CFiltFilt** 	 threads = new CFiltFilt*[countChannels];
@@ -214,6 +279,9 @@ void CDSP::Filtering(vector<SIGNALTYPE>* data, const int& countChannels, const i
 /// Digital signal filtering Nx50hz
 void CDSP::Filt50Hz(vector<SIGNALTYPE>* data, const int& countChannels, const int& fs, const int& hum_fs, const BANDWIDTH& bandwidth)
 {
+    PROFILE_SCOPE("CDSP::Filt50Hz");
+    PROFILE_COUNT("CDSP::Filt50Hz", (long long)countChannels * data[0].size(), (long long)countChannels * data[0].size() * sizeof(SIGNALTYPE));
+
     double 			 R = 1, r = 0.985, tmp, i;
     vector<int> 	 f0;
     vector<double>   b, a;
@@ -259,14 +327,11 @@ void CDSP::filt50Hz(vector<SIGNALTYPE>* data, const int& countChannels, const ve
 
 
 /// Zero-phase forward and reverse digital IIR filtering.
-void CDSP::FiltFilt(const vector<double>& B, const vector<double>& A, vector<SIGNALTYPE>* X)
+void CDSP::FiltFilt(const vector<double>& B, const vector<double>& A, vector<SIGNALTYPE>* X, FILTFILT_BUFFERS* buffers)
 {
-	CFiltFilt * filter;
+	CFiltFilt filter(B, A, X, buffers);
 
-	filter = new CFiltFilt(B, A, X);
-	filter->Run();
-
-	delete filter;
+	filter.Run();
 }
 
 // Butterworth filter design ----
@@ -512,11 +577,10 @@ bool CDSP::Butter(vector<double>& b, vector<double>& a, const int& order, const
 // ------------------------------------------------------------------------------------------------
 
 /// A constructor.
-CFiltFilt::CFiltFilt(const vector<double>& B, const vector<double>& A, vector<SIGNALTYPE>* X)
+CFiltFilt::CFiltFilt(const vector<double>& B, const vector<double>& A, vector<SIGNALTYPE>* X, FILTFILT_BUFFERS* buffers)
+    : m_B(B), m_A(A), m_X(X), m_buffers(buffers ? buffers : &m_ownBuffers)
 {
-    m_A = A;
-    m_B = B;
-    m_X = X;
+    /* empty */
 }
 
 /// A destructor.
@@ -528,16 +592,16 @@ CFiltFilt::~CFiltFilt()
 /// This is the entry point of the thread. Run filtering. 
 const char * CFiltFilt::Run()
 { 
-    vector<double> a, b, x, y;
-
-    a.assign(m_A.begin(), m_A.end());
-    b.assign(m_B.begin(), m_B.end());
-    x.assign(m_X->begin(), m_X->end());
+    PROFILE_SCOPE("CFiltFilt::Run");
+    PROFILE_COUNT("CFiltFilt::Run", m_X->size(), m_X->size() * sizeof(SIGNALTYPE));
+    // the input and the output, the padded signal and its reversed copy
+    PROFILE_MEMORY("CFiltFilt::Run", m_X->size() * (long long)(sizeof(SIGNALTYPE) + 4 * sizeof(double)));
 
     try
     {
-        filtFilt(b, a, x, y);
-        m_X->assign(y.begin(), y.end());
+        if (CDSP::IsFast(DSP_FAST_FILTFILT))
+            filtFiltFast();
+        else filtFilt();
     }
     catch(const char * e)
     {
@@ -547,23 +611,103 @@ const char * CFiltFilt::Run()
     return NULL;
 }
 
+/// The padded and normalized coefficients and the initial conditions.
+int CFiltFilt::prepare()
+{
+    FILTFILT_BUFFERS& w = *m_buffers;
+    int               nfilt = max(m_B.size(), m_A.size());
+
+    if (w.m_B == m_B && w.m_A == m_A && !w.m_zi.empty())
+        return nfilt;
+
+    if (m_A.empty())
+        throw "The feedback filter coefficients are empty.";
+    if (all_of(m_A.begin(), m_A.end(), [](double coef){ return coef == 0; }))
+        throw "At least one of the feedback filter coefficients has to be non-zero.";
+    if (m_A[0] == 0)
+        throw "First feedback coefficient has to be non-zero.";
+
+    // set up filter's initial conditions to remove DC offset problems at the
+    // beginning and end of the sequence
+    w.m_b.assign(m_B.begin(), m_B.end());
+    w.m_a.assign(m_A.begin(), m_A.end());
+    w.m_b.resize(nfilt, 0);
+    w.m_a.resize(nfilt, 0);
+    initialConditions(w.m_b, w.m_a, w.m_zi);
+
+    // Normalize feedback coefficients if a[0] != 1;
+    double a0 = w.m_a[0];
+    if (a0 != 1.0)
+    {
+        transform(w.m_a.begin(), w.m_a.end(), w.m_a.begin(), [a0](double v) { return v / a0; });
+        transform(w.m_b.begin(), w.m_b.end(), w.m_b.begin(), [a0](double v) { return v / a0; });
+    }
+
+    w.m_B.assign(m_B.begin(), m_B.end());
+    w.m_A.assign(m_A.begin(), m_A.end());
+    return nfilt;
+}
+
+/// The signal with the odd extension on both sides.
+void CFiltFilt::pad(const int& nfact)
+{
+    vector<double>&    s = m_buffers->m_signal[0];
+    const SIGNALTYPE * x = &m_X->front();
+    int                len = m_X->size();
+    int                i;
+    double             _2x0 = 2 * (double)x[0];
+    double             _2xl = 2 * (double)x[len-1];
+
+    s.resize(len + 2 * nfact);
+    for (i = 0; i < nfact; i++)
+    {
+        s[i] = _2x0 - x[nfact - i];
+        s[nfact + len + i] = _2xl - x[len - 2 - i];
+    }
+    for (i = 0; i < len; i++)
+        s[nfact + i] = x[i];
+}
+
 // Zero-phase digital filtering
 // this codo is from: http://stackoverflow.com/questions/17675053/matlabs-filtfilt-algorithm/27270420#27270420
-void CFiltFilt::filtFilt(vector<double> B, vector<double> A, const vector<double> &X, vector<double> &Y)
+void CFiltFilt::filtFilt()
 {
-    int len = X.size();     // length of input
-    int na = A.size();
-    int nb = B.size();
-    int nfilt = (nb > na) ? nb : na;
+    FILTFILT_BUFFERS& w = *m_buffers;
+    int len = m_X->size();     // length of input
+    int nfilt = max(m_B.size(), m_A.size());
     int nfact = 3 * (nfilt - 1); // length of edge transients
+    int i;
 
     if (len <= nfact)
         throw "Input data too short! Data must have length more than 3 times filter order.";
 
-    // set up filter's initial conditions to remove DC offset problems at the
-    // beginning and end of the sequence
-    B.resize(nfilt, 0);
-    A.resize(nfilt, 0);
+    prepare();
+    pad(nfact);
+
+    vector<double>& signal1 = w.m_signal[0];
+    vector<double>& signal2 = w.m_signal[1];
+    double y0;
+
+    // Do the forward and backward filtering
+    w.m_z.resize(nfilt);
+    y0 = signal1[0];
+    transform(w.m_zi.begin(), w.m_zi.end(), w.m_z.begin(), [y0](double val){ return val*y0; });
+    w.m_z[nfilt - 1] = 0;
+    filter(signal1, signal2);
+    reverse(signal2.begin(), signal2.end());   
+    y0 = signal2[0];
+    transform(w.m_zi.begin(), w.m_zi.end(), w.m_z.begin(), [y0](double val){ return val*y0; });
+    w.m_z[nfilt - 1] = 0;
+    filter(signal2, signal1);
+
+    for (i = 0; i < len; i++)
+        (*m_X)[i] = signal1[signal1.size() - nfact - 1 - i];
+}
+
+/// Initial conditions of the filter for the step response.
+void CFiltFilt::initialConditions(const vector<double>& B, const vector<double>& A, vector<double>& zi)
+{
+    int nfilt = A.size();
 
     vector<int> rows, cols;
     //rows = [1:nfilt-1           2:nfilt-1             1:nfilt-2];
@@ -596,40 +740,73 @@ void CFiltFilt::filtFilt(vector<double> B, vector<double> A, const vector<double
             data[j++] = -1.0;
     }
 
-    vector<double> leftpad = subvector_reverse(X, nfact, 1);
-    double _2x0 = 2 * X[0];
-    transform(leftpad.begin(), leftpad.end(), leftpad.begin(), [_2x0](double val) {return _2x0 - val; });
-
-    vector<double> rightpad = subvector_reverse(X, len - 2, len - nfact - 1);
-    double _2xl = 2 * X[len-1];
-    transform(rightpad.begin(), rightpad.end(), rightpad.begin(), [_2xl](double val) {return _2xl - val; });
-
-    double y0;
-    vector<double> signal1, signal2, zi;
-
-    signal1.reserve(leftpad.size() + X.size() + rightpad.size());
-    append_vector(signal1, leftpad);
-    append_vector(signal1, X);
-    append_vector(signal1, rightpad);
-
-    // Calculate initial conditions
     MatrixXd sp = MatrixXd::Zero(max_val(rows) + 1, max_val(cols) + 1);
     for (size_t k = 0; k < klen; ++k)
         sp(rows[k], cols[k]) = data[k];
     auto bb = VectorXd::Map(B.data(), B.size());
     auto aa = VectorXd::Map(A.data(), A.size());
     MatrixXd zzi = (sp.inverse() * (bb.segment(1, nfilt - 1) - (bb(0) * aa.segment(1, nfilt - 1))));
-    zi.resize(zzi.size());
 
-    // Do the forward and backward filtering
-    y0 = signal1[0];
-    transform(zzi.data(), zzi.data() + zzi.size(), zi.begin(), [y0](double val){ return val*y0; });
-    filter(B, A, signal1, signal2, zi);
-    reverse(signal2.begin(), signal2.end());   
-    y0 = signal2[0];
-    transform(zzi.data(), zzi.data() + zzi.size(), zi.begin(), [y0](double val){ return val*y0; });
-    filter(B, A, signal2, signal1, zi);
-    Y = subvector_reverse(signal1, signal1.size() - nfact - 1, nfact);
+    zi.assign(zzi.data(), zzi.data() + zzi.size());
+}
+
+/// Fast path of filtFilt - both passes in place in one padded buffer.
+void CFiltFilt::filtFiltFast()
+{
+    FILTFILT_BUFFERS& w = *m_buffers;
+    int            len = m_X->size();
+    int            nfilt = max(m_B.size(), m_A.size());
+    int            nfact = 3 * (nfilt - 1); // length of edge transients
+    int            i, k, order;
+    double         x0, y;
+
+    if (len <= nfact)
+        throw "Input data too short! Data must have length more than 3 times filter order.";
+
+    prepare();
+
+    // odd extension on both sides
+    pad(nfact);
+    vector<double>& s = w.m_signal[0];
+
+    // transposed direct form II, the same order of the operations as filter()
+    order = nfilt - 1;
+    w.m_z.assign(nfilt, 0);
+    double *       z = &w.m_z[0];
+    const double * zi = w.m_zi.data();
+    const double * b = &w.m_b[0];
+    const double * a = &w.m_a[0];
+
+    // forward
+    x0 = s.front();
+    for (k = 0; k < order; k++)
+        z[k] = zi[k] * x0;
+    z[order] = 0;
+    for (i = 0; i < (int)s.size(); i++)
+    {
+        x0 = s[i];
+        y = b[0] * x0 + z[0];
+        for (k = 1; k <= order; k++)
+            z[k-1] = b[k] * x0 - a[k] * y + z[k];
+        s[i] = y;
+    }
+
+    // backward
+    x0 = s.back();
+    for (k = 0; k < order; k++)
+        z[k] = zi[k] * x0;
+    z[order] = 0;
+    for (i = s.size() - 1; i >= 0; i--)
+    {
+        x0 = s[i];
+        y = b[0] * x0 + z[0];
+        for (k = 1; k <= order; k++)
+            z[k-1] = b[k] * x0 - a[k] * y + z[k];
+        s[i] = y;
+    }
+
+    for (i = 0; i < len; i++)
+        (*m_X)[i] = s[nfact + i];
 }
 
 void CFiltFilt::add_index_range(vector<int> &indices, int beg, int end, int inc = 1)
@@ -644,47 +821,16 @@ void CFiltFilt::add_index_const(vector<int> &indices, int value, size_t numel)
         indices.push_back(value);
 }
 
-void CFiltFilt::append_vector(vector<double> &vec, const vector<double> &tail)
-{
-    vec.insert(vec.end(), tail.begin(), tail.end());
-}
-
-vector<double> CFiltFilt::subvector_reverse(const vector<double> &vec, int idx_end, int idx_start)
+void CFiltFilt::filter(const vector<double> &X, vector<double> &Y)
 {
-    vector<double> result(&vec[idx_start], &vec[idx_end+1]);
-    reverse(result.begin(), result.end());
-
-    return result;
-}
-
-void CFiltFilt::filter(vector<double> B, vector<double> A, const vector<double> &X, vector<double> &Y, vector<double> &Zi)
-{
-    if (A.empty())
-        throw "The feedback filter coefficients are empty.";
-    if (all_of(A.begin(), A.end(), [](double coef){ return coef == 0; }))
-        throw "At least one of the feedback filter coefficients has to be non-zero.";
-    if (A[0] == 0)
-        throw "First feedback coefficient has to be non-zero.";
-
-    // Normalize feedback coefficients if a[0] != 1;
-    double a0 = A[0];
-    if (a0 != 1.0)
-    {       
-        transform(A.begin(), A.end(), A.begin(), [a0](double v) { return v / a0; });
-        transform(B.begin(), B.end(), B.begin(), [a0](double v) { return v / a0; });
-    }
-
     size_t input_size = X.size();
-    size_t filter_order = max(A.size(), B.size());
-    B.resize(filter_order, 0);
-    A.resize(filter_order, 0);  
-    Zi.resize(filter_order, 0);
+    size_t filter_order = m_buffers->m_a.size();
     Y.resize(input_size);
 
     const double *x = &X[0];
-    const double *b = &B[0];  
-    const double *a = &A[0];
-    double *z = &Zi[0];
+    const double *b = &m_buffers->m_b[0];  
+    const double *a = &m_buffers->m_a[0];
+    double *z = &m_buffers->m_z[0];
     double *y = &Y[0];
 
     for (size_t i = 0; i < input_size; ++i)
@@ -698,5 +844,4 @@ void CFiltFilt::filter(vector<double> B, vector<double> A, const vector<double>
         }
         y[i] = b[0] * x[i] + z[0];
     }
-    Zi.resize(filter_order - 1);
 }
\ No newline at end of file
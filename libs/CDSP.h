@@ -8,6 +8,7 @@
 #include <cmath>
 #include <string.h>
 #include <cstdlib> 
+#include <atomic>
 
 #include "Definitions.h"
 #include "lib/samplerate.h"
@@ -35,6 +36,26 @@ enum FILTERTYPE
 	HIGHPASS = 1 
 };
 
+/**
+ * Fast implementations of the kernels, switched by \ref CDSP::SetFastPaths. The reference implementations are the default,
+ * edf-verify compares both.
+ */
+enum DSP_FAST_PATH
+{
+	/// CFiltFilt - both passes in place in one buffer
+	DSP_FAST_FILTFILT = 1,
+	/// CDSP::AbsHilbert - FFT of the real input
+	DSP_FAST_HILBERT  = 2,
+	/// CDSP::ResampleOneChannel - medium quality sinc converter
+	DSP_FAST_RESAMPLE = 4,
+	/// COneChannelDetect::Thresholds - padding of the interpolated statistics in one pass
+	DSP_FAST_SPLINE   = 8,
+	/// COneChannelDetect::localMaximaDetection - without rescanning of the markers
+	DSP_FAST_MAXIMA   = 16,
+	/// all fast paths
+	DSP_FAST_ALL      = 31
+};
+
 /**
  * Coefficients of filter design
  */
@@ -45,6 +66,27 @@ struct coeff {
 	double* den; 
 };
 
+/**
+ * Work buffers of \ref CFiltFilt, reused by the next filtering. The initial conditions are computed again only for other
+ * coefficients, the filtering of the same length with the same coefficients does not allocate.
+ */
+typedef struct filtFiltBuffers
+{
+public:
+	/// the numerator and denominator coefficients of the last filtering
+	std::vector<double>   m_B;
+	std::vector<double>   m_A;
+	/// the coefficients padded to the same length and normalized by A[0]
+	std::vector<double>   m_b;
+	std::vector<double>   m_a;
+	/// initial conditions of the filter for the step response
+	std::vector<double>   m_zi;
+	/// state of the filter
+	std::vector<double>   m_z;
+	/// the padded signal and the output of one pass
+	std::vector<double>   m_signal[2];
+} FILTFILT_BUFFERS;
+
 /**
  * Static class for digital signal processing.
  */
@@ -52,6 +94,20 @@ class CDSP
 {
 // methods
 public:
+	/**
+	 * Switch the fast implementations of the kernels on, for all threads.
+	 * @param mask combination of \ref DSP_FAST_PATH flags, 0 - the reference implementations
+	 */
+	static void SetFastPaths(const int& mask);
+
+	/**
+	 * Returns true if the fast implementation of the kernel is switched on.
+	 */
+	static inline bool IsFast(const DSP_FAST_PATH& path)
+	{
+		return (m_fastPaths.load(std::memory_order_relaxed) & path) != 0;
+	}
+
 	/**
 	 * Method for digital signal resampling - In this program is used for decimating.
 	 * The result is save in the data param.
@@ -87,8 +143,10 @@ public:
 	 * @param A vector describing filter.
 	 * @param B vector describing filter.
 	 * @param X input and output vector.
+	 * @param buffers work buffers reused by the calls with the same coefficients, NULL - temporary buffers
 	 */
-	static void FiltFilt(const std::vector<double>& B, const std::vector<double>& A, std::vector<SIGNALTYPE>* X);
+	static void FiltFilt(const std::vector<double>& B, const std::vector<double>& A, std::vector<SIGNALTYPE>* X,
+						 FILTFILT_BUFFERS* buffers = NULL);
 
 	/**
 	 * Calculation of the absolute values of the Hilbert transform.
@@ -143,6 +201,16 @@ private:
 	 */				
 	static int calcButterCoeff(unsigned int nchann, int proctype, double fc,
                       unsigned int num_pole, int highpass, struct coeff *coeff);
+
+	/**
+	 * Fast path of \ref AbsHilbert - the spectrum of the analytic signal from the FFT of the real input.
+	 */
+	static void absHilbertFast(std::vector<SIGNALTYPE>& data);
+
+// variables
+private:
+	/// switched fast paths, \ref DSP_FAST_PATH
+	static std::atomic<int> m_fastPaths;
 };
 
 /**
@@ -156,11 +224,12 @@ private:
  public:
  	/**
  	 * A constructor.
- 	 * @param B the numerator coefficients
- 	 * @param A the denominator coefficients
+ 	 * @param B the numerator coefficients, referenced until the end of \ref Run
+ 	 * @param A the denominator coefficients, referenced until the end of \ref Run
  	 * @param X data for filtering
+ 	 * @param buffers work buffers, NULL - own buffers of the object
  	 */
- 	CFiltFilt(const std::vector<double>& B, const std::vector<double>& A, std::vector<SIGNALTYPE>* X);
+ 	CFiltFilt(const std::vector<double>& B, const std::vector<double>& A, std::vector<SIGNALTYPE>* X, FILTFILT_BUFFERS* buffers = NULL);
 
  	/**
  	 * A desctructor.
@@ -172,23 +241,48 @@ private:
 
  private:
  	// methonds from: http://stackoverflow.com/questions/17675053/matlabs-filtfilt-algorithm/27270420#27270420
- 	void filtFilt(std::vector<double> B, std::vector<double> A, const std::vector<double> &X, std::vector<double> &Y);
+ 	void filtFilt();
 	void add_index_range(std::vector<int> &indices, int beg, int end, int inc);
 	void add_index_const(std::vector<int> &indices, int value, size_t numel);
-	void append_vector(std::vector<double> &vec, const std::vector<double> &tail);
-	std::vector<double> subvector_reverse(const std::vector<double> &vec, int idx_end, int idx_start);
 	inline int max_val(const std::vector<int>& vec){ return std::max_element(vec.begin(), vec.end())[0]; }
-	void filter(std::vector<double> B, std::vector<double> A, const std::vector<double> &X, std::vector<double> &Y, std::vector<double> &Zi);
+	void filter(const std::vector<double> &X, std::vector<double> &Y);
+
+	/**
+	 * The padded and normalized coefficients and the initial conditions in the buffers, kept if the coefficients are
+	 * the same as in the last filtering.
+	 * @return count of the coefficients of the padded filter
+	 */
+	int prepare();
+
+	/**
+	 * The signal with the odd extension of nfact samples on both sides to the first buffer.
+	 */
+	void pad(const int& nfact);
+
+	/**
+	 * Initial conditions of the filter for the step response (MATLAB filtfilt), B and A have the same length.
+	 * @param zi output - the initial conditions for an input of 1
+	 */
+	void initialConditions(const std::vector<double>& B, const std::vector<double>& A, std::vector<double>& zi);
+
+	/**
+	 * Fast path of \ref filtFilt - the padded signal is filtered forward and backward in place, the results are the same.
+	 */
+	void filtFiltFast();
 
  // variables
  public:
  private:
  	/// the numerator coefficients
- 	std::vector<double>      m_B; 
+ 	const std::vector<double>& m_B;
  	/// the denominator coefficients
-	std::vector<double>      m_A; 
+	const std::vector<double>& m_A;
 	/// data for filtering
- 	std::vector<SIGNALTYPE>* m_X; 
+ 	std::vector<SIGNALTYPE>*   m_X;
+	/// the work buffers
+	FILTFILT_BUFFERS*          m_buffers;
+	/// own work buffers, used without the buffers of the caller
+	FILTFILT_BUFFERS           m_ownBuffers;
  };
 
 // auxiliary classes
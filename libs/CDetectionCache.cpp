@@ -0,0 +1,230 @@
+#include "CDetectionCache.h"
+#include "CPipeline.h"
+
+using namespace std;
+
+/// A constructor.
+CDetectionCache::CDetectionCache(const DETECTOR_SETTINGS& settings)
+	: m_settings(settings), m_stop(false), m_running(false), m_attached(false)
+{
+	/* empty */
+}
+
+/// A virtual destructor.
+CDetectionCache::~CDetectionCache()
+{
+	Detach();
+}
+
+/// Attach an open file.
+void CDetectionCache::Attach(const struct edf_hdr_struct& hdr)
+{
+	Detach();
+
+	lock_guard<mutex> lock(m_mutex);
+
+	m_complete.clear();
+
+	m_model.AttachFile(hdr);
+	m_attached = true;
+}
+
+/// Stop the background detection and forget the file.
+void CDetectionCache::Detach()
+{
+	stop();
+
+	lock_guard<mutex> lock(m_mutex);
+	m_model.CloseFile();
+	m_attached = false;
+}
+
+/// Detect the derivations of the montage.
+void CDetectionCache::SetMontage(const shared_ptr<const CMontage>& montage, const shared_ptr<CPageCache>& pages)
+{
+	stop();
+
+	lock_guard<mutex> lock(m_mutex);
+
+	if (!m_attached)
+		throw "Warning: isn't open any file! You must first open input file!";
+
+	m_complete.clear();
+	m_model.SetPageCache(pages);
+	m_model.SetMontage(montage);
+}
+
+/// Returns detections of the channel with the onset in [t0, t1].
+bool CDetectionCache::Query(const int& channel, const double& t0, const double& t1, unique_ptr<CDetectorOutput>& output)
+{
+	{
+		lock_guard<mutex> lock(m_mutex);
+
+		map<int, unique_ptr<CDetectorOutput> >::const_iterator it = m_complete.find(channel);
+		if (it != m_complete.end())
+		{
+			const CDetectorOutput * all = it->second.get();
+			int                     first, last, i;
+
+			// the detections of the channel are sorted
+			all->FindRange(t0, t1, first, last);
+
+			output.reset(new CDetectorOutput());
+			output->Reserve(last - first);
+			for (i = first; i < last; i++)
+				output->Add(all->m_pos[i], all->m_dur[i], all->m_chan[i], all->m_con[i], all->m_weight[i], all->m_pdf[i]);
+
+			return true;
+		}
+
+		if (!m_attached)
+			throw "Warning: isn't open any file! You must first open input file!";
+	}
+
+	// the visible range only, the background thread can read the same file
+	DETECTOR_SETTINGS settings = m_settings;
+	CSpikeDetector    detector(&m_model, &settings);
+	unique_ptr<CDischarges> discharges;
+
+	detector.AnalyseRange(channel, t0, t1, output, discharges);
+
+	return false;
+}
+
+/// Queue the whole channel for the background detection.
+void CDetectionCache::StartBackground(const int& channel, const function<void(int)>& done)
+{
+	lock_guard<mutex> lock(m_mutex);
+
+	if (!m_attached || m_complete.count(channel))
+		return;
+
+	for (size_t i = 0; i < m_queue.size(); i++)
+		if (m_queue[i] == channel)
+			return;
+
+	m_queue.push_back(channel);
+	m_done = done;
+
+	if (!m_running)
+	{
+		// the previous thread has left the mutex for good
+		if (m_thread.joinable())
+			m_thread.join();
+
+		m_stop = false;
+		m_running = true;
+		m_thread = thread(&CDetectionCache::backgroundRun, this);
+	}
+}
+
+/// Keep the curves of the time range of the channel for retuning.
+void CDetectionCache::QueryRetune(const int& channel, const double& t0, const double& t1, CThresholdRetune& retune)
+{
+	{
+		lock_guard<mutex> lock(m_mutex);
+
+		if (!m_attached)
+			throw "Warning: isn't open any file! You must first open input file!";
+	}
+
+	// the same segments as Query, the background thread can read the same file
+	CPipeline pipeline(&m_model, retune.GetSettings());
+
+	pipeline.AddDetector(&retune);
+	pipeline.RunRange(channel, t0, t1);
+}
+
+/// Returns true if the whole channel is detected.
+bool CDetectionCache::IsComplete(const int& channel)
+{
+	lock_guard<mutex> lock(m_mutex);
+	return m_complete.count(channel) != 0;
+}
+
+/// Entry point of the background thread.
+void CDetectionCache::backgroundRun()
+{
+	int                      channel;
+	unique_ptr<CDetectorOutput> output;
+	function<void(int)>      done;
+
+	while (!m_stop)
+	{
+		{
+			lock_guard<mutex> lock(m_mutex);
+
+			if (m_queue.empty())
+				break;
+			channel = m_queue.front();
+		}
+
+		try
+		{
+			output = detectChannel(channel);
+		}
+		catch (const char *)
+		{
+			// the channel can not be detected, the queries detect the visible range
+			output.reset();
+		}
+
+		{
+			lock_guard<mutex> lock(m_mutex);
+
+			if (!m_queue.empty())
+				m_queue.pop_front();
+			if (!output)
+				continue;
+
+			m_complete[channel] = std::move(output);
+			done = m_done;
+		}
+
+		if (done)
+			done(channel);
+	}
+
+	lock_guard<mutex> lock(m_mutex);
+	m_running = false;
+}
+
+/// Detect the whole channel, segment after segment.
+unique_ptr<CDetectorOutput> CDetectionCache::detectChannel(const int& channel)
+{
+	DETECTOR_SETTINGS    		settings = m_settings;
+	CSpikeDetector       		detector(&m_model, &settings);
+	vector<SAMPLEINDEX>  		indexStart, indexStop;
+	unique_ptr<CDetectorOutput> output(new CDetectorOutput());
+	CDischarges          		discharges(1);
+	unique_ptr<CDetectorOutput> subOut;
+	unique_ptr<CDischarges>     subDischarges;
+	int                  		i;
+
+	detector.GetSegments(channel, indexStart, indexStop);
+	for (i = 0; i < (int)indexStop.size() && !m_stop; i++)
+	{
+		if (!detector.AnalyseSegment(channel, indexStart, indexStop, i, subOut, subDischarges))
+			break;
+
+		CSpikeDetector::AppendSegment(*output, discharges, std::move(*subOut), std::move(*subDischarges));
+	}
+
+	if (m_stop)
+		output.reset();
+
+	return output;
+}
+
+/// Stop the background thread.
+void CDetectionCache::stop()
+{
+	m_stop = true;
+	if (m_thread.joinable())
+		m_thread.join();
+	m_stop = false;
+
+	lock_guard<mutex> lock(m_mutex);
+	m_queue.clear();
+	m_running = false;
+}
@@ -0,0 +1,142 @@
+#ifndef CDetectionCache_H
+#define CDetectionCache_H
+
+#include <vector>
+#include <deque>
+#include <map>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <functional>
+
+#include "CInputEDF.h"
+#include "CSpikeDetector.h"
+#include "CThresholdRetune.h"
+
+/**
+ * Spike detections of the channels of one open file for the viewer.
+ * The visible time range is detected at once (\ref CSpikeDetector::AnalyseRange), the whole channels are detected
+ * by a background thread in the order of the requests. When a channel is complete, the queries of the channel are
+ * answered from the stored detections.
+ *
+ * The file is opened by the caller (\ref CInputEDF::AttachFile) and read with positional reads, the caller can
+ * read it at the same time. \ref Detach must be called before the file is closed.
+ */
+class CDetectionCache
+{
+// methods
+public:
+	/**
+	 * A constructor.
+	 * @param settings settings of the detector
+	 */
+	CDetectionCache(const DETECTOR_SETTINGS& settings);
+
+	/**
+	 * A virtual desctructor. Stops the background detection.
+	 */
+	virtual ~CDetectionCache();
+
+	/**
+	 * Attach an open file, the detections of the previous file are removed.
+	 * @param hdr header of the file
+	 */
+	void Attach(const struct edf_hdr_struct& hdr);
+
+	/**
+	 * Stop the background detection and forget the file (before closing the file). The detections are kept.
+	 */
+	void Detach();
+
+	/**
+	 * Detect the derivations of the montage instead of the signals, the detections of the previous channels are
+	 * removed. The background detection is stopped, the channels of the queries are the derivations.
+	 * @param montage montage of the attached file, NULL - the signals
+	 * @param pages decoded pages of the attached file, shared with the viewer
+	 */
+	void SetMontage(const std::shared_ptr<const CMontage>& montage, const std::shared_ptr<CPageCache>& pages);
+
+	/**
+	 * Returns detections of the channel with the onset in [t0, t1]. Detected at once if the whole channel is not
+	 * complete yet. Throws an error message of the detector.
+	 * @param channel number of the channel
+	 * @param t0 start of the range (second)
+	 * @param t1 end of the range (second)
+	 * @param output output - detections
+	 * @return true if the detections are taken from the complete channel
+	 */
+	bool Query(const int& channel, const double& t0, const double& t1, std::unique_ptr<CDetectorOutput>& output);
+
+	/**
+	 * Keep the envelope and the lognormal curves of the time range of the channel (with the margins of \ref Query) for
+	 * the retuning of the thresholds (\ref CThresholdRetune::Retune). Throws an error message of the detector.
+	 * @param channel number of the channel
+	 * @param t0 start of the range (second)
+	 * @param t1 end of the range (second)
+	 * @param retune output - the curves of the range, the settings of the retune are used
+	 */
+	void QueryRetune(const int& channel, const double& t0, const double& t1, CThresholdRetune& retune);
+
+	/**
+	 * Queue the whole channel for the background detection, a complete or queued channel is skipped.
+	 * @param channel number of the channel
+	 * @param done called from the background thread when the channel is complete (optional)
+	 */
+	void StartBackground(const int& channel, const std::function<void(int)>& done = std::function<void(int)>());
+
+	/**
+	 * Returns the settings of the detector.
+	 */
+	inline const DETECTOR_SETTINGS& GetSettings() const
+	{
+		return m_settings;
+	}
+
+	/**
+	 * Returns true if the whole channel is detected.
+	 */
+	bool IsComplete(const int& channel);
+
+private:
+	/**
+	 * Entry point of the background thread - detects the queued channels.
+	 */
+	void backgroundRun();
+
+	/**
+	 * Detect the whole channel, segment after segment.
+	 * @return detections, empty if stopped
+	 */
+	std::unique_ptr<CDetectorOutput> detectChannel(const int& channel);
+
+	/**
+	 * Stop the background thread, the queue is cleared.
+	 */
+	void stop();
+
+// variables
+private:
+	/// settings of the detector
+	DETECTOR_SETTINGS                  m_settings;
+	/// the attached file
+	CInputEDF                          m_model;
+	/// detections of the complete channels
+	std::map<int, std::unique_ptr<CDetectorOutput> > m_complete;
+	/// channels waiting for the background detection
+	std::deque<int>                    m_queue;
+	/// called when a channel is complete
+	std::function<void(int)>           m_done;
+	/// guards m_complete, m_queue and m_done
+	std::mutex                         m_mutex;
+	/// background detection thread
+	std::thread                        m_thread;
+	/// request to stop the background thread
+	std::atomic<bool>                  m_stop;
+	/// the background thread is running, guarded by m_mutex
+	bool                               m_running;
+	/// a file is attached
+	bool                               m_attached;
+};
+
+#endif
@@ -0,0 +1,88 @@
+#include "CDetectorArena.h"
+#include "CProfiler.h"
+
+using namespace std;
+
+/// Bytes held by a vector.
+template<typename T> static long long arenaBytes(const vector<T>& buffer)
+{
+	return buffer.capacity() * sizeof(T);
+}
+
+/// Bytes held by a vector of bits.
+static long long arenaBytes(const vector<bool>& buffer)
+{
+	return buffer.capacity() / 8;
+}
+
+/// A constructor.
+CDetectorArena::CDetectorArena()
+	: m_countSegments(0), m_segmentStart(0), m_segmentAllocations(0), m_allocations(0)
+{
+	m_result.m_markersHigh = &m_markersHigh;
+	m_result.m_markersLow = &m_markersLow;
+}
+
+/// A virtual destructor.
+CDetectorArena::~CDetectorArena()
+{
+	/* empty */
+}
+
+/// Returns the arena of the calling thread.
+CDetectorArena& CDetectorArena::GetThreadArena()
+{
+	static thread_local CDetectorArena arena;
+	return arena;
+}
+
+/// Start counting the allocations of one segment.
+void CDetectorArena::BeginSegment()
+{
+	m_segmentStart = CProfiler::GetThreadAllocations();
+}
+
+/// Stop counting the allocations of the segment.
+void CDetectorArena::EndSegment()
+{
+	m_segmentAllocations = CProfiler::GetThreadAllocations() - m_segmentStart;
+	m_allocations += m_segmentAllocations;
+	m_countSegments++;
+}
+
+/// Forget the counters of the previous segments.
+void CDetectorArena::ResetCounters()
+{
+	m_countSegments = 0;
+	m_segmentAllocations = 0;
+	m_allocations = 0;
+}
+
+/// Returns the bytes held by the buffers.
+long long CDetectorArena::GetCapacity() const
+{
+	long long bytes = 0;
+	int       i;
+
+	bytes += arenaBytes(m_segment.m_raw) + arenaBytes(m_segment.m_resampled) + arenaBytes(m_segment.m_notch)
+		+ arenaBytes(m_segment.m_bandpass) + arenaBytes(m_segment.m_envelope);
+	bytes += arenaBytes(m_index) + arenaBytes(m_markersHigh) + arenaBytes(m_markersLow);
+	bytes += arenaBytes(m_result.m_prahInt[0]) + arenaBytes(m_result.m_prahInt[1]) + arenaBytes(m_result.m_envelopeCdf)
+		+ arenaBytes(m_result.m_envelopePdf) + arenaBytes(m_result.m_envelope);
+	bytes += arenaBytes(m_phatMedian) + arenaBytes(m_phatStd) + arenaBytes(m_logs) + arenaBytes(m_smoothingB) + arenaBytes(m_smoothingA);
+	bytes += arenaBytes(m_smoothing.m_B) + arenaBytes(m_smoothing.m_A) + arenaBytes(m_smoothing.m_b) + arenaBytes(m_smoothing.m_a)
+		+ arenaBytes(m_smoothing.m_zi) + arenaBytes(m_smoothing.m_z) + arenaBytes(m_smoothing.m_signal[0]) + arenaBytes(m_smoothing.m_signal[1]);
+	bytes += arenaBytes(m_thresholdsX) + arenaBytes(m_thresholdsY) + arenaBytes(m_phatMedianDouble) + arenaBytes(m_phatStdDouble);
+	bytes += arenaBytes(m_maximaPointer) + arenaBytes(m_maximaSegment) + arenaBytes(m_maximaSigns) + arenaBytes(m_maximaDiff)
+		+ arenaBytes(m_maximaLocal) + arenaBytes(m_maximaLocalPosition) + arenaBytes(m_maximaLocalValue) + arenaBytes(m_maximaLocalDiff);
+	bytes += arenaBytes(m_unionMask) + arenaBytes(m_unionMarkers) + arenaBytes(m_assemblyObvious);
+	bytes += arenaBytes(m_assemblyFirst) + arenaBytes(m_assemblyLast) + arenaBytes(m_assemblyOrder) + arenaBytes(m_assemblyEvent)
+		+ arenaBytes(m_assemblyM);
+
+	for (i = 0; i < 2; i++)
+	{
+		bytes += arenaBytes(m_phatInt[i]) + arenaBytes(m_maximaPoint[i]) + arenaBytes(m_unionPoint[i]);
+	}
+
+	return bytes;
+}
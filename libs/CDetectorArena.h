@@ -0,0 +1,143 @@
+#ifndef CDetectorArena_H
+#define CDetectorArena_H
+
+#include <vector>
+
+#include "Definitions.h"
+#include "CDSP.h"
+#include "CSpikeDetector.h"
+#include "CPipeline.h"
+
+/**
+ * Temporary buffers of the detector for one segment, reused by the next segment of the same thread.
+ *
+ * The buffers are cleared or resized by their users and keep their capacity, after the first segments (the longest
+ * one) the detection of a segment (\ref CSpikeDetector::DetectSegment) does not grow them. Every thread has its own
+ * arena (\ref GetThreadArena), every function of the detector has its own buffers - the buffers of one function are
+ * not valid after the next call of the function in the same thread. The buffers are released when the thread ends.
+ *
+ * The calls of the global allocator are counted per segment (\ref BeginSegment, \ref EndSegment) if the
+ * instrumentation is compiled in (EDF_PROFILE, \ref CProfiler::GetThreadAllocations).
+ */
+class CDetectorArena
+{
+// methods
+public:
+	/**
+	 * A constructor.
+	 */
+	CDetectorArena();
+
+	/**
+	 * A virtual desctructor.
+	 */
+	virtual ~CDetectorArena();
+
+	/**
+	 * Returns the arena of the calling thread, created at the first use.
+	 */
+	static CDetectorArena& GetThreadArena();
+
+	/**
+	 * Start counting the allocations of one segment.
+	 */
+	void BeginSegment();
+
+	/**
+	 * Stop counting the allocations of the segment.
+	 */
+	void EndSegment();
+
+	/**
+	 * Forget the counters of the previous segments, the buffers are kept.
+	 */
+	void ResetCounters();
+
+	/**
+	 * Returns count of the segments since \ref ResetCounters.
+	 */
+	inline long long GetCountSegments() const
+	{
+		return m_countSegments;
+	}
+
+	/**
+	 * Returns calls of the global allocator in the last segment, 0 without EDF_PROFILE.
+	 */
+	inline long long GetSegmentAllocations() const
+	{
+		return m_segmentAllocations;
+	}
+
+	/**
+	 * Returns calls of the global allocator in all segments since \ref ResetCounters, 0 without EDF_PROFILE.
+	 */
+	inline long long GetAllocations() const
+	{
+		return m_allocations;
+	}
+
+	/**
+	 * Returns the bytes held by the buffers of the arena.
+	 */
+	long long GetCapacity() const;
+
+// variables
+public:
+	/// streams of the segment (\ref CSpikeDetector::spikeDetector)
+	PIPELINE_SEGMENT                  m_segment;
+	/// starts of the windows (\ref CSpikeDetector::DetectSegment)
+	std::vector<int>                  m_index;
+	/// result of \ref COneChannelDetect::Run, the markers point to m_markersHigh and m_markersLow
+	ONECHANNELDETECTRET               m_result;
+	std::vector<bool>                 m_markersHigh;
+	std::vector<bool>                 m_markersLow;
+
+	/// \ref COneChannelDetect::Run
+	std::vector<SIGNALTYPE>           m_phatMedian;
+	std::vector<SIGNALTYPE>           m_phatStd;
+	/// \ref COneChannelDetect::WindowStatistics
+	std::vector<double>               m_logs;
+	std::vector<double>               m_smoothingB;
+	std::vector<double>               m_smoothingA;
+	FILTFILT_BUFFERS                  m_smoothing;
+	/// \ref COneChannelDetect::Thresholds
+	std::vector<double>               m_thresholdsX;
+	std::vector<double>               m_thresholdsY;
+	std::vector<double>               m_phatMedianDouble;
+	std::vector<double>               m_phatStdDouble;
+	std::vector<double>               m_phatInt[2];
+	/// \ref COneChannelDetect::localMaximaDetection
+	std::vector<int>                  m_maximaPoint[2];
+	std::vector<int>                  m_maximaPointer;
+	std::vector<SIGNALTYPE>           m_maximaSegment;
+	std::vector<SIGNALTYPE>           m_maximaSigns;
+	std::vector<int>                  m_maximaDiff;
+	std::vector<int>                  m_maximaLocal;
+	std::vector<int>                  m_maximaLocalPosition;
+	std::vector<SIGNALTYPE>           m_maximaLocalValue;
+	std::vector<float>                m_maximaLocalDiff;
+	/// \ref COneChannelDetect::detectionUnion
+	std::vector<double>               m_unionMask;
+	std::vector<double>               m_unionMarkers;
+	std::vector<int>                  m_unionPoint[2];
+	/// \ref CSpikeDetector::AssembleDetections
+	std::vector<bool>                 m_assemblyObvious;
+	std::vector<int>                  m_assemblyFirst;
+	std::vector<int>                  m_assemblyLast;
+	std::vector<int>                  m_assemblyOrder;
+	std::vector<int>                  m_assemblyEvent;
+	std::vector<double>               m_assemblyM;
+
+private:
+	/// count of the segments
+	long long                         m_countSegments;
+	/// allocations of the thread at \ref BeginSegment
+	long long                         m_segmentStart;
+	/// allocations of the last segment
+	long long                         m_segmentAllocations;
+	/// allocations of all segments
+	long long                         m_allocations;
+};
+
+#endif
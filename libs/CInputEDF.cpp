@@ -1,8 +1,16 @@
 #include "CInputEDF.h"
-#include <qdebug.h>
+#include "CProfiler.h"
+
+#include <algorithm>
 
 using namespace std;
 
+CInputEDF::CInputEDF()
+	: m_endOfFile(false), m_isOpen(false), m_attached(false), m_start(0), m_T_seg(0), m_fs(0), m_countSamples(0)
+{
+	memset(&m_hdr, 0, sizeof(m_hdr));
+}
+
 CInputEDF::~CInputEDF()
 {
 	CloseFile();
@@ -31,9 +39,9 @@ void CInputEDF::OpenFile(const char * fileName)
 	m_fs = 0;
 	m_start = 0;
 	
-	if(edfopen_file_readonly(fileName, &m_hdr, EDFLIB_READ_ALL_ANNOTATIONS))
+	if(edfopen_file_readonly(fileName, &m_hdr, EDFLIB_DO_NOT_READ_ANNOTATIONS))
 	{
-		string error;
+		const char * error;
 		switch(m_hdr.filetype)
 		{
 		  case EDFLIB_MALLOC_ERROR:
@@ -58,10 +66,35 @@ void CInputEDF::OpenFile(const char * fileName)
 		  	error = "Unknown error.";
 		    break;
 		}
-		
+		throw error;
 	}
 
-	// get highest sample rate and length of signal
+	readSignals();
+	m_isOpen = true;
+	m_attached = false;
+	m_montage.reset();
+	m_pages.reset();
+}
+
+/// Use a file opened by the caller.
+void CInputEDF::AttachFile(const struct edf_hdr_struct& hdr)
+{
+	CloseFile();
+
+	m_hdr = hdr;
+	m_endOfFile = false;
+	m_fs = 0;
+	m_start = 0;
+
+	readSignals();
+	m_isOpen = true;
+	m_attached = true;
+}
+
+/// Get the highest sample rate and the length of the signal.
+void CInputEDF::readSignals()
+{
+	m_countSamples = 0;
 	for (int i = 0; i < m_hdr.edfsignals; i++)
 	{
 		if (m_hdr.signalparam[i].smp_in_datarecord > m_fs)
@@ -70,11 +103,28 @@ void CInputEDF::OpenFile(const char * fileName)
 			m_countSamples = m_hdr.signalparam[i].smp_in_file;
 		}
 	}
+}
 
-	m_isOpen = true;
+/// Read the derivations of the montage instead of the signals.
+void CInputEDF::SetMontage(const shared_ptr<const CMontage>& montage)
+{
+	if (montage && (!m_isOpen || montage->GetCountSignals() != m_hdr.edfsignals))
+		throw "Error: the montage does not belong to the open file!";
+
+	m_montage = montage;
+	if (m_montage && !m_pages)
+		m_pages.reset(new CPageCache());
 }
 
-vector<SIGNALTYPE> * CInputEDF::GetSegmentFromChannel(const int& channelNumber, const int& start, const int& end)
+/// Read the channels by pages kept in the cache.
+void CInputEDF::SetPageCache(const shared_ptr<CPageCache>& pages)
+{
+	m_pages = pages;
+	if (m_montage && !m_pages)
+		m_pages.reset(new CPageCache());
+}
+
+vector<SIGNALTYPE> * CInputEDF::GetSegmentFromChannel(const int& channelNumber, const SAMPLEINDEX& start, const SAMPLEINDEX& end)
 {
 	if (m_endOfFile)  
 		return NULL;
@@ -82,35 +132,206 @@ vector<SIGNALTYPE> * CInputEDF::GetSegmentFromChannel(const int& channelNumber,
 	if (!m_isOpen)
 		throw "Warning: isn't open any file! You must first open input file!";
 
-	if (channelNumber < 0 || channelNumber > m_hdr.edfsignals)
+	if (channelNumber < 0 || channelNumber >= GetCountChannels())
 		throw "Error: invalid channel number!";
 
-	int 				 i;
-	int 				 buffersize = end - start;
+	PROFILE_SCOPE("CInputEDF::GetSegmentFromChannel");
+
+	// the pages of the cache, the derivations are computed from the pages of their signals
+	if (m_pages)
+	{
+		vector<SIGNALTYPE> * data = new vector<SIGNALTYPE>;
+		SAMPLEINDEX          page, first, last;
+
+		data->reserve(end - start);
+		for (page = start / PAGE_CACHE_SAMPLES; page * PAGE_CACHE_SAMPLES < end; page++)
+		{
+			PAGE_DATA   samples = readPage(channelNumber, page);
+			SAMPLEINDEX offset = page * PAGE_CACHE_SAMPLES;
+
+			first = max(start, offset) - offset;
+			last = min(end, offset + (SAMPLEINDEX)samples->size()) - offset;
+			if (last > first)
+				data->insert(data->end(), samples->begin() + first, samples->begin() + last);
+
+			// the end of the channel
+			if ((SAMPLEINDEX)samples->size() < PAGE_CACHE_SAMPLES)
+				break;
+		}
+
+		return data;
+	}
+
+	SAMPLEINDEX 		 buffersize = end - start;
     double* 			 segment = new double[buffersize+10];
-    int 				 ret = 0;
+    SAMPLEINDEX 		 ret = 0;
     vector<SIGNALTYPE> * data;
 
-    edfseek(m_hdr.handle, channelNumber, start, EDFSEEK_SET);
-    ret = edfread_physical_samples(m_hdr.handle, channelNumber, buffersize, segment);
+    // positional read - no shared file position, channels can be read from more threads at once
+    ret = edfread_physical_samples_at(m_hdr.handle, channelNumber, start, buffersize, segment);
 	if (ret == -1)
 		throw "Error reading samples from file!";
 
 	data = new vector<SIGNALTYPE>;
 	data->insert(data->begin(), segment, segment+ret);
 
+	PROFILE_COUNT("CInputEDF::GetSegmentFromChannel", ret, (long long)ret * (m_hdr.filetype == EDFLIB_FILETYPE_BDF || m_hdr.filetype == EDFLIB_FILETYPE_BDFPLUS ? 3 : 2));
+	PROFILE_MEMORY("CInputEDF::GetSegmentFromChannel", buffersize * (long long)(sizeof(double) + sizeof(SIGNALTYPE)));
+
 	delete [] segment;
 
 	return data;	
 }
 
+/// Read many windows at once, the close ones by one read of whole data records.
+void CInputEDF::ReadWindows(vector<READ_WINDOW>& windows)
+{
+	if (!m_isOpen)
+		throw "Warning: isn't open any file! You must first open input file!";
+
+	PROFILE_SCOPE("CInputEDF::ReadWindows");
+
+	vector<struct edf_read_request_struct>  requests;
+	SAMPLEINDEX                             total, page, offset, first, last;
+	size_t                                  i;
+
+	for (i = 0; i < windows.size(); i++)
+	{
+		if (windows[i].m_channel < 0 || windows[i].m_channel >= GetCountChannels())
+			throw "Error: invalid channel number!";
+		if (windows[i].m_start < 0 || windows[i].m_length < 0 || (windows[i].m_length > 0 && windows[i].m_buffer == NULL))
+			throw "Error: invalid window!";
+
+		windows[i].m_read = 0;
+	}
+
+	// the pages of the cache, the derivations are computed from the pages of their signals
+	if (m_pages)
+	{
+		for (i = 0; i < windows.size(); i++)
+		{
+			READ_WINDOW& window = windows[i];
+
+			for (page = window.m_start / PAGE_CACHE_SAMPLES; page * PAGE_CACHE_SAMPLES < window.m_start + window.m_length; page++)
+			{
+				PAGE_DATA data = readPage(window.m_channel, page);
+
+				offset = page * PAGE_CACHE_SAMPLES;
+				first = max(window.m_start, offset) - offset;
+				last = min(window.m_start + window.m_length, offset + (SAMPLEINDEX)data->size()) - offset;
+				if (last > first)
+				{
+					copy(data->begin() + first, data->begin() + last, window.m_buffer + (offset + first - window.m_start));
+					window.m_read = offset + last - window.m_start;
+				}
+
+				// the end of the channel
+				if ((SAMPLEINDEX)data->size() < PAGE_CACHE_SAMPLES)
+					break;
+			}
+		}
+
+		return;
+	}
+
+	// the samples decoded straight to the buffers of the windows
+	requests.resize(windows.size());
+	for (i = 0; i < windows.size(); i++)
+	{
+		requests[i].edfsignal = windows[i].m_channel;
+		requests[i].start = windows[i].m_start;
+		requests[i].n = windows[i].m_length;
+		requests[i].buf = NULL;
+		requests[i].fbuf = windows[i].m_buffer;
+		requests[i].read = 0;
+	}
+
+	total = edfread_physical_samples_vec(m_hdr.handle, requests.data(), requests.size());
+	if (total == -1)
+		throw "Error reading samples from file!";
+
+	for (i = 0; i < windows.size(); i++)
+		windows[i].m_read = requests[i].read;
+
+	PROFILE_COUNT("CInputEDF::ReadWindows", total, total * (m_hdr.filetype == EDFLIB_FILETYPE_BDF || m_hdr.filetype == EDFLIB_FILETYPE_BDFPLUS ? 3 : 2));
+}
+
+/// One page of the channel, from the cache or decoded.
+PAGE_DATA CInputEDF::readPage(const int& channel, const SAMPLEINDEX& page)
+{
+	if (!m_montage)
+		return readSignalPage(channel, page);
+
+	PAGE_DATA data = m_pages->Find(PAGE_KEY(m_montage->GetId(), channel, page));
+	if (data)
+		return data;
+
+	// all derivations of the group are computed at once, they share the pages of the signals
+	int                      group = m_montage->GetGroup(channel);
+	const vector<int>&       signals = m_montage->GetGroupSignals(group);
+	const vector<int>&       derivations = m_montage->GetGroupDerivations(group);
+	vector<PAGE_DATA>        samples(signals.size());
+	vector<vector<double> >  derived;
+	size_t                   i;
+
+	for (i = 0; i < signals.size(); i++)
+		samples[i] = readSignalPage(signals[i], page);
+
+	m_montage->Apply(group, samples, derived);
+
+	for (i = 0; i < derivations.size(); i++)
+	{
+		PAGE_DATA derivation = make_shared<const vector<double> >(std::move(derived[i]));
+
+		m_pages->Insert(PAGE_KEY(m_montage->GetId(), derivations[i], page), derivation);
+		if (derivations[i] == channel)
+			data = derivation;
+	}
+
+	return data;
+}
+
+/// One page of the signal of the file, from the cache or decoded.
+PAGE_DATA CInputEDF::readSignalPage(const int& signal, const SAMPLEINDEX& page)
+{
+	PAGE_KEY    key(0, signal, page);
+	PAGE_DATA   data = m_pages->Find(key);
+	SAMPLEINDEX count, ret;
+
+	if (data)
+		return data;
+
+	count = min((SAMPLEINDEX)PAGE_CACHE_SAMPLES, m_hdr.signalparam[signal].smp_in_file - page * PAGE_CACHE_SAMPLES);
+	shared_ptr<vector<double> > samples = make_shared<vector<double> >(max(count, 0LL));
+
+	if (count > 0)
+	{
+		PROFILE_SCOPE("CInputEDF::readSignalPage");
+
+		ret = edfread_physical_samples_at(m_hdr.handle, signal, page * PAGE_CACHE_SAMPLES, count, samples->data());
+		if (ret == -1)
+			throw "Error reading samples from file!";
+		samples->resize(ret);
+
+		PROFILE_COUNT("CInputEDF::readSignalPage", ret, (long long)ret * (m_hdr.filetype == EDFLIB_FILETYPE_BDF || m_hdr.filetype == EDFLIB_FILETYPE_BDFPLUS ? 3 : 2));
+	}
+
+	m_pages->Insert(key, samples);
+	return samples;
+}
+
 /// Close input file if is open.
 void CInputEDF::CloseFile()
 {
+	m_montage.reset();
+	m_pages.reset();
+
 	if (m_isOpen)
 	{
-		edfclose_file(m_hdr.handle);
+		if (!m_attached)
+			edfclose_file(m_hdr.handle);
 		m_isOpen = false;
+		m_attached = false;
 		//m_channels.clear();
 	}	
 }
@@ -4,18 +4,48 @@
 #include <vector>
 #include <iostream>
 #include <cstring> // memset
+#include <memory>
 
 #include "edflib.h"
 #include "Definitions.h"
+#include "CPageCache.h"
+#include "CMontage.h"
 
 struct output {
 	double position, CDF, PDF;
 	int type;
 };
 
+/**
+ * One window of a vectored read, see \ref CInputEDF::ReadWindows.
+ */
+typedef struct readWindow
+{
+public:
+	/// the channel
+	int           m_channel;
+	/// the first sample
+	SAMPLEINDEX   m_start;
+	/// count of the samples
+	SAMPLEINDEX   m_length;
+	/// buffer of the caller for at least m_length samples
+	SIGNALTYPE *  m_buffer;
+	/// count of the samples read, less than m_length at the end of the channel
+	SAMPLEINDEX   m_read;
+
+	/// A constructor
+	readWindow(const int& channel = 0, const SAMPLEINDEX& start = 0, const SAMPLEINDEX& length = 0, SIGNALTYPE * buffer = NULL)
+		: m_channel(channel), m_start(start), m_length(length), m_buffer(buffer), m_read(0)
+	{
+		/* empty */
+	}
+} READ_WINDOW;
+
 class CInputEDF
 {
 public:
+	// constructor
+	      CInputEDF();
 	// desctructor
 	     ~CInputEDF();
 
@@ -23,8 +53,63 @@ public:
 	void OpenFile(const wchar_t * fileName);
 	void OpenFile(const char * fileName);
 
+	/**
+	 * Use a file opened by the caller (edfopen_file_readonly). The file is read with positional reads, the caller
+	 * can read it at the same time. \ref CloseFile does not close it, the caller must not close it before.
+	 * @param hdr header of the open file
+	 */
+	void AttachFile(const struct edf_hdr_struct& hdr);
+
+	/**
+	 * Read the derivations of the montage instead of the signals - the channels of the other methods are the
+	 * derivations. The pages are kept in the page cache, a new one is created if none is set. The montage is
+	 * forgotten with the file.
+	 * @param montage montage of the open file, NULL - the signals
+	 */
+	void SetMontage(const std::shared_ptr<const CMontage>& montage);
+
+	/**
+	 * Read the channels by pages kept in the cache, the cache can be shared by more readers of the same file. The
+	 * cache is forgotten with the file.
+	 * @param pages the cache, NULL - direct reads
+	 */
+	void SetPageCache(const std::shared_ptr<CPageCache>& pages);
+
+	/**
+	 * Returns the montage, NULL if the channels are the signals.
+	 */
+	inline const std::shared_ptr<const CMontage>& GetMontage() const
+	{
+		return m_montage;
+	}
+
+	/**
+	 * Returns true if a file is open or attached.
+	 */
+	inline bool IsOpen() const
+	{
+		return m_isOpen;
+	}
+
+	/**
+	 * Returns header of the open file.
+	 */
+	inline const struct edf_hdr_struct& GetHeader() const
+	{
+		return m_hdr;
+	}
+
 	// get data from one channel
-	std::vector<SIGNALTYPE> * GetSegmentFromChannel(const int& channelNumber, const int& start, const int& end);
+	std::vector<SIGNALTYPE> * GetSegmentFromChannel(const int& channelNumber, const SAMPLEINDEX& start, const SAMPLEINDEX& end);
+
+	/**
+	 * Read many short windows of any channels at once, e.g. epochs around spikes or annotations. The windows are
+	 * sorted by their data records, the close ones are read together by a few long reads of whole records and
+	 * decoded straight to the buffers (edfread_physical_samples_vec) - no seek and read per window. With the page
+	 * cache or the montage the windows are copied from the pages. Throws an error message.
+	 * @param windows the windows in any order, they can overlap, output - the samples and their counts
+	 */
+	void ReadWindows(std::vector<READ_WINDOW>& windows);
 
 	// close open file
 	void CloseFile();
@@ -32,7 +117,7 @@ public:
 	/**
 	 * Returns count of samples in one channel.
 	 */
-	inline int GetCountSamples() const
+	inline SAMPLEINDEX GetCountSamples() const
 	{
 		return m_countSamples;
 	}
@@ -45,17 +130,68 @@ public:
 		return m_fs;
 	}	
 
+	/**
+	 * Returns count of signals in the file (without annotation signals).
+	 */
+	inline int GetCountChannels() const
+	{
+		if (m_montage)
+			return m_isOpen ? m_montage->GetCountDerivations() : 0;
+		return m_isOpen ? m_hdr.edfsignals : 0;
+	}
+
+	/**
+	 * Returns label of the channel.
+	 */
+	inline const char * GetLabel(const int channel) const
+	{
+		if (m_montage)
+			return (m_isOpen && m_montage->GetCountDerivations() > channel && channel >= 0) ? m_montage->GetLabel(channel) : "";
+		if (m_isOpen && m_hdr.edfsignals > channel && channel >= 0)
+			return m_hdr.signalparam[channel].label;
+		else return "";
+	}
+
 	/**
 	 * Returns the highest sample rate. 
 	 */
 	inline int GetFS(const int channel) const
 	{
+		if (m_montage)
+			return (m_isOpen && m_montage->GetCountDerivations() > channel && channel >= 0) ? m_montage->GetFS(channel) : -1;
 		if (m_isOpen && m_hdr.edfsignals > channel && channel >= 0)
 			return m_hdr.signalparam[channel].smp_in_datarecord;
 		else return -1;
 	}	
 
+	/**
+	 * Returns count of samples of the channel.
+	 */
+	inline SAMPLEINDEX GetCountSamples(const int channel) const
+	{
+		if (m_montage)
+			return (m_isOpen && m_montage->GetCountDerivations() > channel && channel >= 0) ? m_montage->GetCountSamples(channel) : 0;
+		if (m_isOpen && m_hdr.edfsignals > channel && channel >= 0)
+			return m_hdr.signalparam[channel].smp_in_file;
+		else return 0;
+	}
+
 private:
+	/**
+	 * Returns one page of the channel (a derivation if the montage is set), from the cache or decoded.
+	 */
+	PAGE_DATA readPage(const int& channel, const SAMPLEINDEX& page);
+
+	/**
+	 * Returns one page of the signal of the file, from the cache or decoded.
+	 */
+	PAGE_DATA readSignalPage(const int& signal, const SAMPLEINDEX& page);
+
+	/**
+	 * Get the highest sample rate and the length of the signal from the header.
+	 */
+	void readSignals();
+
 	/// A private variable. Header structure.
 	struct edf_hdr_struct 	m_hdr; 		 
 
@@ -63,14 +199,20 @@ private:
 	bool				  	m_endOfFile; 
 	/// A private variable. Indicates whether is the file open.
 	bool					m_isOpen; 	 
+	/// the file was opened by the caller, see \ref AttachFile
+	bool					m_attached;
 	/// A private variable. Positions start of a new segment.
-	int 				  	m_start; 	 
+	SAMPLEINDEX 		  	m_start; 	 
 	/// A private variable. T_seg.
 	int  				  	m_T_seg; 
 	/// sample rate of data in file 
 	int 		 			m_fs;				
 	/// Number of samples of signal in the file
-	int 		  			m_countSamples;
+	SAMPLEINDEX   			m_countSamples;
+	/// the montage, NULL - the channels are the signals
+	std::shared_ptr<const CMontage> m_montage;
+	/// the decoded pages, NULL - direct reads
+	std::shared_ptr<CPageCache>     m_pages;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,340 @@
+#include "CMontage.h"
+#include "CProfiler.h"
+
+#include <atomic>
+#include <algorithm>
+#include <cctype>
+
+using namespace std;
+
+/// the last identifier of a montage, 0 are the signals of the file in \ref PAGE_KEY
+static atomic<int> montageLastId(0);
+
+/// Label without the surrounding spaces and in lower case.
+static string normalizeLabel(const string& label)
+{
+	string normalized;
+	size_t start = label.find_first_not_of(" \t");
+	size_t end = label.find_last_not_of(" \t");
+
+	if (start == string::npos)
+		return normalized;
+
+	normalized = label.substr(start, end - start + 1);
+	for (size_t i = 0; i < normalized.size(); i++)
+		normalized[i] = tolower((unsigned char)normalized[i]);
+
+	return normalized;
+}
+
+/// Label without the trailing spaces.
+static string trimLabel(const char * label)
+{
+	string trimmed = label;
+	size_t end = trimmed.find_last_not_of(' ');
+
+	return end == string::npos ? string() : trimmed.substr(0, end + 1);
+}
+
+/// A constructor.
+CMontage::CMontage()
+	: m_id(++montageLastId), m_countSignals(0)
+{
+	/* empty */
+}
+
+/// A virtual destructor.
+CMontage::~CMontage()
+{
+	/* empty */
+}
+
+/// Remove all derivations.
+void CMontage::Clear()
+{
+	m_countSignals = 0;
+	m_labels.clear();
+	m_fs.clear();
+	m_countSamples.clear();
+	m_terms.clear();
+	build();
+}
+
+/// Every signal as it is stored.
+void CMontage::SetReferential(const struct edf_hdr_struct& hdr)
+{
+	Clear();
+	for (int i = 0; i < hdr.edfsignals; i++)
+		addDerivation(hdr.signalparam[i].label, vector<int>(1, i), vector<double>(1, 1.0), hdr);
+	build();
+}
+
+/// Differences of the neighbouring signals with the same sample rate.
+void CMontage::SetBipolar(const struct edf_hdr_struct& hdr)
+{
+	vector<int> signals(2);
+	vector<double> weights(2);
+	int i, j;
+
+	weights[0] = 1;
+	weights[1] = -1;
+
+	Clear();
+	for (i = 0; i < hdr.edfsignals; i++)
+	{
+		for (j = i + 1; j < hdr.edfsignals; j++)
+			if (hdr.signalparam[j].smp_in_datarecord == hdr.signalparam[i].smp_in_datarecord)
+				break;
+
+		if (j == hdr.edfsignals)
+			continue;
+
+		signals[0] = i;
+		signals[1] = j;
+		addDerivation(trimLabel(hdr.signalparam[i].label) + "-" + trimLabel(hdr.signalparam[j].label), signals, weights, hdr);
+	}
+	build();
+}
+
+/// Every signal minus the common average of its sample rate.
+void CMontage::SetCommonAverage(const struct edf_hdr_struct& hdr)
+{
+	Clear();
+	for (int i = 0; i < hdr.edfsignals; i++)
+		addAverage(i, hdr);
+	build();
+}
+
+/// Set the montage from its definition.
+void CMontage::Parse(const string& definition, const struct edf_hdr_struct& hdr)
+{
+	string name = normalizeLabel(definition);
+	size_t start, stop, split;
+
+	if (name.empty() || name == "referential")
+	{
+		SetReferential(hdr);
+		return;
+	}
+	if (name == "bipolar")
+	{
+		SetBipolar(hdr);
+		return;
+	}
+	if (name == "average")
+	{
+		SetCommonAverage(hdr);
+		return;
+	}
+
+	Clear();
+	for (start = 0; start < definition.size(); start = stop + 1)
+	{
+		stop = definition.find_first_of(",\n", start);
+		if (stop == string::npos)
+			stop = definition.size();
+
+		string item = definition.substr(start, stop - start);
+		size_t first = item.find_first_not_of(" \t\r");
+		if (first == string::npos)
+			continue;
+		item = item.substr(first, item.find_last_not_of(" \t\r") - first + 1);
+
+		// the whole item is a label, the labels can contain '-' too
+		int signal = findSignal(item, hdr);
+		if (signal >= 0)
+		{
+			addDerivation(item, vector<int>(1, signal), vector<double>(1, 1.0), hdr);
+			continue;
+		}
+
+		for (split = item.find('-'); split != string::npos; split = item.find('-', split + 1))
+		{
+			string left = item.substr(0, split);
+			string right = item.substr(split + 1);
+			int    a = findSignal(left, hdr);
+			int    b;
+
+			if (a < 0)
+				continue;
+
+			if (normalizeLabel(right) == "avg")
+			{
+				addAverage(a, hdr);
+				m_labels.back() = item;
+				break;
+			}
+
+			b = findSignal(right, hdr);
+			if (b >= 0)
+			{
+				vector<int> signals(2);
+				vector<double> weights(2);
+
+				signals[0] = a;
+				signals[1] = b;
+				weights[0] = 1;
+				weights[1] = -1;
+				addDerivation(item, signals, weights, hdr);
+				break;
+			}
+		}
+
+		if (split == string::npos)
+			throw "Montage: unknown label of a signal.";
+	}
+	build();
+}
+
+/// Add one derivation.
+void CMontage::AddDerivation(const string& label, const vector<int>& signals, const vector<double>& weights, const struct edf_hdr_struct& hdr)
+{
+	addDerivation(label, signals, weights, hdr);
+	build();
+}
+
+/// Add one derivation without building the matrices.
+void CMontage::addDerivation(const string& label, const vector<int>& signals, const vector<double>& weights, const struct edf_hdr_struct& hdr)
+{
+	int         row = m_labels.size();
+	SAMPLEINDEX countSamples = 0;
+	size_t      i;
+
+	if (signals.empty() || signals.size() != weights.size())
+		throw "Montage: a derivation needs signals and their weights.";
+
+	for (i = 0; i < signals.size(); i++)
+	{
+		if (signals[i] < 0 || signals[i] >= hdr.edfsignals)
+			throw "Montage: invalid number of a signal.";
+		if (hdr.signalparam[signals[i]].smp_in_datarecord != hdr.signalparam[signals[0]].smp_in_datarecord)
+			throw "Montage: the signals of a derivation have different sample rates.";
+
+		if (i == 0 || hdr.signalparam[signals[i]].smp_in_file < countSamples)
+			countSamples = hdr.signalparam[signals[i]].smp_in_file;
+	}
+
+	for (i = 0; i < signals.size(); i++)
+		m_terms.push_back(Eigen::Triplet<double>(row, signals[i], weights[i]));
+
+	m_countSignals = hdr.edfsignals;
+	m_labels.push_back(label);
+	m_fs.push_back(hdr.signalparam[signals[0]].smp_in_datarecord);
+	m_countSamples.push_back(countSamples);
+}
+
+/// Add the signal minus the mean of the signals with its sample rate.
+void CMontage::addAverage(const int& signal, const struct edf_hdr_struct& hdr)
+{
+	vector<int>    signals;
+	vector<double> weights;
+	int            i;
+
+	for (i = 0; i < hdr.edfsignals; i++)
+		if (hdr.signalparam[i].smp_in_datarecord == hdr.signalparam[signal].smp_in_datarecord)
+			signals.push_back(i);
+
+	for (i = 0; i < (int)signals.size(); i++)
+		weights.push_back((signals[i] == signal ? 1.0 : 0.0) - 1.0 / signals.size());
+
+	addDerivation(trimLabel(hdr.signalparam[signal].label) + "-AVG", signals, weights, hdr);
+}
+
+/// Returns number of the signal with the label.
+int CMontage::findSignal(const string& label, const struct edf_hdr_struct& hdr) const
+{
+	string normalized = normalizeLabel(label);
+
+	for (int i = 0; i < hdr.edfsignals; i++)
+		if (!normalized.empty() && normalizeLabel(hdr.signalparam[i].label) == normalized)
+			return i;
+
+	return -1;
+}
+
+/// Build the groups and their matrices.
+void CMontage::build()
+{
+	vector<int>                          groupFS;
+	vector<vector<Eigen::Triplet<double> > > groupTerms;
+	vector<int>                          column(m_countSignals, -1);
+	vector<int>                          row(m_labels.size(), -1);
+	size_t                               i, g;
+
+	m_id = ++montageLastId;
+	m_group.assign(m_labels.size(), -1);
+	m_groupSignals.clear();
+	m_groupDerivations.clear();
+	m_groupMatrix.clear();
+
+	// the derivations of one sample rate are one group
+	for (i = 0; i < m_labels.size(); i++)
+	{
+		g = find(groupFS.begin(), groupFS.end(), m_fs[i]) - groupFS.begin();
+		if (g == groupFS.size())
+		{
+			groupFS.push_back(m_fs[i]);
+			m_groupSignals.push_back(vector<int>());
+			m_groupDerivations.push_back(vector<int>());
+			groupTerms.push_back(vector<Eigen::Triplet<double> >());
+		}
+
+		m_group[i] = g;
+		row[i] = m_groupDerivations[g].size();
+		m_groupDerivations[g].push_back(i);
+	}
+
+	for (i = 0; i < m_terms.size(); i++)
+	{
+		int derivation = m_terms[i].row();
+		int signal = m_terms[i].col();
+
+		g = m_group[derivation];
+		if (column[signal] < 0)
+		{
+			column[signal] = m_groupSignals[g].size();
+			m_groupSignals[g].push_back(signal);
+		}
+
+		groupTerms[g].push_back(Eigen::Triplet<double>(row[derivation], column[signal], m_terms[i].value()));
+	}
+
+	for (g = 0; g < groupFS.size(); g++)
+	{
+		m_groupMatrix.push_back(Eigen::SparseMatrix<double, Eigen::RowMajor>(m_groupDerivations[g].size(), m_groupSignals[g].size()));
+		m_groupMatrix.back().setFromTriplets(groupTerms[g].begin(), groupTerms[g].end());
+	}
+}
+
+/// Derivations of one group for one page.
+void CMontage::Apply(const int& group, const vector<PAGE_DATA>& signals, vector<vector<double> >& derived) const
+{
+	PROFILE_SCOPE("CMontage::Apply");
+
+	const Eigen::SparseMatrix<double, Eigen::RowMajor>& matrix = m_groupMatrix[group];
+	size_t                                               count = 0;
+	int                                                  i;
+
+	for (i = 0; i < (int)signals.size(); i++)
+		if (i == 0 || signals[i]->size() < count)
+			count = signals[i]->size();
+
+	derived.resize(matrix.rows());
+	for (i = 0; i < matrix.rows(); i++)
+	{
+		Eigen::SparseMatrix<double, Eigen::RowMajor>::InnerIterator term(matrix, i);
+
+		// referential - the samples of the signal
+		if (matrix.innerVector(i).nonZeros() == 1 && term.value() == 1)
+		{
+			derived[i].assign(signals[term.index()]->begin(), signals[term.index()]->begin() + count);
+			continue;
+		}
+
+		// one row of the sparse product, the whole page of every signal at once
+		derived[i].assign(count, 0);
+		Eigen::Map<Eigen::VectorXd> out(derived[i].data(), count);
+		for (; term; ++term)
+			out += term.value() * Eigen::Map<const Eigen::VectorXd>(signals[term.index()]->data(), count);
+	}
+}
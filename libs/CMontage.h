@@ -0,0 +1,201 @@
+#ifndef CMontage_H
+#define CMontage_H
+
+#include <vector>
+#include <string>
+
+#include "lib/Eigen/Sparse"
+#include "edflib.h"
+#include "Definitions.h"
+#include "CPageCache.h"
+
+/**
+ * Montage - derivations of the signals of one file, every derivation is a linear combination of signals with the
+ * same sample rate (referential: the signal, bipolar: A - B, common average: A - the mean of the signals). The
+ * derivations are rows of a sparse matrix (derivations x signals), the derivations of one sample rate are a group
+ * and are computed together from the same decoded pages of their signals (\ref Apply). \ref CInputEDF reads the
+ * derivations instead of the signals when a montage is set, the plot and the detector see the same channels.
+ */
+class CMontage
+{
+// methods
+public:
+	/**
+	 * A constructor - no derivations.
+	 */
+	CMontage();
+
+	/**
+	 * A virtual desctructor.
+	 */
+	virtual ~CMontage();
+
+	/**
+	 * Remove all derivations.
+	 */
+	void Clear();
+
+	/**
+	 * Every signal as it is stored, the labels of the file.
+	 * @param hdr header of the file
+	 */
+	void SetReferential(const struct edf_hdr_struct& hdr);
+
+	/**
+	 * Differences of the neighbouring signals with the same sample rate in the order of the file, "A-B".
+	 * @param hdr header of the file
+	 */
+	void SetBipolar(const struct edf_hdr_struct& hdr);
+
+	/**
+	 * Every signal minus the mean of all signals with its sample rate, "A-AVG".
+	 * @param hdr header of the file
+	 */
+	void SetCommonAverage(const struct edf_hdr_struct& hdr);
+
+	/**
+	 * Set the montage from its definition - "referential", "bipolar", "average" or a list of derivations separated
+	 * by commas or new lines: "A" (the signal), "A-B" (difference of two signals) or "A-AVG" (the signal minus the
+	 * common average). The labels are compared without the surrounding spaces and the case. Throws on an unknown label.
+	 * @param definition definition of the montage
+	 * @param hdr header of the file
+	 */
+	void Parse(const std::string& definition, const struct edf_hdr_struct& hdr);
+
+	/**
+	 * Add one derivation. Throws if the signals do not exist or have different sample rates.
+	 * @param label label of the derivation
+	 * @param signals numbers of the signals in the file
+	 * @param weights weights of the signals
+	 * @param hdr header of the file
+	 */
+	void AddDerivation(const std::string& label, const std::vector<int>& signals, const std::vector<double>& weights,
+					   const struct edf_hdr_struct& hdr);
+
+	/**
+	 * Derivations of one group for one page - the sparse rows of the group times the pages of its signals.
+	 * @param group number of the group
+	 * @param signals pages of the signals of the group (\ref GetGroupSignals), the same page of every signal
+	 * @param derived output - pages of the derivations of the group (\ref GetGroupDerivations)
+	 */
+	void Apply(const int& group, const std::vector<PAGE_DATA>& signals, std::vector<std::vector<double> >& derived) const;
+
+	/**
+	 * Returns identifier of the montage, unique for every change of every montage - the key of the derived pages.
+	 */
+	inline int GetId() const
+	{
+		return m_id;
+	}
+
+	/**
+	 * Returns count of the signals of the file.
+	 */
+	inline int GetCountSignals() const
+	{
+		return m_countSignals;
+	}
+
+	/**
+	 * Returns count of the derivations.
+	 */
+	inline int GetCountDerivations() const
+	{
+		return m_labels.size();
+	}
+
+	/**
+	 * Returns label of the derivation.
+	 */
+	inline const char * GetLabel(const int& derivation) const
+	{
+		return m_labels[derivation].c_str();
+	}
+
+	/**
+	 * Returns sample rate of the derivation (samples in one data record).
+	 */
+	inline int GetFS(const int& derivation) const
+	{
+		return m_fs[derivation];
+	}
+
+	/**
+	 * Returns count of samples of the derivation.
+	 */
+	inline SAMPLEINDEX GetCountSamples(const int& derivation) const
+	{
+		return m_countSamples[derivation];
+	}
+
+	/**
+	 * Returns group of the derivation.
+	 */
+	inline int GetGroup(const int& derivation) const
+	{
+		return m_group[derivation];
+	}
+
+	/**
+	 * Returns signals used by the derivations of the group.
+	 */
+	inline const std::vector<int>& GetGroupSignals(const int& group) const
+	{
+		return m_groupSignals[group];
+	}
+
+	/**
+	 * Returns derivations of the group, in the order of the rows of its matrix.
+	 */
+	inline const std::vector<int>& GetGroupDerivations(const int& group) const
+	{
+		return m_groupDerivations[group];
+	}
+
+private:
+	/**
+	 * Add one derivation without building the matrices.
+	 */
+	void addDerivation(const std::string& label, const std::vector<int>& signals, const std::vector<double>& weights,
+					   const struct edf_hdr_struct& hdr);
+
+	/**
+	 * Build the groups and their matrices, a new identifier.
+	 */
+	void build();
+
+	/**
+	 * Returns number of the signal with the label, -1 if none.
+	 */
+	int findSignal(const std::string& label, const struct edf_hdr_struct& hdr) const;
+
+	/**
+	 * Add the signal minus the mean of the signals with its sample rate.
+	 */
+	void addAverage(const int& signal, const struct edf_hdr_struct& hdr);
+
+// variables
+private:
+	/// identifier of the montage
+	int                                     m_id;
+	/// count of the signals of the file
+	int                                     m_countSignals;
+	/// labels of the derivations
+	std::vector<std::string>                m_labels;
+	/// sample rates of the derivations
+	std::vector<int>                        m_fs;
+	/// count of samples of the derivations
+	std::vector<SAMPLEINDEX>                m_countSamples;
+	/// the derivation matrix - rows are derivations, columns are signals of the file
+	std::vector<Eigen::Triplet<double> >    m_terms;
+	/// group of the derivations
+	std::vector<int>                        m_group;
+	/// signals of the groups
+	std::vector<std::vector<int> >          m_groupSignals;
+	/// derivations of the groups
+	std::vector<std::vector<int> >          m_groupDerivations;
+	/// the derivation matrix of the groups - rows are m_groupDerivations, columns are m_groupSignals
+	std::vector<Eigen::SparseMatrix<double, Eigen::RowMajor> > m_groupMatrix;
+};
+
+#endif
@@ -0,0 +1,90 @@
+#include "CPageCache.h"
+
+using namespace std;
+
+/// A constructor.
+CPageCache::CPageCache(const long long& budget)
+	: m_budget(budget), m_size(0), m_hits(0), m_misses(0)
+{
+	/* empty */
+}
+
+/// A virtual destructor.
+CPageCache::~CPageCache()
+{
+	/* empty */
+}
+
+/// Returns the page, empty if it is not kept.
+PAGE_DATA CPageCache::Find(const PAGE_KEY& key)
+{
+	lock_guard<mutex> lock(m_mutex);
+
+	PAGE_MAP::iterator it = m_pages.find(key);
+	if (it == m_pages.end())
+	{
+		m_misses++;
+		return PAGE_DATA();
+	}
+
+	m_hits++;
+	m_recent.splice(m_recent.begin(), m_recent, it->second.second);
+	return it->second.first;
+}
+
+/// Keep the page, evict the least recently used pages over the budget.
+void CPageCache::Insert(const PAGE_KEY& key, const PAGE_DATA& page)
+{
+	lock_guard<mutex> lock(m_mutex);
+
+	// another reader decoded the same page meanwhile
+	if (m_pages.find(key) != m_pages.end())
+		return;
+
+	m_recent.push_front(key);
+	m_pages.insert(make_pair(key, make_pair(page, m_recent.begin())));
+	m_size += page->size() * sizeof(double);
+
+	// the newest page is kept also over the budget
+	while (m_size > m_budget && m_recent.size() > 1)
+	{
+		PAGE_MAP::iterator oldest = m_pages.find(m_recent.back());
+
+		m_size -= oldest->second.first->size() * sizeof(double);
+		m_pages.erase(oldest);
+		m_recent.pop_back();
+	}
+}
+
+/// Forget all pages.
+void CPageCache::Clear()
+{
+	lock_guard<mutex> lock(m_mutex);
+
+	m_pages.clear();
+	m_recent.clear();
+	m_size = 0;
+	m_hits = 0;
+	m_misses = 0;
+}
+
+/// Returns bytes of the kept pages.
+long long CPageCache::GetSize()
+{
+	lock_guard<mutex> lock(m_mutex);
+	return m_size;
+}
+
+/// Returns count of the found pages.
+long long CPageCache::GetHits()
+{
+	lock_guard<mutex> lock(m_mutex);
+	return m_hits;
+}
+
+/// Returns count of the missing pages.
+long long CPageCache::GetMisses()
+{
+	lock_guard<mutex> lock(m_mutex);
+	return m_misses;
+}
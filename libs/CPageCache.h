@@ -0,0 +1,125 @@
+#ifndef CPageCache_H
+#define CPageCache_H
+
+#include <vector>
+#include <map>
+#include <list>
+#include <memory>
+#include <mutex>
+
+#include "Definitions.h"
+
+/// Count of samples of one page of a channel.
+#define PAGE_CACHE_SAMPLES 65536
+/// Default budget of the cache (byte).
+#define PAGE_CACHE_BUDGET (256LL * 1024 * 1024)
+
+/**
+ * Key of one page - the samples [m_page * \ref PAGE_CACHE_SAMPLES, (m_page + 1) * \ref PAGE_CACHE_SAMPLES) of a channel.
+ */
+typedef struct pageKey
+{
+public:
+	/// 0 - a signal of the file, otherwise the identifier of the montage (\ref CMontage::GetId)
+	int          m_montage;
+	/// number of the signal in the file or of the derivation in the montage
+	int          m_channel;
+	/// number of the page
+	SAMPLEINDEX  m_page;
+
+	/// A constructor
+	pageKey(const int& montage, const int& channel, const SAMPLEINDEX& page)
+		: m_montage(montage), m_channel(channel), m_page(page)
+	{
+		/* empty */
+	}
+
+	/// Ordering of the keys.
+	bool operator<(const pageKey& other) const
+	{
+		if (m_montage != other.m_montage)
+			return m_montage < other.m_montage;
+		if (m_channel != other.m_channel)
+			return m_channel < other.m_channel;
+		return m_page < other.m_page;
+	}
+} PAGE_KEY;
+
+/// One page - the physical values of the samples, shorter than \ref PAGE_CACHE_SAMPLES at the end of the signal.
+typedef std::shared_ptr<const std::vector<double> > PAGE_DATA;
+
+/**
+ * Least recently used cache of the decoded pages of one file - the signals of the file and the derivations of the
+ * montages. The readers of the same file share it (the plot, the visible window and the background detection), a page
+ * is decoded once and a montage is switched without reading the file again. The cache is thread safe, a page stays
+ * valid for its holders after it is evicted.
+ */
+class CPageCache
+{
+// methods
+public:
+	/**
+	 * A constructor.
+	 * @param budget the most bytes of the kept pages
+	 */
+	CPageCache(const long long& budget = PAGE_CACHE_BUDGET);
+
+	/**
+	 * A virtual desctructor.
+	 */
+	virtual ~CPageCache();
+
+	/**
+	 * Returns the page, empty if it is not kept.
+	 * @param key key of the page
+	 */
+	PAGE_DATA Find(const PAGE_KEY& key);
+
+	/**
+	 * Keep the page, the least recently used pages are evicted over the budget.
+	 * @param key key of the page
+	 * @param page samples of the page
+	 */
+	void Insert(const PAGE_KEY& key, const PAGE_DATA& page);
+
+	/**
+	 * Forget all pages (another file).
+	 */
+	void Clear();
+
+	/**
+	 * Returns bytes of the kept pages.
+	 */
+	long long GetSize();
+
+	/**
+	 * Returns count of the found pages since the last \ref Clear.
+	 */
+	long long GetHits();
+
+	/**
+	 * Returns count of the missing pages since the last \ref Clear.
+	 */
+	long long GetMisses();
+
+// variables
+private:
+	typedef std::map<PAGE_KEY, std::pair<PAGE_DATA, std::list<PAGE_KEY>::iterator> > PAGE_MAP;
+
+	/// the most bytes of the kept pages
+	long long             m_budget;
+	/// bytes of the kept pages
+	long long             m_size;
+	/// count of the found pages
+	long long             m_hits;
+	/// count of the missing pages
+	long long             m_misses;
+	/// the kept pages and their place in m_recent
+	PAGE_MAP              m_pages;
+	/// keys of the kept pages, the most recently used first
+	std::list<PAGE_KEY>   m_recent;
+	/// guards all variables
+	std::mutex            m_mutex;
+};
+
+#endif
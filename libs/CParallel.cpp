@@ -0,0 +1,47 @@
+#include "CParallel.h"
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <algorithm>
+
+using namespace std;
+
+/// Run the task for every item by the threads.
+void CParallel::Run(const int& count, const int& workers, const function<void(int)>& task)
+{
+	int            countThreads = workers > 0 ? workers : max(1u, thread::hardware_concurrency());
+	atomic<int>    next(0);
+	const char *   error = NULL;
+	mutex          errorMutex;
+	vector<thread> threads;
+	int            i;
+
+	auto work = [&]() {
+		for (int item = next++; item < count; item = next++)
+		{
+			try
+			{
+				task(item);
+			}
+			catch (const char * e)
+			{
+				lock_guard<mutex> lock(errorMutex);
+				if (error == NULL)
+					error = e;
+			}
+		}
+	};
+
+	countThreads = min(countThreads, count);
+	for (i = 1; i < countThreads; i++)
+		threads.push_back(thread(work));
+	work();
+
+	for (i = 0; i < (int)threads.size(); i++)
+		threads[i].join();
+
+	if (error)
+		throw error;
+}
@@ -0,0 +1,26 @@
+#ifndef CParallel_H
+#define CParallel_H
+
+#include <functional>
+
+/**
+ * Parallel loop over independent items of the analyses (channels, blocks of discharges).
+ *
+ * The threads are started for one call and every thread takes the next item from a shared counter, the items of
+ * uneven cost are balanced without a scheduler. The first error message thrown by a task is thrown again by
+ * \ref Run after all threads finish.
+ */
+class CParallel
+{
+// methods
+public:
+	/**
+	 * Run the task for every item by the threads, every thread takes the next item. Throws the first error of the tasks.
+	 * @param count count of the items
+	 * @param workers count of threads, 0 - count of cores
+	 * @param task the task of one item, called from more threads at once
+	 */
+	static void Run(const int& count, const int& workers, const std::function<void(int)>& task);
+};
+
+#endif
@@ -0,0 +1,207 @@
+#include "CPipeline.h"
+#include "CProfiler.h"
+
+using namespace std;
+
+/// A constructor.
+CPipeline::CPipeline(CInputEDF * model, const DETECTOR_SETTINGS& settings)
+	: m_model(model), m_settings(settings)
+{
+	/* empty */
+}
+
+/// A virtual destructor.
+CPipeline::~CPipeline()
+{
+	/* empty */
+}
+
+/// Add a detector.
+void CPipeline::AddDetector(CPipelineDetector * detector)
+{
+	m_detectors.push_back(detector);
+}
+
+/// Returns the streams subscribed by the detectors.
+int CPipeline::GetStreams() const
+{
+	int streams = 0;
+
+	for (size_t i = 0; i < m_detectors.size(); i++)
+		streams |= m_detectors[i]->GetStreams();
+
+	return streams;
+}
+
+/// One pass over the channel.
+bool CPipeline::RunChannel(const int& channel)
+{
+	PROFILE_SCOPE("CPipeline::RunChannel");
+
+	// GetSegments limits the buffering of its settings
+	DETECTOR_SETTINGS    settings = m_settings;
+	CSpikeDetector       segmentation(m_model, &settings);
+	vector<SAMPLEINDEX>  indexStart, indexStop;
+	int                  fs;
+
+	fs = segmentation.GetSegments(channel, indexStart, indexStop);
+
+	return runSegments(channel, fs, indexStart, indexStop);
+}
+
+/// One pass over the time range of the channel.
+bool CPipeline::RunRange(const int& channel, const double& t0, const double& t1)
+{
+	PROFILE_SCOPE("CPipeline::RunRange");
+
+	DETECTOR_SETTINGS    settings = m_settings;
+	CSpikeDetector       segmentation(m_model, &settings);
+	vector<SAMPLEINDEX>  indexStart, indexStop;
+	int                  fs;
+
+	fs = segmentation.GetRangeSegments(channel, t0, t1, indexStart, indexStop);
+
+	return runSegments(channel, fs, indexStart, indexStop);
+}
+
+/// Read the segments, process them and pass them to the detectors.
+bool CPipeline::runSegments(const int& channel, const int& fs, const vector<SAMPLEINDEX>& indexStart, const vector<SAMPLEINDEX>& indexStop)
+{
+	vector<SIGNALTYPE> * data;
+	int                  streams = GetStreams();
+	int                  countSegments = indexStop.size(), i;
+	size_t               j;
+	bool                 ret = true;
+
+	for (j = 0; j < m_detectors.size(); j++)
+		m_detectors[j]->BeginChannel(channel, countSegments);
+
+	for (i = 0; i < countSegments; i++)
+	{
+		data = m_model->GetSegmentFromChannel(channel, indexStart[i], indexStop[i]);
+		if (data == NULL)
+		{
+			ret = false;
+			break;
+		}
+
+		PIPELINE_SEGMENT segment(channel, i, countSegments, indexStart[i], indexStop[i], fs);
+		Process(data, fs, m_settings, streams, segment);
+		delete data;
+
+		for (j = 0; j < m_detectors.size(); j++)
+			m_detectors[j]->ProcessSegment(segment);
+	}
+
+	for (j = 0; j < m_detectors.size(); j++)
+		m_detectors[j]->EndChannel(channel);
+
+	return ret;
+}
+
+/// Run the stages on one segment.
+void CPipeline::Process(vector<SIGNALTYPE>*& data, const int& inputFS, const DETECTOR_SETTINGS& settings, const int& streams,
+						PIPELINE_SEGMENT& segment)
+{
+	BANDWIDTH bandwidth(settings.m_band_low, settings.m_band_high);
+	int       fs = inputFS;
+
+	segment.m_inputFS = inputFS;
+	segment.m_fs = inputFS;
+
+	// decode
+	keepStream(data, PIPELINE_RAW, streams, segment.m_raw);
+	if (streams < PIPELINE_RESAMPLED)
+		return;
+
+	// If sample rate is > "decimation" the signal is decimated => 200Hz default.
+	if (fs > settings.m_decimation)
+	{
+		CDSP::ResampleOneChannel(data, fs, settings.m_decimation);
+		fs = settings.m_decimation;
+	}
+	segment.m_fs = fs;
+	keepStream(data, PIPELINE_RESAMPLED, streams, segment.m_resampled);
+	if (streams < PIPELINE_NOTCH)
+		return;
+
+	// filtering Nx50Hz
+	CDSP::Filt50Hz(data, 1, fs, settings.m_main_hum_freq, bandwidth);
+	keepStream(data, PIPELINE_NOTCH, streams, segment.m_notch);
+	if (streams < PIPELINE_BANDPASS)
+		return;
+
+	// filtering 10-60Hz
+	CDSP::Filtering(data, 1, fs, bandwidth);
+	keepStream(data, PIPELINE_BANDPASS, streams, segment.m_bandpass);
+	if (streams < PIPELINE_ENVELOPE)
+		return;
+
+	// Hilbert's envelope
+	CDSP::AbsHilbert(*data);
+	keepStream(data, PIPELINE_ENVELOPE, streams, segment.m_envelope);
+}
+
+/// Keep the output of one stage if the stream is subscribed.
+void CPipeline::keepStream(vector<SIGNALTYPE>* data, const PIPELINE_STREAM& stream, const int& streams, vector<SIGNALTYPE>& target)
+{
+	if (!(streams & stream))
+		return;
+
+	// the later stages work on the data
+	if (streams >= 2 * stream)
+		target.assign(data->begin(), data->end());
+	else target.swap(*data);
+}
+
+// ------------------------------------------------------------------------------------------------
+// CPipelineSpikeDetector
+// ------------------------------------------------------------------------------------------------
+
+/// A constructor.
+CPipelineSpikeDetector::CPipelineSpikeDetector(const DETECTOR_SETTINGS& settings)
+	: m_settings(settings), m_detector(NULL, &m_settings)
+{
+	/* empty */
+}
+
+/// A virtual destructor.
+CPipelineSpikeDetector::~CPipelineSpikeDetector()
+{
+	/* empty */
+}
+
+/// The band-pass stream and its envelope.
+int CPipelineSpikeDetector::GetStreams() const
+{
+	return PIPELINE_BANDPASS | PIPELINE_ENVELOPE;
+}
+
+/// Start the detections of the channel.
+void CPipelineSpikeDetector::BeginChannel(const int& /*channel*/, const int& /*countSegments*/)
+{
+	m_out.reset(new CDetectorOutput());
+	m_discharges.reset(new CDischarges(1));
+}
+
+/// Detect one segment and append it to the channel.
+void CPipelineSpikeDetector::ProcessSegment(const PIPELINE_SEGMENT& segment)
+{
+	m_detector.DetectSegment(segment, m_subOut, m_subDischarges);
+	m_detector.TrimSegment(segment.m_segment, segment.m_countSegments, segment.m_start, segment.m_stop, segment.m_inputFS,
+						   *m_subOut, *m_subDischarges);
+
+	CSpikeDetector::AppendSegment(*m_out, *m_discharges, std::move(*m_subOut), std::move(*m_subDischarges));
+}
+
+/// Returns the detections of the last channel.
+void CPipelineSpikeDetector::TakeResults(unique_ptr<CDetectorOutput>& output, unique_ptr<CDischarges>& discharges)
+{
+	output = std::move(m_out);
+	discharges = std::move(m_discharges);
+
+	if (!output)
+		output.reset(new CDetectorOutput());
+	if (!discharges)
+		discharges.reset(new CDischarges(1));
+}
@@ -0,0 +1,240 @@
+#ifndef CPipeline_H
+#define CPipeline_H
+
+#include <vector>
+#include <memory>
+
+#include "Definitions.h"
+#include "CInputEDF.h"
+#include "CSpikeDetector.h"
+
+/**
+ * Intermediate streams of the pipeline in the order of the stages, used as a bit mask.
+ * Every stage computes its stream from the previous one.
+ */
+typedef enum
+{
+	/// decoded samples, the sample rate of the file
+	PIPELINE_RAW       = 1,
+	/// decimated to m_decimation of the settings (if the file has a higher sample rate)
+	PIPELINE_RESAMPLED = 2,
+	/// the main hum and its harmonics removed
+	PIPELINE_NOTCH     = 4,
+	/// band-pass m_band_low - m_band_high of the settings
+	PIPELINE_BANDPASS  = 8,
+	/// Hilbert's envelope of the band-pass stream
+	PIPELINE_ENVELOPE  = 16
+} PIPELINE_STREAM;
+
+/**
+ * One segment of the channel passed to the detectors. Only the subscribed streams are filled.
+ */
+typedef struct pipelineSegment
+{
+public:
+	/// number of the channel
+	int                      m_channel;
+	/// number of the segment
+	int                      m_segment;
+	/// count of segments of the channel
+	int                      m_countSegments;
+	/// start of the segment in the file (sample, the sample rate of the file)
+	SAMPLEINDEX              m_start;
+	/// end of the segment in the file
+	SAMPLEINDEX              m_stop;
+	/// sample rate of the file
+	int                      m_inputFS;
+	/// sample rate of the resampled stream and all later streams
+	int                      m_fs;
+
+	std::vector<SIGNALTYPE>  m_raw;
+	std::vector<SIGNALTYPE>  m_resampled;
+	std::vector<SIGNALTYPE>  m_notch;
+	std::vector<SIGNALTYPE>  m_bandpass;
+	std::vector<SIGNALTYPE>  m_envelope;
+
+	/// A constructor
+	pipelineSegment(const int& channel = 0, const int& segment = 0, const int& countSegments = 1, const SAMPLEINDEX& start = 0,
+					const SAMPLEINDEX& stop = 0, const int& inputFS = 0)
+		: m_channel(channel), m_segment(segment), m_countSegments(countSegments), m_start(start), m_stop(stop),
+		m_inputFS(inputFS), m_fs(inputFS)
+	{
+		/* empty */
+	}
+
+} PIPELINE_SEGMENT;
+
+/**
+ * A detector fed by \ref CPipeline. The detector subscribes the streams it needs, the segments of one channel
+ * are passed in their order. The segments overlap by 3 windows of the settings (\ref CSpikeDetector::GetSegments),
+ * the detector removes its detections in the overlaps itself.
+ */
+class CPipelineDetector
+{
+// methods
+public:
+	/**
+	 * A virtual desctructor.
+	 */
+	virtual ~CPipelineDetector()
+	{
+		/* empty */
+	}
+
+	/**
+	 * Returns the subscribed streams - a mask of \ref PIPELINE_STREAM.
+	 */
+	virtual int GetStreams() const = 0;
+
+	/**
+	 * Called before the first segment of the channel.
+	 * @param channel number of the channel
+	 * @param countSegments count of segments of the channel
+	 */
+	virtual void BeginChannel(const int& /*channel*/, const int& /*countSegments*/)
+	{
+		/* empty */
+	}
+
+	/**
+	 * Process one segment.
+	 * @param segment the segment with the subscribed streams
+	 */
+	virtual void ProcessSegment(const PIPELINE_SEGMENT& segment) = 0;
+
+	/**
+	 * Called after the last segment of the channel (also if the channel could not be read to its end).
+	 * @param channel number of the channel
+	 */
+	virtual void EndChannel(const int& /*channel*/)
+	{
+		/* empty */
+	}
+};
+
+/**
+ * Stage graph of the detection: decode -> resample -> notch -> band-pass -> envelope.
+ * One pass over the channel feeds all added detectors, every segment is decoded and filtered once and only the stages
+ * up to the last subscribed stream are computed. The stages use the settings of the spike detector.
+ */
+class CPipeline
+{
+// methods
+public:
+	/**
+	 * A constructor.
+	 * @param model input file (must be open)
+	 * @param settings settings of the stages and of the segmentation
+	 */
+	CPipeline(CInputEDF * model, const DETECTOR_SETTINGS& settings);
+
+	/**
+	 * A virtual desctructor.
+	 */
+	virtual ~CPipeline();
+
+	/**
+	 * Add a detector, it is not owned by the pipeline.
+	 */
+	void AddDetector(CPipelineDetector * detector);
+
+	/**
+	 * Returns the streams subscribed by the detectors - a mask of \ref PIPELINE_STREAM.
+	 */
+	int GetStreams() const;
+
+	/**
+	 * One pass over the channel - every segment is read, processed by the stages and passed to the detectors.
+	 * Throws an error message of the input.
+	 * @param channel number of the channel
+	 * @return false if a segment can not be read
+	 */
+	bool RunChannel(const int& channel);
+
+	/**
+	 * One pass over the time range of the channel with the margins of \ref CSpikeDetector::AnalyseRange, the same as
+	 * \ref RunChannel. The detectors get the segments of the range (the positions of the detections are in the file).
+	 * @param channel number of the channel
+	 * @param t0 start of the range (second)
+	 * @param t1 end of the range (second)
+	 * @return false if a segment can not be read
+	 */
+	bool RunRange(const int& channel, const double& t0, const double& t1);
+
+	/**
+	 * Run the stages on one segment.
+	 * @param data samples of the segment, changed by the stages
+	 * @param inputFS sample rate of the samples
+	 * @param settings settings of the stages
+	 * @param streams streams to fill - a mask of \ref PIPELINE_STREAM
+	 * @param segment output - the streams and the sample rate after resampling
+	 */
+	static void Process(std::vector<SIGNALTYPE>*& data, const int& inputFS, const DETECTOR_SETTINGS& settings, const int& streams,
+						PIPELINE_SEGMENT& segment);
+
+private:
+	/**
+	 * Read the segments, process them by the stages and pass them to the detectors.
+	 */
+	bool runSegments(const int& channel, const int& fs, const std::vector<SAMPLEINDEX>& indexStart, const std::vector<SAMPLEINDEX>& indexStop);
+
+	/**
+	 * Keep the output of one stage if the stream is subscribed - a copy if a later stage follows.
+	 */
+	static void keepStream(std::vector<SIGNALTYPE>* data, const PIPELINE_STREAM& stream, const int& streams, std::vector<SIGNALTYPE>& target);
+
+// variables
+private:
+	/// input file
+	CInputEDF *                       m_model;
+	/// settings of the stages
+	DETECTOR_SETTINGS                 m_settings;
+	/// the detectors, not owned
+	std::vector<CPipelineDetector*>   m_detectors;
+};
+
+/**
+ * The spike detector as a plugin of \ref CPipeline - subscribes the band-pass stream and its envelope.
+ */
+class CPipelineSpikeDetector : public CPipelineDetector
+{
+// methods
+public:
+	/**
+	 * A constructor.
+	 * @param settings settings of the detector, the stages of the pipeline must use the same settings
+	 */
+	CPipelineSpikeDetector(const DETECTOR_SETTINGS& settings);
+
+	/**
+	 * A virtual desctructor.
+	 */
+	virtual ~CPipelineSpikeDetector();
+
+	virtual int GetStreams() const;
+	virtual void BeginChannel(const int& channel, const int& countSegments);
+	virtual void ProcessSegment(const PIPELINE_SEGMENT& segment);
+
+	/**
+	 * Returns the detections of the last channel, the caller owns them.
+	 * @param output output - detections
+	 * @param discharges output - discharges
+	 */
+	void TakeResults(std::unique_ptr<CDetectorOutput>& output, std::unique_ptr<CDischarges>& discharges);
+
+// variables
+private:
+	/// settings of the detector
+	DETECTOR_SETTINGS    m_settings;
+	/// the detector, without the input
+	CSpikeDetector       m_detector;
+	/// detections of the channel
+	std::unique_ptr<CDetectorOutput> m_out;
+	/// discharges of the channel
+	std::unique_ptr<CDischarges>     m_discharges;
+	/// detections and discharges of one segment, reused by the next segment
+	std::unique_ptr<CDetectorOutput> m_subOut;
+	std::unique_ptr<CDischarges>     m_subDischarges;
+};
+
+#endif
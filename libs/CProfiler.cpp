@@ -0,0 +1,419 @@
+#include "CProfiler.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <new>
+
+#if defined(__unix__) || defined(__APPLE__)
+	#include <sys/resource.h>
+	#include <unistd.h>
+#endif
+
+using namespace std;
+
+/// One event of the timeline.
+struct profileEvent
+{
+	const char * m_name;
+	double       m_start;
+	double       m_duration;
+};
+
+/// Recording of one thread. The owner thread writes, the readers merge - both under the mutex of the buffer.
+struct profileThreadBuffer
+{
+	int                  m_thread;
+	mutex                m_mutex;
+	vector<profileEvent> m_events;
+	/// aggregated counters, the key is the address of the name literal
+	map<const char *, PROFILE_STAT> m_stats;
+};
+
+/// all buffers, never released - a thread can end before the summary is written
+static vector<profileThreadBuffer*>        profileBuffers;
+static mutex                               profileBuffersMutex;
+static thread_local profileThreadBuffer *  profileCurrentBuffer = NULL;
+/// the innermost running scope of the thread
+static thread_local CProfilerScope *       profileCurrentScope = NULL;
+
+/// calls of the global operator new by the thread
+static thread_local long long              profileAllocations = 0;
+/// the profiler itself is running in the thread, its allocations are not counted
+static thread_local int                    profileInternal = 0;
+
+atomic<bool> CProfiler::m_enabled(false);
+
+/// Marks the code of the profiler for the allocation counter.
+struct profileInternalScope
+{
+	profileInternalScope()
+	{
+		profileInternal++;
+	}
+
+	~profileInternalScope()
+	{
+		profileInternal--;
+	}
+};
+
+#ifdef EDF_PROFILE
+/// The global allocator counting the calls of the thread.
+void * operator new(size_t size)
+{
+	void * p;
+
+	if (!profileInternal)
+		profileAllocations++;
+
+	p = malloc(size ? size : 1);
+	if (p == NULL)
+		throw bad_alloc();
+
+	return p;
+}
+
+void * operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void operator delete(void * p) noexcept
+{
+	free(p);
+}
+
+void operator delete[](void * p) noexcept
+{
+	free(p);
+}
+#endif
+
+/// Returns the time of the first use of the profiler.
+static chrono::steady_clock::time_point profileEpoch()
+{
+	static chrono::steady_clock::time_point epoch = chrono::steady_clock::now();
+	return epoch;
+}
+
+/// Returns the buffer of the calling thread, created at the first use.
+static profileThreadBuffer * profileBuffer()
+{
+	if (profileCurrentBuffer == NULL)
+	{
+		lock_guard<mutex> lock(profileBuffersMutex);
+		profileCurrentBuffer = new profileThreadBuffer();
+		profileCurrentBuffer->m_thread = profileBuffers.size() + 1;
+		profileBuffers.push_back(profileCurrentBuffer);
+	}
+
+	return profileCurrentBuffer;
+}
+
+/// Ordering of the summary by self time, the longest first.
+static bool profileSelfLonger(const PROFILE_STAT& a, const PROFILE_STAT& b)
+{
+	return a.m_self > b.m_self;
+}
+
+/// Returns true if the instrumentation is compiled in.
+bool CProfiler::IsCompiled()
+{
+#ifdef EDF_PROFILE
+	return true;
+#else
+	return false;
+#endif
+}
+
+/// Switch the recording on or off.
+void CProfiler::SetEnabled(const bool& enabled)
+{
+	profileEpoch();
+	m_enabled = enabled;
+}
+
+/// Remove all recorded events and counters.
+void CProfiler::Reset()
+{
+	lock_guard<mutex> lock(profileBuffersMutex);
+
+	for (unsigned i = 0; i < profileBuffers.size(); i++)
+	{
+		lock_guard<mutex> bufferLock(profileBuffers[i]->m_mutex);
+		profileBuffers[i]->m_events.clear();
+		profileBuffers[i]->m_stats.clear();
+	}
+}
+
+/// Returns seconds since the first use of the profiler.
+double CProfiler::Now()
+{
+	return chrono::duration<double>(chrono::steady_clock::now() - profileEpoch()).count();
+}
+
+/// Record one call of a scope.
+void CProfiler::AddEvent(const char * name, const double& start, const double& duration, const double& self)
+{
+	profileInternalScope internal;
+	profileThreadBuffer * b = profileBuffer();
+	lock_guard<mutex> lock(b->m_mutex);
+
+	PROFILE_STAT& stat = b->m_stats[name];
+	if (stat.m_calls == 0 || duration < stat.m_min)
+		stat.m_min = duration;
+	if (duration > stat.m_max)
+		stat.m_max = duration;
+	stat.m_calls++;
+	stat.m_total += duration;
+	stat.m_self += self;
+
+	if (b->m_events.size() < PROFILE_MAX_EVENTS)
+	{
+		profileEvent event;
+		event.m_name = name;
+		event.m_start = start;
+		event.m_duration = duration;
+		b->m_events.push_back(event);
+	}
+}
+
+/// Add to the counters of a scope.
+void CProfiler::AddCount(const char * name, const long long& samples, const long long& bytes, const long long& allocations)
+{
+	profileInternalScope internal;
+	profileThreadBuffer * b = profileBuffer();
+	lock_guard<mutex> lock(b->m_mutex);
+
+	PROFILE_STAT& stat = b->m_stats[name];
+	stat.m_samples += samples;
+	stat.m_bytes += bytes;
+	stat.m_allocations += allocations;
+}
+
+/// Record the working set of one call of a scope.
+void CProfiler::AddMemory(const char * name, const long long& bytes)
+{
+	profileInternalScope internal;
+	profileThreadBuffer * b = profileBuffer();
+	lock_guard<mutex> lock(b->m_mutex);
+
+	PROFILE_STAT& stat = b->m_stats[name];
+	if (bytes > stat.m_peakBytes)
+		stat.m_peakBytes = bytes;
+}
+
+/// Returns count of calls of the global operator new by the calling thread.
+long long CProfiler::GetThreadAllocations()
+{
+	return profileAllocations;
+}
+
+/// Returns the resident set size of the process.
+long long CProfiler::GetCurrentRSS()
+{
+#if defined(__linux__)
+	long long pages = 0, resident = 0;
+	FILE *    statm = fopen("/proc/self/statm", "r");
+
+	if (statm == NULL)
+		return 0;
+	if (fscanf(statm, "%lld %lld", &pages, &resident) != 2)
+		resident = 0;
+	fclose(statm);
+
+	return resident * sysconf(_SC_PAGESIZE);
+#else
+	return 0;
+#endif
+}
+
+/// Returns the peak resident set size of the process.
+long long CProfiler::GetPeakRSS()
+{
+#if defined(__unix__) || defined(__APPLE__)
+	struct rusage usage;
+
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+		return 0;
+	#if defined(__APPLE__)
+		return usage.ru_maxrss;
+	#else
+		// kilobytes
+		return (long long)usage.ru_maxrss * 1024;
+	#endif
+#else
+	return 0;
+#endif
+}
+
+/// Summary of all scopes, sorted by name.
+void CProfiler::GetSummary(vector<PROFILE_STAT>& stats)
+{
+	map<string, PROFILE_STAT> merged;
+
+	{
+		lock_guard<mutex> lock(profileBuffersMutex);
+		for (unsigned i = 0; i < profileBuffers.size(); i++)
+		{
+			lock_guard<mutex> bufferLock(profileBuffers[i]->m_mutex);
+
+			map<const char *, PROFILE_STAT>::const_iterator it;
+			for (it = profileBuffers[i]->m_stats.begin(); it != profileBuffers[i]->m_stats.end(); ++it)
+			{
+				PROFILE_STAT& stat = merged[it->first];
+				const PROFILE_STAT& add = it->second;
+
+				if (add.m_calls > 0)
+				{
+					if (stat.m_calls == 0 || add.m_min < stat.m_min)
+						stat.m_min = add.m_min;
+					if (add.m_max > stat.m_max)
+						stat.m_max = add.m_max;
+				}
+				stat.m_name = it->first;
+				stat.m_calls += add.m_calls;
+				stat.m_total += add.m_total;
+				stat.m_self += add.m_self;
+				stat.m_samples += add.m_samples;
+				stat.m_bytes += add.m_bytes;
+				stat.m_allocations += add.m_allocations;
+				if (add.m_peakBytes > stat.m_peakBytes)
+					stat.m_peakBytes = add.m_peakBytes;
+			}
+		}
+	}
+
+	stats.clear();
+	for (map<string, PROFILE_STAT>::const_iterator it = merged.begin(); it != merged.end(); ++it)
+		stats.push_back(it->second);
+}
+
+/// One line for a status bar.
+string CProfiler::FormatSummary(const int& count)
+{
+	vector<PROFILE_STAT> stats;
+	string               line;
+	char                 item[128];
+	int                  i;
+
+	GetSummary(stats);
+	stable_sort(stats.begin(), stats.end(), profileSelfLonger);
+
+	for (i = 0; i < count && i < (int)stats.size(); i++)
+	{
+		// the class name is left out, the method names are unique enough
+		const char * name = strrchr(stats[i].m_name.c_str(), ':');
+		name = name ? name + 1 : stats[i].m_name.c_str();
+
+		snprintf(item, sizeof(item), "%s%s %.1f ms", i ? ", " : "", name, 1000 * stats[i].m_self);
+		line += item;
+	}
+
+	return line;
+}
+
+/// Write the summary as CSV.
+bool CProfiler::WriteSummary(const char * fileName)
+{
+	vector<PROFILE_STAT> stats;
+	FILE *               out = fopen(fileName, "w");
+	unsigned             i;
+
+	if (out == NULL)
+		return false;
+
+	GetSummary(stats);
+
+	fprintf(out, "scope,calls,total,self,min,max,samples,bytes,allocations,peak_bytes\n");
+	for (i = 0; i < stats.size(); i++)
+	{
+		fprintf(out, "%s,%lld,%.6f,%.6f,%.6f,%.6f,%lld,%lld,%lld,%lld\n", stats[i].m_name.c_str(), stats[i].m_calls, stats[i].m_total,
+				stats[i].m_self, stats[i].m_min, stats[i].m_max, stats[i].m_samples, stats[i].m_bytes, stats[i].m_allocations,
+				stats[i].m_peakBytes);
+	}
+
+	return fclose(out) == 0;
+}
+
+/// Write the timeline in the Chrome trace event format.
+bool CProfiler::WriteTrace(const char * fileName)
+{
+	FILE *   out = fopen(fileName, "w");
+	bool     first = true;
+	unsigned i, j;
+
+	if (out == NULL)
+		return false;
+
+	fprintf(out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+	{
+		lock_guard<mutex> lock(profileBuffersMutex);
+		for (i = 0; i < profileBuffers.size(); i++)
+		{
+			profileThreadBuffer * b = profileBuffers[i];
+			lock_guard<mutex> bufferLock(b->m_mutex);
+
+			if (b->m_events.empty())
+				continue;
+
+			fprintf(out, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"thread %d\"}}",
+					first ? "" : ",\n", b->m_thread, b->m_thread);
+			first = false;
+
+			// complete events, microseconds
+			for (j = 0; j < b->m_events.size(); j++)
+			{
+				fprintf(out, ",\n{\"name\":\"%s\",\"cat\":\"detector\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+						b->m_events[j].m_name, b->m_thread, 1e6 * b->m_events[j].m_start, 1e6 * b->m_events[j].m_duration);
+			}
+		}
+	}
+
+	fprintf(out, "\n]}\n");
+
+	return fclose(out) == 0;
+}
+
+// ------------------------------------------------------------------------------------------------
+// CProfilerScope
+// ------------------------------------------------------------------------------------------------
+
+/// A constructor.
+CProfilerScope::CProfilerScope(const char * name)
+	: m_name(name), m_start(-1), m_allocations(0), m_children(0), m_parent(NULL)
+{
+	if (!CProfiler::IsEnabled())
+		return;
+
+	m_parent = profileCurrentScope;
+	profileCurrentScope = this;
+	m_allocations = profileAllocations;
+	m_start = CProfiler::Now();
+}
+
+/// A destructor.
+CProfilerScope::~CProfilerScope()
+{
+	double    duration;
+	long long allocations;
+
+	if (m_start < 0)
+		return;
+
+	duration = CProfiler::Now() - m_start;
+	allocations = profileAllocations - m_allocations;
+	profileCurrentScope = m_parent;
+	if (m_parent)
+		m_parent->m_children += duration;
+
+	CProfiler::AddEvent(m_name, m_start, duration, duration - m_children);
+	if (allocations > 0)
+		CProfiler::AddCount(m_name, 0, 0, allocations);
+}
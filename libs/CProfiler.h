@@ -0,0 +1,209 @@
+#ifndef CProfiler_H
+#define CProfiler_H
+
+#include <vector>
+#include <string>
+#include <atomic>
+
+/// Maximal count of timeline events stored per thread, the summary is computed from all events.
+#define PROFILE_MAX_EVENTS 1000000
+
+/**
+ * Summary of one instrumented scope.
+ */
+typedef struct profileStat
+{
+public:
+	/// name of the scope
+	std::string m_name;
+	/// count of calls
+	long long   m_calls;
+	/// total time (second)
+	double      m_total;
+	/// time without the nested scopes (second)
+	double      m_self;
+	/// the shortest call (second)
+	double      m_min;
+	/// the longest call (second)
+	double      m_max;
+	/// count of processed samples
+	long long   m_samples;
+	/// count of processed bytes
+	long long   m_bytes;
+	/// count of calls of the global allocator in the calls, the nested scopes included (EDF_PROFILE)
+	long long   m_allocations;
+	/// the largest working set of one call (byte) - the buffers held by the stage at once
+	long long   m_peakBytes;
+
+	/// A constructor
+	profileStat(const std::string& name = std::string())
+		: m_name(name), m_calls(0), m_total(0), m_self(0), m_min(0), m_max(0), m_samples(0), m_bytes(0), m_allocations(0),
+		  m_peakBytes(0)
+	{
+		/* empty */
+	}
+} PROFILE_STAT;
+
+/**
+ * Instrumentation of the detector - scoped timers and counters of samples, bytes, allocations and working sets.
+ *
+ * The instrumentation is compiled in only with EDF_PROFILE defined (qmake CONFIG+=edf_profile), without it the
+ * macros \ref PROFILE_SCOPE, \ref PROFILE_COUNT, \ref PROFILE_ALLOC and \ref PROFILE_MEMORY are empty. The resident
+ * set size of the process (\ref GetCurrentRSS, \ref GetPeakRSS) is always available. When compiled in, the global
+ * operator new is replaced by a counting one (\ref GetThreadAllocations), the scopes count the calls. The recording
+ * is switched by \ref SetEnabled. Every thread records to its own buffer, the buffers are merged by \ref GetSummary
+ * and \ref WriteTrace (Chrome trace / Perfetto JSON timeline).
+ */
+class CProfiler
+{
+// methods
+public:
+	/**
+	 * Returns true if the instrumentation is compiled in (EDF_PROFILE).
+	 */
+	static bool IsCompiled();
+
+	/**
+	 * Switch the recording on or off.
+	 */
+	static void SetEnabled(const bool& enabled);
+
+	/**
+	 * Returns true if the recording is on.
+	 */
+	static inline bool IsEnabled()
+	{
+		return m_enabled.load(std::memory_order_relaxed);
+	}
+
+	/**
+	 * Remove all recorded events and counters - the start of a new run. Must not be called while an instrumented
+	 * code is running.
+	 */
+	static void Reset();
+
+	/**
+	 * Returns seconds since the first use of the profiler.
+	 */
+	static double Now();
+
+	/**
+	 * Record one call of a scope.
+	 * @param name name of the scope, a string literal
+	 * @param start start of the call (\ref Now)
+	 * @param duration duration of the call (second)
+	 * @param self duration without the nested scopes (second)
+	 */
+	static void AddEvent(const char * name, const double& start, const double& duration, const double& self);
+
+	/**
+	 * Add to the counters of a scope.
+	 * @param name name of the scope, a string literal
+	 * @param samples count of processed samples
+	 * @param bytes count of processed bytes
+	 * @param allocations count of buffer allocations
+	 */
+	static void AddCount(const char * name, const long long& samples, const long long& bytes, const long long& allocations);
+
+	/**
+	 * Record the working set of one call of a scope, the largest one is kept.
+	 * @param name name of the scope, a string literal
+	 * @param bytes bytes held by the scope at once
+	 */
+	static void AddMemory(const char * name, const long long& bytes);
+
+	/**
+	 * Returns the resident set size of the process (byte), 0 if it is not known on the platform.
+	 */
+	static long long GetCurrentRSS();
+
+	/**
+	 * Returns the peak resident set size of the process since its start (byte), 0 if it is not known on the platform.
+	 */
+	static long long GetPeakRSS();
+
+	/**
+	 * Returns count of calls of the global operator new by the calling thread since its start, 0 without EDF_PROFILE.
+	 * The allocations of the profiler itself are not counted. Counted also if the recording is off.
+	 */
+	static long long GetThreadAllocations();
+
+	/**
+	 * Summary of all scopes since the last \ref Reset, sorted by name.
+	 * @param stats output vector
+	 */
+	static void GetSummary(std::vector<PROFILE_STAT>& stats);
+
+	/**
+	 * One line for a status bar - the scopes with the longest self time.
+	 * @param count count of scopes in the line
+	 */
+	static std::string FormatSummary(const int& count = 4);
+
+	/**
+	 * Write the summary as CSV.
+	 * @return false if the file can not be written
+	 */
+	static bool WriteSummary(const char * fileName);
+
+	/**
+	 * Write the timeline in the Chrome trace event format (chrome://tracing, ui.perfetto.dev).
+	 * @return false if the file can not be written
+	 */
+	static bool WriteTrace(const char * fileName);
+
+// variables
+private:
+	static std::atomic<bool> m_enabled;
+};
+
+/**
+ * Scoped timer - records the time from the construction to the destruction, nested timers of one thread are
+ * subtracted from the self time.
+ */
+class CProfilerScope
+{
+public:
+	/**
+	 * A constructor.
+	 * @param name name of the scope, a string literal
+	 */
+	CProfilerScope(const char * name);
+
+	/**
+	 * A destructor.
+	 */
+	~CProfilerScope();
+
+private:
+	const char *     m_name;
+	double           m_start;
+	/// allocations of the thread at the start
+	long long        m_allocations;
+	/// time of the nested scopes
+	double           m_children;
+	CProfilerScope * m_parent;
+};
+
+#ifdef EDF_PROFILE
+	#define PROFILE_CONCAT_(a, b) a##b
+	#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+	/// time the rest of the enclosing block
+	#define PROFILE_SCOPE(name) CProfilerScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+	/// count processed samples and bytes
+	#define PROFILE_COUNT(name, samples, bytes) \
+		do { if (CProfiler::IsEnabled()) CProfiler::AddCount(name, samples, bytes, 0); } while (0)
+	/// count allocations outside of the global allocator (malloc of the libraries)
+	#define PROFILE_ALLOC(name, count) \
+		do { if (CProfiler::IsEnabled()) CProfiler::AddCount(name, 0, 0, count); } while (0)
+	/// record the working set of the call
+	#define PROFILE_MEMORY(name, bytes) \
+		do { if (CProfiler::IsEnabled()) CProfiler::AddMemory(name, bytes); } while (0)
+#else
+	#define PROFILE_SCOPE(name)
+	#define PROFILE_COUNT(name, samples, bytes)
+	#define PROFILE_ALLOC(name, count)
+	#define PROFILE_MEMORY(name, bytes)
+#endif
+
+#endif
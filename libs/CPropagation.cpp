@@ -0,0 +1,375 @@
+#include "CPropagation.h"
+#include "CParallel.h"
+#include "CSpectrum.h"
+#include "CProfiler.h"
+
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+using namespace std;
+
+/// Count of discharges analysed by one task, the lags of a task are collected together.
+#define PROPAGATION_BLOCK_EVENTS 256
+/// The lags are summed directly if their count times the window is below this factor times n log2 n of the FFT
+/// (one inverse transform of Alglib costs about as much as 24 n log2 n multiply-adds of the direct sums, measured).
+#define PROPAGATION_FFT_FACTOR 24
+
+// ------------------------------------------------------------------------------------------------
+// CEnvelopeWindows
+// ------------------------------------------------------------------------------------------------
+
+/// A constructor.
+CEnvelopeWindows::CEnvelopeWindows(const DETECTOR_SETTINGS& settings, const double& length)
+	: m_settings(settings), m_length(length), m_fs(0)
+{
+	/* empty */
+}
+
+/// A virtual destructor.
+CEnvelopeWindows::~CEnvelopeWindows()
+{
+	/* empty */
+}
+
+/// Set the windows of the next pass.
+void CEnvelopeWindows::SetStarts(const vector<double>& starts)
+{
+	m_starts = starts;
+	m_order.resize(starts.size());
+	for (size_t i = 0; i < m_order.size(); i++)
+		m_order[i] = i;
+
+	stable_sort(m_order.begin(), m_order.end(), [this](const int& a, const int& b) {
+		return m_starts[a] < m_starts[b];
+	});
+}
+
+/// The envelope only.
+int CEnvelopeWindows::GetStreams() const
+{
+	return PIPELINE_ENVELOPE;
+}
+
+/// Forget the windows of the previous pass.
+void CEnvelopeWindows::BeginChannel(const int& /*channel*/, const int& /*countSegments*/)
+{
+	m_windows.assign(m_starts.size(), vector<SIGNALTYPE>());
+}
+
+/// Copy the windows with the centre in the segment without its overlaps.
+void CEnvelopeWindows::ProcessSegment(const PIPELINE_SEGMENT& segment)
+{
+	const vector<SIGNALTYPE>& envelope = segment.m_envelope;
+	double                    segmentStart = segment.m_start / (double)segment.m_inputFS;
+	double                    low = -numeric_limits<double>::infinity(), high = numeric_limits<double>::infinity();
+	SAMPLEINDEX               first, sample;
+	size_t                    n;
+	vector<int>::iterator     it;
+
+	// the same parts of the segments as CSpikeDetector::TrimSegment
+	if (segment.m_segment > 0)
+		low = segmentStart + 3 * m_settings.m_winsize;
+	if (segment.m_segment < segment.m_countSegments - 1)
+		high = segment.m_stop / (double)segment.m_inputFS - 3 * m_settings.m_winsize;
+
+	m_fs = segment.m_fs;
+	n = max(2, (int)round(m_length * m_fs));
+
+	it = lower_bound(m_order.begin(), m_order.end(), low, [this](const int& window, const double& time) {
+		return m_starts[window] + m_length / 2 < time;
+	});
+	for (; it != m_order.end() && m_starts[*it] + m_length / 2 < high; it++)
+	{
+		vector<SIGNALTYPE>& window = m_windows[*it];
+
+		window.assign(n, 0);
+		first = (SAMPLEINDEX)round((m_starts[*it] - segmentStart) * m_fs);
+		for (size_t i = 0; i < n; i++)
+		{
+			sample = first + (SAMPLEINDEX)i;
+			if (sample >= 0 && sample < (SAMPLEINDEX)envelope.size())
+				window[i] = envelope[sample];
+		}
+	}
+}
+
+// ------------------------------------------------------------------------------------------------
+// CPropagation
+// ------------------------------------------------------------------------------------------------
+
+/// A constructor.
+CPropagation::CPropagation(CInputEDF * model, const DETECTOR_SETTINGS& settings, const PROPAGATION_SETTINGS& propagation)
+	: m_model(model), m_settings(settings), m_propagation(propagation), m_countEvents(0)
+{
+	/* empty */
+}
+
+/// A virtual destructor.
+CPropagation::~CPropagation()
+{
+	/* empty */
+}
+
+/// Lags of the discharges.
+void CPropagation::Analyse(const CDischarges& discharges, const int& workers)
+{
+	PROFILE_SCOPE("CPropagation::Analyse");
+
+	int                                   countChannels = min((int)discharges.GetCountChannels(), m_model->GetCountChannels());
+	int                                   countRecords = discharges.GetCount();
+	vector<vector<double> >               starts(countChannels);
+	vector<int>                           events, channels;
+	vector<vector<pair<int, int> > >      eventChannels;
+	vector<map<pair<int, int>, LAG_DISTRIBUTION> > blocks;
+	int                                   record, channel;
+
+	m_pairs.clear();
+	m_windows.assign(countChannels, vector<vector<SIGNALTYPE> >());
+	m_fs.assign(countChannels, 0);
+
+	// the discharges of at least two channels, one window per channel at the onset of the discharge
+	for (record = 0; record < countRecords; record++)
+	{
+		vector<pair<int, int> > involved;
+		double                  start = discharges.GetOnset(record) - m_propagation.m_window / 2;
+
+		for (channel = 0; channel < countChannels; channel++)
+			if (!std::isnan(discharges.m_MP[channel][record]))
+				involved.push_back(make_pair(channel, (int)starts[channel].size()));
+
+		if (involved.size() < 2)
+			continue;
+
+		for (size_t i = 0; i < involved.size(); i++)
+			starts[involved[i].first].push_back(start);
+
+		events.push_back(record);
+		eventChannels.push_back(involved);
+	}
+	m_countEvents = events.size();
+
+	for (channel = 0; channel < countChannels; channel++)
+		if (!starts[channel].empty())
+			channels.push_back(channel);
+
+	// the envelope windows, one pass of the pipeline per channel
+	CParallel::Run(channels.size(), workers, [&](int i) {
+		CPipeline        pipeline(m_model, m_settings);
+		CEnvelopeWindows windows(m_settings, m_propagation.m_window);
+
+		windows.SetStarts(starts[channels[i]]);
+		pipeline.AddDetector(&windows);
+		pipeline.RunChannel(channels[i]);
+
+		m_windows[channels[i]] = windows.GetWindows();
+		m_fs[channels[i]] = windows.GetFS();
+	});
+
+	// the lags of the blocks of the discharges, merged in the order of the blocks
+	blocks.resize((events.size() + PROPAGATION_BLOCK_EVENTS - 1) / PROPAGATION_BLOCK_EVENTS);
+	CParallel::Run(blocks.size(), workers, [&](int block) {
+		size_t last = min(events.size(), (size_t)(block + 1) * PROPAGATION_BLOCK_EVENTS);
+
+		for (size_t i = (size_t)block * PROPAGATION_BLOCK_EVENTS; i < last; i++)
+			estimateLags(events[i], eventChannels[i], blocks[block]);
+	});
+
+	for (size_t block = 0; block < blocks.size(); block++)
+	{
+		map<pair<int, int>, LAG_DISTRIBUTION>::iterator it;
+
+		for (it = blocks[block].begin(); it != blocks[block].end(); it++)
+		{
+			LAG_DISTRIBUTION& pair = m_pairs[it->first];
+
+			pair.m_events.insert(pair.m_events.end(), it->second.m_events.begin(), it->second.m_events.end());
+			pair.m_lags.insert(pair.m_lags.end(), it->second.m_lags.begin(), it->second.m_lags.end());
+			pair.m_correlations.insert(pair.m_correlations.end(), it->second.m_correlations.begin(), it->second.m_correlations.end());
+		}
+		blocks[block].clear();
+	}
+
+	m_windows.clear();
+}
+
+/// Lags of all pairs of the channels of one discharge.
+void CPropagation::estimateLags(const int& event, const vector<pair<int, int> >& channels, map<pair<int, int>, LAG_DISTRIBUTION>& pairs)
+{
+	static thread_local vector<double> centred, spectra, cross;
+
+	size_t              count = channels.size(), i, j;
+	vector<size_t>      offsets(count + 1, 0);
+	vector<int>         lengths(count, 0);
+	vector<double>      energy(count, 0);
+	vector<bool>        transformed(count, false);
+	int                 n, fs, length, maxLag, lag, best, t;
+	double              mean, peak, shift, y0, y2, denominator;
+
+	for (i = 0; i < count; i++)
+	{
+		const vector<SIGNALTYPE>& window = m_windows[channels[i].first][channels[i].second];
+
+		if (window.size() >= 2 && m_fs[channels[i].first] > 0)
+			lengths[i] = window.size();
+		offsets[i + 1] = offsets[i] + 2 * lengths[i];
+	}
+
+	// every window without its mean, zero padded to the double length (no circular wrap of the lags)
+	centred.resize(offsets[count]);
+	spectra.resize(offsets[count]);
+	for (i = 0; i < count; i++)
+	{
+		const vector<SIGNALTYPE>& window = m_windows[channels[i].first][channels[i].second];
+		double *                  data = centred.data() + offsets[i];
+
+		mean = 0;
+		for (t = 0; t < lengths[i]; t++)
+			mean += window[t];
+		mean /= max(lengths[i], 1);
+
+		for (t = 0; t < lengths[i]; t++)
+		{
+			data[t] = window[t] - mean;
+			energy[i] += data[t] * data[t];
+		}
+		fill(data + lengths[i], data + 2 * lengths[i], 0.0);
+	}
+
+	for (i = 0; i < count; i++)
+	{
+		for (j = i + 1; j < count; j++)
+		{
+			if (lengths[i] == 0 || lengths[i] != lengths[j] || m_fs[channels[i].first] != m_fs[channels[j].first] || energy[i] <= 0 || energy[j] <= 0)
+				continue;
+
+			length = lengths[i];
+			n = 2 * length;
+			fs = m_fs[channels[i].first];
+			maxLag = min((int)round(m_propagation.m_maxLag * fs), length - 1);
+			cross.resize(n);
+
+			if ((2 * maxLag + 1) * (double)length > PROPAGATION_FFT_FACTOR * n * log2((double)n))
+			{
+				// many lags - the inverse transform of the cross spectrum conj(X_i) * X_j, every window is transformed once
+				const double * a = spectra.data() + offsets[i];
+				const double * b = spectra.data() + offsets[j];
+
+				for (size_t k = i; k <= j; k += j - i)
+				{
+					if (transformed[k])
+						continue;
+
+					copy(centred.begin() + offsets[k], centred.begin() + offsets[k + 1], spectra.begin() + offsets[k]);
+					CFFTPlan::GetThreadPlan(n).Forward(spectra.data() + offsets[k]);
+					transformed[k] = true;
+				}
+
+				cross[0] = a[0] * b[0];
+				cross[1] = a[1] * b[1];
+				for (int k = 1; k < length; k++)
+				{
+					cross[2 * k] = a[2 * k] * b[2 * k] + a[2 * k + 1] * b[2 * k + 1];
+					cross[2 * k + 1] = a[2 * k] * b[2 * k + 1] - a[2 * k + 1] * b[2 * k];
+				}
+				CFFTPlan::GetThreadPlan(n).Inverse(cross.data());
+			}
+			else
+			{
+				// few lags - the sums of the lags directly, the same values
+				const double * a = centred.data() + offsets[i];
+				const double * b = centred.data() + offsets[j];
+
+				for (lag = -maxLag; lag <= maxLag; lag++)
+				{
+					double sum = 0;
+
+					for (t = max(0, -lag); t < min(length, length - lag); t++)
+						sum += a[t] * b[t + lag];
+					cross[(lag + n) % n] = sum;
+				}
+			}
+
+			// the peak within the largest lag, the negative lags at the end
+			best = 0;
+			for (lag = -maxLag; lag <= maxLag; lag++)
+				if (cross[(lag + n) % n] > cross[(best + n) % n])
+					best = lag;
+
+			peak = cross[(best + n) % n];
+			shift = 0;
+			if (best > -maxLag && best < maxLag)
+			{
+				y0 = cross[(best - 1 + n) % n];
+				y2 = cross[(best + 1 + n) % n];
+				denominator = y0 - 2 * peak + y2;
+				if (denominator < 0)
+				{
+					shift = 0.5 * (y0 - y2) / denominator;
+					peak -= 0.25 * (y0 - y2) * shift;
+				}
+			}
+
+			LAG_DISTRIBUTION& distribution = pairs[make_pair(channels[i].first, channels[j].first)];
+			distribution.m_events.push_back(event);
+			distribution.m_lags.push_back((best + shift) / fs);
+			distribution.m_correlations.push_back(peak / sqrt(energy[i] * energy[j]));
+		}
+	}
+}
+
+/// Discharges of single channels to multichannel discharges.
+void CPropagation::Combine(const vector<const CDischarges*>& channels, const double& tolerance, CDischarges& out)
+{
+	vector<pair<double, pair<int, int> > > onsets;
+	vector<int>                            records;
+	int                                    countChannels = channels.size(), channel, record;
+	double                                 previous = 0, end;
+	size_t                                 i, j, first;
+
+	out = CDischarges(countChannels);
+
+	for (channel = 0; channel < countChannels; channel++)
+	{
+		if (channels[channel] == NULL || channels[channel]->GetCountChannels() == 0)
+			continue;
+
+		const vector<double>& positions = channels[channel]->m_MP[0];
+		for (record = 0; record < (int)positions.size(); record++)
+			if (!std::isnan(positions[record]))
+				onsets.push_back(make_pair(positions[record], make_pair(channel, record)));
+	}
+	sort(onsets.begin(), onsets.end());
+
+	for (i = 0; i < onsets.size(); i = j)
+	{
+		// the onsets of one discharge, the first onset of every channel
+		records.assign(countChannels, -1);
+		first = i;
+		for (j = i; j < onsets.size() && (j == first || onsets[j].first - previous <= tolerance); j++)
+		{
+			previous = onsets[j].first;
+			if (records[onsets[j].second.first] < 0)
+				records[onsets[j].second.first] = onsets[j].second.second;
+		}
+
+		// the duration of the discharge from the first onset to the last end
+		end = onsets[first].first;
+		for (channel = 0; channel < countChannels; channel++)
+			if (records[channel] >= 0)
+				end = max(end, channels[channel]->m_MP[0][records[channel]] + channels[channel]->m_MD[0][records[channel]]);
+
+		for (channel = 0; channel < countChannels; channel++)
+		{
+			const CDischarges * source = channels[channel];
+
+			record = records[channel];
+			out.m_MV[channel].push_back(record >= 0 ? source->m_MV[0][record] : 0);
+			out.m_MA[channel].push_back(record >= 0 ? source->m_MA[0][record] : 0);
+			out.m_MP[channel].push_back(record >= 0 ? source->m_MP[0][record] : NAN);
+			out.m_MD[channel].push_back(end - onsets[first].first);
+			out.m_MW[channel].push_back(record >= 0 ? source->m_MW[0][record] : 0);
+			out.m_MPDF[channel].push_back(record >= 0 ? source->m_MPDF[0][record] : 0);
+		}
+	}
+}
@@ -0,0 +1,207 @@
+#ifndef CPropagation_H
+#define CPropagation_H
+
+#include <vector>
+#include <map>
+#include <memory>
+
+#include "Definitions.h"
+#include "CInputEDF.h"
+#include "CSpikeDetector.h"
+#include "CPipeline.h"
+
+/**
+ * Settings of the lag analysis.
+ */
+typedef struct propagationSettings
+{
+public:
+	/// length of the envelope window around the onset of the discharge (second)
+	double    m_window;
+	/// the largest lag searched (second)
+	double    m_maxLag;
+
+	/// A constructor
+	propagationSettings(const double& window = 0.25, const double& maxLag = 0.05)
+		: m_window(window), m_maxLag(maxLag)
+	{
+		/* empty */
+	}
+} PROPAGATION_SETTINGS;
+
+/**
+ * Lags of one pair of channels, one estimate per discharge of both channels, in the order of the discharges.
+ */
+typedef struct lagDistribution
+{
+public:
+	/// index of the discharge of the estimate
+	std::vector<int>     m_events;
+	/// lag of the second channel of the pair behind the first one (second), negative - the second channel leads
+	std::vector<double>  m_lags;
+	/// peak of the normalized cross-correlation of the envelopes (-1 - 1)
+	std::vector<double>  m_correlations;
+
+	/// A constructor
+	lagDistribution()
+	{
+		/* empty */
+	}
+} LAG_DISTRIBUTION;
+
+/**
+ * Windows of the envelope of one channel, a plugin of \ref CPipeline. The windows are requested by their start before
+ * the pass over the channel, every window is taken from the segment whose part without the overlaps holds its centre
+ * - the same envelope as the detector sees.
+ */
+class CEnvelopeWindows : public CPipelineDetector
+{
+// methods
+public:
+	/**
+	 * A constructor.
+	 * @param settings settings of the detector, the pipeline must use the same settings
+	 * @param length length of the windows (second)
+	 */
+	CEnvelopeWindows(const DETECTOR_SETTINGS& settings, const double& length);
+
+	/**
+	 * A virtual desctructor.
+	 */
+	virtual ~CEnvelopeWindows();
+
+	/**
+	 * Set the windows of the next pass, the previous windows are removed.
+	 * @param starts starts of the windows (second)
+	 */
+	void SetStarts(const std::vector<double>& starts);
+
+	virtual int GetStreams() const;
+	virtual void BeginChannel(const int& channel, const int& countSegments);
+	virtual void ProcessSegment(const PIPELINE_SEGMENT& segment);
+
+	/**
+	 * Returns the windows in the order of their starts - zeros outside the channel, empty if the channel could not be read.
+	 */
+	inline const std::vector<std::vector<SIGNALTYPE> >& GetWindows() const
+	{
+		return m_windows;
+	}
+
+	/**
+	 * Returns sample rate of the envelope, 0 before the first segment.
+	 */
+	inline int GetFS() const
+	{
+		return m_fs;
+	}
+
+// variables
+private:
+	/// settings of the detector
+	DETECTOR_SETTINGS                       m_settings;
+	/// length of the windows (second)
+	double                                  m_length;
+	/// starts of the windows (second)
+	std::vector<double>                     m_starts;
+	/// indexes of the windows sorted by their start
+	std::vector<int>                        m_order;
+	/// the windows
+	std::vector<std::vector<SIGNALTYPE> >   m_windows;
+	/// sample rate of the envelope
+	int                                     m_fs;
+};
+
+/**
+ * Propagation of the discharges - lags between the channels of every multichannel discharge.
+ *
+ * The envelope of every channel is read by one pass of \ref CPipeline (\ref CEnvelopeWindows), a window of
+ * \ref PROPAGATION_SETTINGS::m_window around the onset of every discharge of the channel is kept - the same window
+ * for all channels of one discharge. The lags of all pairs of channels of a discharge are estimated by the
+ * cross-correlation of the windows without their mean. With many lags to search the correlation is the FFT one - every
+ * window is transformed once and every pair takes one inverse transform of the cross spectrum; a short window with a
+ * few lags sums the lags directly, which is cheaper than the transform. The peak within
+ * \ref PROPAGATION_SETTINGS::m_maxLag is refined by a parabola through its neighbours.
+ *
+ * The channels are read and the discharges are analysed in parallel, every block of discharges collects its own lags
+ * and the blocks are merged in their order - the result does not depend on the count of threads. Only channels of the
+ * same sample rate (after the decimation) are paired.
+ */
+class CPropagation
+{
+// methods
+public:
+	/**
+	 * A constructor.
+	 * @param model the open file, read by more threads at once
+	 * @param settings settings of the detector, the envelope of the detection
+	 * @param propagation settings of the lag analysis
+	 */
+	CPropagation(CInputEDF * model, const DETECTOR_SETTINGS& settings, const PROPAGATION_SETTINGS& propagation = PROPAGATION_SETTINGS());
+
+	/**
+	 * A virtual desctructor.
+	 */
+	virtual ~CPropagation();
+
+	/**
+	 * Lags of the discharges, the previous lags are removed. Throws an error message of the input.
+	 * @param discharges discharges of the channels of the model (\ref CDischarges::m_MP, NaN - the channel does not take part)
+	 * @param workers count of threads, 0 - count of cores
+	 */
+	void Analyse(const CDischarges& discharges, const int& workers = 0);
+
+	/**
+	 * Returns the lags of the pairs of channels (first < second), only the pairs with an estimate.
+	 */
+	inline const std::map<std::pair<int, int>, LAG_DISTRIBUTION>& GetPairs() const
+	{
+		return m_pairs;
+	}
+
+	/**
+	 * Returns count of the discharges of at least two channels of the last analysis.
+	 */
+	inline int GetCountEvents() const
+	{
+		return m_countEvents;
+	}
+
+	/**
+	 * Discharges of single channels to multichannel discharges. The onsets of all channels are swept in time order, an
+	 * onset within the tolerance of the previous one joins its discharge, every channel takes its first onset of the
+	 * discharge.
+	 * @param channels discharges of every channel of the model (one channel each), NULL - no discharges
+	 * @param tolerance the largest gap between the onsets of one discharge (second)
+	 * @param out output - discharges of channels.size() channels, sorted by the onset
+	 */
+	static void Combine(const std::vector<const CDischarges*>& channels, const double& tolerance, CDischarges& out);
+
+private:
+	/**
+	 * Lags of all pairs of the channels of one discharge.
+	 * @param event index of the discharge
+	 * @param channels channels of the discharge and the indexes of their windows
+	 * @param pairs output - the lags are added
+	 */
+	void estimateLags(const int& event, const std::vector<std::pair<int, int> >& channels, std::map<std::pair<int, int>, LAG_DISTRIBUTION>& pairs);
+
+// variables
+private:
+	/// the open file
+	CInputEDF *                                       m_model;
+	/// settings of the detector
+	DETECTOR_SETTINGS                                 m_settings;
+	/// settings of the lag analysis
+	PROPAGATION_SETTINGS                              m_propagation;
+	/// envelope windows of the channels, in the order of the discharges of the channel
+	std::vector<std::vector<std::vector<SIGNALTYPE> > > m_windows;
+	/// sample rate of the envelope of the channels
+	std::vector<int>                                  m_fs;
+	/// lags of the pairs of channels
+	std::map<std::pair<int, int>, LAG_DISTRIBUTION>   m_pairs;
+	/// count of the discharges of at least two channels
+	int                                               m_countEvents;
+};
+
+#endif
@@ -0,0 +1,276 @@
+#include "CSpectrum.h"
+#include "CParallel.h"
+#include "CProfiler.h"
+
+#include <cmath>
+#include <map>
+#include <memory>
+#include <algorithm>
+
+using namespace std;
+
+/// A constructor.
+CFFTPlan::CFFTPlan(const int& n)
+	: m_n(n), m_window(n), m_windowPower(0)
+{
+	int i;
+
+	if (n < 2 || n % 2)
+		throw "Spectrum: the length of the FFT must be even.";
+
+	alglib_impl::ae_state_init(&m_state);
+	alglib_impl::_fasttransformplan_init(&m_plan, NULL);
+	alglib_impl::ae_vector_init(&m_data, n, alglib_impl::DT_REAL, NULL);
+	alglib_impl::ae_vector_init(&m_buffer, n, alglib_impl::DT_REAL, NULL);
+
+	// the real transform of n is the complex transform of n / 2 (Alglib's fftr1d), the plan is the expensive part
+	if (n > 2)
+		alglib_impl::ftcomplexfftplan(n / 2, 1, &m_plan, &m_state);
+
+	// periodic Hann window
+	for (i = 0; i < n; i++)
+	{
+		m_window[i] = 0.5 - 0.5 * cos(2 * M_PI * i / n);
+		m_windowPower += m_window[i] * m_window[i];
+	}
+}
+
+/// A virtual destructor.
+CFFTPlan::~CFFTPlan()
+{
+	alglib_impl::_fasttransformplan_destroy(&m_plan);
+	alglib_impl::ae_vector_destroy(&m_data);
+	alglib_impl::ae_vector_destroy(&m_buffer);
+	alglib_impl::ae_state_clear(&m_state);
+}
+
+/// Forward FFT in place.
+void CFFTPlan::Forward(double * data)
+{
+	copy(data, data + m_n, m_data.ptr.p_double);
+	alglib_impl::fftr1dinternaleven(&m_data, m_n, &m_buffer, &m_plan, &m_state);
+	copy(m_data.ptr.p_double, m_data.ptr.p_double + m_n, data);
+}
+
+/// Inverse FFT in place.
+void CFFTPlan::Inverse(double * data)
+{
+	double * h = m_data.ptr.p_double;
+	int      i;
+
+	// the inverse by the forward transform of the Hartley sequence, as Alglib's fftr1dinv
+	h[0] = data[0];
+	h[m_n / 2] = data[1];
+	for (i = 1; i < m_n / 2; i++)
+	{
+		h[i] = data[2 * i] - data[2 * i + 1];
+		h[m_n - i] = data[2 * i] + data[2 * i + 1];
+	}
+
+	alglib_impl::fftr1dinternaleven(&m_data, m_n, &m_buffer, &m_plan, &m_state);
+
+	data[0] = h[0] / m_n;
+	data[m_n / 2] = h[1] / m_n;
+	for (i = 1; i < m_n / 2; i++)
+	{
+		double re = h[2 * i], im = h[2 * i + 1];
+		data[i] = (re - im) / m_n;
+		data[m_n - i] = (re + im) / m_n;
+	}
+}
+
+/// Add the power of one window.
+void CFFTPlan::AddPower(const SIGNALTYPE * samples, vector<double>& power)
+{
+	double * data = m_data.ptr.p_double;
+	double   mean = 0;
+	int      i;
+
+	for (i = 0; i < m_n; i++)
+		mean += samples[i];
+	mean /= m_n;
+
+	for (i = 0; i < m_n; i++)
+		data[i] = (samples[i] - mean) * m_window[i];
+
+	// packed spectrum - DC, Nyquist, then the real and imaginary parts of the bins 1 .. n / 2 - 1
+	alglib_impl::fftr1dinternaleven(&m_data, m_n, &m_buffer, &m_plan, &m_state);
+
+	power[0] += data[0] * data[0];
+	power[m_n / 2] += data[1] * data[1];
+	for (i = 1; i < m_n / 2; i++)
+		power[i] += data[2 * i] * data[2 * i] + data[2 * i + 1] * data[2 * i + 1];
+}
+
+/// Returns the plan of the length of the calling thread.
+CFFTPlan& CFFTPlan::GetThreadPlan(const int& n)
+{
+	static thread_local map<int, unique_ptr<CFFTPlan> > plans;
+
+	unique_ptr<CFFTPlan>& plan = plans[n];
+	if (!plan)
+		plan.reset(new CFFTPlan(n));
+
+	return *plan;
+}
+
+/// A constructor.
+CSpectrum::CSpectrum(CInputEDF * model, const SPECTRUM_SETTINGS& settings)
+	: m_model(model), m_settings(settings)
+{
+	/* empty */
+}
+
+/// A virtual destructor.
+CSpectrum::~CSpectrum()
+{
+	/* empty */
+}
+
+/// Returns length of the window of the channel.
+int CSpectrum::GetLength(const int& channel) const
+{
+	int n = (int)round(m_settings.m_window * m_model->GetFS(channel));
+
+	return max(2, n + n % 2);
+}
+
+/// Returns frequency of the bin.
+double CSpectrum::GetFrequency(const int& channel, const int& bin) const
+{
+	return bin * (double)m_model->GetFS(channel) / GetLength(channel);
+}
+
+/// Samples of the range of the channel.
+void CSpectrum::getRange(const int& channel, const double& t0, const double& t1, SAMPLEINDEX& start, SAMPLEINDEX& stop) const
+{
+	int fs = m_model->GetFS(channel);
+
+	if (fs <= 0)
+		throw "Spectrum: invalid channel number.";
+
+	start = max(0LL, (SAMPLEINDEX)floor(t0 * fs));
+	stop = min(m_model->GetCountSamples(channel), (SAMPLEINDEX)ceil(t1 * fs));
+	if (stop < start)
+		stop = start;
+}
+
+/// Add the power of the windows, read by blocks.
+void CSpectrum::addWindows(const int& channel, const SAMPLEINDEX& start, const SAMPLEINDEX& hop, const SAMPLEINDEX& count, vector<double>& power)
+{
+	int                          n = GetLength(channel);
+	CFFTPlan&                    plan = CFFTPlan::GetThreadPlan(n);
+	SAMPLEINDEX                  perBlock = max(1LL, (SPECTRUM_BLOCK_SAMPLES - n) / hop + 1);
+	SAMPLEINDEX                  k, j, first, length;
+	unique_ptr<vector<SIGNALTYPE> > block;
+
+	for (k = 0; k < count; k += perBlock)
+	{
+		j = min(perBlock, count - k);
+		first = start + k * hop;
+		length = (j - 1) * hop + n;
+
+		block.reset(m_model->GetSegmentFromChannel(channel, first, first + length));
+		if (!block)
+			throw "Spectrum: can not read the channel.";
+
+		// the last window of a short channel is padded by zeros
+		block->resize(length, 0);
+
+		for (j = 0; j < min(perBlock, count - k); j++)
+			plan.AddPower(block->data() + j * hop, power);
+	}
+}
+
+/// The accumulated power to one-sided density.
+void CSpectrum::normalize(const int& channel, const SAMPLEINDEX& countWindows, vector<double>& power) const
+{
+	int    n = GetLength(channel);
+	double scale = 1.0 / (max(countWindows, 1LL) * m_model->GetFS(channel) * CFFTPlan::GetThreadPlan(n).GetWindowPower());
+
+	for (size_t i = 0; i < power.size(); i++)
+		power[i] *= (i == 0 || (int)i == n / 2) ? scale : 2 * scale;
+}
+
+/// Welch's power spectral density of the range of the channel.
+void CSpectrum::Welch(const int& channel, const double& t0, const double& t1, vector<double>& psd)
+{
+	PROFILE_SCOPE("CSpectrum::Welch");
+
+	int         n = GetLength(channel);
+	SAMPLEINDEX hop = max(1, (int)round(n * (1 - m_settings.m_overlap)));
+	SAMPLEINDEX start, stop, count;
+
+	getRange(channel, t0, t1, start, stop);
+	psd.assign(n / 2 + 1, 0);
+
+	// a range shorter than the window is one window from its start
+	count = (stop - start >= n) ? (stop - start - n) / hop + 1 : 1;
+	if (stop - start < n)
+		start = max(0LL, min(start, m_model->GetCountSamples(channel) - n));
+
+	addWindows(channel, start, hop, count, psd);
+	normalize(channel, count, psd);
+}
+
+/// Spectrogram of the range of the channel.
+void CSpectrum::Spectrogram(const int& channel, const double& t0, const double& t1, const int& countColumns, vector<vector<double> >& columns)
+{
+	PROFILE_SCOPE("CSpectrum::Spectrogram");
+
+	int         n = GetLength(channel);
+	SAMPLEINDEX hop = max(1, (int)round(n * (1 - m_settings.m_overlap)));
+	SAMPLEINDEX start, stop, first, last, count, k;
+	double      span;
+	int         c;
+
+	getRange(channel, t0, t1, start, stop);
+	span = (stop - start) / (double)max(countColumns, 1);
+	columns.assign(max(countColumns, 0), vector<double>(n / 2 + 1, 0));
+
+	for (c = 0; c < countColumns; c++)
+	{
+		vector<double>& column = columns[c];
+
+		first = start + (SAMPLEINDEX)floor(c * span);
+		last = start + (SAMPLEINDEX)floor((c + 1) * span);
+
+		// a column shorter than the window is the window around its centre
+		if (last - first < n)
+		{
+			first = max(0LL, min((first + last - n) / 2, m_model->GetCountSamples(channel) - n));
+			count = 1;
+			addWindows(channel, first, hop, 1, column);
+		}
+		else if ((count = (last - first - n) / hop + 1) <= SPECTRUM_COLUMN_WINDOWS)
+			addWindows(channel, first, hop, count, column);
+		else
+		{
+			// windows spread over a long column, read one by one
+			count = SPECTRUM_COLUMN_WINDOWS;
+			for (k = 0; k < count; k++)
+				addWindows(channel, first + k * (last - first - n) / (count - 1), hop, 1, column);
+		}
+
+		normalize(channel, count, column);
+	}
+}
+
+/// Welch's power spectral density of more channels in parallel.
+void CSpectrum::WelchChannels(const vector<int>& channels, const double& t0, const double& t1, vector<vector<double> >& psd, const int& workers)
+{
+	psd.assign(channels.size(), vector<double>());
+	CParallel::Run(channels.size(), workers, [&](int i) {
+		Welch(channels[i], t0, t1, psd[i]);
+	});
+}
+
+/// Spectrograms of more channels in parallel.
+void CSpectrum::SpectrogramChannels(const vector<int>& channels, const double& t0, const double& t1, const int& countColumns,
+									vector<vector<vector<double> > >& columns, const int& workers)
+{
+	columns.assign(channels.size(), vector<vector<double> >());
+	CParallel::Run(channels.size(), workers, [&](int i) {
+		Spectrogram(channels[i], t0, t1, countColumns, columns[i]);
+	});
+}
@@ -0,0 +1,213 @@
+#ifndef CSpectrum_H
+#define CSpectrum_H
+
+#include <vector>
+
+#include "lib/Alglib/fasttransforms.h"
+#include "Definitions.h"
+#include "CInputEDF.h"
+
+/// The most samples read at once by one channel, the memory of the streaming average.
+#define SPECTRUM_BLOCK_SAMPLES (1 << 20)
+/// The most windows averaged in one column of a spectrogram, the columns of a long range sample their span.
+#define SPECTRUM_COLUMN_WINDOWS 8
+
+/**
+ * Settings of the spectral analysis.
+ */
+typedef struct spectrumSettings
+{
+public:
+	/// length of one window (second), the FFT length is the even count of samples of the window
+	double    m_window;
+	/// overlap of the neighbouring windows (0 - 1)
+	double    m_overlap;
+
+	/// A constructor
+	spectrumSettings(const double& window = 2, const double& overlap = 0.5)
+		: m_window(window), m_overlap(overlap)
+	{
+		/* empty */
+	}
+} SPECTRUM_SETTINGS;
+
+/**
+ * Real FFT of one even length - the Alglib plan of the complex FFT of the half length, its buffers and the Hann window.
+ * The plan is built once, \ref GetThreadPlan keeps the plans of every length of the calling thread.
+ */
+class CFFTPlan
+{
+// methods
+public:
+	/**
+	 * A constructor.
+	 * @param n length of the transform, even
+	 */
+	CFFTPlan(const int& n);
+
+	/**
+	 * A virtual desctructor.
+	 */
+	virtual ~CFFTPlan();
+
+	/**
+	 * Forward FFT of n real samples in place, the packed spectrum - [0] DC, [1] Nyquist, [2k] and [2k + 1] the real and
+	 * imaginary part of the bin k (0 < k < n / 2).
+	 * @param data n samples, the packed spectrum after the call
+	 */
+	void Forward(double * data);
+
+	/**
+	 * Inverse of \ref Forward in place, the packed spectrum to n real samples.
+	 * @param data the packed spectrum, n samples after the call
+	 */
+	void Inverse(double * data);
+
+	/**
+	 * Returns length of the transform.
+	 */
+	inline int GetLength() const
+	{
+		return m_n;
+	}
+
+	/**
+	 * Power of one window - the samples without their mean, times the Hann window, |FFT|^2 of bins 0 .. n / 2.
+	 * @param samples n samples
+	 * @param power output - accumulator of n / 2 + 1 bins, the power is added
+	 */
+	void AddPower(const SIGNALTYPE * samples, std::vector<double>& power);
+
+	/**
+	 * Returns sum of squares of the window.
+	 */
+	inline double GetWindowPower() const
+	{
+		return m_windowPower;
+	}
+
+	/**
+	 * Returns the plan of the length of the calling thread, built at the first call.
+	 * @param n length of the transform, even
+	 */
+	static CFFTPlan& GetThreadPlan(const int& n);
+
+// variables
+private:
+	/// length of the transform
+	int                            m_n;
+	/// the Hann window
+	std::vector<double>            m_window;
+	/// sum of squares of the window
+	double                         m_windowPower;
+	/// the plan of the complex FFT of n / 2
+	alglib_impl::fasttransformplan m_plan;
+	/// the windowed samples, the packed spectrum after the transform
+	alglib_impl::ae_vector         m_data;
+	/// work buffer of the transform
+	alglib_impl::ae_vector         m_buffer;
+	/// state of Alglib
+	alglib_impl::ae_state          m_state;
+};
+
+/**
+ * Power spectra of the channels - Welch's average of the periodograms of the overlapping windows and spectrograms
+ * (short-time spectra) of a time range. A channel is read by blocks of at most \ref SPECTRUM_BLOCK_SAMPLES, the memory
+ * does not depend on the length of the range. The channels are computed in parallel, every thread with its plans.
+ *
+ * The power spectral density is one-sided (unit^2 / Hz), the bin i is i * fs / n Hz.
+ */
+class CSpectrum
+{
+// methods
+public:
+	/**
+	 * A constructor.
+	 * @param model the open file, read by more threads at once
+	 * @param settings settings of the windows
+	 */
+	CSpectrum(CInputEDF * model, const SPECTRUM_SETTINGS& settings = SPECTRUM_SETTINGS());
+
+	/**
+	 * A virtual desctructor.
+	 */
+	virtual ~CSpectrum();
+
+	/**
+	 * Returns length of the window of the channel (sample), the FFT length.
+	 */
+	int GetLength(const int& channel) const;
+
+	/**
+	 * Returns frequency of the bin of the channel (Hz).
+	 */
+	double GetFrequency(const int& channel, const int& bin) const;
+
+	/**
+	 * Welch's power spectral density of the time range of the channel.
+	 * @param channel number of the channel
+	 * @param t0 start of the range (second)
+	 * @param t1 end of the range (second)
+	 * @param psd output - \ref GetLength / 2 + 1 bins
+	 */
+	void Welch(const int& channel, const double& t0, const double& t1, std::vector<double>& psd);
+
+	/**
+	 * Spectrogram of the time range of the channel - the range is divided to columns, every column is the average of
+	 * its windows (at most \ref SPECTRUM_COLUMN_WINDOWS spread over the column).
+	 * @param channel number of the channel
+	 * @param t0 start of the range (second)
+	 * @param t1 end of the range (second)
+	 * @param countColumns count of the columns
+	 * @param columns output - power spectral density of the columns, \ref GetLength / 2 + 1 bins each
+	 */
+	void Spectrogram(const int& channel, const double& t0, const double& t1, const int& countColumns, std::vector<std::vector<double> >& columns);
+
+	/**
+	 * Welch's power spectral density of more channels in parallel.
+	 * @param channels numbers of the channels
+	 * @param t0 start of the range (second)
+	 * @param t1 end of the range (second)
+	 * @param psd output - the density of every channel
+	 * @param workers count of threads, 0 - count of cores
+	 */
+	void WelchChannels(const std::vector<int>& channels, const double& t0, const double& t1, std::vector<std::vector<double> >& psd,
+					   const int& workers = 0);
+
+	/**
+	 * Spectrograms of more channels in parallel.
+	 * @param channels numbers of the channels
+	 * @param t0 start of the range (second)
+	 * @param t1 end of the range (second)
+	 * @param countColumns count of the columns
+	 * @param columns output - the spectrogram of every channel
+	 * @param workers count of threads, 0 - count of cores
+	 */
+	void SpectrogramChannels(const std::vector<int>& channels, const double& t0, const double& t1, const int& countColumns,
+							 std::vector<std::vector<std::vector<double> > >& columns, const int& workers = 0);
+
+private:
+	/**
+	 * Samples of the range of the channel, clipped to the channel.
+	 */
+	void getRange(const int& channel, const double& t0, const double& t1, SAMPLEINDEX& start, SAMPLEINDEX& stop) const;
+
+	/**
+	 * Add the power of the windows [start + k * hop, start + k * hop + n) for k < count, read by blocks.
+	 */
+	void addWindows(const int& channel, const SAMPLEINDEX& start, const SAMPLEINDEX& hop, const SAMPLEINDEX& count, std::vector<double>& power);
+
+	/**
+	 * The accumulated power to one-sided density.
+	 */
+	void normalize(const int& channel, const SAMPLEINDEX& countWindows, std::vector<double>& power) const;
+
+// variables
+private:
+	/// the open file
+	CInputEDF *         m_model;
+	/// settings of the windows
+	SPECTRUM_SETTINGS   m_settings;
+};
+
+#endif
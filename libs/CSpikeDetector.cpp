@@ -1,5 +1,13 @@
 #include "CSpikeDetector.h"
 #include "Definitions.h"
+#include "CProfiler.h"
+#include "CPipeline.h"
+#include "CDetectorArena.h"
+
+#include <numeric>
+#include <algorithm>
+#include <climits>
+#include <iterator>
 
 using namespace std;
 
@@ -9,161 +17,304 @@ CSpikeDetector::CSpikeDetector(CInputEDF * model, DETECTOR_SETTINGS * settings)
 	m_settings = settings;
 }
 
-void CSpikeDetector::AnalyseChannel(const int channelNumber, CDetectorOutput ** output, CDischarges ** discharges, const wchar_t * fileName)
+void CSpikeDetector::AnalyseChannel(const int channelNumber, unique_ptr<CDetectorOutput>& output, unique_ptr<CDischarges>& discharges,
+									const wchar_t * fileName)
 {
+	PROFILE_SCOPE("CSpikeDetector::AnalyseChannel");
+
 	if (fileName != NULL)
 	{
 		m_model->CloseFile();
 		m_model->OpenFile(fileName);
 	}
 	
-	int 				 countSamples  = m_model->GetCountSamples();
-	int 				 fs = m_model->GetFS(channelNumber);
-	int    	  			 winsize  = m_settings->m_winsize * fs;
-	BANDWIDTH 			 bandwidth(m_settings->m_band_low, m_settings->m_band_high);
-	vector<int> 		 indexStart, indexStop;
-	int 				 i, j, k, indexSize;
-	int 				 start, stop, tmp;
-	vector<SIGNALTYPE> * segment = NULL;
-	int 				 countChannels = 1;
-	CDetectorOutput*     subOut 		= NULL;
-	CDischarges*         subDischarges = NULL;
-	int 				 posSize, disSize, tmpFirst, tmpLast;
-	double 				 minMP, tmpShift;
+	vector<SAMPLEINDEX>  	   indexStart, indexStop;
+	int 				 	   i, indexSize;
+	int 				 	   countChannels = 1;
+	unique_ptr<CDetectorOutput> subOut;
+	unique_ptr<CDischarges>     subDischarges;
+
+	output.reset(new CDetectorOutput());
+	discharges.reset(new CDischarges(countChannels));
+
+	GetSegments(channelNumber, indexStart, indexStop);
+
+	// starting analysis on the segmented data
+    indexSize = indexStop.size();
+    for (i = 0; i < indexSize; i ++)
+    {	
+		if (!AnalyseSegment(channelNumber, indexStart, indexStop, i, subOut, subDischarges))
+		{
+			// error - end of file?
+            break;
+		}
 
-	vector<int>          removeOut;
-	vector<int>          removeDish;
+		if (m_segmentDone)
+			m_segmentDone(channelNumber, *subOut);
+
+		AppendSegment(*output, *discharges, std::move(*subOut), std::move(*subDischarges));
+    }
+}
 
+/// Set the function called with the detections of every segment.
+void CSpikeDetector::SetSegmentDone(const function<void(const int&, const CDetectorOutput&)>& segmentDone)
+{
+	m_segmentDone = segmentDone;
+}
 
-	m_out = new CDetectorOutput();
-	m_discharges = new CDischarges(countChannels);
+/// Analyse the time range of one channel.
+void CSpikeDetector::AnalyseRange(const int channelNumber, const double& t0, const double& t1, unique_ptr<CDetectorOutput>& output,
+								  unique_ptr<CDischarges>& discharges)
+{
+	PROFILE_SCOPE("CSpikeDetector::AnalyseRange");
+
+	vector<SAMPLEINDEX>  	   indexStart, indexStop;
+	int 				 	   i, indexSize;
+	unique_ptr<CDetectorOutput> subOut;
+	unique_ptr<CDischarges>     subDischarges;
+
+	output.reset(new CDetectorOutput());
+	discharges.reset(new CDischarges(1));
+
+	GetRangeSegments(channelNumber, t0, t1, indexStart, indexStop);
+
+	indexSize = indexStop.size();
+	for (i = 0; i < indexSize; i++)
+	{
+		if (!AnalyseSegment(channelNumber, indexStart, indexStop, i, subOut, subDischarges))
+			break;
+
+		AppendSegment(*output, *discharges, std::move(*subOut), std::move(*subDischarges));
+	}
 
-	tmp = countSamples / fs;
-	if (m_settings->m_buffering > tmp)
-		m_settings->m_buffering = tmp;
+	// detections in the margins
+	const CDetectorOutput& out = *output;
+	output->RemoveIf([&out, &t0, &t1](const int& i) {
+		return out.m_pos[i] < t0 || out.m_pos[i] > t1;
+	});
+
+	const CDischarges& dis = *discharges;
+	discharges->RemoveIf([&dis, &t0, &t1](const int& i) {
+		return dis.m_MP[0][i] < t0 || dis.m_MP[0][i] > t1;
+	});
+}
+
+/// Compute the segments of the channel.
+int CSpikeDetector::GetSegments(const int channelNumber, vector<SAMPLEINDEX>& indexStart, vector<SAMPLEINDEX>& indexStop)
+{
+	SAMPLEINDEX 		 countSamples  = m_model->GetCountSamples();
+	int 				 fs = m_model->GetFS(channelNumber);
+	int    	  			 winsize  = m_settings->m_winsize * fs;
+	SAMPLEINDEX 		 buffering = m_settings->m_buffering;
+
+	indexStart.clear();
+	indexStop.clear();
+
+	// the buffering is limited to the length of the signal, the settings are not changed
+	if (buffering > countSamples / fs)
+		buffering = countSamples / fs;
+	if (buffering < 1)
+		buffering = 1;
 
 	// Signal buffering
-	int N_seg = floor(countSamples/(m_settings->m_buffering * fs));
+	int N_seg = floor(countSamples/(buffering * fs));
     if (N_seg < 1) N_seg = 1;
     int T_seg = round((double)countSamples/(double)N_seg/fs);
         // Indexs of segments with two-side overlap
 	getIndexStartStop(indexStart, indexStop, countSamples, T_seg, fs, winsize);
 
-	// starting analysis on the segmented data
-    indexSize = indexStop.size();
-    for (i = 0; i < indexSize; i ++)
-    {	
-    	start = indexStart.at(i);
-    	stop = indexStop.at(i);
+	return fs;
+}
+
+/// Estimated peak memory of the detection of one segment.
+long long CSpikeDetector::EstimateSegmentMemory(const SAMPLEINDEX& countSamples, const int& fs, const DETECTOR_SETTINGS& settings)
+{
+	SAMPLEINDEX decimated = countSamples;
+	long long   input, detection;
+
+	if (fs > settings.m_decimation)
+		decimated = (SAMPLEINDEX)ceil(countSamples * (double)settings.m_decimation / fs);
+
+	// the buffers of the input are released before the filtering
+	input = countSamples * DETECTOR_BYTES_PER_INPUT_SAMPLE;
+	detection = decimated * DETECTOR_BYTES_PER_SAMPLE;
+
+	return input > detection ? input : detection;
+}
+
+/// Returns the longest buffering whose segments fit to the memory.
+int CSpikeDetector::GetBufferingForMemory(const long long& memory, const int& fs, const DETECTOR_SETTINGS& settings)
+{
+	int         minimum = DETECTOR_MIN_BUFFERING_WINDOWS * settings.m_winsize;
+	int         buffering = settings.m_buffering;
+	SAMPLEINDEX overlap = 2 * 3 * (SAMPLEINDEX)settings.m_winsize * fs;
+
+	if (fs <= 0 || memory <= 0)
+		return buffering;
+
+	// bisection - the estimate grows with the length of the segment
+	if (minimum > buffering)
+		minimum = buffering;
+	if (EstimateSegmentMemory((SAMPLEINDEX)buffering * fs + overlap, fs, settings) <= memory)
+		return buffering;
+
+	while (buffering - minimum > 1)
+	{
+		int middle = minimum + (buffering - minimum) / 2;
+
+		if (EstimateSegmentMemory((SAMPLEINDEX)middle * fs + overlap, fs, settings) <= memory)
+			minimum = middle;
+		else buffering = middle;
+	}
+
+	return minimum;
+}
 
-    	segment = m_model->GetSegmentFromChannel(channelNumber, start, stop);
-		if (segment == NULL)
+/// Compute the segments covering the time range of the channel.
+int CSpikeDetector::GetRangeSegments(const int channelNumber, const double& t0, const double& t1, vector<SAMPLEINDEX>& indexStart,
+									 vector<SAMPLEINDEX>& indexStop)
+{
+	SAMPLEINDEX 		 countSamples  = m_model->GetCountSamples();
+	int 				 fs = m_model->GetFS(channelNumber);
+	int    	  			 winsize  = m_settings->m_winsize * fs;
+	SAMPLEINDEX 		 start, stop, count;
+	SAMPLEINDEX 		 buffering;
+	size_t 				 i;
+
+	indexStart.clear();
+	indexStop.clear();
+
+	if (fs <= 0 || t1 <= t0)
+		return fs;
+
+	// the range with the margins, limited to the signal
+	start = (SAMPLEINDEX)floor(t0 * fs) - 3*winsize;
+	stop = (SAMPLEINDEX)ceil(t1 * fs) + 3*winsize;
+	if (start < 0) start = 0;
+	if (stop > countSamples) stop = countSamples;
+	if (stop <= start)
+		return fs;
+
+	// the same buffering as the whole channel, the settings are not changed
+	count = stop - start;
+	buffering = m_settings->m_buffering;
+	if (buffering > count / fs)
+		buffering = count / fs;
+	if (buffering < 1)
+		buffering = 1;
+
+	int N_seg = floor(count/(buffering * fs));
+	if (N_seg < 1) N_seg = 1;
+	int T_seg = round((double)count/(double)N_seg/fs);
+	if (T_seg < 1) T_seg = 1;
+
+	getIndexStartStop(indexStart, indexStop, count, T_seg, fs, winsize);
+	for (i = 0; i < indexStart.size(); i++)
+	{
+		indexStart[i] += start;
+		indexStop[i] += start;
+	}
+
+	return fs;
+}
+
+/// Analyse one segment of the channel.
+bool CSpikeDetector::AnalyseSegment(const int channelNumber, const vector<SAMPLEINDEX>& indexStart, const vector<SAMPLEINDEX>& indexStop, const int& segmentNumber,
+									unique_ptr<CDetectorOutput>& subOut, unique_ptr<CDischarges>& subDischarges)
+{
+	PROFILE_SCOPE("CSpikeDetector::AnalyseSegment");
+
+	int 				 fs = m_model->GetFS(channelNumber);
+	SAMPLEINDEX 		 start, stop;
+	vector<SIGNALTYPE> * segment = NULL;
+
+	start = indexStart.at(segmentNumber);
+	stop = indexStop.at(segmentNumber);
+
+	segment = m_model->GetSegmentFromChannel(channelNumber, start, stop);
+	if (segment == NULL)
+		return false;
+	
+	spikeDetector(segment, fs, subOut, subDischarges);
+
+	delete segment;
+	segment = NULL;
+
+	TrimSegment(segmentNumber, indexStop.size(), start, stop, fs, *subOut, *subDischarges);
+
+	return true;
+}
+
+/// Remove the detections in the overlaps and shift the positions to the time in the file.
+void CSpikeDetector::TrimSegment(const int& segmentNumber, const int& countSegments, const SAMPLEINDEX& start, const SAMPLEINDEX& stop, const int& fs,
+								 CDetectorOutput& subOut, CDischarges& subDischarges)
+{
+	int 				 j, k;
+	int 				 countChannels = 1;
+	int 				 posSize, tmpFirst, tmpLast;
+	double 				 low, high, tmpShift;
+
+	// removing of two side overlap detections
+	posSize = subOut.m_pos.size();
+
+	if (segmentNumber > 0)
+		tmpFirst = 1;
+	else tmpFirst = 0;
+
+	if (segmentNumber < countSegments-1)
+		tmpLast = 1;
+	else tmpLast = 0;
+
+	if (posSize > 0)
+	{
+		if (countSegments > 1)
 		{
-			// error - end of file?
-            break;
+			low = tmpFirst*3*m_settings->m_winsize;
+			high = ((stop - start) - tmpLast*3*m_settings->m_winsize*fs)/fs;
+
+			const CDetectorOutput& out = subOut;
+			subOut.RemoveIf([&out, &low, &high](const int& i) {
+				return out.m_pos[i] < low || out.m_pos[i] > high;
+			});
+
+			const CDischarges& dis = subDischarges;
+			subDischarges.RemoveIf([&dis, &low, &high](const int& i) {
+				double onset = dis.GetOnset(i);
+				return onset < low || onset > high;
+			});
 		}
-		
-		spikeDetector(segment, fs, bandwidth, subOut, subDischarges);
-
-		delete segment;
-		segment = NULL;
-
-    	// removing of two side overlap detections
-    	posSize = subOut->m_pos.size();
-    	disSize = subDischarges->m_MP[0].size();
-
-    	if (i > 0)
-    		tmpFirst = 1;
-    	else tmpFirst = 0;
-
-    	if (i < (int)indexStop.size()-1)
-    		tmpLast = 1;
-    	else tmpLast = 0;
-
-    	if (posSize > 0)
-    	{
-    		if (indexStop.size() > 1)
-    		{
-    			for (j = 0; j < posSize; j++)
-    			{
-    				if (subOut->m_pos.at(j) < tmpFirst*3*m_settings->m_winsize ||
-    					subOut->m_pos.at(j) > ((stop - start) - tmpLast*3*m_settings->m_winsize*fs)/fs )
-    						removeOut.push_back(j);
-    			}
-    			subOut->Remove(removeOut);
-
-    			for (j = 0; j < disSize; j++)
-    			{
-					minMP = INT_MAX;
-					for (k = 0; k < countChannels; k++)
-						if (subDischarges->m_MP[k].at(j) < minMP)
-								minMP = subDischarges->m_MP[k].at(j);
-
-					if (minMP < tmpFirst*3*m_settings->m_winsize ||
-						minMP > ((stop-start) - tmpLast*3*m_settings->m_winsize*fs)/fs )
-								removeDish.push_back(j);
-    			}
-    			subDischarges->Remove(removeDish);
-    		}
-    	}
-        
-    	posSize = subOut->m_pos.size();
-    	disSize = subDischarges->m_MP[0].size();
-    	tmpShift = (indexStart.at(i)+1)/(double)fs - 1/(double)fs;
-
-
-    	// connect out
-    	for (j = 0; j < posSize; j++)
-    	{
-    		m_out->Add(
-    				subOut->m_pos.at(j) + tmpShift,
-    				subOut->m_dur.at(j),
-    				subOut->m_chan.at(j),
-    				subOut->m_con.at(j),
-    				subOut->m_weight.at(j),
-    				subOut->m_pdf.at(j)
-    			);
-    	}
-
-    	// connect discharges
-    	for (j = 0; j < countChannels; j++)
-    	{
-    		for (k = 0; k < (int)subDischarges->m_MP[j].size(); k++)
-    		{
-    			subDischarges->m_MP[j].at(k) += tmpShift;
-    		}
-    	}
-
-    	for (j = 0; j < countChannels; j++)
-    	{
-			m_discharges->m_MV[j].insert(m_discharges->m_MV[j].end(), subDischarges->m_MV[j].begin(), subDischarges->m_MV[j].end());
-			m_discharges->m_MA[j].insert(m_discharges->m_MA[j].end(), subDischarges->m_MA[j].begin(), subDischarges->m_MA[j].end());
-			m_discharges->m_MP[j].insert(m_discharges->m_MP[j].end(), subDischarges->m_MP[j].begin(), subDischarges->m_MP[j].end());
-			m_discharges->m_MD[j].insert(m_discharges->m_MD[j].end(), subDischarges->m_MD[j].begin(), subDischarges->m_MD[j].end());
-			m_discharges->m_MW[j].insert(m_discharges->m_MW[j].end(), subDischarges->m_MW[j].begin(), subDischarges->m_MW[j].end());
-			m_discharges->m_MPDF[j].insert(m_discharges->m_MPDF[j].end(), subDischarges->m_MPDF[j].begin(), subDischarges->m_MPDF[j].end());
-    	}
-		
-    	// clear
-    	if (subOut)
-    		delete subOut;
-    	if (subDischarges)
-    		delete subDischarges;
-    	removeOut.clear();
-    	removeDish.clear();
-    }
+	}
+
+	// shift to the position in the file
+	posSize = subOut.m_pos.size();
+	tmpShift = (start+1)/(double)fs - 1/(double)fs;
 
-    // RETURN
-    *output = m_out;
-    *discharges = m_discharges;
+	for (j = 0; j < posSize; j++)
+		subOut.m_pos.at(j) += tmpShift;
+
+	for (j = 0; j < countChannels; j++)
+	{
+		for (k = 0; k < (int)subDischarges.m_MP[j].size(); k++)
+		{
+			subDischarges.m_MP[j].at(k) += tmpShift;
+		}
+	}
+}
+
+/// Append results of one segment.
+void CSpikeDetector::AppendSegment(CDetectorOutput& out, CDischarges& discharges, CDetectorOutput&& subOut, CDischarges&& subDischarges)
+{
+	out.Append(std::move(subOut));
+	discharges.Append(std::move(subDischarges));
 }
 
 /// Calculate the starts and ends of indexes for @see #spikeDetector
-void CSpikeDetector::getIndexStartStop(vector<int>& indexStart, vector<int>& indexStop, const int& cntElemInCh, const double& T_seg,
+void CSpikeDetector::getIndexStartStop(vector<SAMPLEINDEX>& indexStart, vector<SAMPLEINDEX>& indexStop, const SAMPLEINDEX& cntElemInCh, const double& T_seg,
 									   const int& fs, const int& winsize)
 {
-	int start = 0;
-	int i, startSize, end;
+	SAMPLEINDEX start = 0;
+	SAMPLEINDEX end;
+	int         i, startSize;
 
 	while (start < cntElemInCh)
 	{
@@ -186,10 +337,11 @@ void CSpikeDetector::getIndexStartStop(vector<int>& indexStart, vector<int>& ind
 		indexStop.front() -= 3*winsize;
 		indexStop.back() = cntElemInCh;
 
+		// a short last segment is merged to the previous one
 		if (indexStop.back() - indexStart.back() < T_seg * fs)
 		{
 			indexStart.pop_back();
-			indexStart.pop_back();
+			indexStop.pop_back();
 			indexStop.back() = cntElemInCh;
 		}
 	} 
@@ -199,42 +351,91 @@ void CSpikeDetector::getIndexStartStop(vector<int>& indexStart, vector<int>& ind
 	}
 }
 
-void CSpikeDetector::spikeDetector(vector<SIGNALTYPE>*& data, const int& inputFS, const BANDWIDTH& bandwidth, 
-									CDetectorOutput*& out, CDischarges*& discharges)
+void CSpikeDetector::spikeDetector(vector<SIGNALTYPE>*& data, const int& inputFS, unique_ptr<CDetectorOutput>& out, unique_ptr<CDischarges>& discharges)
+{
+	PIPELINE_SEGMENT& segment = CDetectorArena::GetThreadArena().m_segment;
+
+	// resampling, filtering Nx50Hz, filtering 10-60Hz and the envelope
+	CPipeline::Process(data, inputFS, *m_settings, PIPELINE_BANDPASS | PIPELINE_ENVELOPE, segment);
+
+	DetectSegment(segment, out, discharges);
+}
+
+/// Detect spikes in one segment processed by the pipeline.
+void CSpikeDetector::DetectSegment(const PIPELINE_SEGMENT& segment, unique_ptr<CDetectorOutput>& out, unique_ptr<CDischarges>& discharges)
+{
+	CDetectorArena&       arena = CDetectorArena::GetThreadArena();
+	int                   fs = segment.m_fs;
+	int    		  		  countRecords = segment.m_bandpass.size();
+	int    	  			  winsize  = m_settings->m_winsize * fs;
+	double 	  			  noverlap = m_settings->m_noverlap * fs;
+	ONECHANNELDETECTRET*  ret = NULL;
+
+	arena.BeginSegment();
+
+	// Segmentation index
+	GetWindowIndex(countRecords, winsize, noverlap, arena.m_index);
+
+	// local maxima detection
+	COneChannelDetect detector(&segment.m_bandpass, m_settings, fs, &arena.m_index, 0);
+	if (detector.Run(arena.m_result, segment.m_envelope.empty() ? NULL : &segment.m_envelope))
+		ret = &arena.m_result;
+
+	// processing detection results
+	AssembleDetections(&ret, 1, countRecords, fs, out, discharges);
+
+	arena.EndSegment();
+}
+
+/// Compute starts of the windows of the statistics.
+void CSpikeDetector::GetWindowIndex(const int& countRecords, const int& winsize, const double& noverlap, vector<int>& index)
+{
+	int stop, step, i;
+
+	index.clear();
+
+	stop = countRecords - winsize + 1;
+
+    if (noverlap < 1)
+        step = round(winsize * (1 - noverlap));
+    else 
+        step = winsize - noverlap;
+
+    for (i = 0; i < stop; i += step)
+        index.push_back(i);
+}
+
+/// Make spikes and discharges from the markers of the channels.
+void CSpikeDetector::AssembleDetections(ONECHANNELDETECTRET** ret, const int& countChannels, const int& countRecords, const int& fs,
+										unique_ptr<CDetectorOutput>& out, unique_ptr<CDischarges>& discharges)
 {
+	PROFILE_SCOPE("CSpikeDetector::AssembleDetections");
 
+	CDetectorArena&       arena = CDetectorArena::GetThreadArena();
 	double 				  k1 = m_settings->m_k1;
 	double 				  k2 = m_settings->m_k2;
 	double 				  discharge_tol = m_settings->m_discharge_tol;
-	int 				  decimation = m_settings->m_decimation;
-	int                   fs = inputFS;
-
-	int    		  		  countRecords = data[0].size();
-	vector<int> 		  index;
-	int 		  		  stop, step;
 	int	  	        	  i, j;
 	float 				  k;
 	int 				  tmp_start;
-	COneChannelDetect**   threads;
-	ONECHANNELDETECTRET** ret;
-	
-	int    	  			  winsize  = m_settings->m_winsize * fs;
-    double 	  			  noverlap = m_settings->m_noverlap * fs;
 
 	// OUT
     double 				  t_dur = 0.005;
-    vector<bool> 		  ovious_M(data[0].size(), false);
+    vector<bool>& 		  ovious_M = arena.m_assemblyObvious;
     double 				  position;
     bool 				  tmp_sum = false;
 
-    vector<double>** 	  m;
+    vector<int>& 		  first = arena.m_assemblyFirst;
+    vector<int>& 		  last = arena.m_assemblyLast;
     int 				  tmp_round;
     float 				  tmp_start2, tmp_stop;
 
-    	// definition of multichannel events vectors
-    vector<int>* 		  point = new vector<int>[2];
-    int 				  tmp_old = 0;
-    int 				  tmp_act = 0;
+    	// definition of multichannel events - sweep over the painted intervals
+    vector<int>& 		  order = arena.m_assemblyOrder;
+    vector<int>& 		  event = arena.m_assemblyEvent;
+    vector<double>& 	  m = arena.m_assemblyM;
+    int 				  point[2];
+    int 				  countSpikes, countEvents, countWindow, eventStart, eventStop, p;
     int 				  channel;
 
     	// MV && MA && MW && MPDF && MD && MP
@@ -247,49 +448,8 @@ void CSpikeDetector::spikeDetector(vector<SIGNALTYPE>*& data, const int& inputFS
     double 				  tmp_mp;
     int    				  tmp_row;
 
-    int 				  countChannels = 1;
-
-	// If sample rate is > "decimation" the signal is decimated => 200Hz default.
-	if (fs > decimation)
-	{
-		CDSP::ResampleOneChannel(data, fs, decimation);
-		
-        fs = decimation; 
-        winsize  = m_settings->m_winsize * fs;
-        noverlap = m_settings->m_noverlap * fs;
-        countRecords = data[0].size();
-	}
-
-	// Segmentation index
-	stop = countRecords - winsize + 1;
-
-    if (noverlap < 1)
-        step = round(winsize * (1 - noverlap));
-    else 
-        step = winsize - noverlap;
-
-    for (i = 0; i < stop; i += step)
-        index.push_back(i);
+    ovious_M.assign(countRecords, false);
 
-    // FILTERING
-    // filtering Nx50Hz
-    CDSP::Filt50Hz(data, 1, fs, m_settings->m_main_hum_freq, bandwidth);
-
-	// filtering 10-60Hz
-	CDSP::Filtering(data, 1, fs, bandwidth);
-
-    // local maxima detection
-    ret = new ONECHANNELDETECTRET*[countChannels];
-    threads = new COneChannelDetect*[countChannels];
-    for (i = 0; i < countChannels; i++)
-    {
-    	threads[i] = new COneChannelDetect(&data[i], m_settings, fs, &index, i);
-    	ret[i] = threads[i]->Run();
-    	delete threads[i];	
-    }
-
-    delete [] threads;
-    // processing detection results
     for (i = 0; i < countChannels; i++)
     {
         if (ret[i] == NULL)
@@ -311,8 +471,23 @@ void CSpikeDetector::spikeDetector(vector<SIGNALTYPE>*& data, const int& inputFS
         }    
     }
 
-    // OUT
-    out = new CDetectorOutput();
+    // OUT - the markers are counted first, the output is allocated once
+    size_t countMarkers = 0;
+    for (channel = 0; channel < countChannels; channel++)
+    {
+        if (ret[channel] == NULL)
+            continue;
+
+        countMarkers += count(ret[channel]->m_markersHigh->begin(), ret[channel]->m_markersHigh->end(), true);
+        if (k1 != k2)
+            countMarkers += count(ret[channel]->m_markersLow->begin(), ret[channel]->m_markersLow->end(), true);
+    }
+
+    // the output of the previous segment is reused
+    if (out)
+        out->Clear();
+    else out.reset(new CDetectorOutput());
+    out->Reserve(countMarkers);
     for (channel = 0; channel < countChannels; channel++)
     {
         for (j = 0; j < countRecords; j++)
@@ -360,44 +535,70 @@ void CSpikeDetector::spikeDetector(vector<SIGNALTYPE>*& data, const int& inputFS
         }
     }
     
-    // making M stack pointer of events
-    m = new vector<double>*[countChannels];
-    for (i = 0; i < countChannels; i++)
-    	m[i] = new vector<double>(countRecords, 0.0);
-
-    for (i = 0; i < (int)out->m_pos.size(); i++)
+    // M stack of events - every spike paints the samples [first, last] of its channel with its con, a later spike
+    // overwrites an earlier one. Only the intervals are kept, M is painted for the samples of one event.
+    countSpikes = out->m_pos.size();
+    first.resize(countSpikes);
+    last.resize(countSpikes);
+    order.clear();
+    for (i = 0; i < countSpikes; i++)
     {
         tmp_start2 = out->m_pos.at(i) * fs;
         tmp_stop = out->m_pos.at(i) * fs + discharge_tol * fs;
+        first[i] = INT_MAX;
+        last[i] = INT_MIN;
         for (k = tmp_start2; k <= tmp_stop; k += 1)
-        {   
+        {
             tmp_round = round(k) - 1;
-            m[out->m_chan.at(i)-1]->at(tmp_round) = out->m_con.at(i);
+            first[i] = min(first[i], tmp_round);
+            last[i] = max(last[i], min(tmp_round, countRecords - 1));
         }
+
+        if (first[i] <= last[i])
+            order.push_back(i);
     }
-    
-    // definition of multichannel events vectors
-    delete [] point;
-    point = new vector<int>[2];
-    for (i = 0; i < countRecords; i++)
-    {
-        tmp_act = 0;
-        for (j = 0; j < countChannels; j++)
-            if (m[j]->at(i) > 0)
-                tmp_act = 1;
-        
-        if (tmp_old != tmp_act && tmp_act - tmp_old > 0) 
-            point[0].push_back(i);
-        else if (tmp_old != tmp_act && tmp_act - tmp_old < 0)
-            point[1].push_back(i-1);   
+    sort(order.begin(), order.end(), [&first](const int& a, const int& b) { return first[a] < first[b] || (first[a] == first[b] && a < b); });
+    PROFILE_MEMORY("CSpikeDetector::AssembleDetections", countSpikes * (long long)(3 * sizeof(int)) + countRecords / 8);
 
-        tmp_old = tmp_act;
+    // count of multichannel events - the union of the intervals of all channels, touching intervals make one event
+    countEvents = 0;
+    for (p = 0, eventStop = INT_MIN; p < (int)order.size(); p++)
+    {
+        if (p == 0 || first[order[p]] > eventStop + 1)
+            countEvents++;
+        eventStop = max(eventStop, last[order[p]]);
     }
-  
+
 	// MV && MA && MW && MPDF && MD && MP
-    discharges = new CDischarges(countChannels);
-    for (i = 0; i < (int)point[0].size(); i++)
+    if (discharges && discharges->GetCountChannels() == (unsigned)countChannels)
+        discharges->Clear();
+    else discharges.reset(new CDischarges(countChannels));
+    discharges->Reserve(countEvents);
+    for (p = 0; p < (int)order.size(); )
     {
+        // the spikes of the event
+        event.clear();
+        point[0] = first[order[p]];
+        point[1] = last[order[p]];
+        for (; p < (int)order.size() && first[order[p]] <= point[1] + 1; p++)
+        {
+            point[1] = max(point[1], last[order[p]]);
+            event.push_back(order[p]);
+        }
+
+        // M of the samples point[0] - 1 ... point[1] - 1 in the order of painting
+        sort(event.begin(), event.end());
+        countWindow = point[1] - point[0] + 1;
+        m.assign(countChannels * (size_t)countWindow, 0.0);
+        for (i = 0; i < (int)event.size(); i++)
+        {
+            eventStart = max(first[event[i]], point[0] - 1);
+            eventStop = min(last[event[i]], point[1] - 1);
+            channel = out->m_chan.at(event[i]) - 1;
+            for (j = eventStart; j <= eventStop; j++)
+                m[channel * (size_t)countWindow + j - point[0] + 1] = out->m_con.at(event[i]);
+        }
+
         for (channel = 0; channel < countChannels; channel++)
         {
             if (ret[channel] == NULL) continue;
@@ -409,15 +610,15 @@ void CSpikeDetector::spikeDetector(vector<SIGNALTYPE>*& data, const int& inputFS
             tmp_mp  	 = NAN;
             tmp_row 	 = 0;
 
-            for (j = point[0].at(i) - 1; j < point[1].at(i); j++)
+            for (j = point[0] - 1; j < point[1]; j++)
             {  
                 // MV
-                if (m[channel]->at(j) > tmp_mv)
+                if (m[channel * (size_t)countWindow + tmp_row] > tmp_mv)
                 {
-                    tmp_mv = m[channel]->at(j);
+                    tmp_mv = m[channel * (size_t)countWindow + tmp_row];
                     // MP    
                     if (std::isnan(tmp_mp))
-                        tmp_mp = ((double)tmp_row + point[0].at(i)+1) / (double)fs;
+                        tmp_mp = ((double)tmp_row + point[0]+1) / (double)fs;
                 } 
 
                 // MA
@@ -432,7 +633,7 @@ void CSpikeDetector::spikeDetector(vector<SIGNALTYPE>*& data, const int& inputFS
                     tmp_max_mw = tmp_seg;
 
                 // MPDF
-                tmp_seg = ret[channel]->m_envelopePdf.at(j) * m[channel]->at(j);
+                tmp_seg = ret[channel]->m_envelopePdf.at(j) * m[channel * (size_t)countWindow + tmp_row];
                 if (tmp_seg > tmp_max_mpdf)
                    tmp_max_mpdf = tmp_seg; 
             
@@ -446,22 +647,13 @@ void CSpikeDetector::spikeDetector(vector<SIGNALTYPE>*& data, const int& inputFS
             discharges->m_MP[channel].push_back(tmp_mp);
 
             // MD
-            tmp_md = (point[1].at(i) - point[0].at(i)) / (double)fs;
+            tmp_md = (point[1] - point[0]) / (double)fs;
             discharges->m_MD[channel].push_back(tmp_md);
         }
     }
 
-    for (i = 0; i < countChannels; i++)
-    {
-        if (ret[i] == NULL) continue;
-
-        delete ret[i];
-        delete m[i];
-    }
-
-    delete [] point;
-    delete [] m;
-    delete [] ret;
+    // the ambiguous spikes follow the obvious ones
+    out->Sort();
 }
 
 // ------------------------------------------------------------------------------------------------
@@ -483,24 +675,86 @@ COneChannelDetect::~COneChannelDetect()
 }
 
 /// This is the entry point of the thread.
-ONECHANNELDETECTRET * COneChannelDetect::Run()
+bool COneChannelDetect::Run(ONECHANNELDETECTRET& ret, const vector<SIGNALTYPE>* precomputed)
 {
-	
-	vector<SIGNALTYPE>    envelope(m_data->begin(), m_data->end());
+	PROFILE_SCOPE("COneChannelDetect::Run");
+
+	CDetectorArena&       arena = CDetectorArena::GetThreadArena();
+	vector<SIGNALTYPE>&   envelope = ret.m_envelope;
+
+ 	// Hilbert's envelope (intense envelope)
+	if (precomputed != NULL)
+		envelope.assign(precomputed->begin(), precomputed->end());
+	else Envelope(envelope);
+
+	// lognormal statistics in the windows
+	WindowStatistics(envelope, arena.m_phatMedian, arena.m_phatStd);
+
+	// threshold curves
+	if (!Thresholds(envelope, arena.m_phatMedian, arena.m_phatStd, ret.m_prahInt, ret.m_envelopeCdf, ret.m_envelopePdf))
+		return false;
+
+    // markers of the spikes
+    if (!Markers(ret))
+    	return false;
+
+    // the curves of the stages, written to the result
+    PROFILE_MEMORY("COneChannelDetect::Run", (long long)(envelope.size() * sizeof(SIGNALTYPE) + (ret.m_prahInt[0].size() + ret.m_prahInt[1].size()
+                   + ret.m_envelopeCdf.size() + ret.m_envelopePdf.size()) * sizeof(double)) + (m_data->size() * sizeof(SIGNALTYPE)) + m_data->size() / 4);
+    return true;
+}
+
+/// Local maxima of the envelope above the threshold curves and their union.
+bool COneChannelDetect::Markers(ONECHANNELDETECTRET& ret)
+{
+	CDetectorArena&       arena = CDetectorArena::GetThreadArena();
+	vector<SIGNALTYPE>&   envelope = ret.m_envelope;
+
+    ret.m_markersHigh = &arena.m_markersHigh;
+    ret.m_markersLow = &arena.m_markersHigh;
+    try {
+        localMaximaDetection(envelope, ret.m_prahInt[0], m_settings->m_polyspike_union_time, arena.m_markersHigh);
+        detectionUnion(&arena.m_markersHigh, envelope, m_settings->m_polyspike_union_time * m_fs);
+
+        if (m_settings->m_k2 != m_settings->m_k1 && ret.m_prahInt[1].size() != 0)
+        {
+            localMaximaDetection(envelope, ret.m_prahInt[1], m_settings->m_polyspike_union_time, arena.m_markersLow);
+            detectionUnion(&arena.m_markersLow, envelope, m_settings->m_polyspike_union_time * m_fs);
+            ret.m_markersLow = &arena.m_markersLow;
+        }
+    } 
+    catch (const char * e)
+    {
+    	return false;
+    }
+
+    return true;
+}
+
+/// Hilbert's envelope of the input data.
+void COneChannelDetect::Envelope(vector<SIGNALTYPE>& envelope)
+{
+	PROFILE_SCOPE("COneChannelDetect::Envelope");
+
+	envelope.assign(m_data->begin(), m_data->end());
+	CDSP::AbsHilbert(envelope);
+}
+
+/// Mean and standard deviation of the logarithm of the envelope in the windows, smoothed.
+void COneChannelDetect::WindowStatistics(const vector<SIGNALTYPE>& envelope, vector<SIGNALTYPE>& phatMedian, vector<SIGNALTYPE>& phatStd)
+{
+    PROFILE_SCOPE("COneChannelDetect::WindowStatistics");
+
     int 				  start, stop, tmp, i, j;
     int 				  indexSize = m_index->size();
-    int     			  envelopeSize = envelope.size();
     double 				  std, l, m;
 
-    vector<double>        logs;
-    alglib::real_1d_array r1a_logs;
- 
- 	vector<SIGNALTYPE>    phatMedian, phatStd;
+    CDetectorArena&       arena = CDetectorArena::GetThreadArena();
+    vector<double>&       logs = arena.m_logs;
 
- 	ONECHANNELDETECTRET*  ret = NULL;
-
- 	// Hilbert's envelope (intense envelope)
-	CDSP::AbsHilbert(envelope);
+    logs.clear();
+    phatMedian.clear();
+    phatStd.clear();
 
     for (i = 0; i < indexSize; i++)
     {
@@ -527,9 +781,13 @@ ONECHANNELDETECTRET * COneChannelDetect::Run()
 	double r = (double)envelope.size() / (double)indexSize;
     double n_average = m_settings->m_winsize;
 
-    vector<double> b, a;
+    vector<double>& b = arena.m_smoothingB;
+    vector<double>& a = arena.m_smoothingA;
     tmp = round(n_average*m_fs/r);
 
+    b.clear();
+    a.clear();
+
     if (tmp > 1)
     {
         a.push_back(1);
@@ -539,15 +797,68 @@ ONECHANNELDETECTRET * COneChannelDetect::Run()
             b.push_back(l);
         }
 
-    	CDSP::FiltFilt(b, a, &phatMedian);
-        CDSP::FiltFilt(b, a, &phatStd);
+    	CDSP::FiltFilt(b, a, &phatMedian, &arena.m_smoothing);
+        CDSP::FiltFilt(b, a, &phatStd, &arena.m_smoothing);
     }
+}
+
+/// Interpolation of the statistics to the threshold curves, CDF and PDF of the envelope.
+bool COneChannelDetect::Thresholds(const vector<SIGNALTYPE>& envelope, const vector<SIGNALTYPE>& phatMedian, const vector<SIGNALTYPE>& phatStd,
+								   vector<double> prah_int[2], vector<double>& envelope_cdf, vector<double>& envelope_pdf)
+{
+    PROFILE_SCOPE("COneChannelDetect::Thresholds");
+    PROFILE_COUNT("COneChannelDetect::Thresholds", envelope.size(), envelope.size() * sizeof(SIGNALTYPE));
+
+    vector<double>*       lognormal = CDetectorArena::GetThreadArena().m_phatInt;
+
+    if (!LognormalCurves(envelope, phatMedian, phatStd, lognormal, envelope_cdf, envelope_pdf))
+    	return false;
+
+    ThresholdCurves(lognormal, *m_settings, prah_int);
+    return true;
+}
+
+/// The threshold curves of the k-values of the settings.
+void COneChannelDetect::ThresholdCurves(const vector<double> lognormal[2], const DETECTOR_SETTINGS& settings, vector<double> prah_int[2])
+{
+    int 				  i;
+    int 				  size = lognormal[0].size();
+    bool 				  low = settings.m_k2 != settings.m_k1;
+
+    prah_int[0].resize(size);
+    prah_int[1].resize(low ? size : 0);
+
+    for (i = 0; i < size; i++)
+    {
+        prah_int[0][i] = (settings.m_k1 * lognormal[0][i]) - (settings.m_k3 * lognormal[1][i]);
+        if (low)
+            prah_int[1][i] = (settings.m_k2 * lognormal[0][i]) - (settings.m_k3 * lognormal[1][i]);
+    }
+}
+
+/// Interpolation of the statistics to the lognormal curves, CDF and PDF of the envelope.
+bool COneChannelDetect::LognormalCurves(const vector<SIGNALTYPE>& envelope, const vector<SIGNALTYPE>& phatMedian, const vector<SIGNALTYPE>& phatStd,
+										vector<double> lognormal[2], vector<double>& envelope_cdf, vector<double>& envelope_pdf)
+{
+    int 				  start, stop, i;
+    int 				  indexSize = m_index->size();
+    int     			  envelopeSize = envelope.size();
 
- 	// interpolation of thresholds value to threshold curve (like backround)
-    vector<double> phat_int[2]; 
-    vector<double> x, y;
+ 	// interpolation of thresholds value to threshold curve (like backround), the curves of the statistics are
+ 	// replaced by the lognormal curves
+    CDetectorArena&       arena = CDetectorArena::GetThreadArena();
+    vector<double>*       phat_int = lognormal;
+    vector<double>&       x = arena.m_thresholdsX;
+    vector<double>&       y = arena.m_thresholdsY;
     alglib::real_1d_array xreal, yrealMedian, yrealStd, x2real, retMedian, retStd;
 
+    phat_int[0].clear();
+    phat_int[1].clear();
+    x.clear();
+    y.clear();
+    envelope_cdf.clear();
+    envelope_pdf.clear();
+
     if (phatMedian.size() > 1)
     {
         for (i = 0; i < indexSize; i++)
@@ -562,8 +873,11 @@ ONECHANNELDETECTRET * COneChannelDetect::Run()
         try
         {
             // interpolation Median and Std
-            vector<double> phatMedVecDoub(phatMedian.begin(), phatMedian.end());
-            vector<double> phatStdVecDoub(phatStd.begin(), phatStd.end());
+            vector<double>& phatMedVecDoub = arena.m_phatMedianDouble;
+            vector<double>& phatStdVecDoub = arena.m_phatStdDouble;
+
+            phatMedVecDoub.assign(phatMedian.begin(), phatMedian.end());
+            phatStdVecDoub.assign(phatStd.begin(), phatStd.end());
             
             xreal.setcontent(x.size(), &x[0]);
             yrealMedian.setcontent(phatMedVecDoub.size(), &phatMedVecDoub[0]);
@@ -576,32 +890,50 @@ ONECHANNELDETECTRET * COneChannelDetect::Run()
         catch(alglib::ap_error e)
         {
             //cout << "Aglib msg: " << e.msg.c_str() << endl;
-            return NULL;
+            return false;
         }
           
-        for (i = 0; i < retMedian.length(); i++)
+        if (CDSP::IsFast(DSP_FAST_SPLINE))
         {
-            phat_int[0].push_back(retMedian[i]);
-            phat_int[1].push_back(retStd[i]);   
+            // DOPLNENI - the padding is written first, the same values without moving the vector
+            int pad = floor(m_settings->m_winsize * m_fs / 2);
+            int count = max(envelopeSize, (int)(pad + retMedian.length()));
+
+            phat_int[0].reserve(count);
+            phat_int[1].reserve(count);
+            phat_int[0].assign(pad, retMedian[0]);
+            phat_int[1].assign(pad, retStd[0]);
+            phat_int[0].insert(phat_int[0].end(), retMedian.getcontent(), retMedian.getcontent() + retMedian.length());
+            phat_int[1].insert(phat_int[1].end(), retStd.getcontent(), retStd.getcontent() + retStd.length());
+            phat_int[0].resize(count, phat_int[0].back());
+            phat_int[1].resize(count, phat_int[1].back());
         }
-
-        // DOPLNENI
-        double temp_elem0 = phat_int[0].front();
-        double temp_elem1 = phat_int[1].front();
-        
-        for (i = 0; i < floor(m_settings->m_winsize * m_fs / 2); i++)
+        else
         {
-            phat_int[0].insert(phat_int[0].begin(), temp_elem0);
-            phat_int[1].insert(phat_int[1].begin(), temp_elem1);
-        }
+            for (i = 0; i < retMedian.length(); i++)
+            {
+                phat_int[0].push_back(retMedian[i]);
+                phat_int[1].push_back(retStd[i]);   
+            }
 
-        temp_elem0 = phat_int[0].back();
-        temp_elem1 = phat_int[1].back();
-        for (i = phat_int[0].size(); i < envelopeSize; i++)
-        {
-            phat_int[0].push_back(temp_elem0);
-            phat_int[1].push_back(temp_elem1);
-        }  
+            // DOPLNENI
+            double temp_elem0 = phat_int[0].front();
+            double temp_elem1 = phat_int[1].front();
+            
+            for (i = 0; i < floor(m_settings->m_winsize * m_fs / 2); i++)
+            {
+                phat_int[0].insert(phat_int[0].begin(), temp_elem0);
+                phat_int[1].insert(phat_int[1].begin(), temp_elem1);
+            }
+
+            temp_elem0 = phat_int[0].back();
+            temp_elem1 = phat_int[1].back();
+            for (i = phat_int[0].size(); i < envelopeSize; i++)
+            {
+                phat_int[0].push_back(temp_elem0);
+                phat_int[1].push_back(temp_elem1);
+            }  
+        }
     }
     else
     {
@@ -613,12 +945,10 @@ ONECHANNELDETECTRET * COneChannelDetect::Run()
     }
 
     // LOGNORMAL distr.
-    double tmp_diff, tmp_exp, tmp_square, lognormal_mode, lognormal_median, tmp_prah_int, lognormal_mean, tmp_sum;
-    vector<double> prah_int[2];
+    double tmp_diff, tmp_exp, tmp_square, lognormal_mode, lognormal_median, lognormal_mean, tmp_sum;
 
     double tmp_sqrt_one, tmp_to_erf, tmp_log, tmp_erf, tmp_pdf, tmp_x, tmp_x2;
     double tmp_sqrt = sqrt(2*M_PI);
-    vector<double> envelope_cdf, envelope_pdf;
     int phatIntSize = phat_int[0].size();
 
     for (i = 0; i < phatIntSize; i++)
@@ -631,15 +961,6 @@ ONECHANNELDETECTRET * COneChannelDetect::Run()
         lognormal_median = exp(phat_int[0].at(i));
         lognormal_mean   = exp(tmp_sum);
 
-        tmp_prah_int = (m_settings->m_k1 * (lognormal_mode + lognormal_median)) - (m_settings->m_k3 * (lognormal_mean-lognormal_mode));
-        prah_int[0].push_back(tmp_prah_int);
-
-        if (m_settings->m_k2 != m_settings->m_k1)  
-        {
-            tmp_prah_int = (m_settings->m_k2 * (lognormal_mode + lognormal_median)) - (m_settings->m_k3 * (lognormal_mean-lognormal_mode));
-            prah_int[1].push_back(tmp_prah_int);
-        }
-
         // CDF of lognormal distribution, PDF of lognormal distribution
         // CDF
         tmp_sqrt_one = sqrt( 2.0f * phat_int[1].at(i) * phat_int[1].at(i));
@@ -655,26 +976,13 @@ ONECHANNELDETECTRET * COneChannelDetect::Run()
         tmp_x2 = (envelope[i] * phat_int[1].at(i) * tmp_sqrt);
         tmp_pdf = tmp_exp / tmp_x2;
         envelope_pdf.push_back(tmp_pdf);
-    }
-
-    vector<bool>* markers_high = NULL,* markers_low = NULL;
-    try {
-        markers_high = localMaximaDetection(envelope, prah_int[0], m_settings->m_polyspike_union_time);
-        detectionUnion(markers_high, envelope, m_settings->m_polyspike_union_time * m_fs);
 
-        if (m_settings->m_k2 != m_settings->m_k1 && prah_int[1].size() != 0)
-        {
-            markers_low = localMaximaDetection(envelope, prah_int[1], m_settings->m_polyspike_union_time);
-            detectionUnion(markers_low, envelope, m_settings->m_polyspike_union_time * m_fs);
-        } else markers_low = markers_high;
-    } 
-    catch (const char * e)
-    {
-    	return NULL;
+        // the threshold is k * (mode + median) - k3 * (mean - mode), the curves do not depend on the k-values
+        phat_int[0][i] = lognormal_mode + lognormal_median;
+        phat_int[1][i] = lognormal_mean - lognormal_mode;
     }
 
-    ret = new ONECHANNELDETECTRET(markers_high, markers_low, prah_int, envelope_cdf, envelope_pdf, envelope);
-    return ret;
+    return true;
 }
 
 /// Calculating a mean from data in vector
@@ -696,50 +1004,77 @@ double COneChannelDetect::mean(vector<double>& data)
 /// Calculating a variance from data in vector
 double COneChannelDetect::variance(vector<double>& data, const double & mean)
 {   
-    vector<double> v(data.begin(), data.end());
+    double diff, sq_sum = 0.0;
 
-    vector<double> diff(v.size());
-    std::transform(v.begin(), v.end(), diff.begin(),
-            std::bind2nd(std::minus<double>(), mean));
-    double sq_sum = std::inner_product(diff.begin(), diff.end(), diff.begin(), 0.0);
+    // the same order of the operations as the sum of the squared differences
+    for (vector<double>::const_iterator it = data.begin(); it != data.end(); ++it)
+    {
+        diff = *it - mean;
+        sq_sum = sq_sum + diff * diff;
+    }
     
-    return sq_sum / (v.size()-1);
+    return sq_sum / (data.size()-1);
 }
 
 /// Detection of local maxima in envelope
-vector<bool>* COneChannelDetect::localMaximaDetection(vector<SIGNALTYPE>& envelope, const vector<double>& prah_int, const double& polyspike_union_time)
+vector<bool> COneChannelDetect::localMaximaDetection(vector<SIGNALTYPE>& envelope, const vector<double>& prah_int, const double& polyspike_union_time)
 {
+	vector<bool> marker1;
+
+	localMaximaDetection(envelope, prah_int, polyspike_union_time, marker1);
+
+	return marker1;
+}
+
+/// Detection of local maxima in envelope to a reused vector.
+void COneChannelDetect::localMaximaDetection(vector<SIGNALTYPE>& envelope, const vector<double>& prah_int, const double& polyspike_union_time,
+											 vector<bool>& marker1)
+{
+	PROFILE_SCOPE("COneChannelDetect::localMaximaDetection");
+	PROFILE_COUNT("COneChannelDetect::localMaximaDetection", envelope.size(), envelope.size() * sizeof(SIGNALTYPE));
+
+	if (CDSP::IsFast(DSP_FAST_MAXIMA))
+	{
+		localMaximaDetectionFast(envelope, prah_int, polyspike_union_time, marker1);
+		return;
+	}
+
+	CDetectorArena&      arena = CDetectorArena::GetThreadArena();
 	unsigned int         size = envelope.size();
-	vector<bool>* 	     marker1 = new vector<bool>(size, 0);
-    vector<int>   	     point[2];
-    vector<SIGNALTYPE>   seg, seg_s;
-    vector<int>          tmp_diff_vector;
+    vector<int>*   	     point = arena.m_maximaPoint;
+    vector<SIGNALTYPE>&  seg = arena.m_maximaSegment;
+    vector<SIGNALTYPE>&  seg_s = arena.m_maximaSigns;
+    vector<int>&         tmp_diff_vector = arena.m_maximaDiff;
 	int        			 pointer_max;
     SIGNALTYPE 			 tmp_max;
 	int 				 tmp_pointer;
     unsigned int 		 i, j, tmp;
 
-    vector<int> 		 pointer;
+    vector<int>& 		 pointer = arena.m_maximaPointer;
     bool 				 state_previous = false;
     int 				 tmp_ceil, tmp_stop, start;
     float 				 tmp_sum_elems;
 
-    vector<int> 		 lokal_max, lokal_max_poz;
-    vector<SIGNALTYPE>   lokal_max_val;
+    vector<int>& 		 lokal_max = arena.m_maximaLocal;
+    vector<int>& 		 lokal_max_poz = arena.m_maximaLocalPosition;
+    vector<SIGNALTYPE>&  lokal_max_val = arena.m_maximaLocalValue;
     float 				 tmp_diff;
     int 				 tmp_sign, tmp_sign_next;
-    vector<float> 	     tmp_diff_vector2;
+    vector<float>& 	     tmp_diff_vector2 = arena.m_maximaLocalDiff;
+
+    marker1.assign(size, 0);
+    pointer.clear();
 
     for (i = 0; i < size; i++)
         if (envelope[i] > prah_int[i])
-            marker1->at(i) = 1;
+            marker1.at(i) = 1;
 
     // start + end crossing
-    findStartEndCrossing(point, marker1);
+    findStartEndCrossing(point, &marker1);
     if (point[0].size() != point[1].size())
         throw "local_maxima_detection: point sizes are different";  
 
-    marker1->assign(size, 0);
+    marker1.assign(size, 0);
 
     for (i = 0; i < point[0].size(); i++)
     {
@@ -775,7 +1110,7 @@ vector<bool>* COneChannelDetect::localMaximaDetection(vector<SIGNALTYPE>& envelo
             {
                 tmp_pointer = point[0].at(i) + seg_s.at(j);
                 if (tmp_pointer < (int)size)
-                    marker1->at(tmp_pointer) = 1;
+                    marker1.at(tmp_pointer) = 1;
             }
         } 
         else if (point[1].at(i) - point[0].at(i) <= 2)
@@ -794,13 +1129,13 @@ vector<bool>* COneChannelDetect::localMaximaDetection(vector<SIGNALTYPE>& envelo
 
             tmp = point[0].at(i) + pointer_max;
             if (tmp < size)
-                marker1->at(tmp) = 1;
+                marker1.at(tmp) = 1;
         }
     }
 
     // union of section, where local maxima are close together <(1/f_low + 0.02 sec.)~ 120 ms
-    for (i = 0; i < marker1->size(); i++)
-        if (marker1->at(i))
+    for (i = 0; i < marker1.size(); i++)
+        if (marker1.at(i))
         	pointer.push_back(i); 
     
     state_previous = false;
@@ -816,7 +1151,7 @@ vector<bool>* COneChannelDetect::localMaximaDetection(vector<SIGNALTYPE>& envelo
             tmp_stop = tmp_ceil + 1;
 
         for(j = pointer.at(i)+1; j < (unsigned)tmp_stop; j++)
-                seg.push_back(marker1->at(j));       
+                seg.push_back(marker1.at(j));       
 
         for (vector<SIGNALTYPE>::iterator j = seg.begin() ; j != seg.end(); ++j)
             tmp_sum_elems += *j;
@@ -829,7 +1164,7 @@ vector<bool>* COneChannelDetect::localMaximaDetection(vector<SIGNALTYPE>& envelo
             {
                 state_previous = false;
                 for (j = start; j <= (unsigned)pointer.at(i) && j < size; j++)
-                    marker1->at(j) = true;
+                    marker1.at(j) = true;
             }
         }
         else
@@ -843,7 +1178,7 @@ vector<bool>* COneChannelDetect::localMaximaDetection(vector<SIGNALTYPE>& envelo
     }
 
     // finding of the highes maxima of the section with local maxima
-    findStartEndCrossing(point, marker1);
+    findStartEndCrossing(point, &marker1);
 
     if (point[0].size() != point[1].size())
         throw "local_maxima_detection: point sizes are different 2";
@@ -863,7 +1198,7 @@ vector<bool>* COneChannelDetect::localMaximaDetection(vector<SIGNALTYPE>& envelo
                     lokal_max.push_back(pointer.at(j));
             
             for (j = point[0].at(i); j <= (unsigned)point[1].at(i) && j < size; j++)
-                marker1->at(j) = false;
+                marker1.at(j) = false;
 
             // envelope magnitude in local maxima
             for (j = 0; j < lokal_max.size(); j++)
@@ -898,24 +1233,157 @@ vector<bool>* COneChannelDetect::localMaximaDetection(vector<SIGNALTYPE>& envelo
             {
                 if (lokal_max_poz.at(j) == 1 && lokal_max.at(j) < (int)size)
                 {
-                    marker1->at( lokal_max.at(j) ) = true;
+                    marker1.at( lokal_max.at(j) ) = true;
                 }
             }
         }
     }   
+}
 
-    return marker1;
+/// Fast path of localMaximaDetection - the same markers without the temporary copies of the sections.
+void COneChannelDetect::localMaximaDetectionFast(const vector<SIGNALTYPE>& envelope, const vector<double>& prah_int, const double& polyspike_union_time,
+												 vector<bool>& marker1)
+{
+	CDetectorArena&      arena = CDetectorArena::GetThreadArena();
+	int                  size = envelope.size();
+	vector<int>*         point = arena.m_maximaPoint;
+	vector<int>&         pointer = arena.m_maximaPointer;
+	vector<int>&         lokal_max = arena.m_maximaLocal;
+	vector<float>&       lokal_max_diff = arena.m_maximaLocalDiff;
+	int                  i, j, k, start = 0, stop, tmp_ceil, pointer_max, sign, sign_previous;
+	bool                 state_previous = false;
+	SIGNALTYPE           tmp_max, d;
+
+	marker1.assign(size, 0);
+	pointer.clear();
+
+	for (i = 0; i < size; i++)
+		if (envelope[i] > prah_int[i])
+			marker1[i] = 1;
+
+	// start + end crossing
+	findStartEndCrossing(point, &marker1);
+	if (point[0].size() != point[1].size())
+		throw "local_maxima_detection: point sizes are different";
+
+	marker1.assign(size, 0);
+
+	for (i = 0; i < (int)point[0].size(); i++)
+	{
+		start = point[0][i];
+		stop = point[1][i];
+
+		if (stop - start > 2)
+		{
+			// local maxima - the sign of the difference falls
+			sign_previous = 0;
+			for (j = 0; j < stop - start; j++)
+			{
+				d = envelope[start + j + 1] - envelope[start + j];
+				sign = (d > 0) ? 1 : ((d < 0) ? -1 : 0);
+				if (sign - sign_previous < 0 && start + j < size)
+					marker1[start + j] = 1;
+				sign_previous = sign;
+			}
+		}
+		else
+		{
+			pointer_max = 1;
+			tmp_max = 0;
+			for (j = 0; j <= stop - start; j++)
+			{
+				if (envelope[start + j] > tmp_max)
+				{
+					pointer_max = j;
+					tmp_max = envelope[start + j];
+				}
+			}
+
+			if (start + pointer_max < size)
+				marker1[start + pointer_max] = 1;
+		}
+	}
+
+	// union of section, where local maxima are close together - the next marker is in the window, the markers
+	// written by the union are always before the window
+	for (i = 0; i < size; i++)
+		if (marker1[i])
+			pointer.push_back(i);
+
+	state_previous = false;
+	for (i = 0; i < (int)pointer.size(); i++)
+	{
+		tmp_ceil = ceil(pointer[i] + polyspike_union_time * m_fs);
+		stop = (tmp_ceil >= size) ? size : tmp_ceil + 1;
+
+		bool next = (i + 1 < (int)pointer.size() && pointer[i+1] < stop);
+
+		if (state_previous)
+		{
+			if (!next)
+			{
+				state_previous = false;
+				for (j = start; j <= pointer[i] && j < size; j++)
+					marker1[j] = true;
+			}
+		}
+		else if (next)
+		{
+			state_previous = true;
+			start = pointer[i];
+		}
+	}
+
+	// finding of the highes maxima of the section with local maxima
+	findStartEndCrossing(point, &marker1);
+	if (point[0].size() != point[1].size())
+		throw "local_maxima_detection: point sizes are different 2";
+
+	for (i = 0; i < (int)point[0].size(); i++)
+	{
+		if (point[1][i] - point[0][i] <= 1)
+			continue;
+
+		// local maxima in the section, the pointers are sorted
+		lokal_max.assign(lower_bound(pointer.begin(), pointer.end(), point[0][i]), upper_bound(pointer.begin(), pointer.end(), point[1][i]));
+
+		for (j = point[0][i]; j <= point[1][i] && j < size; j++)
+			marker1[j] = false;
+
+		// lokal_max_poz=(diff(sign(diff([0;lokal_max_val;0]))<0)>0);
+		lokal_max_diff.clear();
+		float previous = 0;
+		for (k = 0; k < (int)lokal_max.size(); k++)
+		{
+			lokal_max_diff.push_back(envelope[lokal_max[k]] - previous);
+			previous = envelope[lokal_max[k]];
+		}
+		lokal_max_diff.push_back(0 - envelope[lokal_max.back()]);
+
+		for (k = 0; k < (int)lokal_max.size(); k++)
+		{
+			if ((lokal_max_diff[k] > 0) && !(lokal_max_diff[k+1] > 0) && lokal_max[k] < size)
+				marker1[lokal_max[k]] = true;
+		}
+	}
 }
 
 /// Detecting of union and their merging.
 void COneChannelDetect::detectionUnion(vector<bool>* marker1, vector<SIGNALTYPE>& envelope, const double& union_samples)
 {
+    PROFILE_SCOPE("COneChannelDetect::detectionUnion");
+    PROFILE_COUNT("COneChannelDetect::detectionUnion", envelope.size(), envelope.size() * sizeof(SIGNALTYPE));
+
     int 				  i, j, start, stop, sum = round(union_samples);
     float 			 	  max; // maximum value in segment of envelope
     int 			 	  max_pos; // position of maximum
-    vector<double> 	  	  vec_MASK(sum, 1.0);
-    vector<double> 	 	  vec_marker2(marker1->begin(), marker1->end());
-    vector<int>    	  	  point[2];
+    CDetectorArena&       arena = CDetectorArena::GetThreadArena();
+    vector<double>& 	  vec_MASK = arena.m_unionMask;
+    vector<double>& 	  vec_marker2 = arena.m_unionMarkers;
+    vector<int>*   	  	  point = arena.m_unionPoint;
+
+    vec_MASK.assign(sum, 1.0);
+    vec_marker2.assign(marker1->begin(), marker1->end());
 	alglib::real_1d_array r1a_marker2, r1a_MASK, r1a_ret;
   
     // dilatation
@@ -1001,6 +1469,35 @@ void COneChannelDetect::findStartEndCrossing(vector<int> point[2], const vector<
 // CDetectorOutput
 // ------------------------------------------------------------------------------------------------
 
+/// Move the records of source to the end of target, source is left empty.
+template<typename T> static void spliceVector(vector<T>& target, vector<T>& source)
+{
+	if (target.empty())
+		target.swap(source);
+	else target.insert(target.end(), make_move_iterator(source.begin()), make_move_iterator(source.end()));
+
+	source.clear();
+}
+
+/// Reorder the column, the record order[i] becomes the record i.
+template<typename T> static void permuteColumn(vector<T>& column, const vector<int>& order)
+{
+	vector<T> permuted;
+	size_t    i;
+
+	permuted.reserve(order.size());
+	for (i = 0; i < order.size(); i++)
+		permuted.push_back(std::move(column[order[i]]));
+
+	column.swap(permuted);
+}
+
+/// Order of the spikes - by the position, then by the channel.
+static inline bool spikeBefore(const CDetectorOutput& a, const int& i, const CDetectorOutput& b, const int& j)
+{
+	return a.m_pos[i] < b.m_pos[j] || (a.m_pos[i] == b.m_pos[j] && a.m_chan[i] < b.m_chan[j]);
+}
+
 /// A constructor.
 CDetectorOutput::CDetectorOutput()
 {
@@ -1023,27 +1520,239 @@ void CDetectorOutput::Add(const double& pos, const double& dur, const int& chan,
     m_con.push_back(con);       
     m_weight.push_back(weight);    
     m_pdf.push_back(pdf);       
+
+    if (!m_channelIndex.empty())
+    	m_channelIndex.clear();
 }
 
-///Erase records at positions.
-void CDetectorOutput::Remove(const vector<int>& pos)
+/// Reserve the vectors for records.
+void CDetectorOutput::Reserve(const size_t& count)
 {
-	unsigned i, counter = 0;
-	
-	for (i = 0; i < pos.size(); i++)
+	m_pos.reserve(count);
+	m_dur.reserve(count);
+	m_chan.reserve(count);
+	m_con.reserve(count);
+	m_weight.reserve(count);
+	m_pdf.reserve(count);
+}
+
+/// Remove all records.
+void CDetectorOutput::Clear()
+{
+	m_pos.clear();
+	m_dur.clear();
+	m_chan.clear();
+	m_con.clear();
+	m_weight.clear();
+	m_pdf.clear();
+	m_channelIndex.clear();
+}
+
+/// Move the records of other output to this one.
+void CDetectorOutput::Append(CDetectorOutput&& other)
+{
+	int  count = m_pos.size();
+	bool ordered = count == 0 || other.m_pos.empty() || !spikeBefore(other, 0, *this, count - 1);
+
+	spliceVector(m_pos, other.m_pos);
+	spliceVector(m_dur, other.m_dur);
+	spliceVector(m_chan, other.m_chan);
+	spliceVector(m_con, other.m_con);
+	spliceVector(m_weight, other.m_weight);
+	spliceVector(m_pdf, other.m_pdf);
+
+	m_channelIndex.clear();
+	other.m_channelIndex.clear();
+	if (ordered)
+		return;
+
+	// overlapping outputs - merge of the two sorted runs
+	vector<int> order(m_pos.size());
+	iota(order.begin(), order.end(), 0);
+	inplace_merge(order.begin(), order.begin() + count, order.end(), [this](const int& i, const int& j) {
+		return spikeBefore(*this, i, *this, j);
+	});
+	permute(order);
+}
+
+/// Merge sorted outputs to the output.
+void CDetectorOutput::Merge(vector<unique_ptr<CDetectorOutput> >& parts, CDetectorOutput& out)
+{
+	vector<int> heap, cursor(parts.size(), 0);
+	size_t      total = 0;
+	int         i, part;
+
+	out.RemoveIf([](const int&) { return true; });
+
+	for (i = 0; i < (int)parts.size(); i++)
 	{
-		if (m_pos.size() < pos.at(i)-counter || pos.at(i)-counter < 0)
+		if (!parts[i] || parts[i]->m_pos.empty())
 			continue;
 
-		m_pos.erase(m_pos.begin()+pos.at(i)-counter);      
-    	m_dur.erase(m_dur.begin()+pos.at(i)-counter);       
-    	m_chan.erase(m_chan.begin()+pos.at(i)-counter);     
-    	m_con.erase(m_con.begin()+pos.at(i)-counter);       
-    	m_weight.erase(m_weight.begin()+pos.at(i)-counter);   
-    	m_pdf.erase(m_pdf.begin()+pos.at(i)-counter); 
+		total += parts[i]->m_pos.size();
+		heap.push_back(i);
+	}
 
-    	counter++; 
+	if (heap.size() == 1)
+	{
+		out.Append(std::move(*parts[heap[0]]));
+		return;
+	}
+
+	// the part with the first head on the top, the earlier part for the same head
+	auto after = [&parts, &cursor](const int& a, const int& b) {
+		if (spikeBefore(*parts[b], cursor[b], *parts[a], cursor[a]))
+			return true;
+		return !spikeBefore(*parts[a], cursor[a], *parts[b], cursor[b]) && a > b;
+	};
+
+	out.Reserve(total);
+	make_heap(heap.begin(), heap.end(), after);
+	while (!heap.empty())
+	{
+		pop_heap(heap.begin(), heap.end(), after);
+		part = heap.back();
+
+		CDetectorOutput& source = *parts[part];
+		i = cursor[part]++;
+		out.Add(source.m_pos[i], source.m_dur[i], source.m_chan[i], source.m_con[i], source.m_weight[i], source.m_pdf[i]);
+
+		if (cursor[part] < (int)source.m_pos.size())
+			push_heap(heap.begin(), heap.end(), after);
+		else heap.pop_back();
 	}
+
+	for (i = 0; i < (int)parts.size(); i++)
+		if (parts[i])
+			parts[i]->RemoveIf([](const int&) { return true; });
+}
+
+/// Stable sort of the records.
+void CDetectorOutput::Sort()
+{
+	if (IsSorted())
+		return;
+
+	vector<int> order(m_pos.size());
+	iota(order.begin(), order.end(), 0);
+	stable_sort(order.begin(), order.end(), [this](const int& i, const int& j) {
+		return spikeBefore(*this, i, *this, j);
+	});
+	permute(order);
+}
+
+/// Returns true if the records are sorted.
+bool CDetectorOutput::IsSorted() const
+{
+	for (int i = 1; i < (int)m_pos.size(); i++)
+		if (spikeBefore(*this, i, *this, i - 1))
+			return false;
+
+	return true;
+}
+
+/// Erase the records for which the predicate returns true.
+int CDetectorOutput::RemoveIf(const function<bool(const int&)>& predicate)
+{
+	int i, count = m_pos.size(), kept = 0;
+
+	for (i = 0; i < count; i++)
+	{
+		if (predicate(i))
+			continue;
+
+		if (kept != i)
+			moveRecord(i, kept);
+		kept++;
+	}
+
+	m_pos.resize(kept);
+	m_dur.resize(kept);
+	m_chan.resize(kept);
+	m_con.resize(kept);
+	m_weight.resize(kept);
+	m_pdf.resize(kept);
+	m_channelIndex.clear();
+
+	return count - kept;
+}
+
+///Erase records at positions.
+void CDetectorOutput::Remove(const vector<int>& pos)
+{
+	size_t next = 0;
+
+	RemoveIf([&pos, &next](const int& record) {
+		while (next < pos.size() && pos[next] < record)
+			next++;
+		return next < pos.size() && pos[next] == record;
+	});
+}
+
+/// Find the records in the time range.
+void CDetectorOutput::FindRange(const double& t0, const double& t1, int& first, int& last) const
+{
+	first = lower_bound(m_pos.begin(), m_pos.end(), t0) - m_pos.begin();
+	last = upper_bound(m_pos.begin() + first, m_pos.end(), t1) - m_pos.begin();
+}
+
+/// Find the records of one channel in the time range.
+void CDetectorOutput::FindRange(const double& t0, const double& t1, const int& channel, vector<int>& records) const
+{
+	int first, last, i;
+
+	records.clear();
+
+	if (m_channelIndex.empty())
+	{
+		FindRange(t0, t1, first, last);
+		for (i = first; i < last; i++)
+			if (m_chan[i] == channel)
+				records.push_back(i);
+		return;
+	}
+
+	map<int, vector<int> >::const_iterator it = m_channelIndex.find(channel);
+	if (it == m_channelIndex.end())
+		return;
+
+	const vector<int>& index = it->second;
+	vector<int>::const_iterator record = lower_bound(index.begin(), index.end(), t0, [this](const int& i, const double& t) {
+		return m_pos[i] < t;
+	});
+	for (; record != index.end() && m_pos[*record] <= t1; ++record)
+		records.push_back(*record);
+}
+
+/// Build the index of the channels.
+void CDetectorOutput::BuildIndex()
+{
+	m_channelIndex.clear();
+	for (int i = 0; i < (int)m_pos.size(); i++)
+		m_channelIndex[m_chan[i]].push_back(i);
+}
+
+/// Move the record to an other index.
+void CDetectorOutput::moveRecord(const int& from, const int& to)
+{
+	m_pos[to] = m_pos[from];
+	m_dur[to] = m_dur[from];
+	m_chan[to] = m_chan[from];
+	m_con[to] = m_con[from];
+	m_weight[to] = m_weight[from];
+	m_pdf[to] = m_pdf[from];
+}
+
+/// Reorder the records.
+void CDetectorOutput::permute(const vector<int>& order)
+{
+	permuteColumn(m_pos, order);
+	permuteColumn(m_dur, order);
+	permuteColumn(m_chan, order);
+	permuteColumn(m_con, order);
+	permuteColumn(m_weight, order);
+	permuteColumn(m_pdf, order);
+	m_channelIndex.clear();
 }
 
 // ------------------------------------------------------------------------------------------------
@@ -1052,26 +1761,196 @@ void CDetectorOutput::Remove(const vector<int>& pos)
 
 /// A constructor.
 CDischarges::CDischarges(const int& countChannels)
+	: m_MV(countChannels), m_MA(countChannels), m_MP(countChannels), m_MD(countChannels), m_MW(countChannels), m_MPDF(countChannels),
+	m_countChannels(countChannels)
 {
-    m_countChannels = countChannels;
-
-    m_MV   = new vector<double>[countChannels];
-    m_MA   = new vector<double>[countChannels]; 
-    m_MP   = new vector<double>[countChannels];
-    m_MD   = new vector<double>[countChannels]; 
-    m_MW   = new vector<double>[countChannels];
-    m_MPDF = new vector<double>[countChannels];
+	/* empty */
 }
 
 /// A virual destructor.
 CDischarges::~CDischarges()
 {
-    delete [] m_MV;
-    delete [] m_MA;
-    delete [] m_MP;
-    delete [] m_MD;
-    delete [] m_MW;
-    delete [] m_MPDF;
+	/* empty */
+}
+
+/// Reserve the vectors of all channels for records.
+void CDischarges::Reserve(const size_t& count)
+{
+	for (unsigned channel = 0; channel < m_countChannels; channel++)
+	{
+		m_MV[channel].reserve(count);
+		m_MA[channel].reserve(count);
+		m_MP[channel].reserve(count);
+		m_MD[channel].reserve(count);
+		m_MW[channel].reserve(count);
+		m_MPDF[channel].reserve(count);
+	}
+}
+
+/// Remove all records of all channels.
+void CDischarges::Clear()
+{
+	for (unsigned channel = 0; channel < m_countChannels; channel++)
+	{
+		m_MV[channel].clear();
+		m_MA[channel].clear();
+		m_MP[channel].clear();
+		m_MD[channel].clear();
+		m_MW[channel].clear();
+		m_MPDF[channel].clear();
+	}
+}
+
+/// Move the records of other discharges to this one.
+void CDischarges::Append(CDischarges&& other)
+{
+	int  count = GetCount();
+	bool ordered = count == 0 || other.GetCount() == 0 || !(other.GetOnset(0) < GetOnset(count - 1));
+
+	for (unsigned channel = 0; channel < m_countChannels && channel < other.m_countChannels; channel++)
+	{
+		spliceVector(m_MV[channel], other.m_MV[channel]);
+		spliceVector(m_MA[channel], other.m_MA[channel]);
+		spliceVector(m_MP[channel], other.m_MP[channel]);
+		spliceVector(m_MD[channel], other.m_MD[channel]);
+		spliceVector(m_MW[channel], other.m_MW[channel]);
+		spliceVector(m_MPDF[channel], other.m_MPDF[channel]);
+	}
+
+	if (ordered)
+		return;
+
+	// overlapping discharges - merge of the two sorted runs
+	vector<double> onset(GetCount());
+	vector<int>    order(GetCount());
+	for (int i = 0; i < (int)onset.size(); i++)
+		onset[i] = GetOnset(i);
+
+	iota(order.begin(), order.end(), 0);
+	inplace_merge(order.begin(), order.begin() + count, order.end(), [&onset](const int& i, const int& j) {
+		return onset[i] < onset[j];
+	});
+	permute(order);
+}
+
+/// Merge sorted discharges to the discharges.
+void CDischarges::Merge(vector<unique_ptr<CDischarges> >& parts, CDischarges& out)
+{
+	vector<int>              heap, cursor(parts.size(), 0);
+	vector<vector<double> >  onset(parts.size());
+	size_t                   total = 0;
+	int                      i, part;
+	unsigned                 channel;
+
+	out.RemoveIf([](const int&) { return true; });
+
+	for (i = 0; i < (int)parts.size(); i++)
+	{
+		if (!parts[i] || parts[i]->GetCount() == 0)
+			continue;
+
+		onset[i].resize(parts[i]->GetCount());
+		for (part = 0; part < (int)onset[i].size(); part++)
+			onset[i][part] = parts[i]->GetOnset(part);
+
+		total += onset[i].size();
+		heap.push_back(i);
+	}
+
+	if (heap.size() == 1)
+	{
+		out.Append(std::move(*parts[heap[0]]));
+		return;
+	}
+
+	// the part with the earliest head on the top, the earlier part for the same onset
+	auto after = [&onset, &cursor](const int& a, const int& b) {
+		if (onset[b][cursor[b]] < onset[a][cursor[a]])
+			return true;
+		return !(onset[a][cursor[a]] < onset[b][cursor[b]]) && a > b;
+	};
+
+	out.Reserve(total);
+	make_heap(heap.begin(), heap.end(), after);
+	while (!heap.empty())
+	{
+		pop_heap(heap.begin(), heap.end(), after);
+		part = heap.back();
+
+		CDischarges& source = *parts[part];
+		i = cursor[part]++;
+		for (channel = 0; channel < out.m_countChannels && channel < source.m_countChannels; channel++)
+		{
+			out.m_MV[channel].push_back(source.m_MV[channel][i]);
+			out.m_MA[channel].push_back(source.m_MA[channel][i]);
+			out.m_MP[channel].push_back(source.m_MP[channel][i]);
+			out.m_MD[channel].push_back(source.m_MD[channel][i]);
+			out.m_MW[channel].push_back(source.m_MW[channel][i]);
+			out.m_MPDF[channel].push_back(source.m_MPDF[channel][i]);
+		}
+
+		if (cursor[part] < (int)onset[part].size())
+			push_heap(heap.begin(), heap.end(), after);
+		else heap.pop_back();
+	}
+
+	for (i = 0; i < (int)parts.size(); i++)
+		if (parts[i])
+			parts[i]->RemoveIf([](const int&) { return true; });
+}
+
+/// Stable sort of the records by the onset.
+void CDischarges::Sort()
+{
+	vector<double> onset(GetCount());
+	vector<int>    order(GetCount());
+	bool           sorted = true;
+	int            i;
+
+	for (i = 0; i < (int)onset.size(); i++)
+	{
+		onset[i] = GetOnset(i);
+		if (i > 0 && onset[i] < onset[i - 1])
+			sorted = false;
+	}
+
+	if (sorted)
+		return;
+
+	iota(order.begin(), order.end(), 0);
+	stable_sort(order.begin(), order.end(), [&onset](const int& i, const int& j) {
+		return onset[i] < onset[j];
+	});
+	permute(order);
+}
+
+/// Erase the records for which the predicate returns true.
+int CDischarges::RemoveIf(const function<bool(const int&)>& predicate)
+{
+	int      i, count = GetCount(), kept = 0;
+	unsigned channel;
+
+	for (i = 0; i < count; i++)
+	{
+		if (predicate(i))
+			continue;
+
+		if (kept != i)
+			moveRecord(i, kept);
+		kept++;
+	}
+
+	for (channel = 0; channel < m_countChannels; channel++)
+	{
+		m_MV[channel].resize(kept);
+		m_MA[channel].resize(kept);
+		m_MP[channel].resize(kept);
+		m_MD[channel].resize(kept);
+		m_MW[channel].resize(kept);
+		m_MPDF[channel].resize(kept);
+	}
+
+	return count - kept;
 }
 
 /**
@@ -1080,24 +1959,51 @@ CDischarges::~CDischarges()
  */
 void CDischarges::Remove(const vector<int>& pos)
 {	
-	unsigned i, channel, counter = 0;
+	size_t next = 0;
 
-	for (i = 0; i < pos.size(); i++)
+	RemoveIf([&pos, &next](const int& record) {
+		while (next < pos.size() && pos[next] < record)
+			next++;
+		return next < pos.size() && pos[next] == record;
+	});
+}
+
+/// Returns the onset of the record.
+double CDischarges::GetOnset(const int& record) const
+{
+	double onset = INT_MAX;
+
+	for (unsigned channel = 0; channel < m_countChannels; channel++)
+		if (m_MP[channel][record] < onset)
+			onset = m_MP[channel][record];
+
+	return onset;
+}
+
+/// Move the record of all channels to an other index.
+void CDischarges::moveRecord(const int& from, const int& to)
+{
+	for (unsigned channel = 0; channel < m_countChannels; channel++)
 	{
+		m_MV[channel][to] = m_MV[channel][from];
+		m_MA[channel][to] = m_MA[channel][from];
+		m_MP[channel][to] = m_MP[channel][from];
+		m_MD[channel][to] = m_MD[channel][from];
+		m_MW[channel][to] = m_MW[channel][from];
+		m_MPDF[channel][to] = m_MPDF[channel][from];
+	}
+}
 
-		for (channel = 0; channel < m_countChannels; channel++)
-		{
-			if (m_MV[channel].size() < pos.at(i)-counter || pos.at(i)-counter < 0)
-				continue;
-
-		    m_MV[channel].erase(m_MV[channel].begin()+pos.at(i)-counter);
-		    m_MA[channel].erase(m_MA[channel].begin()+pos.at(i)-counter);
-		    m_MP[channel].erase(m_MP[channel].begin()+pos.at(i)-counter);
-		    m_MW[channel].erase(m_MW[channel].begin()+pos.at(i)-counter);
-		    m_MPDF[channel].erase(m_MPDF[channel].begin()+pos.at(i)-counter);
-		    m_MD[channel].erase(m_MD[channel].begin()+pos.at(i)-counter);
-		}		
-		counter++;
+/// Reorder the records.
+void CDischarges::permute(const vector<int>& order)
+{
+	for (unsigned channel = 0; channel < m_countChannels; channel++)
+	{
+		permuteColumn(m_MV[channel], order);
+		permuteColumn(m_MA[channel], order);
+		permuteColumn(m_MP[channel], order);
+		permuteColumn(m_MD[channel], order);
+		permuteColumn(m_MW[channel], order);
+		permuteColumn(m_MPDF[channel], order);
 	}
-	
-}
\ No newline at end of file
+}
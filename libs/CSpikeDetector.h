@@ -2,6 +2,9 @@
 #define	CSpikeDetector_H
 
 #include <vector>
+#include <memory>
+#include <map>
+#include <functional>
 #include <iostream>
 #include <cmath>
 
@@ -11,9 +14,19 @@
 
 #include "lib/Alglib/interpolation.h"
 
+/// Peak memory of the detection per sample of a segment at the sample rate of the file - the read buffers and the resampling (measured).
+#define DETECTOR_BYTES_PER_INPUT_SAMPLE 16
+/// Peak memory of the detection per sample of a segment after decimation - the filters, the envelope, the threshold curves,
+/// the markers and the result of \ref COneChannelDetect (measured).
+#define DETECTOR_BYTES_PER_SAMPLE 128
+/// The shortest buffering chosen for a memory budget, in windows - the segments overlap by 3 windows on both sides.
+#define DETECTOR_MIN_BUFFERING_WINDOWS 6
+
 class CDetectorOutput;
 class CMarker;
 class CDischarges;
+struct oneChannelDetectRet;
+struct pipelineSegment;
 
 // structure containing settings of the spike detector
 typedef struct detectorSettings
@@ -51,7 +64,139 @@ public:
 	CSpikeDetector(CInputEDF * model, DETECTOR_SETTINGS * settings);
 
 	// analyse one channel, is possible change file
-	void AnalyseChannel(const int channelNumber, CDetectorOutput ** output, CDischarges ** discharges, const wchar_t * fileName = NULL);
+	void AnalyseChannel(const int channelNumber, std::unique_ptr<CDetectorOutput>& output, std::unique_ptr<CDischarges>& discharges,
+						const wchar_t * fileName = NULL);
+
+	/**
+	 * Analyse the time range [t0, t1] of one channel. The range is read with a margin of 3 windows on both sides
+	 * (the same as the overlap of the segments, the warm-up of the filters and the statistics), the detections in
+	 * the margins are removed.
+	 * @param channelNumber number of the channel
+	 * @param t0 start of the range (second)
+	 * @param t1 end of the range (second)
+	 * @param output output - detections with the onset in the range
+	 * @param discharges output - discharges with the onset in the range
+	 */
+	void AnalyseRange(const int channelNumber, const double& t0, const double& t1, std::unique_ptr<CDetectorOutput>& output,
+					  std::unique_ptr<CDischarges>& discharges);
+
+	/**
+	 * Compute the segments of the channel (buffering with two-side overlap), see \ref getIndexStartStop.
+	 * The buffering is limited to the length of the signal, the settings are not changed.
+	 * @param channelNumber number of the channel
+	 * @param indexStart output vector with starts of the segments (sample)
+	 * @param indexStop output vector with ends of the segments (sample)
+	 * @return sample rate of the channel
+	 */
+	int GetSegments(const int channelNumber, std::vector<SAMPLEINDEX>& indexStart, std::vector<SAMPLEINDEX>& indexStop);
+
+	/**
+	 * Estimated peak memory of the detection of one segment - the larger of the input stage (reading and resampling at the
+	 * sample rate of the file) and the detection stage (after decimation).
+	 * @param countSamples count of samples of the segment
+	 * @param fs sample rate of the channel
+	 * @param settings settings of the detector
+	 * @return bytes
+	 */
+	static long long EstimateSegmentMemory(const SAMPLEINDEX& countSamples, const int& fs, const DETECTOR_SETTINGS& settings);
+
+	/**
+	 * Returns the longest buffering whose segments (with the overlaps) fit to the memory, limited by m_buffering of the settings.
+	 * At least \ref DETECTOR_MIN_BUFFERING_WINDOWS windows are returned even if they do not fit.
+	 * @param memory memory of one segment (byte)
+	 * @param fs sample rate of the channel
+	 * @param settings settings of the detector
+	 * @return buffering (second)
+	 */
+	static int GetBufferingForMemory(const long long& memory, const int& fs, const DETECTOR_SETTINGS& settings);
+
+	/**
+	 * Compute the segments covering the time range [t0, t1] of the channel with the margins of \ref AnalyseRange.
+	 * @param channelNumber number of the channel
+	 * @param t0 start of the range (second)
+	 * @param t1 end of the range (second)
+	 * @param indexStart output vector with starts of the segments (sample), empty if the range is out of the signal
+	 * @param indexStop output vector with ends of the segments (sample)
+	 * @return sample rate of the channel
+	 */
+	int GetRangeSegments(const int channelNumber, const double& t0, const double& t1, std::vector<SAMPLEINDEX>& indexStart,
+						 std::vector<SAMPLEINDEX>& indexStop);
+
+	/**
+	 * Analyse one segment of the channel - read data, detect, remove detections in the overlaps and shift the positions
+	 * to the time in the file. The segments of one channel can be analysed concurrently (the input model must support
+	 * concurrent reads), the results must be appended in the order of the segments.
+	 * @param channelNumber number of the channel
+	 * @param indexStart starts of the segments from \ref GetSegments
+	 * @param indexStop ends of the segments from \ref GetSegments
+	 * @param segmentNumber number of the segment
+	 * @param subOut output - detections in the segment, the object of the previous segment is reused (\ref DetectSegment)
+	 * @param subDischarges output - discharges in the segment
+	 * @return false if the segment can not be read, the outputs are not valid
+	 */
+	bool AnalyseSegment(const int channelNumber, const std::vector<SAMPLEINDEX>& indexStart, const std::vector<SAMPLEINDEX>& indexStop, const int& segmentNumber,
+						std::unique_ptr<CDetectorOutput>& subOut, std::unique_ptr<CDischarges>& subDischarges);
+
+	/**
+	 * Append results of one segment from \ref AnalyseSegment to the results of the channel. The vectors of the segment
+	 * are moved (the first segment) or spliced to the end, the results of the segment are left empty.
+	 * @param out results of the channel
+	 * @param discharges discharges of the channel
+	 * @param subOut results of the segment
+	 * @param subDischarges discharges of the segment
+	 */
+	static void AppendSegment(CDetectorOutput& out, CDischarges& discharges, CDetectorOutput&& subOut, CDischarges&& subDischarges);
+
+	/**
+	 * Compute starts of the windows of the statistics.
+	 * @param countRecords count of samples of the segment
+	 * @param winsize size of the window (sample)
+	 * @param noverlap overlap of the windows (sample), or a ratio when < 1
+	 * @param index output vector with the starts of the windows
+	 */
+	static void GetWindowIndex(const int& countRecords, const int& winsize, const double& noverlap, std::vector<int>& index);
+
+	/**
+	 * Make spikes and discharges from the markers of the channels (the last stage of the detection).
+	 * The first and the last second of the markers is cleared.
+	 * @param ret results of \ref COneChannelDetect::Run for every channel
+	 * @param countChannels count of channels
+	 * @param countRecords count of samples of the segment
+	 * @param fs sample rate of the segment (after decimation)
+	 * @param out output - detections
+	 * @param discharges output - discharges
+	 */
+	void AssembleDetections(oneChannelDetectRet** ret, const int& countChannels, const int& countRecords, const int& fs,
+							std::unique_ptr<CDetectorOutput>& out, std::unique_ptr<CDischarges>& discharges);
+
+	/**
+	 * Detect spikes in one segment processed by \ref CPipeline (the band-pass stream and its envelope).
+	 * @param segment the segment
+	 * @param out output - detections, positions from the start of the segment; an object left by the previous segment
+	 *            is cleared and reused with its capacity
+	 * @param discharges output - discharges, reused the same way
+	 */
+	void DetectSegment(const pipelineSegment& segment, std::unique_ptr<CDetectorOutput>& out, std::unique_ptr<CDischarges>& discharges);
+
+	/**
+	 * Remove the detections in the overlaps of the segments and shift the positions to the time in the file.
+	 * @param segmentNumber number of the segment
+	 * @param countSegments count of segments of the channel
+	 * @param start start of the segment (sample)
+	 * @param stop end of the segment (sample)
+	 * @param fs sample rate of the channel
+	 * @param subOut detections of the segment
+	 * @param subDischarges discharges of the segment
+	 */
+	void TrimSegment(const int& segmentNumber, const int& countSegments, const SAMPLEINDEX& start, const SAMPLEINDEX& stop, const int& fs,
+					 CDetectorOutput& subOut, CDischarges& subDischarges);
+
+	/**
+	 * Set the function called by \ref AnalyseChannel with the detections of every segment as soon as the segment is done
+	 * (positions in the file, without the overlaps), before they are appended to the detections of the channel.
+	 * @param segmentDone the function of the channel number and the detections, empty - none
+	 */
+	void SetSegmentDone(const std::function<void(const int&, const CDetectorOutput&)>& segmentDone);
 
 private:
 	/** 
@@ -63,27 +208,22 @@ private:
 	 * @param fs sample rate
 	 * @param winsize size of the window
 	 */
-	void getIndexStartStop(std::vector<int>& indexStart, std::vector<int>& indexStop, const int& cntElemInCh, const double& T_seg, const int& fs, const int& winsize);
+	void getIndexStartStop(std::vector<SAMPLEINDEX>& indexStart, std::vector<SAMPLEINDEX>& indexStop, const SAMPLEINDEX& cntElemInCh, const double& T_seg, const int& fs, const int& winsize);
 
 	/**
-	 * Run analysis for a segment of data - data from one channel!
+	 * Run analysis for a segment of data - data from one channel! The stages of \ref CPipeline and \ref DetectSegment.
 	 * @param data inpud data - iEEG
-	 * @param counChanles count channles of input data
 	 * @param inpuFS sample rate of input data
-	 * @param bandwidth bandwifth
-	 * @param out a pointer to output object of \ref CDetectorOutput
-	 * @param discharges a pointer to output object of \ref CDischarges
+	 * @param out output object of \ref CDetectorOutput
+	 * @param discharges output object of \ref CDischarges
 	 */
-	void spikeDetector(std::vector<SIGNALTYPE>*& data, const int& inputFS, const BANDWIDTH& bandwidth,
-					   CDetectorOutput*& out, CDischarges*& discharges);
+	void spikeDetector(std::vector<SIGNALTYPE>*& data, const int& inputFS, std::unique_ptr<CDetectorOutput>& out, std::unique_ptr<CDischarges>& discharges);
 
 private:
 	CInputEDF 		  * m_model;
 	DETECTOR_SETTINGS * m_settings;
-	/// output object - structure out
-	CDetectorOutput*   m_out;
-	/// output object - strucutre discharges
-	CDischarges*       m_discharges;   
+	/// called with the detections of every segment of AnalyseChannel
+	std::function<void(const int&, const CDetectorOutput&)> m_segmentDone;
 };
 
 /**
@@ -99,16 +239,21 @@ public:
 	std::vector<double>  	 m_envelopePdf;
 	std::vector<SIGNALTYPE>  m_envelope;
 
-	/// A constructor
-	oneChannelDetectRet(std::vector<bool>*& markersHigh, std::vector<bool>*& markersLow, const std::vector<double> prahInt[2],
-						const std::vector<double> envelopeCdf, const std::vector<double> envelopePdf, const std::vector<SIGNALTYPE>& envelope)
-		: m_markersHigh(markersHigh), m_markersLow(markersLow)
+	/// A constructor - empty result, filled by \ref COneChannelDetect::Run
+	oneChannelDetectRet()
+		: m_markersHigh(NULL), m_markersLow(NULL)
 	{
-		m_prahInt[0].assign(prahInt[0].begin(), prahInt[0].end());
-		m_prahInt[1].assign(prahInt[1].begin(), prahInt[1].end());
-		m_envelopeCdf.assign(envelopeCdf.begin(), envelopeCdf.end());
-		m_envelopePdf.assign(envelopePdf.begin(), envelopePdf.end());
-		m_envelope.assign(envelope.begin(), envelope.end());
+		/* empty */
+	}
+
+	/// A constructor - the curves are moved to the result, the markers are not owned
+	oneChannelDetectRet(std::vector<bool>* markersHigh, std::vector<bool>* markersLow, std::vector<double> prahInt[2],
+						std::vector<double>&& envelopeCdf, std::vector<double>&& envelopePdf, std::vector<SIGNALTYPE>&& envelope)
+		: m_markersHigh(markersHigh), m_markersLow(markersLow), m_envelopeCdf(std::move(envelopeCdf)), m_envelopePdf(std::move(envelopePdf)),
+		m_envelope(std::move(envelope))
+	{
+		m_prahInt[0].swap(prahInt[0]);
+		m_prahInt[1].swap(prahInt[1]);
 	}
 
 	/// A destructor
@@ -142,11 +287,72 @@ public:
 	virtual ~COneChannelDetect();
 
 	/**
-	 * Run detection
+	 * Run detection - all stages below. The temporaries are kept in the arena of the thread (\ref CDetectorArena),
+	 * the markers of the result point to its buffers and are valid until the next call in the same thread.
+	 * @param ret output - the result, its vectors are reused
+	 * @param precomputed envelope of the input data computed before (\ref PIPELINE_ENVELOPE), NULL computes \ref Envelope
+	 * @return false if the thresholds or the local maxima can not be computed
 	 */
-	ONECHANNELDETECTRET * Run();
+	bool Run(ONECHANNELDETECTRET& ret, const std::vector<SIGNALTYPE>* precomputed = NULL);
+
+	/**
+	 * Hilbert's envelope of the input data.
+	 * @param envelope output envelope
+	 */
+	void Envelope(std::vector<SIGNALTYPE>& envelope);
+
+	/**
+	 * Mean and standard deviation of the logarithm of the envelope in the windows, smoothed by moving average.
+	 * @param envelope envelope from \ref Envelope
+	 * @param phatMedian output - mean of every window
+	 * @param phatStd output - standard deviation of every window
+	 */
+	void WindowStatistics(const std::vector<SIGNALTYPE>& envelope, std::vector<SIGNALTYPE>& phatMedian, std::vector<SIGNALTYPE>& phatStd);
+
+	/**
+	 * Spline interpolation of the window statistics to the threshold curves, CDF and PDF of the envelope.
+	 * @param envelope envelope from \ref Envelope
+	 * @param phatMedian mean of every window
+	 * @param phatStd standard deviation of every window
+	 * @param prah_int output - threshold curves for k1 and k2
+	 * @param envelope_cdf output - CDF of the envelope
+	 * @param envelope_pdf output - PDF of the envelope
+	 * @return false if the interpolation failed
+	 */
+	bool Thresholds(const std::vector<SIGNALTYPE>& envelope, const std::vector<SIGNALTYPE>& phatMedian, const std::vector<SIGNALTYPE>& phatStd,
+					std::vector<double> prah_int[2], std::vector<double>& envelope_cdf, std::vector<double>& envelope_pdf);
+
+	/**
+	 * The part of \ref Thresholds which does not depend on the k-values - spline interpolation of the window statistics
+	 * to the lognormal curves (mode + median, mean - mode), CDF and PDF of the envelope.
+	 * @param envelope envelope from \ref Envelope
+	 * @param phatMedian mean of every window
+	 * @param phatStd standard deviation of every window
+	 * @param lognormal output - mode + median and mean - mode of the lognormal distribution in every sample
+	 * @param envelope_cdf output - CDF of the envelope
+	 * @param envelope_pdf output - PDF of the envelope
+	 * @return false if the interpolation failed
+	 */
+	bool LognormalCurves(const std::vector<SIGNALTYPE>& envelope, const std::vector<SIGNALTYPE>& phatMedian, const std::vector<SIGNALTYPE>& phatStd,
+						 std::vector<double> lognormal[2], std::vector<double>& envelope_cdf, std::vector<double>& envelope_pdf);
+
+	/**
+	 * The threshold curves k * (mode + median) - k3 * (mean - mode) of the k-values of the settings, the same values as
+	 * \ref Thresholds. The curve of k2 is empty if k2 equals to k1.
+	 * @param lognormal curves from \ref LognormalCurves
+	 * @param settings the k-values
+	 * @param prah_int output - threshold curves for k1 and k2
+	 */
+	static void ThresholdCurves(const std::vector<double> lognormal[2], const DETECTOR_SETTINGS& settings, std::vector<double> prah_int[2]);
+
+	/**
+	 * Markers of the spikes - the local maxima of the envelope above the threshold curves and their union. The markers
+	 * of the result point to the buffers of the arena of the thread (\ref CDetectorArena).
+	 * @param ret the envelope and the threshold curves, output - the markers
+	 * @return false if the local maxima can not be computed
+	 */
+	bool Markers(ONECHANNELDETECTRET& ret);
 
-private:
 	/**
 	 * Calculating a mean from data in vector.
 	 * @param data a vector of input data
@@ -162,6 +368,7 @@ private:
 	 */
 	double variance(std::vector<double>& data, const double & mean);
 
+public:
 	/**
 	 * Detection of local maxima in envelope.
 	 * @param envelope envelope of input channel
@@ -169,7 +376,7 @@ private:
 	 * @param polyspike_union_time polyspike union time
 	 * @return vector cintaining markers of local maxima
 	 */
-	std::vector<bool>* localMaximaDetection(std::vector<SIGNALTYPE>& envelope, const std::vector<double>& prah_int, const double& polyspike_union_time);
+	std::vector<bool> localMaximaDetection(std::vector<SIGNALTYPE>& envelope, const std::vector<double>& prah_int, const double& polyspike_union_time);
 	
 	/**
 	 * Detecting of union and their merging.
@@ -179,6 +386,21 @@ private:
 	 */
 	void detectionUnion(std::vector<bool>* marker1, std::vector<SIGNALTYPE>& envelope, const double& union_samples);
 
+private:
+	/**
+	 * Detection of local maxima in envelope to a reused vector.
+	 * @param marker1 output - markers of local maxima
+	 */
+	void localMaximaDetection(std::vector<SIGNALTYPE>& envelope, const std::vector<double>& prah_int, const double& polyspike_union_time,
+							  std::vector<bool>& marker1);
+
+	/**
+	 * Fast path of \ref localMaximaDetection (\ref DSP_FAST_MAXIMA), the same markers.
+	 */
+	void localMaximaDetectionFast(const std::vector<SIGNALTYPE>& envelope, const std::vector<double>& prah_int, const double& polyspike_union_time,
+								  std::vector<bool>& marker1);
+
+
 	/** 
 	 * Finding of the highes maxima of the section with local maxima.
 	 * implement:
@@ -211,7 +433,11 @@ private:
 // ------------------------------------------------------------------------------------------------
 
 /**
- * Output class containing output data from the detector.
+ * Output class containing output data from the detector - a column store of the spikes, one record per spike.
+ *
+ * The records of the detector are sorted by the position (and the channel for the same position), the results of the
+ * segments are merged in this order (\ref Append, \ref Merge) and the time ranges are found by binary search
+ * (\ref FindRange). Filtering (\ref RemoveIf, \ref Remove) compacts the columns in one pass.
  */
 class CDetectorOutput
 {
@@ -238,12 +464,98 @@ public:
 	 */
 	void Add(const double& pos, const double& dur, const int& chan, const double& con, const double& weight, const double& pdf);
 
+	/**
+	 * Reserve the vectors for records, \ref Add does not reallocate them up to the count.
+	 * @param count count of records
+	 */
+	void Reserve(const size_t& count);
+
+	/**
+	 * Remove all records, the vectors keep their capacity.
+	 */
+	void Clear();
+
+	/**
+	 * Move the records of other output to this one, the other output is left empty. Both outputs must be sorted -
+	 * the other output is spliced to the end if it follows the last record, the records are merged otherwise.
+	 * @param other the output to append
+	 */
+	void Append(CDetectorOutput&& other);
+
+	/**
+	 * Merge sorted outputs (k-way) to the output, the parts are left empty. Empty pointers are skipped.
+	 * @param parts sorted outputs, e.g. the segments of a channel
+	 * @param out output - sorted records of all parts, the previous records are removed
+	 */
+	static void Merge(std::vector<std::unique_ptr<CDetectorOutput> >& parts, CDetectorOutput& out);
+
+	/**
+	 * Stable sort of the records by the position and the channel.
+	 */
+	void Sort();
+
+	/**
+	 * Returns true if the records are sorted by the position and the channel.
+	 */
+	bool IsSorted() const;
+
+	/**
+	 * Erase the records for which the predicate returns true, the order of the other records is kept. The predicate gets
+	 * the index of the record and may read only this record (the previous ones are already moved).
+	 * @param predicate predicate of the index of the record
+	 * @return count of erased records
+	 */
+	int RemoveIf(const std::function<bool(const int&)>& predicate);
+
 	/**
 	 * Erase records at positions.
-	 * @param pos position of records to erase.
+	 * @param pos position of records to erase, ascending.
 	 */
 	 void Remove(const std::vector<int>& pos);
+
+	/**
+	 * Find the records with the position in [t0, t1] in the sorted output.
+	 * @param t0 start of the range (second)
+	 * @param t1 end of the range (second)
+	 * @param first output - index of the first record in the range
+	 * @param last output - index behind the last record in the range
+	 */
+	void FindRange(const double& t0, const double& t1, int& first, int& last) const;
+
+	/**
+	 * Find the records of one channel with the position in [t0, t1] in the sorted output, by the index
+	 * of the channels (\ref BuildIndex) if it is built.
+	 * @param t0 start of the range (second)
+	 * @param t1 end of the range (second)
+	 * @param channel channel of the records (\ref m_chan)
+	 * @param records output - indexes of the records in the order of the position
+	 */
+	void FindRange(const double& t0, const double& t1, const int& channel, std::vector<int>& records) const;
+
+	/**
+	 * Build the index of the channels for \ref FindRange. The methods changing the records drop the index, the index
+	 * must be built again after the columns are changed directly.
+	 */
+	void BuildIndex();
+
+	/**
+	 * Returns count of records.
+	 */
+	inline int GetCount() const
+	{
+		return m_pos.size();
+	}
+
 private:
+	/**
+	 * Move the record to an other index.
+	 */
+	void moveRecord(const int& from, const int& to);
+
+	/**
+	 * Reorder the records, the record order[i] becomes the record i.
+	 */
+	void permute(const std::vector<int>& order);
 
 // variables
 public:
@@ -260,7 +572,8 @@ public:
 	/// statistical significance "PDF"
 	std::vector<double>  m_pdf;    
 private: 
-	/* none */
+	/// records of every channel in the order of the position, see \ref BuildIndex
+	std::map<int, std::vector<int> > m_channelIndex;
 };
 
 /**
@@ -281,12 +594,64 @@ public:
 	 */
 	virtual ~CDischarges();
 
+	/**
+	 * Reserve the vectors of all channels for records.
+	 * @param count count of records
+	 */
+	void Reserve(const size_t& count);
+
+	/**
+	 * Remove all records, the vectors keep their capacity.
+	 */
+	void Clear();
+
+	/**
+	 * Move the records of other discharges (the same count of channels) to this one, the other discharges are left empty.
+	 * Both must be sorted by the onset (\ref GetOnset) - spliced to the end or merged as \ref CDetectorOutput::Append.
+	 * @param other the discharges to append
+	 */
+	void Append(CDischarges&& other);
+
+	/**
+	 * Merge discharges sorted by the onset (k-way) to the discharges, the parts are left empty. Empty pointers are skipped.
+	 * @param parts sorted discharges with the same count of channels
+	 * @param out output - sorted records of all parts, the previous records are removed
+	 */
+	static void Merge(std::vector<std::unique_ptr<CDischarges> >& parts, CDischarges& out);
+
+	/**
+	 * Stable sort of the records by the onset.
+	 */
+	void Sort();
+
+	/**
+	 * Erase the records for which the predicate returns true, see \ref CDetectorOutput::RemoveIf.
+	 * @param predicate predicate of the index of the record
+	 * @return count of erased records
+	 */
+	int RemoveIf(const std::function<bool(const int&)>& predicate);
+
 	/**
 	 * Erase records at positions.
-	 * @param pos positions of record to erase.
+	 * @param pos positions of record to erase, ascending.
 	 */
 	 void Remove(const std::vector<int>& pos);
 
+	/**
+	 * Returns the onset of the record - the earliest position of the channels (NaN of a channel is skipped).
+	 * @param record index of the record
+	 * @return onset (second), INT_MAX if no channel has a position
+	 */
+	double GetOnset(const int& record) const;
+
+	/**
+	 * Returns count of records.
+	 */
+	inline int GetCount() const
+	{
+		return m_countChannels > 0 ? m_MP[0].size() : 0;
+	}
+
 	 /**
 	  *	Return count channels.
 	  * @return count channels.s
@@ -296,24 +661,33 @@ public:
 		return m_countChannels;
 	}
 private:
+	/**
+	 * Move the record of all channels to an other index.
+	 */
+	void moveRecord(const int& from, const int& to);
+
+	/**
+	 * Reorder the records, the record order[i] becomes the record i.
+	 */
+	void permute(const std::vector<int>& order);
 
 // variables
 public:
 	/// spike type 1-obvious, 0.5- ambiguous
-	std::vector<double>* m_MV;
+	std::vector<std::vector<double> > m_MV;
 	/// max. amplitude of envelope above backround
-	std::vector<double>* m_MA;
+	std::vector<std::vector<double> > m_MA;
 	/// event start position
-	std::vector<double>* m_MP;
+	std::vector<std::vector<double> > m_MP;
 	/// duration of event	   
-	std::vector<double>* m_MD;
+	std::vector<std::vector<double> > m_MD;
 	/// statistical significance "CDF"	   
-	std::vector<double>* m_MW;
+	std::vector<std::vector<double> > m_MW;
 	/// probability of occurence	   
-	std::vector<double>* m_MPDF;   
+	std::vector<std::vector<double> > m_MPDF;   
 private:
 	/// count channels
-	unsigned 			 m_countChannels; 
+	unsigned 			 			  m_countChannels; 
 };
 
 #endif
\ No newline at end of file
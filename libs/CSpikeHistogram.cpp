@@ -0,0 +1,130 @@
+#include "CSpikeHistogram.h"
+
+#include <cmath>
+
+using namespace std;
+
+/// A constructor.
+CSpikeHistogram::CSpikeHistogram()
+{
+	/* empty */
+}
+
+/// A virtual destructor.
+CSpikeHistogram::~CSpikeHistogram()
+{
+	/* empty */
+}
+
+/// Remove the counts of all channels.
+void CSpikeHistogram::Clear()
+{
+	m_counts.clear();
+}
+
+/// Remove the counts of one channel.
+void CSpikeHistogram::ClearChannel(const int& channel)
+{
+	m_counts.erase(channel);
+}
+
+/// Add detections of one channel.
+void CSpikeHistogram::Add(const int& channel, const CDetectorOutput& output)
+{
+	// the channel is listed also without detections
+	m_counts[channel].resize(HISTOGRAM_LEVELS);
+
+	for (size_t i = 0; i < output.m_pos.size(); i++)
+		Add(channel, output.m_pos[i]);
+}
+
+/// Add one detection.
+void CSpikeHistogram::Add(const int& channel, const double& position)
+{
+	vector<vector<int> >& levels = m_counts[channel];
+	long long             bin;
+	int                   level;
+
+	if (position < 0)
+		return;
+
+	levels.resize(HISTOGRAM_LEVELS);
+	for (level = 0; level < HISTOGRAM_LEVELS; level++)
+	{
+		bin = (long long)floor(position / GetBinWidth(level));
+		if (bin >= (long long)levels[level].size())
+			levels[level].resize(bin + 1, 0);
+
+		levels[level][bin]++;
+	}
+}
+
+/// Returns true if the channel has counts.
+bool CSpikeHistogram::HasChannel(const int& channel) const
+{
+	return m_counts.find(channel) != m_counts.end();
+}
+
+/// Returns the finest level which covers the range by at most countBins bins.
+int CSpikeHistogram::GetLevel(const double& t0, const double& t1, const int& countBins) const
+{
+	long long first, last;
+	int       level;
+
+	for (level = 0; level < HISTOGRAM_LEVELS - 1; level++)
+	{
+		GetBins(level, t0, t1, first, last);
+		if (last - first + 1 <= countBins)
+			break;
+	}
+
+	return level;
+}
+
+/// Returns width of the bins of the level.
+double CSpikeHistogram::GetBinWidth(const int& level) const
+{
+	return HISTOGRAM_BIN_WIDTH * pow((double)HISTOGRAM_LEVEL_FACTOR, level);
+}
+
+/// Returns the bins of the level which cover the time range.
+void CSpikeHistogram::GetBins(const int& level, const double& t0, const double& t1, long long& first, long long& last) const
+{
+	double width = GetBinWidth(level);
+
+	first = (long long)floor(max(t0, 0.0) / width);
+	last = (long long)floor(max(t1, 0.0) / width);
+	if (last < first)
+		last = first;
+}
+
+/// Returns counts of the channel in the bins [first, last] of the level.
+void CSpikeHistogram::GetCounts(const int& channel, const int& level, const long long& first, const long long& last, vector<int>& counts) const
+{
+	map<int, vector<vector<int> > >::const_iterator it = m_counts.find(channel);
+	long long                                       bin;
+
+	counts.assign(last - first + 1, 0);
+	if (it == m_counts.end() || level < 0 || level >= (int)it->second.size())
+		return;
+
+	const vector<int>& bins = it->second[level];
+	for (bin = max(first, 0LL); bin <= last && bin < (long long)bins.size(); bin++)
+		counts[bin - first] = bins[bin];
+}
+
+/// Returns count of the detections of the channel in the bins [first, last] of the level.
+long long CSpikeHistogram::GetCount(const int& channel, const int& level, const long long& first, const long long& last) const
+{
+	map<int, vector<vector<int> > >::const_iterator it = m_counts.find(channel);
+	long long                                       bin, count = 0;
+
+	if (it == m_counts.end() || level < 0 || level >= (int)it->second.size())
+		return 0;
+
+	const vector<int>& bins = it->second[level];
+	for (bin = max(first, 0LL); bin <= last && bin < (long long)bins.size(); bin++)
+		count += bins[bin];
+
+	return count;
+}
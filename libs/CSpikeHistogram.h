@@ -0,0 +1,110 @@
+#ifndef CSpikeHistogram_H
+#define CSpikeHistogram_H
+
+#include <vector>
+#include <map>
+
+#include "CSpikeDetector.h"
+
+/// Width of the bins of the finest level (second).
+#define HISTOGRAM_BIN_WIDTH 1.0
+/// Every level merges this count of bins of the previous level.
+#define HISTOGRAM_LEVEL_FACTOR 4
+/// Count of levels - the coarsest bins are 4^9 s (~73 hours) wide.
+#define HISTOGRAM_LEVELS 10
+
+/**
+ * Spike counts of the channels in time bins of several resolutions, the overview of a long recording.
+ * Level 0 has bins of \ref HISTOGRAM_BIN_WIDTH, every next level merges \ref HISTOGRAM_LEVEL_FACTOR bins of the
+ * previous one. The detections are added incrementally - one detection increments one bin of every level, a view of
+ * any length reads at most the requested count of bins of the level which fits it.
+ */
+class CSpikeHistogram
+{
+// methods
+public:
+	/**
+	 * A constructor.
+	 */
+	CSpikeHistogram();
+
+	/**
+	 * A virtual desctructor.
+	 */
+	virtual ~CSpikeHistogram();
+
+	/**
+	 * Remove the counts of all channels.
+	 */
+	void Clear();
+
+	/**
+	 * Remove the counts of one channel (before its detections are added again).
+	 * @param channel number of the channel
+	 */
+	void ClearChannel(const int& channel);
+
+	/**
+	 * Add detections of one channel to its bins.
+	 * @param channel number of the channel
+	 * @param output detections, all of them belong to the channel
+	 */
+	void Add(const int& channel, const CDetectorOutput& output);
+
+	/**
+	 * Add one detection.
+	 * @param channel number of the channel
+	 * @param position onset of the detection (second)
+	 */
+	void Add(const int& channel, const double& position);
+
+	/**
+	 * Returns true if the channel has counts.
+	 */
+	bool HasChannel(const int& channel) const;
+
+	/**
+	 * Returns the finest level which covers the time range by at most countBins bins, the coarsest level if none.
+	 * @param t0 start of the range (second)
+	 * @param t1 end of the range (second)
+	 * @param countBins the most bins
+	 */
+	int GetLevel(const double& t0, const double& t1, const int& countBins) const;
+
+	/**
+	 * Returns width of the bins of the level (second).
+	 */
+	double GetBinWidth(const int& level) const;
+
+	/**
+	 * Returns the bins of the level which cover the time range.
+	 * @param level level of the bins
+	 * @param t0 start of the range (second)
+	 * @param t1 end of the range (second)
+	 * @param first output - number of the first bin, it starts at first * \ref GetBinWidth
+	 * @param last output - number of the last bin
+	 */
+	void GetBins(const int& level, const double& t0, const double& t1, long long& first, long long& last) const;
+
+	/**
+	 * Returns counts of the channel in the bins [first, last] of the level, 0 for the bins without detections.
+	 * @param channel number of the channel
+	 * @param level level of the bins
+	 * @param first number of the first bin
+	 * @param last number of the last bin
+	 * @param counts output - last - first + 1 counts
+	 */
+	void GetCounts(const int& channel, const int& level, const long long& first, const long long& last, std::vector<int>& counts) const;
+
+	/**
+	 * Returns count of the detections of the channel in the bins [first, last] of the level.
+	 */
+	long long GetCount(const int& channel, const int& level, const long long& first, const long long& last) const;
+
+// variables
+private:
+	/// counts of the channels - levels, bins; the bins grow with the latest detection
+	std::map<int, std::vector<std::vector<int> > > m_counts;
+};
+
+#endif
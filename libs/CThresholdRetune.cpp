@@ -0,0 +1,170 @@
+#include "CThresholdRetune.h"
+#include "CDetectorArena.h"
+#include "CProfiler.h"
+
+#include <algorithm>
+
+using namespace std;
+
+/// A constructor.
+CThresholdRetune::CThresholdRetune(const DETECTOR_SETTINGS& settings)
+	: m_settings(settings), m_countThresholds(0), m_countMarkers(0)
+{
+	/* empty */
+}
+
+/// A virtual destructor.
+CThresholdRetune::~CThresholdRetune()
+{
+	/* empty */
+}
+
+/// The band-pass stream and its envelope.
+int CThresholdRetune::GetStreams() const
+{
+	return PIPELINE_BANDPASS | PIPELINE_ENVELOPE;
+}
+
+/// Forget the curves of the previous channel.
+void CThresholdRetune::BeginChannel(const int& /*channel*/, const int& countSegments)
+{
+	m_segments.clear();
+	m_segments.reserve(countSegments);
+}
+
+/// Keep the curves of one segment, the stages of CSpikeDetector::DetectSegment before the thresholds.
+void CThresholdRetune::ProcessSegment(const PIPELINE_SEGMENT& segment)
+{
+	PROFILE_SCOPE("CThresholdRetune::ProcessSegment");
+
+	CDetectorArena&   arena = CDetectorArena::GetThreadArena();
+	int               fs = segment.m_fs;
+	int               countRecords = segment.m_bandpass.size();
+
+	m_segments.push_back(RETUNE_SEGMENT(segment));
+	RETUNE_SEGMENT& kept = m_segments.back();
+
+	CSpikeDetector::GetWindowIndex(countRecords, m_settings.m_winsize * fs, m_settings.m_noverlap * fs, arena.m_index);
+	COneChannelDetect detector(&segment.m_bandpass, &m_settings, fs, &arena.m_index, 0);
+
+	if (segment.m_envelope.empty())
+		detector.Envelope(kept.m_envelope);
+	else kept.m_envelope.assign(segment.m_envelope.begin(), segment.m_envelope.end());
+
+	detector.WindowStatistics(kept.m_envelope, arena.m_phatMedian, arena.m_phatStd);
+	kept.m_valid = detector.LognormalCurves(kept.m_envelope, arena.m_phatMedian, arena.m_phatStd, kept.m_lognormal, kept.m_envelopeCdf,
+											kept.m_envelopePdf);
+}
+
+/// Detections of the kept segments for other k-values.
+void CThresholdRetune::Retune(const double& k1, const double& k2, const double& k3, unique_ptr<CDetectorOutput>& output,
+							  unique_ptr<CDischarges>& discharges)
+{
+	PROFILE_SCOPE("CThresholdRetune::Retune");
+
+	vector<DETECTOR_SETTINGS>            grid(1, m_settings);
+	vector<unique_ptr<CDetectorOutput> > outputs;
+	vector<unique_ptr<CDischarges> >     dischargesGrid;
+
+	grid[0].m_k1 = k1;
+	grid[0].m_k2 = k2;
+	grid[0].m_k3 = k3;
+
+	Sweep(grid, outputs, dischargesGrid);
+	output = std::move(outputs[0]);
+	discharges = std::move(dischargesGrid[0]);
+}
+
+/// Detections of the kept segments for every combination of the grid, the shared stages once.
+void CThresholdRetune::Sweep(const vector<DETECTOR_SETTINGS>& grid, vector<unique_ptr<CDetectorOutput> >& outputs,
+							 vector<unique_ptr<CDischarges> >& discharges)
+{
+	PROFILE_SCOPE("CThresholdRetune::Sweep");
+
+	vector<DETECTOR_SETTINGS>  settings(grid.size(), m_settings);
+	vector<int>                order(grid.size());
+	ONECHANNELDETECTRET&       result = CDetectorArena::GetThreadArena().m_result;
+	ONECHANNELDETECTRET *      ret;
+	const DETECTOR_SETTINGS *  thresholds;
+	const DETECTOR_SETTINGS *  markers;
+	bool                       valid = false;
+	size_t                     i, j;
+
+	m_countThresholds = 0;
+	m_countMarkers = 0;
+
+	// only the parameters of the stages after the lognormal fit are taken from the grid
+	for (j = 0; j < grid.size(); j++)
+	{
+		settings[j].m_k1 = grid[j].m_k1;
+		settings[j].m_k2 = grid[j].m_k2;
+		settings[j].m_k3 = grid[j].m_k3;
+		settings[j].m_polyspike_union_time = grid[j].m_polyspike_union_time;
+		settings[j].m_discharge_tol = grid[j].m_discharge_tol;
+		order[j] = j;
+	}
+
+	// the combinations with the same thresholds and then the same markers are neighbours
+	stable_sort(order.begin(), order.end(), [&settings](const int& a, const int& b) {
+		const DETECTOR_SETTINGS& x = settings[a];
+		const DETECTOR_SETTINGS& y = settings[b];
+		if (x.m_k1 != y.m_k1) return x.m_k1 < y.m_k1;
+		if (x.m_k2 != y.m_k2) return x.m_k2 < y.m_k2;
+		if (x.m_k3 != y.m_k3) return x.m_k3 < y.m_k3;
+		return x.m_polyspike_union_time < y.m_polyspike_union_time;
+	});
+
+	outputs.resize(grid.size());
+	discharges.resize(grid.size());
+	for (j = 0; j < grid.size(); j++)
+	{
+		outputs[j].reset(new CDetectorOutput());
+		discharges[j].reset(new CDischarges(1));
+	}
+
+	for (i = 0; i < m_segments.size(); i++)
+	{
+		RETUNE_SEGMENT& kept = m_segments[i];
+
+		// the kept curves are lent to the result of the arena
+		result.m_envelope.swap(kept.m_envelope);
+		result.m_envelopeCdf.swap(kept.m_envelopeCdf);
+		result.m_envelopePdf.swap(kept.m_envelopePdf);
+
+		thresholds = NULL;
+		markers = NULL;
+		for (j = 0; j < order.size(); j++)
+		{
+			DETECTOR_SETTINGS&          current = settings[order[j]];
+			CSpikeDetector              detector(NULL, &current);
+			unique_ptr<CDetectorOutput> subOut;
+			unique_ptr<CDischarges>     subDischarges;
+
+			if (thresholds == NULL || thresholds->m_k1 != current.m_k1 || thresholds->m_k2 != current.m_k2 || thresholds->m_k3 != current.m_k3)
+			{
+				COneChannelDetect::ThresholdCurves(kept.m_lognormal, current, result.m_prahInt);
+				thresholds = &current;
+				markers = NULL;
+				m_countThresholds++;
+			}
+
+			// the markers of the arena stay valid, the assembly only clears the edges of the segment
+			if (markers == NULL || markers->m_polyspike_union_time != current.m_polyspike_union_time)
+			{
+				COneChannelDetect marker(&result.m_envelope, &current, kept.m_fs, NULL, 0);
+				valid = kept.m_valid && marker.Markers(result);
+				markers = &current;
+				m_countMarkers++;
+			}
+
+			ret = valid ? &result : NULL;
+			detector.AssembleDetections(&ret, 1, result.m_envelope.size(), kept.m_fs, subOut, subDischarges);
+			detector.TrimSegment(kept.m_segment, kept.m_countSegments, kept.m_start, kept.m_stop, kept.m_inputFS, *subOut, *subDischarges);
+			CSpikeDetector::AppendSegment(*outputs[order[j]], *discharges[order[j]], std::move(*subOut), std::move(*subDischarges));
+		}
+
+		result.m_envelope.swap(kept.m_envelope);
+		result.m_envelopeCdf.swap(kept.m_envelopeCdf);
+		result.m_envelopePdf.swap(kept.m_envelopePdf);
+	}
+}
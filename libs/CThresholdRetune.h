@@ -0,0 +1,147 @@
+#ifndef CThresholdRetune_H
+#define CThresholdRetune_H
+
+#include <vector>
+#include <memory>
+
+#include "Definitions.h"
+#include "CSpikeDetector.h"
+#include "CPipeline.h"
+
+/**
+ * The curves of one segment which do not depend on the k-values of the settings.
+ */
+typedef struct retuneSegment
+{
+public:
+	/// number of the segment
+	int                      m_segment;
+	/// count of segments of the channel
+	int                      m_countSegments;
+	/// start of the segment in the file (sample, the sample rate of the file)
+	SAMPLEINDEX              m_start;
+	/// end of the segment in the file
+	SAMPLEINDEX              m_stop;
+	/// sample rate of the file
+	int                      m_inputFS;
+	/// sample rate of the curves
+	int                      m_fs;
+	/// false if the lognormal curves can not be computed, the segment has no detections
+	bool                     m_valid;
+
+	/// Hilbert's envelope
+	std::vector<SIGNALTYPE>  m_envelope;
+	/// mode + median and mean - mode of the lognormal distribution (\ref COneChannelDetect::LognormalCurves)
+	std::vector<double>      m_lognormal[2];
+	/// CDF of the envelope
+	std::vector<double>      m_envelopeCdf;
+	/// PDF of the envelope
+	std::vector<double>      m_envelopePdf;
+
+	/// A constructor
+	retuneSegment(const PIPELINE_SEGMENT& segment)
+		: m_segment(segment.m_segment), m_countSegments(segment.m_countSegments), m_start(segment.m_start), m_stop(segment.m_stop),
+		m_inputFS(segment.m_inputFS), m_fs(segment.m_fs), m_valid(false)
+	{
+		/* empty */
+	}
+
+} RETUNE_SEGMENT;
+
+/**
+ * Retuning of the thresholds of the spike detector. The thresholds are k * (mode + median) - k3 * (mean - mode) of the
+ * lognormal fit of the envelope, the envelope and the fit do not depend on the k-values. The plugin of \ref CPipeline
+ * keeps the envelope and the lognormal curves of every segment of the last channel, \ref Retune derives the threshold
+ * curves, the markers, the spikes and the discharges for other k-values - the same detections as the whole detector
+ * with these k-values, without reading, filtering, the envelope and the window statistics.
+ *
+ * The curves take about 40 bytes per sample after decimation (about 30 MB per hour of a channel at 200 Hz).
+ */
+class CThresholdRetune : public CPipelineDetector
+{
+// methods
+public:
+	/**
+	 * A constructor.
+	 * @param settings settings of the detector, the stages of the pipeline must use the same settings
+	 */
+	CThresholdRetune(const DETECTOR_SETTINGS& settings);
+
+	/**
+	 * A virtual desctructor.
+	 */
+	virtual ~CThresholdRetune();
+
+	virtual int GetStreams() const;
+	virtual void BeginChannel(const int& channel, const int& countSegments);
+	virtual void ProcessSegment(const PIPELINE_SEGMENT& segment);
+
+	/**
+	 * Returns the settings of the detector, the k-values of the pipeline pass.
+	 */
+	inline const DETECTOR_SETTINGS& GetSettings() const
+	{
+		return m_settings;
+	}
+
+	/**
+	 * Returns count of the kept segments.
+	 */
+	inline int GetCountSegments() const
+	{
+		return m_segments.size();
+	}
+
+	/**
+	 * Detections of the kept segments for other k-values, positions in the file.
+	 * @param k1 threshold of the obvious spikes
+	 * @param k2 threshold of the ambiguous spikes, equal to k1 - none
+	 * @param k3 weight of the asymmetry of the lognormal distribution
+	 * @param output output - detections
+	 * @param discharges output - discharges
+	 */
+	void Retune(const double& k1, const double& k2, const double& k3, std::unique_ptr<CDetectorOutput>& output,
+				std::unique_ptr<CDischarges>& discharges);
+
+	/**
+	 * Detections of the kept segments for every combination of a parameter grid, positions in the file. The grid takes
+	 * k1, k2, k3, m_polyspike_union_time and m_discharge_tol, the other parameters are the settings of the pipeline pass.
+	 * The combinations are visited in the order of these parameters - the threshold curves are computed once per (k1, k2, k3)
+	 * and segment, the markers once per polyspike union time, only the assembly of the discharges runs for every combination.
+	 * The detections of every combination equal the whole detector with its parameters.
+	 * @param grid parameters of the combinations
+	 * @param outputs output - detections of the combinations, in the order of the grid
+	 * @param discharges output - discharges of the combinations
+	 */
+	void Sweep(const std::vector<DETECTOR_SETTINGS>& grid, std::vector<std::unique_ptr<CDetectorOutput> >& outputs,
+			   std::vector<std::unique_ptr<CDischarges> >& discharges);
+
+	/**
+	 * Returns count of the threshold curves computed by the last \ref Sweep (all segments).
+	 */
+	inline int GetCountThresholds() const
+	{
+		return m_countThresholds;
+	}
+
+	/**
+	 * Returns count of the marker passes of the last \ref Sweep (all segments).
+	 */
+	inline int GetCountMarkers() const
+	{
+		return m_countMarkers;
+	}
+
+// variables
+private:
+	/// settings of the detector
+	DETECTOR_SETTINGS             m_settings;
+	/// the curves of the segments of the channel
+	std::vector<RETUNE_SEGMENT>   m_segments;
+	/// count of the threshold curves of the last sweep
+	int                           m_countThresholds;
+	/// count of the marker passes of the last sweep
+	int                           m_countMarkers;
+};
+
+#endif
@@ -0,0 +1,264 @@
+#include "CWaveforms.h"
+#include "CParallel.h"
+#include "CProfiler.h"
+
+#include "lib/Eigen/Dense"
+#include "lib/Alglib/dataanalysis.h"
+
+#include <algorithm>
+#include <numeric>
+#include <cmath>
+#include <memory>
+
+using namespace std;
+
+/// A constructor.
+CWaveforms::CWaveforms(CInputEDF * model, const WAVEFORM_SETTINGS& settings)
+	: m_model(model), m_settings(settings)
+{
+	if (m_settings.m_before < 0 || m_settings.m_after <= 0 || m_settings.m_align < 0 || m_settings.m_components < 1
+		|| m_settings.m_clusters < 1 || m_settings.m_restarts < 1 || m_settings.m_maxIterations < 0)
+		throw "Waveforms: invalid settings.";
+}
+
+/// A virtual destructor.
+CWaveforms::~CWaveforms()
+{
+	/* empty */
+}
+
+/// Waveforms, features and clusters of more channels, one channel per task.
+void CWaveforms::Analyse(const vector<int>& channels, const vector<const vector<double>*>& positions, vector<WAVEFORM_CLUSTERS>& out,
+						 const int& workers)
+{
+	PROFILE_SCOPE("CWaveforms::Analyse");
+
+	if (positions.size() != channels.size())
+		throw "Waveforms: count of the channels and of the positions differ.";
+
+	out.assign(channels.size(), WAVEFORM_CLUSTERS());
+
+	CParallel::Run(channels.size(), workers, [&](int i) {
+		static const vector<double> none;
+
+		Extract(channels[i], positions[i] ? *positions[i] : none, out[i]);
+		Features(out[i]);
+		Cluster(out[i]);
+	});
+}
+
+/// Waveforms of one channel, the windows of the spikes read by vectored reads.
+void CWaveforms::Extract(const int& channel, const vector<double>& positions, WAVEFORM_CLUSTERS& out)
+{
+	PROFILE_SCOPE("CWaveforms::Extract");
+
+	int                  fs = m_model->GetFS(channel);
+	SAMPLEINDEX          countSamples = m_model->GetCountSamples(channel);
+	size_t               count = positions.size();
+	vector<SAMPLEINDEX>  centers(count);
+	vector<size_t>       order(count);
+	vector<READ_WINDOW>  windows;
+	vector<SIGNALTYPE>   samples;
+	SAMPLEINDEX          before, after, align, length, first, start, stop, peak, k;
+	size_t               i, j, s;
+	double               mean, deviation;
+
+	if (fs <= 0)
+		throw "Waveforms: invalid channel number.";
+
+	before = (SAMPLEINDEX)round(m_settings.m_before * fs);
+	after = max(1LL, (SAMPLEINDEX)round(m_settings.m_after * fs));
+	align = (SAMPLEINDEX)round(m_settings.m_align * fs);
+	length = 2 * align + before + after;
+
+	out = WAVEFORM_CLUSTERS();
+	out.m_fs = fs;
+	out.m_length = before + after;
+	out.m_peaks.resize(count);
+	out.m_waveforms.assign(count * out.m_length, 0);
+
+	for (i = 0; i < count; i++)
+		centers[i] = (SAMPLEINDEX)round(positions[i] * fs);
+
+	// the windows in the order of the file, the neighbouring ones of one read share their data records
+	iota(order.begin(), order.end(), 0);
+	stable_sort(order.begin(), order.end(), [&centers](const size_t& a, const size_t& b) { return centers[a] < centers[b]; });
+
+	for (i = 0; i < count; i = j)
+	{
+		j = min(count, i + WAVEFORM_READ_WINDOWS);
+
+		// the searched window of every spike, zeros outside the channel
+		samples.assign((j - i) * length, 0);
+		windows.clear();
+		for (s = i; s < j; s++)
+		{
+			first = centers[order[s]] - align - before;
+			start = min(max(0LL, first), countSamples);
+			stop = max(min(first + length, countSamples), start);
+			if (stop > start)
+				windows.push_back(READ_WINDOW(channel, start, stop - start, samples.data() + (s - i) * length + (start - first)));
+		}
+
+		m_model->ReadWindows(windows);
+		out.m_countReads++;
+
+		for (s = i; s < j; s++)
+		{
+			const SIGNALTYPE * window = samples.data() + (s - i) * length;
+			double *           row = out.m_waveforms.data() + order[s] * out.m_length;
+
+			// the peak - the largest deviation from the mean of the searched window
+			mean = 0;
+			for (k = 0; k < length; k++)
+				mean += window[k];
+			mean /= length;
+
+			peak = align;
+			deviation = -1;
+			for (k = before; k <= before + 2 * align; k++)
+			{
+				if (fabs(window[k] - mean) > deviation)
+				{
+					deviation = fabs(window[k] - mean);
+					peak = k - before;
+				}
+			}
+
+			// the waveform around the peak - within the searched window
+			mean = 0;
+			for (k = 0; k < out.m_length; k++)
+			{
+				row[k] = window[peak + k];
+				mean += row[k];
+			}
+			mean /= out.m_length;
+			for (k = 0; k < out.m_length; k++)
+				row[k] -= mean;
+
+			out.m_peaks[order[s]] = centers[order[s]] - align + peak;
+		}
+	}
+}
+
+/// Projection of the waveforms to the principal components of their covariance.
+void CWaveforms::Features(WAVEFORM_CLUSTERS& out) const
+{
+	PROFILE_SCOPE("CWaveforms::Features");
+
+	typedef Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> ROWMATRIX;
+
+	int    count = out.m_peaks.size();
+	int    length = out.m_length;
+	int    components = min(m_settings.m_components, length);
+	int    stride = max(1, count / WAVEFORM_PCA_SAMPLES);
+	int    countSampled = (count + stride - 1) / stride;
+	int    i, j;
+
+	out.m_countFeatures = components;
+	out.m_features.clear();
+	out.m_variance.clear();
+	if (count == 0)
+		return;
+
+	Eigen::Map<const ROWMATRIX> waveforms(out.m_waveforms.data(), count, length);
+	ROWMATRIX                   sampled(countSampled, length);
+
+	for (i = 0; i < countSampled; i++)
+		sampled.row(i) = waveforms.row(i * stride);
+
+	Eigen::RowVectorXd mean = sampled.colwise().mean();
+	sampled.rowwise() -= mean;
+
+	Eigen::MatrixXd covariance = sampled.transpose() * sampled / max(1, countSampled - 1);
+	Eigen::SelfAdjointEigenSolver<Eigen::MatrixXd> solver(covariance);
+	if (solver.info() != Eigen::Success)
+		throw "Waveforms: principal components failed.";
+
+	// the eigenvalues are ascending, the sign of a component makes its largest coefficient positive
+	Eigen::MatrixXd basis(length, components);
+	out.m_variance.resize(components);
+	for (j = 0; j < components; j++)
+	{
+		Eigen::DenseIndex largest;
+
+		basis.col(j) = solver.eigenvectors().col(length - 1 - j);
+		basis.col(j).cwiseAbs().maxCoeff(&largest);
+		if (basis(largest, j) < 0)
+			basis.col(j) = -basis.col(j);
+		out.m_variance[j] = max(0.0, solver.eigenvalues()(length - 1 - j));
+	}
+
+	out.m_features.resize((size_t)count * components);
+	Eigen::Map<ROWMATRIX> features(out.m_features.data(), count, components);
+	features.noalias() = (waveforms.rowwise() - mean) * basis;
+}
+
+/// K-means of the features, the clusters renumbered by their size.
+void CWaveforms::Cluster(WAVEFORM_CLUSTERS& out) const
+{
+	PROFILE_SCOPE("CWaveforms::Cluster");
+
+	int    count = out.m_peaks.size();
+	int    clusters = min(m_settings.m_clusters, count);
+	int    i, j, k;
+
+	out.m_labels.assign(count, 0);
+	out.m_centers.clear();
+	out.m_sizes.clear();
+	if (count == 0 || out.m_countFeatures == 0)
+		return;
+
+	alglib::real_2d_array    xy;
+	alglib::clusterizerstate state;
+	alglib::kmeansreport     report;
+
+	xy.setcontent(count, out.m_countFeatures, out.m_features.data());
+
+	try
+	{
+		alglib::clusterizercreate(state);
+		alglib::clusterizersetpoints(state, xy, 2);
+		alglib::clusterizersetkmeanslimits(state, m_settings.m_restarts, m_settings.m_maxIterations);
+		alglib::clusterizerrunkmeans(state, clusters, report);
+	}
+	catch (alglib::ap_error)
+	{
+		throw "Waveforms: k-means failed.";
+	}
+
+	if (report.terminationtype < 0)
+		throw "Waveforms: k-means failed.";
+
+	// the largest cluster first, the labels do not depend on the numbering of k-means
+	vector<int> sizes(clusters, 0), order(clusters), rank(clusters);
+	for (i = 0; i < count; i++)
+		sizes[report.cidx[i]]++;
+
+	iota(order.begin(), order.end(), 0);
+	stable_sort(order.begin(), order.end(), [&sizes](const int& a, const int& b) { return sizes[a] > sizes[b]; });
+	for (k = 0; k < clusters; k++)
+		rank[order[k]] = k;
+
+	out.m_sizes.resize(clusters);
+	out.m_centers.assign((size_t)clusters * out.m_length, 0);
+	for (k = 0; k < clusters; k++)
+		out.m_sizes[k] = sizes[order[k]];
+
+	for (i = 0; i < count; i++)
+	{
+		const double * row = out.m_waveforms.data() + (size_t)i * out.m_length;
+		double *       center;
+
+		out.m_labels[i] = rank[report.cidx[i]];
+		center = out.m_centers.data() + (size_t)out.m_labels[i] * out.m_length;
+		for (j = 0; j < out.m_length; j++)
+			center[j] += row[j];
+	}
+
+	for (k = 0; k < clusters; k++)
+	{
+		for (j = 0; j < out.m_length; j++)
+			out.m_centers[(size_t)k * out.m_length + j] /= max(1, out.m_sizes[k]);
+	}
+}
@@ -0,0 +1,147 @@
+#ifndef CWaveforms_H
+#define CWaveforms_H
+
+#include <vector>
+
+#include "Definitions.h"
+#include "CInputEDF.h"
+#include "CSpikeDetector.h"
+
+/// The windows of at most this count of spikes are read by one vectored read, the memory of the windows.
+#define WAVEFORM_READ_WINDOWS 1024
+/// The principal components are estimated from at most this count of waveforms, evenly chosen.
+#define WAVEFORM_PCA_SAMPLES 10000
+
+/**
+ * Settings of the extraction and clustering of the waveforms.
+ */
+typedef struct waveformSettings
+{
+public:
+	/// length of the waveform before the peak (second)
+	double    m_before;
+	/// length of the waveform after the peak (second)
+	double    m_after;
+	/// the peak is searched within this distance of the detection (second)
+	double    m_align;
+	/// count of the principal components - the features of the clustering
+	int       m_components;
+	/// count of the clusters
+	int       m_clusters;
+	/// count of the restarts of k-means
+	int       m_restarts;
+	/// the largest count of the iterations of k-means, 0 - until convergence
+	int       m_maxIterations;
+
+	/// A constructor
+	waveformSettings(const double& before = 0.05, const double& after = 0.1, const double& align = 0.01, const int& components = 3,
+					 const int& clusters = 3, const int& restarts = 5, const int& maxIterations = 0)
+		: m_before(before), m_after(after), m_align(align), m_components(components), m_clusters(clusters),
+		  m_restarts(restarts), m_maxIterations(maxIterations)
+	{
+		/* empty */
+	}
+} WAVEFORM_SETTINGS;
+
+/**
+ * Waveforms of the spikes of one channel, their features and clusters. All vectors are in the order of the spikes.
+ */
+typedef struct waveformClusters
+{
+public:
+	/// sample rate of the channel
+	int                       m_fs;
+	/// count of the samples of one waveform
+	int                       m_length;
+	/// count of the features of one waveform
+	int                       m_countFeatures;
+	/// position of the peak of every waveform (sample)
+	std::vector<SAMPLEINDEX>  m_peaks;
+	/// the waveforms without their mean, one row of m_length samples per spike
+	std::vector<double>       m_waveforms;
+	/// projection of the waveforms to the principal components, one row of m_countFeatures per spike
+	std::vector<double>       m_features;
+	/// variance of the principal components
+	std::vector<double>       m_variance;
+	/// cluster of every waveform, the clusters are ordered by their size
+	std::vector<int>          m_labels;
+	/// mean waveform of every cluster, one row of m_length samples per cluster
+	std::vector<double>       m_centers;
+	/// count of the waveforms of every cluster
+	std::vector<int>          m_sizes;
+	/// count of the vectored reads of the channel (\ref CInputEDF::ReadWindows)
+	int                       m_countReads;
+
+	/// A constructor
+	waveformClusters() : m_fs(0), m_length(0), m_countFeatures(0), m_countReads(0)
+	{
+		/* empty */
+	}
+} WAVEFORM_CLUSTERS;
+
+/**
+ * Waveforms of the detected spikes and their clusters by the shape.
+ *
+ * The windows of the spikes are sorted and read by \ref CInputEDF::ReadWindows, at most \ref WAVEFORM_READ_WINDOWS
+ * at once - the close ones by a few long reads of whole data records instead of one read per spike. Every waveform is
+ * aligned to its largest deviation from the mean near the detection and copied to one matrix, a row per spike. The
+ * features are the principal components of the waveforms (Eigen, the basis from at most \ref WAVEFORM_PCA_SAMPLES
+ * waveforms), the clusters are k-means of the features (Alglib).
+ *
+ * The channels are processed in parallel (\ref Analyse).
+ */
+class CWaveforms
+{
+// methods
+public:
+	/**
+	 * A constructor.
+	 * @param model the open file, read by more threads at once
+	 * @param settings settings of the extraction and clustering
+	 */
+	CWaveforms(CInputEDF * model, const WAVEFORM_SETTINGS& settings = WAVEFORM_SETTINGS());
+
+	/**
+	 * A virtual desctructor.
+	 */
+	virtual ~CWaveforms();
+
+	/**
+	 * Waveforms, features and clusters of the spikes of more channels in parallel. Throws an error message.
+	 * @param channels the channels
+	 * @param positions positions of the spikes of every channel (second), e.g. \ref CDetectorOutput::m_pos
+	 * @param out output - one result per channel
+	 * @param workers count of threads, 0 - count of cores
+	 */
+	void Analyse(const std::vector<int>& channels, const std::vector<const std::vector<double>*>& positions,
+				 std::vector<WAVEFORM_CLUSTERS>& out, const int& workers = 0);
+
+	/**
+	 * Waveforms of the spikes of one channel, the previous content of the output is removed. Throws an error message.
+	 * @param channel the channel
+	 * @param positions positions of the spikes (second)
+	 * @param out output - the waveforms
+	 */
+	void Extract(const int& channel, const std::vector<double>& positions, WAVEFORM_CLUSTERS& out);
+
+	/**
+	 * The principal components of the extracted waveforms.
+	 * @param out the waveforms, output - the features
+	 */
+	void Features(WAVEFORM_CLUSTERS& out) const;
+
+	/**
+	 * K-means clusters of the features.
+	 * @param out the waveforms and features, output - the clusters
+	 */
+	void Cluster(WAVEFORM_CLUSTERS& out) const;
+
+// variables
+private:
+	/// the open file
+	CInputEDF *          m_model;
+	/// settings of the extraction and clustering
+	WAVEFORM_SETTINGS    m_settings;
+};
+
+#endif
@@ -3,6 +3,9 @@
 
 typedef float SIGNALTYPE;
 
+/// Index or count of samples in one channel - 64 bit, long recordings at high sample rates have more than 2^31 samples.
+typedef long long SAMPLEINDEX;
+
 /// Definition bandwidth - upper and lower limits of filtering.
 typedef struct bandwidth
 {
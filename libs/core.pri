@@ -0,0 +1,80 @@
+#-------------------------------------------------
+#
+# Qt-free core of the spike detector: EDF input, DSP and the detector.
+# Shared by edf-core.pro and the command-line tools.
+#
+#-------------------------------------------------
+
+CONFIG += c++11
+
+INCLUDEPATH += $$PWD
+
+# 64-bit file offsets for edflib (fopen64, pread64)
+DEFINES += _LARGEFILE64_SOURCE _LARGEFILE_SOURCE
+
+# instrumentation of the detector (CProfiler), qmake CONFIG+=edf_profile
+edf_profile: DEFINES += EDF_PROFILE
+
+CORE_SOURCES = $$PWD/edflib.c \
+    $$PWD/CInputEDF.cpp \
+    $$PWD/CDSP.cpp \
+    $$PWD/CSpikeDetector.cpp \
+    $$PWD/CBatchScheduler.cpp \
+    $$PWD/CProfiler.cpp \
+    $$PWD/CDetectionCache.cpp \
+    $$PWD/CPipeline.cpp \
+    $$PWD/CDetectorArena.cpp \
+    $$PWD/CSpikeHistogram.cpp \
+    $$PWD/CThresholdRetune.cpp \
+    $$PWD/CPageCache.cpp \
+    $$PWD/CMontage.cpp \
+    $$PWD/CParallel.cpp \
+    $$PWD/CSpectrum.cpp \
+    $$PWD/CPropagation.cpp \
+    $$PWD/CCoactivation.cpp \
+    $$PWD/CWaveforms.cpp \
+    $$PWD/lib/Alglib/alglibinternal.cpp \
+    $$PWD/lib/Alglib/alglibmisc.cpp \
+    $$PWD/lib/Alglib/ap.cpp \
+    $$PWD/lib/Alglib/dataanalysis.cpp \
+    $$PWD/lib/Alglib/diffequations.cpp \
+    $$PWD/lib/Alglib/fasttransforms.cpp \
+    $$PWD/lib/Alglib/integration.cpp \
+    $$PWD/lib/Alglib/interpolation.cpp \
+    $$PWD/lib/Alglib/linalg.cpp \
+    $$PWD/lib/Alglib/optimization.cpp \
+    $$PWD/lib/Alglib/solvers.cpp \
+    $$PWD/lib/Alglib/specialfunctions.cpp \
+    $$PWD/lib/Alglib/statistics.cpp
+
+CORE_HEADERS = $$PWD/edflib.h \
+    $$PWD/Definitions.h \
+    $$PWD/CInputEDF.h \
+    $$PWD/CDSP.h \
+    $$PWD/CSpikeDetector.h \
+    $$PWD/CBatchScheduler.h \
+    $$PWD/CProfiler.h \
+    $$PWD/CDetectionCache.h \
+    $$PWD/CPipeline.h \
+    $$PWD/CDetectorArena.h \
+    $$PWD/CSpikeHistogram.h \
+    $$PWD/CThresholdRetune.h \
+    $$PWD/CPageCache.h \
+    $$PWD/CMontage.h \
+    $$PWD/CParallel.h \
+    $$PWD/CSpectrum.h \
+    $$PWD/CPropagation.h \
+    $$PWD/CCoactivation.h \
+    $$PWD/CWaveforms.h
+
+QMAKE_CXXFLAGS += -fopenmp
+LIBS += -fopenmp
+
+# libsamplerate - the bundled build on Windows, elsewhere the system library found by pkg-config
+win32 {
+    LIBS += -L$$PWD -lsamplerate
+} else {
+    CONFIG += link_pkgconfig
+    !packagesExist(samplerate): error("libsamplerate not found - install its development package (libsamplerate0-dev, libsamplerate-devel) or add its .pc file to PKG_CONFIG_PATH")
+    PKGCONFIG += samplerate
+}
@@ -40,7 +40,10 @@
 
 
 #define EDFLIB_VERSION 111
-#define EDFLIB_MAXFILES 64
+#define EDFLIB_MAXFILES 65536
+
+/* the handle table is allocated in chunks, a chunk never moves once allocated */
+#define EDFLIB_HANDLE_CHUNKSZ 256
 
 
 #if defined(__APPLE__) || defined(__MACH__) || defined(__APPLE_CC__)
@@ -74,6 +77,60 @@
 #endif
 
 
+#ifdef _WIN32
+
+#include <windows.h>
+#include <io.h>
+
+#else
+
+#include <unistd.h>
+#include <pthread.h>
+
+#endif
+
+
+#if defined(_WIN32) && !defined(__MINGW32__)
+
+static SRWLOCK edflib_handle_lock = SRWLOCK_INIT;
+
+#define edflib_lock() AcquireSRWLockExclusive(&edflib_handle_lock)
+#define edflib_unlock() ReleaseSRWLockExclusive(&edflib_handle_lock)
+
+#elif defined(_WIN32)
+
+static CRITICAL_SECTION edflib_handle_lock;
+static volatile LONG edflib_handle_lock_state = 0;
+
+static void edflib_lock(void)
+{
+  if(InterlockedCompareExchange(&edflib_handle_lock_state, 1, 0) == 0)
+  {
+    InitializeCriticalSection(&edflib_handle_lock);
+
+    edflib_handle_lock_state = 2;
+  }
+
+  while(edflib_handle_lock_state != 2)
+  {
+    Sleep(0);
+  }
+
+  EnterCriticalSection(&edflib_handle_lock);
+}
+
+#define edflib_unlock() LeaveCriticalSection(&edflib_handle_lock)
+
+#else
+
+static pthread_mutex_t edflib_handle_lock = PTHREAD_MUTEX_INITIALIZER;
+
+#define edflib_lock() pthread_mutex_lock(&edflib_handle_lock)
+#define edflib_unlock() pthread_mutex_unlock(&edflib_handle_lock)
+
+#endif
+
+
 
 /* max size of annotationtext */
 #define EDFLIB_WRITE_MAX_ANNOTATION_LEN 40
@@ -83,6 +140,12 @@
 
 #define EDFLIB_ANNOT_MEMBLOCKSZ 1000
 
+/* the ranges of a vectored read at most this apart are read together, reading the gap is cheaper than another read */
+#define EDFLIB_VEC_GAP_BYTES 65536
+
+/* the largest positional read of a vectored read */
+#define EDFLIB_VEC_MAX_BYTES 4194304
+
 
 struct edfparamblock{
         char   label[17];
@@ -102,6 +165,20 @@ struct edfparamblock{
         long long sample_pntr;
       };
 
+struct edf_annotationblock{
+        long long onset;
+        char duration[16];
+        char annotation[EDFLIB_MAX_ANNOTATION_LEN + 1];
+       };
+
+
+struct edf_write_annotationblock{
+        long long onset;
+        long long duration;
+        char annotation[EDFLIB_WRITE_MAX_ANNOTATION_LEN + 1];
+       };
+
+
 struct edfhdrblock{
         FILE      *file_hdl;
         char      path[1024];
@@ -148,32 +225,35 @@ struct edfhdrblock{
         int       total_annot_bytes;
         int       eq_sf;
         struct edfparamblock *edfparam;
+        struct edf_annotationblock *annotationslist;
+        struct edf_write_annotationblock *write_annotationslist;
       };
 
 
-static struct edf_annotationblock{
-        long long onset;
-        char duration[16];
-        char annotation[EDFLIB_MAX_ANNOTATION_LEN + 1];
-       } *annotationslist[EDFLIB_MAXFILES];
-
-
-static struct edf_write_annotationblock{
-        long long onset;
-        long long duration;
-        char annotation[EDFLIB_WRITE_MAX_ANNOTATION_LEN + 1];
-       } *write_annotationslist[EDFLIB_MAXFILES];
-
 static int edf_files_open=0;
 
-static struct edfhdrblock *hdrlist[EDFLIB_MAXFILES];
+/* two level table: chunk, slot in the chunk */
+/* opening and closing of files is guarded by edflib_handle_lock, */
+/* reading an open handle does not lock */
+static struct edfhdrblock **hdrlist[EDFLIB_MAXFILES / EDFLIB_HANDLE_CHUNKSZ];
+
+static int hdrlist_chunks=0;
 
 
 static struct edfhdrblock * edflib_check_edf_file(FILE *, int *);
+static struct edfhdrblock * edflib_hdr(int);
+static int edflib_add_hdr(struct edfhdrblock *);
+static int edflib_find_path(const char *);
+static int edfclose_file_locked(int);
+static int edfopen_file_writeonly_locked(const char *, int, int);
+static long long edflib_pread(struct edfhdrblock *, void *, long long, long long);
+static long long edflib_read_samples_at(int, int, long long, long long, double *, int *);
+static int edflib_vec_compare(const void *, const void *);
+static void edflib_vec_decode(struct edfhdrblock *, struct edf_read_request_struct *, long long, long long, long long, unsigned char *);
 static int edflib_is_integer_number(char *);
 static int edflib_is_number(char *);
 static long long edflib_get_long_duration(char *);
-static int edflib_get_annotations(struct edfhdrblock *, int, int);
+static int edflib_get_annotations(struct edfhdrblock *, FILE *, int, long long, long long, edf_annotation_callback, void *, long long *);
 static int edflib_is_duration_number(char *);
 static int edflib_is_onset_number(char *);
 static long long edflib_get_long_time(char *);
@@ -197,21 +277,17 @@ static int edflib_fprint_ll_number_nonlocalized(FILE *, long long, int, int);
 
 int edflib_is_file_used(const char *path)
 {
-  int i, file_used=0;
+  int file_used=0;
 
-  for(i=0; i<EDFLIB_MAXFILES; i++)
-  {
-    if(hdrlist[i]!=NULL)
-    {
-      if(!(strcmp(path, hdrlist[i]->path)))
-      {
-        file_used = 1;
+  edflib_lock();
 
-        break;
-      }
-    }
+  if(edflib_find_path(path)>=0)
+  {
+    file_used = 1;
   }
 
+  edflib_unlock();
+
   return(file_used);
 }
 
@@ -226,11 +302,93 @@ int edflib_get_handle(int file_number)
 {
   int i, file_count=0;
 
-  for(i=0; i<EDFLIB_MAXFILES; i++)
+  edflib_lock();
+
+  for(i=0; i<hdrlist_chunks * EDFLIB_HANDLE_CHUNKSZ; i++)
   {
-    if(hdrlist[i]!=NULL)
+    if(edflib_hdr(i)!=NULL)
     {
       if(file_count++ == file_number)
+      {
+        edflib_unlock();
+
+        return(i);
+      }
+    }
+  }
+
+  edflib_unlock();
+
+  return(-1);
+}
+
+
+/* returns the header of an open handle or NULL, does not lock */
+static struct edfhdrblock * edflib_hdr(int handle)
+{
+  struct edfhdrblock **chunk;
+
+  if((handle<0)||(handle>=EDFLIB_MAXFILES))
+  {
+    return(NULL);
+  }
+
+  chunk = hdrlist[handle / EDFLIB_HANDLE_CHUNKSZ];
+  if(chunk==NULL)
+  {
+    return(NULL);
+  }
+
+  return(chunk[handle % EDFLIB_HANDLE_CHUNKSZ]);
+}
+
+
+/* stores the header in the first free slot and returns its handle, */
+/* -1 when the table is full or a chunk can not be allocated, call with edflib_handle_lock held */
+static int edflib_add_hdr(struct edfhdrblock *hdr)
+{
+  int i;
+
+  for(i=0; i<EDFLIB_MAXFILES; i++)
+  {
+    if(i>=hdrlist_chunks * EDFLIB_HANDLE_CHUNKSZ)
+    {
+      hdrlist[hdrlist_chunks] = (struct edfhdrblock **)calloc(EDFLIB_HANDLE_CHUNKSZ, sizeof(struct edfhdrblock *));
+      if(hdrlist[hdrlist_chunks]==NULL)
+      {
+        return(-1);
+      }
+
+      hdrlist_chunks++;
+    }
+
+    if(hdrlist[i / EDFLIB_HANDLE_CHUNKSZ][i % EDFLIB_HANDLE_CHUNKSZ]==NULL)
+    {
+      hdrlist[i / EDFLIB_HANDLE_CHUNKSZ][i % EDFLIB_HANDLE_CHUNKSZ] = hdr;
+
+      return(i);
+    }
+  }
+
+  return(-1);
+}
+
+
+/* returns the handle of the file opened with path or -1, call with edflib_handle_lock held */
+static int edflib_find_path(const char *path)
+{
+  int i;
+
+  struct edfhdrblock *hdr;
+
+
+  for(i=0; i<hdrlist_chunks * EDFLIB_HANDLE_CHUNKSZ; i++)
+  {
+    hdr = edflib_hdr(i);
+
+    if(hdr!=NULL)
+    {
+      if(!(strcmp(path, hdr->path)))
       {
         return(i);
       }
@@ -241,6 +399,8 @@ int edflib_get_handle(int file_number)
 }
 
 
+/* the header is parsed and the annotations read without the lock, */
+/* the lock is taken only to check the path and to store the header */
 int edfopen_file_readonly(const char *path, struct edf_hdr_struct *edfhdr, int read_annotations)
 {
   int i, j,
@@ -268,26 +428,13 @@ int edfopen_file_readonly(const char *path, struct edf_hdr_struct *edfhdr, int r
 
   memset(edfhdr, 0, sizeof(struct edf_hdr_struct));
 
-  if(edf_files_open>=EDFLIB_MAXFILES)
+  if(edflib_is_file_used(path))
   {
-    edfhdr->filetype = EDFLIB_MAXFILES_REACHED;
+    edfhdr->filetype = EDFLIB_FILE_ALREADY_OPENED;
 
     return(-1);
   }
 
-  for(i=0; i<EDFLIB_MAXFILES; i++)
-  {
-    if(hdrlist[i]!=NULL)
-    {
-      if(!(strcmp(path, hdrlist[i]->path)))
-      {
-        edfhdr->filetype = EDFLIB_FILE_ALREADY_OPENED;
-
-        return(-1);
-      }
-    }
-  }
-
   file = fopeno(path, "rb");
   if(file==NULL)
   {
@@ -320,18 +467,6 @@ int edfopen_file_readonly(const char *path, struct edf_hdr_struct *edfhdr, int r
 
   hdr->writemode = 0;
 
-  for(i=0; i<EDFLIB_MAXFILES; i++)
-  {
-    if(hdrlist[i]==NULL)
-    {
-      hdrlist[i] = hdr;
-
-      edfhdr->handle = i;
-
-      break;
-    }
-  }
-
   if((hdr->edf)&&(!(hdr->edfplus)))
   {
     edfhdr->filetype = EDFLIB_FILETYPE_EDF;
@@ -364,7 +499,7 @@ int edfopen_file_readonly(const char *path, struct edf_hdr_struct *edfhdr, int r
   edfhdr->datarecords_in_file = hdr->datarecords;
   edfhdr->datarecord_duration = hdr->long_data_record_duration;
 
-  annotationslist[edfhdr->handle] = NULL;
+  hdr->annotationslist = NULL;
 
   hdr->annotlist_sz = 0;
 
@@ -402,12 +537,13 @@ int edfopen_file_readonly(const char *path, struct edf_hdr_struct *edfhdr, int r
 
     if((read_annotations==EDFLIB_READ_ANNOTATIONS)||(read_annotations==EDFLIB_READ_ALL_ANNOTATIONS))
     {
-      if(edflib_get_annotations(hdr, edfhdr->handle, read_annotations))
+      if(edflib_get_annotations(hdr, file, read_annotations, 0LL, hdr->datarecords, NULL, NULL, NULL))
       {
         edfhdr->filetype = EDFLIB_FILE_CONTAINS_FORMAT_ERRORS;
 
         fclose(file);
 
+        free(hdr->annotationslist);
         free(hdr->edfparam);
         free(hdr);
 
@@ -420,8 +556,45 @@ int edfopen_file_readonly(const char *path, struct edf_hdr_struct *edfhdr, int r
 
   strcpy(hdr->path, path);
 
+  /* the same file could be opened by another thread meanwhile */
+  edflib_lock();
+
+  edfhdr->handle = -1;
+
+  if(edf_files_open>=EDFLIB_MAXFILES)
+  {
+    edfhdr->filetype = EDFLIB_MAXFILES_REACHED;
+  }
+  else if(edflib_find_path(path)>=0)
+  {
+    edfhdr->filetype = EDFLIB_FILE_ALREADY_OPENED;
+  }
+  else
+  {
+    edfhdr->handle = edflib_add_hdr(hdr);
+    if(edfhdr->handle<0)
+    {
+      edfhdr->filetype = EDFLIB_MAXFILES_REACHED;
+    }
+  }
+
+  if(edfhdr->handle<0)
+  {
+    edflib_unlock();
+
+    fclose(file);
+
+    free(hdr->annotationslist);
+    free(hdr->edfparam);
+    free(hdr);
+
+    return(-1);
+  }
+
   edf_files_open++;
 
+  edflib_unlock();
+
   j = 0;
 
   for(i=0; i<hdr->edfsignals; i++)
@@ -453,6 +626,20 @@ int edfopen_file_readonly(const char *path, struct edf_hdr_struct *edfhdr, int r
 
 
 int edfclose_file(int handle)
+{
+  int ret;
+
+  edflib_lock();
+
+  ret = edfclose_file_locked(handle);
+
+  edflib_unlock();
+
+  return(ret);
+}
+
+
+static int edfclose_file_locked(int handle)
 {
   struct edf_write_annotationblock *annot2;
 
@@ -478,12 +665,12 @@ int edfclose_file(int handle)
     return(-1);
   }
 
-  if(hdrlist[handle]==NULL)
+  if(edflib_hdr(handle)==NULL)
   {
     return(-1);
   }
 
-  hdr = hdrlist[handle];
+  hdr = edflib_hdr(handle);
 
   if(hdr->writemode)
   {
@@ -496,7 +683,7 @@ int edfclose_file(int handle)
 
       for(k=0; k<hdr->annots_in_file; k++)
       {
-        annot2 = write_annotationslist[handle] + k;
+        annot2 = edflib_hdr(handle)->write_annotationslist + k;
 
         p = edflib_fprint_ll_number_nonlocalized(hdr->file_hdl, (hdr->datarecords * hdr->long_data_record_duration) / EDFLIB_TIME_DIMENSION, 0, 1);
 
@@ -554,7 +741,7 @@ int edfclose_file(int handle)
 
     for(k=0; k<hdr->annots_in_file; k++)
     {
-      annot2 = write_annotationslist[handle] + k;
+      annot2 = edflib_hdr(handle)->write_annotationslist + k;
 
       p = 0;
 
@@ -639,11 +826,11 @@ int edfclose_file(int handle)
       }
     }
 
-    free(write_annotationslist[handle]);
+    free(hdr->write_annotationslist);
   }
   else
   {
-    free(annotationslist[handle]);
+    free(hdr->annotationslist);
   }
 
   fclose(hdr->file_hdl);
@@ -652,7 +839,7 @@ int edfclose_file(int handle)
 
   free(hdr);
 
-  hdrlist[handle] = NULL;
+  hdrlist[handle / EDFLIB_HANDLE_CHUNKSZ][handle % EDFLIB_HANDLE_CHUNKSZ] = NULL;
 
   edf_files_open--;
 
@@ -677,7 +864,7 @@ long long edfseek(int handle, int edfsignal, long long offset, int whence)
     return(-1);
   }
 
-  if(hdrlist[handle]==NULL)
+  if(edflib_hdr(handle)==NULL)
   {
     return(-1);
   }
@@ -687,47 +874,47 @@ long long edfseek(int handle, int edfsignal, long long offset, int whence)
     return(-1);
   }
 
-  if(hdrlist[handle]->writemode)
+  if(edflib_hdr(handle)->writemode)
   {
     return(-1);
   }
 
-  if(edfsignal>=(hdrlist[handle]->edfsignals - hdrlist[handle]->nr_annot_chns))
+  if(edfsignal>=(edflib_hdr(handle)->edfsignals - edflib_hdr(handle)->nr_annot_chns))
   {
     return(-1);
   }
 
-  channel = hdrlist[handle]->mapped_signals[edfsignal];
+  channel = edflib_hdr(handle)->mapped_signals[edfsignal];
 
-  smp_in_file = hdrlist[handle]->edfparam[channel].smp_per_record * hdrlist[handle]->datarecords;
+  smp_in_file = edflib_hdr(handle)->edfparam[channel].smp_per_record * edflib_hdr(handle)->datarecords;
 
   if(whence==EDFSEEK_SET)
   {
-    hdrlist[handle]->edfparam[channel].sample_pntr = offset;
+    edflib_hdr(handle)->edfparam[channel].sample_pntr = offset;
   }
 
   if(whence==EDFSEEK_CUR)
   {
-    hdrlist[handle]->edfparam[channel].sample_pntr += offset;
+    edflib_hdr(handle)->edfparam[channel].sample_pntr += offset;
   }
 
   if(whence==EDFSEEK_END)
   {
-    hdrlist[handle]->edfparam[channel].sample_pntr =
-      (hdrlist[handle]->edfparam[channel].smp_per_record * hdrlist[handle]->datarecords) + offset;
+    edflib_hdr(handle)->edfparam[channel].sample_pntr =
+      (edflib_hdr(handle)->edfparam[channel].smp_per_record * edflib_hdr(handle)->datarecords) + offset;
   }
 
-  if(hdrlist[handle]->edfparam[channel].sample_pntr > smp_in_file)
+  if(edflib_hdr(handle)->edfparam[channel].sample_pntr > smp_in_file)
   {
-    hdrlist[handle]->edfparam[channel].sample_pntr = smp_in_file;
+    edflib_hdr(handle)->edfparam[channel].sample_pntr = smp_in_file;
   }
 
-  if(hdrlist[handle]->edfparam[channel].sample_pntr < 0LL)
+  if(edflib_hdr(handle)->edfparam[channel].sample_pntr < 0LL)
   {
-    hdrlist[handle]->edfparam[channel].sample_pntr = 0LL;
+    edflib_hdr(handle)->edfparam[channel].sample_pntr = 0LL;
   }
 
-  return(hdrlist[handle]->edfparam[channel].sample_pntr);
+  return(edflib_hdr(handle)->edfparam[channel].sample_pntr);
 }
 
 
@@ -746,7 +933,7 @@ long long edftell(int handle, int edfsignal)
     return(-1);
   }
 
-  if(hdrlist[handle]==NULL)
+  if(edflib_hdr(handle)==NULL)
   {
     return(-1);
   }
@@ -756,19 +943,19 @@ long long edftell(int handle, int edfsignal)
     return(-1);
   }
 
-  if(hdrlist[handle]->writemode)
+  if(edflib_hdr(handle)->writemode)
   {
     return(-1);
   }
 
-  if(edfsignal>=(hdrlist[handle]->edfsignals - hdrlist[handle]->nr_annot_chns))
+  if(edfsignal>=(edflib_hdr(handle)->edfsignals - edflib_hdr(handle)->nr_annot_chns))
   {
     return(-1);
   }
 
-  channel = hdrlist[handle]->mapped_signals[edfsignal];
+  channel = edflib_hdr(handle)->mapped_signals[edfsignal];
 
-  return(hdrlist[handle]->edfparam[channel].sample_pntr);
+  return(edflib_hdr(handle)->edfparam[channel].sample_pntr);
 }
 
 
@@ -787,7 +974,7 @@ void edfrewind(int handle, int edfsignal)
     return;
   }
 
-  if(hdrlist[handle]==NULL)
+  if(edflib_hdr(handle)==NULL)
   {
     return;
   }
@@ -797,19 +984,19 @@ void edfrewind(int handle, int edfsignal)
     return;
   }
 
-  if(hdrlist[handle]->writemode)
+  if(edflib_hdr(handle)->writemode)
   {
     return;
   }
 
-  if(edfsignal>=(hdrlist[handle]->edfsignals - hdrlist[handle]->nr_annot_chns))
+  if(edfsignal>=(edflib_hdr(handle)->edfsignals - edflib_hdr(handle)->nr_annot_chns))
   {
     return;
   }
 
-  channel = hdrlist[handle]->mapped_signals[edfsignal];
+  channel = edflib_hdr(handle)->mapped_signals[edfsignal];
 
-  hdrlist[handle]->edfparam[channel].sample_pntr = 0LL;
+  edflib_hdr(handle)->edfparam[channel].sample_pntr = 0LL;
 }
 
 
@@ -852,7 +1039,7 @@ int edfread_physical_samples(int handle, int edfsignal, int n, double *buf)
     return(-1);
   }
 
-  if(hdrlist[handle]==NULL)
+  if(edflib_hdr(handle)==NULL)
   {
     return(-1);
   }
@@ -862,17 +1049,17 @@ int edfread_physical_samples(int handle, int edfsignal, int n, double *buf)
     return(-1);
   }
 
-  if(hdrlist[handle]->writemode)
+  if(edflib_hdr(handle)->writemode)
   {
     return(-1);
   }
 
-  if(edfsignal>=(hdrlist[handle]->edfsignals - hdrlist[handle]->nr_annot_chns))
+  if(edfsignal>=(edflib_hdr(handle)->edfsignals - edflib_hdr(handle)->nr_annot_chns))
   {
     return(-1);
   }
 
-  channel = hdrlist[handle]->mapped_signals[edfsignal];
+  channel = edflib_hdr(handle)->mapped_signals[edfsignal];
 
   if(n<0LL)
   {
@@ -884,7 +1071,7 @@ int edfread_physical_samples(int handle, int edfsignal, int n, double *buf)
     return(0LL);
   }
 
-  hdr = hdrlist[handle];
+  hdr = edflib_hdr(handle);
 
   if(hdr->edf)
   {
@@ -1015,168 +1202,775 @@ int edfread_digital_samples(int handle, int edfsignal, int n, int *buf)
 
   struct edfhdrblock *hdr;
 
-  union {
-          unsigned int one;
-          signed int one_signed;
-          unsigned short two[2];
-          signed short two_signed[2];
-          unsigned char four[4];
-        } var;
+  union {
+          unsigned int one;
+          signed int one_signed;
+          unsigned short two[2];
+          signed short two_signed[2];
+          unsigned char four[4];
+        } var;
+
+  FILE *file;
+
+
+  if(handle<0)
+  {
+    return(-1);
+  }
+
+  if(handle>=EDFLIB_MAXFILES)
+  {
+    return(-1);
+  }
+
+  if(edflib_hdr(handle)==NULL)
+  {
+    return(-1);
+  }
+
+  if(edfsignal<0)
+  {
+    return(-1);
+  }
+
+  if(edflib_hdr(handle)->writemode)
+  {
+    return(-1);
+  }
+
+  if(edfsignal>=(edflib_hdr(handle)->edfsignals - edflib_hdr(handle)->nr_annot_chns))
+  {
+    return(-1);
+  }
+
+  channel = edflib_hdr(handle)->mapped_signals[edfsignal];
+
+  if(n<0LL)
+  {
+    return(-1);
+  }
+
+  if(n==0LL)
+  {
+    return(0LL);
+  }
+
+  hdr = edflib_hdr(handle);
+
+  if(hdr->edf)
+  {
+    bytes_per_smpl = 2;
+  }
+
+  if(hdr->bdf)
+  {
+    bytes_per_smpl = 3;
+  }
+
+  smp_in_file = hdr->edfparam[channel].smp_per_record * hdr->datarecords;
+
+  if((hdr->edfparam[channel].sample_pntr + n) > smp_in_file)
+  {
+    n = smp_in_file - hdr->edfparam[channel].sample_pntr;
+
+    if(n==0)
+    {
+      return(0LL);
+    }
+
+    if(n<0)
+    {
+      return(-1);
+    }
+  }
+
+  file = hdr->file_hdl;
+
+  offset = hdr->hdrsize;
+  offset += (hdr->edfparam[channel].sample_pntr / hdr->edfparam[channel].smp_per_record) * hdr->recordsize;
+  offset += hdr->edfparam[channel].buf_offset;
+  offset += ((hdr->edfparam[channel].sample_pntr % hdr->edfparam[channel].smp_per_record) * bytes_per_smpl);
+
+  fseeko(file, offset, SEEK_SET);
+
+  sample_pntr = hdr->edfparam[channel].sample_pntr;
+
+  smp_per_record = hdr->edfparam[channel].smp_per_record;
+
+  jump = hdr->recordsize - (smp_per_record * bytes_per_smpl);
+
+  if(hdr->edf)
+  {
+    for(i=0; i<n; i++)
+    {
+      if(!(sample_pntr%smp_per_record))
+      {
+        if(i)
+        {
+          fseeko(file, jump, SEEK_CUR);
+        }
+      }
+
+      var.four[0] = fgetc(file);
+      tmp = fgetc(file);
+      if(tmp==EOF)
+      {
+        return(-1);
+      }
+      var.four[1] = tmp;
+
+      buf[i] = var.two_signed[0];
+
+      sample_pntr++;
+    }
+  }
+
+  if(hdr->bdf)
+  {
+    for(i=0; i<n; i++)
+    {
+      if(!(sample_pntr%smp_per_record))
+      {
+        if(i)
+        {
+          fseeko(file, jump, SEEK_CUR);
+        }
+      }
+
+      var.four[0] = fgetc(file);
+      var.four[1] = fgetc(file);
+      tmp = fgetc(file);
+      if(tmp==EOF)
+      {
+        return(-1);
+      }
+      var.four[2] = tmp;
+
+      if(var.four[2]&0x80)
+      {
+        var.four[3] = 0xff;
+      }
+      else
+      {
+        var.four[3] = 0x00;
+      }
+
+      buf[i] = var.one_signed;
+
+      sample_pntr++;
+    }
+  }
+
+  hdr->edfparam[channel].sample_pntr = sample_pntr;
+
+  return(n);
+}
+
+
+/* reads nbytes from the absolute offset without using or moving the position of the file stream */
+/* returns the amount of bytes read or -1 in case of an error */
+static long long edflib_pread(struct edfhdrblock *hdr, void *buf, long long nbytes, long long offset)
+{
+  long long done=0;
+
+#ifdef _WIN32
+  HANDLE fh;
+
+  OVERLAPPED ov;
+
+  DWORD got;
+
+
+  fh = (HANDLE)_get_osfhandle(_fileno(hdr->file_hdl));
+  if(fh==INVALID_HANDLE_VALUE)
+  {
+    return(-1);
+  }
+
+  while(done<nbytes)
+  {
+    memset(&ov, 0, sizeof(OVERLAPPED));
+    ov.Offset = (DWORD)((offset + done) & 0xffffffffLL);
+    ov.OffsetHigh = (DWORD)((offset + done) >> 32);
+
+    if(!ReadFile(fh, (char *)buf + done, (DWORD)(nbytes - done), &got, &ov))
+    {
+      if(GetLastError()==ERROR_HANDLE_EOF)
+      {
+        break;
+      }
+
+      return(-1);
+    }
+
+    if(got==0)
+    {
+      break;
+    }
+
+    done += got;
+  }
+#else
+  int fd;
+
+  ssize_t got;
+
+
+  fd = fileno(hdr->file_hdl);
+
+  while(done<nbytes)
+  {
+#if defined(__APPLE__) || defined(__MACH__) || defined(__APPLE_CC__)
+    got = pread(fd, (char *)buf + done, (size_t)(nbytes - done), (off_t)(offset + done));
+#else
+    got = pread64(fd, (char *)buf + done, (size_t)(nbytes - done), (off64_t)(offset + done));
+#endif
+    if(got<0)
+    {
+      return(-1);
+    }
+
+    if(got==0)
+    {
+      break;
+    }
+
+    done += got;
+  }
+#endif
+
+  return(done);
+}
+
+
+/* common part of edfread_physical_samples_at() and edfread_digital_samples_at() */
+/* exactly one of pbuf and dbuf is not NULL */
+static long long edflib_read_samples_at(int handle, int edfsignal, long long start, long long n, double *pbuf, int *dbuf)
+{
+  int bytes_per_smpl=2,
+      channel,
+      j,
+      cnt,
+      dig;
+
+  long long i,
+            smp_in_file,
+            smp_per_record,
+            datarecord,
+            offset;
+
+  double phys_bitvalue,
+         phys_offset;
+
+  unsigned char *rbuf,
+                *p;
+
+  struct edfhdrblock *hdr;
+
+
+  hdr = edflib_hdr(handle);
+  if(hdr==NULL)
+  {
+    return(-1);
+  }
+
+  if(hdr->writemode)
+  {
+    return(-1);
+  }
+
+  if((edfsignal<0)||(edfsignal>=(hdr->edfsignals - hdr->nr_annot_chns)))
+  {
+    return(-1);
+  }
+
+  if((n<0)||(start<0LL))
+  {
+    return(-1);
+  }
+
+  channel = hdr->mapped_signals[edfsignal];
+
+  smp_per_record = hdr->edfparam[channel].smp_per_record;
+
+  smp_in_file = smp_per_record * hdr->datarecords;
+
+  if(start>=smp_in_file)
+  {
+    return(0);
+  }
+
+  if((start + n) > smp_in_file)
+  {
+    n = smp_in_file - start;
+  }
+
+  if(n==0)
+  {
+    return(0);
+  }
+
+  if(hdr->bdf)
+  {
+    bytes_per_smpl = 3;
+  }
+
+  rbuf = (unsigned char *)malloc(smp_per_record * bytes_per_smpl);
+  if(rbuf==NULL)
+  {
+    return(-1);
+  }
+
+  phys_bitvalue = hdr->edfparam[channel].bitvalue;
+
+  phys_offset = hdr->edfparam[channel].offset;
+
+  datarecord = start / smp_per_record;
+
+  j = start % smp_per_record;
+
+  /* one read per datarecord, the samples of one signal are contiguous inside a datarecord */
+  for(i=0; i<n; datarecord++)
+  {
+    cnt = smp_per_record - j;
+    if((long long)cnt > (n - i))
+    {
+      cnt = n - i;
+    }
+
+    offset = hdr->hdrsize;
+    offset += datarecord * hdr->recordsize;
+    offset += hdr->edfparam[channel].buf_offset;
+    offset += (long long)j * bytes_per_smpl;
+
+    if(edflib_pread(hdr, rbuf, (long long)cnt * bytes_per_smpl, offset) != ((long long)cnt * bytes_per_smpl))
+    {
+      free(rbuf);
+
+      return(-1);
+    }
+
+    p = rbuf;
+
+    for(j=0; j<cnt; j++)
+    {
+      if(bytes_per_smpl==2)
+      {
+        dig = (signed short)(p[0] | (p[1] << 8));
+      }
+      else
+      {
+        dig = p[0] | (p[1] << 8) | (p[2] << 16);
+
+        if(p[2]&0x80)
+        {
+          dig |= 0xff000000;
+        }
+      }
+
+      p += bytes_per_smpl;
+
+      if(pbuf!=NULL)
+      {
+        pbuf[i + j] = phys_bitvalue * (phys_offset + (double)dig);
+      }
+      else
+      {
+        dbuf[i + j] = dig;
+      }
+    }
+
+    i += cnt;
+
+    j = 0;
+  }
+
+  free(rbuf);
+
+  return(n);
+}
+
+
+long long edfread_physical_samples_at(int handle, int edfsignal, long long start, long long n, double *buf)
+{
+  if(buf==NULL)
+  {
+    return(-1);
+  }
+
+  return(edflib_read_samples_at(handle, edfsignal, start, n, buf, NULL));
+}
+
+
+long long edfread_digital_samples_at(int handle, int edfsignal, long long start, long long n, int *buf)
+{
+  if(buf==NULL)
+  {
+    return(-1);
+  }
+
+  return(edflib_read_samples_at(handle, edfsignal, start, n, NULL, buf));
+}
+
+
+/* datarecords of one request of a vectored read */
+struct edflib_vec_range{
+        long long first;
+        long long last;
+        int       request;
+       };
+
+
+/* the ranges sorted by their first datarecord, the same first datarecord in the order of the requests */
+static int edflib_vec_compare(const void *a, const void *b)
+{
+  const struct edflib_vec_range *x = (const struct edflib_vec_range *)a,
+                                *y = (const struct edflib_vec_range *)b;
+
+  if(x->first!=y->first)
+  {
+    return((x->first < y->first) ? -1 : 1);
+  }
+
+  return(x->request - y->request);
+}
+
+
+/* decodes the samples [j0, j1) of the datarecord rec of the request, p points to the sample j0 */
+static void edflib_vec_decode(struct edfhdrblock *hdr, struct edf_read_request_struct *r, long long rec, long long j0, long long j1, unsigned char *p)
+{
+  int bytes_per_smpl=2,
+      channel,
+      dig;
+
+  long long j,
+            pos;
+
+  double phys_bitvalue,
+         phys_offset,
+         value;
+
+
+  if(hdr->bdf)
+  {
+    bytes_per_smpl = 3;
+  }
+
+  channel = hdr->mapped_signals[r->edfsignal];
+
+  phys_bitvalue = hdr->edfparam[channel].bitvalue;
+
+  phys_offset = hdr->edfparam[channel].offset;
+
+  pos = rec * hdr->edfparam[channel].smp_per_record + j0 - r->start;
+
+  for(j=j0; j<j1; j++, pos++)
+  {
+    if(bytes_per_smpl==2)
+    {
+      dig = (signed short)(p[0] | (p[1] << 8));
+    }
+    else
+    {
+      dig = p[0] | (p[1] << 8) | (p[2] << 16);
+
+      if(p[2]&0x80)
+      {
+        dig |= 0xff000000;
+      }
+    }
+
+    p += bytes_per_smpl;
+
+    value = phys_bitvalue * (phys_offset + (double)dig);
+
+    if(r->buf!=NULL)
+    {
+      r->buf[pos] = value;
+    }
+    else
+    {
+      r->fbuf[pos] = (float)value;
+    }
+  }
+}
+
+
+long long edfread_physical_samples_vec(int handle, struct edf_read_request_struct *requests, int count)
+{
+  int bytes_per_smpl=2,
+      channel,
+      cnt_ranges=0,
+      i,
+      k,
+      g,
+      h,
+      lo;
+
+  long long smp_per_record,
+            smp_in_file,
+            n,
+            total=0LL,
+            rec,
+            rec_end,
+            group_last,
+            group_bytes,
+            slice_bytes,
+            chunk_first,
+            chunk_last,
+            max_records,
+            gap_records,
+            j0,
+            j1;
+
+  unsigned char *rbuf;
+
+  struct edfhdrblock *hdr;
+
+  struct edflib_vec_range *ranges;
 
-  FILE *file;
+  struct edf_read_request_struct *r;
 
 
-  if(handle<0)
+  hdr = edflib_hdr(handle);
+  if(hdr==NULL)
   {
     return(-1);
   }
 
-  if(handle>=EDFLIB_MAXFILES)
+  if(hdr->writemode)
   {
     return(-1);
   }
 
-  if(hdrlist[handle]==NULL)
+  if((count<0)||((count>0)&&(requests==NULL)))
   {
     return(-1);
   }
 
-  if(edfsignal<0)
+  if(count==0)
   {
-    return(-1);
+    return(0);
   }
 
-  if(hdrlist[handle]->writemode)
+  if(hdr->bdf)
   {
-    return(-1);
+    bytes_per_smpl = 3;
   }
 
-  if(edfsignal>=(hdrlist[handle]->edfsignals - hdrlist[handle]->nr_annot_chns))
+  ranges = (struct edflib_vec_range *)malloc(sizeof(struct edflib_vec_range) * count);
+  if(ranges==NULL)
   {
     return(-1);
   }
 
-  channel = hdrlist[handle]->mapped_signals[edfsignal];
-
-  if(n<0LL)
+  for(i=0; i<count; i++)
   {
-    return(-1);
-  }
+    r = requests + i;
 
-  if(n==0LL)
-  {
-    return(0LL);
-  }
+    r->read = 0LL;
 
-  hdr = hdrlist[handle];
+    if((r->edfsignal<0)||(r->edfsignal>=(hdr->edfsignals - hdr->nr_annot_chns))||(r->n<0)||(r->start<0LL)||((r->n>0)&&(r->buf==NULL)&&(r->fbuf==NULL)))
+    {
+      free(ranges);
 
-  if(hdr->edf)
-  {
-    bytes_per_smpl = 2;
-  }
+      return(-1);
+    }
 
-  if(hdr->bdf)
-  {
-    bytes_per_smpl = 3;
-  }
+    smp_per_record = hdr->edfparam[hdr->mapped_signals[r->edfsignal]].smp_per_record;
 
-  smp_in_file = hdr->edfparam[channel].smp_per_record * hdr->datarecords;
+    smp_in_file = smp_per_record * hdr->datarecords;
 
-  if((hdr->edfparam[channel].sample_pntr + n) > smp_in_file)
-  {
-    n = smp_in_file - hdr->edfparam[channel].sample_pntr;
+    n = r->n;
 
-    if(n==0)
+    if(r->start>=smp_in_file)
     {
-      return(0LL);
+      n = 0;
+    }
+    else if((r->start + n) > smp_in_file)
+    {
+      n = smp_in_file - r->start;
     }
 
-    if(n<0)
+    if(n==0)
     {
-      return(-1);
+      continue;
     }
+
+    r->read = n;
+
+    ranges[cnt_ranges].first = r->start / smp_per_record;
+    ranges[cnt_ranges].last = (r->start + n - 1) / smp_per_record;
+    ranges[cnt_ranges].request = i;
+    cnt_ranges++;
   }
 
-  file = hdr->file_hdl;
+  if(cnt_ranges==0)
+  {
+    free(ranges);
 
-  offset = hdr->hdrsize;
-  offset += (hdr->edfparam[channel].sample_pntr / hdr->edfparam[channel].smp_per_record) * hdr->recordsize;
-  offset += hdr->edfparam[channel].buf_offset;
-  offset += ((hdr->edfparam[channel].sample_pntr % hdr->edfparam[channel].smp_per_record) * bytes_per_smpl);
+    return(0);
+  }
 
-  fseeko(file, offset, SEEK_SET);
+  qsort(ranges, cnt_ranges, sizeof(struct edflib_vec_range), edflib_vec_compare);
 
-  sample_pntr = hdr->edfparam[channel].sample_pntr;
+  max_records = EDFLIB_VEC_MAX_BYTES / hdr->recordsize;
+  if(max_records<1)
+  {
+    max_records = 1;
+  }
+  if(max_records>hdr->datarecords)
+  {
+    max_records = hdr->datarecords;
+  }
 
-  smp_per_record = hdr->edfparam[channel].smp_per_record;
+  gap_records = EDFLIB_VEC_GAP_BYTES / hdr->recordsize;
 
-  jump = hdr->recordsize - (smp_per_record * bytes_per_smpl);
+  rbuf = (unsigned char *)malloc(max_records * hdr->recordsize);
+  if(rbuf==NULL)
+  {
+    free(ranges);
 
-  if(hdr->edf)
+    return(-1);
+  }
+
+  for(k=0; k<cnt_ranges; k=g)
   {
-    for(i=0; i<n; i++)
+    /* the group - the next ranges which share datarecords with it or are close */
+    group_last = ranges[k].last;
+
+    slice_bytes = 0;
+
+    for(g=k; g<cnt_ranges; g++)
     {
-      if(!(sample_pntr%smp_per_record))
+      if((g>k)&&(ranges[g].first > (group_last + 1 + gap_records)))
       {
-        if(i)
-        {
-          fseeko(file, jump, SEEK_CUR);
-        }
+        break;
       }
 
-      var.four[0] = fgetc(file);
-      tmp = fgetc(file);
-      if(tmp==EOF)
+      if(ranges[g].last > group_last)
       {
-        return(-1);
+        group_last = ranges[g].last;
       }
-      var.four[1] = tmp;
 
-      buf[i] = var.two_signed[0];
+      /* one read of the samples of the range per datarecord */
+      r = requests + ranges[g].request;
 
-      sample_pntr++;
+      slice_bytes += (ranges[g].last - ranges[g].first + 1) * EDFLIB_VEC_GAP_BYTES + r->read * bytes_per_smpl;
     }
-  }
 
-  if(hdr->bdf)
-  {
-    for(i=0; i<n; i++)
+    group_bytes = (group_last - ranges[k].first + 1) * hdr->recordsize;
+
+    /* a few signals of long datarecords - only the samples of the ranges */
+    if(slice_bytes<group_bytes)
     {
-      if(!(sample_pntr%smp_per_record))
+      for(h=k; h<g; h++)
       {
-        if(i)
+        r = requests + ranges[h].request;
+
+        channel = hdr->mapped_signals[r->edfsignal];
+
+        smp_per_record = hdr->edfparam[channel].smp_per_record;
+
+        for(rec=ranges[h].first; rec<=ranges[h].last; rec++)
         {
-          fseeko(file, jump, SEEK_CUR);
+          j0 = r->start - rec * smp_per_record;
+          if(j0<0)
+          {
+            j0 = 0;
+          }
+
+          j1 = r->start + r->read - rec * smp_per_record;
+          if(j1>smp_per_record)
+          {
+            j1 = smp_per_record;
+          }
+
+          if(edflib_pread(hdr, rbuf, (j1 - j0) * bytes_per_smpl, hdr->hdrsize + rec * hdr->recordsize + hdr->edfparam[channel].buf_offset + j0 * bytes_per_smpl) != ((j1 - j0) * bytes_per_smpl))
+          {
+            free(rbuf);
+            free(ranges);
+
+            return(-1);
+          }
+
+          edflib_vec_decode(hdr, r, rec, j0, j1, rbuf);
         }
       }
 
-      var.four[0] = fgetc(file);
-      var.four[1] = fgetc(file);
-      tmp = fgetc(file);
-      if(tmp==EOF)
+      continue;
+    }
+
+    /* one positional read per chunk of whole datarecords, the samples scattered to all ranges of the chunk */
+    lo = k;
+
+    for(chunk_first=ranges[k].first; chunk_first<=group_last; chunk_first+=max_records)
+    {
+      chunk_last = chunk_first + max_records - 1;
+      if(chunk_last>group_last)
       {
-        return(-1);
+        chunk_last = group_last;
       }
-      var.four[2] = tmp;
 
-      if(var.four[2]&0x80)
+      if(edflib_pread(hdr, rbuf, (chunk_last - chunk_first + 1) * hdr->recordsize, hdr->hdrsize + chunk_first * hdr->recordsize) != ((chunk_last - chunk_first + 1) * hdr->recordsize))
       {
-        var.four[3] = 0xff;
+        free(rbuf);
+        free(ranges);
+
+        return(-1);
       }
-      else
+
+      while((lo<g)&&(ranges[lo].last<chunk_first))
       {
-        var.four[3] = 0x00;
+        lo++;
       }
 
-      buf[i] = var.one_signed;
+      for(h=lo; (h<g)&&(ranges[h].first<=chunk_last); h++)
+      {
+        if(ranges[h].last<chunk_first)
+        {
+          continue;
+        }
 
-      sample_pntr++;
+        r = requests + ranges[h].request;
+
+        channel = hdr->mapped_signals[r->edfsignal];
+
+        smp_per_record = hdr->edfparam[channel].smp_per_record;
+
+        rec = (ranges[h].first > chunk_first) ? ranges[h].first : chunk_first;
+
+        rec_end = (ranges[h].last < chunk_last) ? ranges[h].last : chunk_last;
+
+        for(; rec<=rec_end; rec++)
+        {
+          j0 = r->start - rec * smp_per_record;
+          if(j0<0)
+          {
+            j0 = 0;
+          }
+
+          j1 = r->start + r->read - rec * smp_per_record;
+          if(j1>smp_per_record)
+          {
+            j1 = smp_per_record;
+          }
+
+          edflib_vec_decode(hdr, r, rec, j0, j1, rbuf + (rec - chunk_first) * hdr->recordsize + hdr->edfparam[channel].buf_offset + j0 * bytes_per_smpl);
+        }
+      }
     }
   }
 
-  hdr->edfparam[channel].sample_pntr = sample_pntr;
+  for(i=0; i<count; i++)
+  {
+    total += requests[i].read;
+  }
 
-  return(n);
+  free(rbuf);
+  free(ranges);
+
+  return(total);
 }
 
 
@@ -1194,12 +1988,12 @@ int edf_get_annotation(int handle, int n, struct edf_annotation_struct *annot)
     return(-1);
   }
 
-  if(hdrlist[handle]==NULL)
+  if(edflib_hdr(handle)==NULL)
   {
     return(-1);
   }
 
-  if(hdrlist[handle]->writemode)
+  if(edflib_hdr(handle)->writemode)
   {
     return(-1);
   }
@@ -1209,19 +2003,96 @@ int edf_get_annotation(int handle, int n, struct edf_annotation_struct *annot)
     return(-1);
   }
 
-  if(n>=hdrlist[handle]->annots_in_file)
+  if(n>=edflib_hdr(handle)->annots_in_file)
   {
     return(-1);
   }
 
-  annot->onset = (annotationslist[handle] + n)->onset;
-  strcpy(annot->duration, (annotationslist[handle] + n)->duration);
-  strcpy(annot->annotation, (annotationslist[handle] + n)->annotation);
+  annot->onset = (edflib_hdr(handle)->annotationslist + n)->onset;
+  strcpy(annot->duration, (edflib_hdr(handle)->annotationslist + n)->duration);
+  strcpy(annot->annotation, (edflib_hdr(handle)->annotationslist + n)->annotation);
 
   return(0);
 }
 
 
+long long edfread_annotations(int handle, long long first_datarecord, long long datarecords, edf_annotation_callback callback, void *userdata)
+{
+  long long annots_found=0LL;
+
+  FILE *file;
+
+  struct edfhdrblock *hdr;
+
+
+  if(handle<0)
+  {
+    return(-1);
+  }
+
+  if(handle>=EDFLIB_MAXFILES)
+  {
+    return(-1);
+  }
+
+  if(edflib_hdr(handle)==NULL)
+  {
+    return(-1);
+  }
+
+  if(edflib_hdr(handle)->writemode)
+  {
+    return(-1);
+  }
+
+  if(callback==NULL)
+  {
+    return(-1);
+  }
+
+  hdr = edflib_hdr(handle);
+
+  if((!(hdr->edfplus))&&(!(hdr->bdfplus)))
+  {
+    return(0LL);
+  }
+
+  if(first_datarecord<0LL)
+  {
+    datarecords += first_datarecord;
+
+    first_datarecord = 0LL;
+  }
+
+  if((first_datarecord + datarecords) > hdr->datarecords)
+  {
+    datarecords = hdr->datarecords - first_datarecord;
+  }
+
+  if(datarecords<=0LL)
+  {
+    return(0LL);
+  }
+
+  file = fopeno(hdr->path, "rb");
+  if(file==NULL)
+  {
+    return(-1);
+  }
+
+  if(edflib_get_annotations(hdr, file, EDFLIB_READ_ALL_ANNOTATIONS, first_datarecord, datarecords, callback, userdata, &annots_found))
+  {
+    fclose(file);
+
+    return(-1);
+  }
+
+  fclose(file);
+
+  return(annots_found);
+}
+
+
 static struct edfhdrblock * edflib_check_edf_file(FILE *inputfile, int *edf_error)
 {
   int i, j, p, r=0, n,
@@ -2824,11 +3695,12 @@ int edflib_version(void)
 }
 
 
-static int edflib_get_annotations(struct edfhdrblock *edfhdr, int hdl, int read_annotations)
+static int edflib_get_annotations(struct edfhdrblock *edfhdr, FILE *inputfile, int read_annotations,
+                                  long long first_datarecord, long long datarecords,
+                                  edf_annotation_callback callback, void *userdata, long long *annots_found)
 {
   int i, j, k, p, r=0, n,
       edfsignals,
-      datarecords,
       recordsize,
       discontinuous,
       *annot_ch,
@@ -2852,21 +3724,21 @@ static int edflib_get_annotations(struct edfhdrblock *edfhdr, int hdl, int read_
 
   long long data_record_duration,
             elapsedtime,
-            time_tmp=0;
-
-  FILE *inputfile;
+            time_tmp=0,
+            datarecord;
 
   struct edfparamblock *edfparam;
 
   struct edf_annotationblock *new_annotation=NULL,
-                             *malloc_list;
+                             *malloc_list,
+                             callback_annotation;
+
+  struct edf_annotation_struct annot;
 
-  inputfile = edfhdr->file_hdl;
   edfsignals = edfhdr->edfsignals;
   recordsize = edfhdr->recordsize;
   edfparam = edfhdr->edfparam;
   nr_annot_chns = edfhdr->nr_annot_chns;
-  datarecords = edfhdr->datarecords;
   data_record_duration = edfhdr->long_data_record_duration;
   discontinuous = edfhdr->discontinuous;
   annot_ch = edfhdr->annot_ch;
@@ -2919,7 +3791,7 @@ static int edflib_get_annotations(struct edfhdrblock *edfhdr, int hdl, int read_
     return(1);
   }
 
-  if(fseeko(inputfile, (long long)((edfsignals + 1) * 256), SEEK_SET))
+  if(fseeko(inputfile, (long long)((edfsignals + 1) * 256) + (first_datarecord * recordsize), SEEK_SET))
   {
     free(cnv_buf);
     free(scratchpad);
@@ -2930,7 +3802,7 @@ static int edflib_get_annotations(struct edfhdrblock *edfhdr, int hdl, int read_
 
   elapsedtime = 0;
 
-  for(i=0; i<datarecords; i++)
+  for(datarecord=first_datarecord; datarecord<(first_datarecord + datarecords); datarecord++)
   {
     if(fread(cnv_buf, recordsize, 1, inputfile)!=1)
     {
@@ -2992,7 +3864,7 @@ static int edflib_get_annotations(struct edfhdrblock *edfhdr, int hdl, int read_
             else
             {
               time_tmp = edflib_get_long_time(scratchpad);
-              if(i)
+              if(datarecord>first_datarecord)
               {
                 if(discontinuous)
                 {
@@ -3011,14 +3883,14 @@ static int edflib_get_annotations(struct edfhdrblock *edfhdr, int hdl, int read_
                   }
                 }
               }
-              else
+              else if(!datarecord)
               {
                 if(time_tmp>=EDFLIB_TIME_DIMENSION)
                 {
                   error = 2;
                   goto END;
                 }
-                else
+                else if(callback==NULL)
                 {
                   edfhdr->starttime_offset = time_tmp;
                 }
@@ -3082,25 +3954,32 @@ static int edflib_get_annotations(struct edfhdrblock *edfhdr, int hdl, int read_
             {
               if(n >= 0)
               {
-                if(edfhdr->annots_in_file >= edfhdr->annotlist_sz)
+                if(callback!=NULL)
+                {
+                  new_annotation = &callback_annotation;
+                }
+                else
                 {
-                  malloc_list = (struct edf_annotationblock *)realloc(annotationslist[hdl],
-                                                                      sizeof(struct edf_annotationblock) * (edfhdr->annotlist_sz + EDFLIB_ANNOT_MEMBLOCKSZ));
-                  if(malloc_list==NULL)
+                  if(edfhdr->annots_in_file >= edfhdr->annotlist_sz)
                   {
-                    free(cnv_buf);
-                    free(scratchpad);
-                    free(time_in_txt);
-                    free(duration_in_txt);
-                    return(-1);
-                  }
+                    malloc_list = (struct edf_annotationblock *)realloc(edfhdr->annotationslist,
+                                                                        sizeof(struct edf_annotationblock) * (edfhdr->annotlist_sz + EDFLIB_ANNOT_MEMBLOCKSZ));
+                    if(malloc_list==NULL)
+                    {
+                      free(cnv_buf);
+                      free(scratchpad);
+                      free(time_in_txt);
+                      free(duration_in_txt);
+                      return(-1);
+                    }
 
-                  annotationslist[hdl] = malloc_list;
+                    edfhdr->annotationslist = malloc_list;
 
-                  edfhdr->annotlist_sz += EDFLIB_ANNOT_MEMBLOCKSZ;
-                }
+                    edfhdr->annotlist_sz += EDFLIB_ANNOT_MEMBLOCKSZ;
+                  }
 
-                new_annotation = annotationslist[hdl] + edfhdr->annots_in_file;
+                  new_annotation = edfhdr->annotationslist + edfhdr->annots_in_file;
+                }
 
                 new_annotation->annotation[0] = 0;
 
@@ -3116,7 +3995,23 @@ static int edflib_get_annotations(struct edfhdrblock *edfhdr, int hdl, int read_
 
                 new_annotation->onset = edflib_get_long_time(time_in_txt);
 
-                edfhdr->annots_in_file++;
+                if(callback!=NULL)
+                {
+                  annot.onset = new_annotation->onset;
+                  strcpy(annot.duration, new_annotation->duration);
+                  strcpy(annot.annotation, new_annotation->annotation);
+
+                  callback(&annot, userdata);
+
+                  if(annots_found!=NULL)
+                  {
+                    (*annots_found)++;
+                  }
+                }
+                else
+                {
+                  edfhdr->annots_in_file++;
+                }
 
                 if(read_annotations==EDFLIB_READ_ANNOTATIONS)
                 {
@@ -3583,7 +4478,21 @@ static void edflib_latin12utf8(char *latin1_str, int len)
 
 int edfopen_file_writeonly(const char *path, int filetype, int number_of_signals)
 {
-  int i, handle;
+  int ret;
+
+  edflib_lock();
+
+  ret = edfopen_file_writeonly_locked(path, filetype, number_of_signals);
+
+  edflib_unlock();
+
+  return(ret);
+}
+
+
+static int edfopen_file_writeonly_locked(const char *path, int filetype, int number_of_signals)
+{
+  int handle;
 
   FILE *file;
 
@@ -3600,15 +4509,9 @@ int edfopen_file_writeonly(const char *path, int filetype, int number_of_signals
     return(EDFLIB_MAXFILES_REACHED);
   }
 
-  for(i=0; i<EDFLIB_MAXFILES; i++)
+  if(edflib_find_path(path)>=0)
   {
-    if(hdrlist[i]!=NULL)
-    {
-      if(!(strcmp(path, hdrlist[i]->path)))
-      {
-        return(EDFLIB_FILE_ALREADY_OPENED);
-      }
-    }
+    return(EDFLIB_FILE_ALREADY_OPENED);
   }
 
   if(number_of_signals<0)
@@ -3639,19 +4542,7 @@ int edfopen_file_writeonly(const char *path, int filetype, int number_of_signals
 
   hdr->edfsignals = number_of_signals;
 
-  handle = -1;
-
-  for(i=0; i<EDFLIB_MAXFILES; i++)
-  {
-    if(hdrlist[i]==NULL)
-    {
-      hdrlist[i] = hdr;
-
-      handle = i;
-
-      break;
-    }
-  }
+  handle = edflib_add_hdr(hdr);
 
   if(handle<0)
   {
@@ -3662,7 +4553,7 @@ int edfopen_file_writeonly(const char *path, int filetype, int number_of_signals
     return(EDFLIB_MAXFILES_REACHED);
   }
 
-  write_annotationslist[handle] = NULL;
+  hdr->write_annotationslist = NULL;
 
   hdr->annotlist_sz = 0;
 
@@ -3671,6 +4562,8 @@ int edfopen_file_writeonly(const char *path, int filetype, int number_of_signals
   file = fopeno(path, "wb");
   if(file==NULL)
   {
+    hdrlist[handle / EDFLIB_HANDLE_CHUNKSZ][handle % EDFLIB_HANDLE_CHUNKSZ] = NULL;
+
     free(hdr->edfparam);
 
     free(hdr);
@@ -3718,12 +4611,12 @@ int edf_set_samplefrequency(int handle, int edfsignal, int samplefrequency)
     return(-1);
   }
 
-  if(hdrlist[handle]==NULL)
+  if(edflib_hdr(handle)==NULL)
   {
     return(-1);
   }
 
-  if(!(hdrlist[handle]->writemode))
+  if(!(edflib_hdr(handle)->writemode))
   {
     return(-1);
   }
@@ -3733,7 +4626,7 @@ int edf_set_samplefrequency(int handle, int edfsignal, int samplefrequency)
     return(-1);
   }
 
-  if(edfsignal>=hdrlist[handle]->edfsignals)
+  if(edfsignal>=edflib_hdr(handle)->edfsignals)
   {
     return(-1);
   }
@@ -3743,12 +4636,12 @@ int edf_set_samplefrequency(int handle, int edfsignal, int samplefrequency)
     return(-1);
   }
 
-  if(hdrlist[handle]->datarecords)
+  if(edflib_hdr(handle)->datarecords)
   {
     return(-1);
   }
 
-  hdrlist[handle]->edfparam[edfsignal].smp_per_record = samplefrequency;
+  edflib_hdr(handle)->edfparam[edfsignal].smp_per_record = samplefrequency;
 
   return(0);
 }
@@ -3766,17 +4659,17 @@ int edf_set_number_of_annotation_signals(int handle, int annot_signals)
     return(-1);
   }
 
-  if(hdrlist[handle]==NULL)
+  if(edflib_hdr(handle)==NULL)
   {
     return(-1);
   }
 
-  if(!(hdrlist[handle]->writemode))
+  if(!(edflib_hdr(handle)->writemode))
   {
     return(-1);
   }
 
-  if(hdrlist[handle]->datarecords)
+  if(edflib_hdr(handle)->datarecords)
   {
     return(-1);
   }
@@ -3786,7 +4679,7 @@ int edf_set_number_of_annotation_signals(int handle, int annot_signals)
     return(-1);
   }
 
-  hdrlist[handle]->nr_annot_chns = annot_signals;
+  edflib_hdr(handle)->nr_annot_chns = annot_signals;
 
   return(0);
 }
@@ -3804,17 +4697,17 @@ int edf_set_datarecord_duration(int handle, int duration)
     return(-1);
   }
 
-  if(hdrlist[handle]==NULL)
+  if(edflib_hdr(handle)==NULL)
   {
     return(-1);
   }
 
-  if(!(hdrlist[handle]->writemode))
+  if(!(edflib_hdr(handle)->writemode))
   {
     return(-1);
   }
 
-  if(hdrlist[handle]->datarecords)
+  if(edflib_hdr(handle)->datarecords)
   {
     return(-1);
   }
@@ -3824,22 +4717,22 @@ int edf_set_datarecord_duration(int handle, int duration)
     return(-1);
   }
 
-  hdrlist[handle]->long_data_record_duration = (long long)duration * 100LL;
+  edflib_hdr(handle)->long_data_record_duration = (long long)duration * 100LL;
 
-  if(hdrlist[handle]->long_data_record_duration < (EDFLIB_TIME_DIMENSION * 10LL))
+  if(edflib_hdr(handle)->long_data_record_duration < (EDFLIB_TIME_DIMENSION * 10LL))
   {
-    hdrlist[handle]->long_data_record_duration /= 10LL;
+    edflib_hdr(handle)->long_data_record_duration /= 10LL;
 
-    hdrlist[handle]->long_data_record_duration *= 10LL;
+    edflib_hdr(handle)->long_data_record_duration *= 10LL;
   }
   else
   {
-    hdrlist[handle]->long_data_record_duration /= 100LL;
+    edflib_hdr(handle)->long_data_record_duration /= 100LL;
 
-    hdrlist[handle]->long_data_record_duration *= 100LL;
+    edflib_hdr(handle)->long_data_record_duration *= 100LL;
   }
 
-  hdrlist[handle]->data_record_duration = ((double)(hdrlist[handle]->long_data_record_duration)) / EDFLIB_TIME_DIMENSION;
+  edflib_hdr(handle)->data_record_duration = ((double)(edflib_hdr(handle)->long_data_record_duration)) / EDFLIB_TIME_DIMENSION;
 
   return(0);
 }
@@ -3870,27 +4763,27 @@ int edfwrite_digital_short_samples(int handle, short *buf)
     return(-1);
   }
 
-  if(hdrlist[handle]==NULL)
+  if(edflib_hdr(handle)==NULL)
   {
     return(-1);
   }
 
-  if(!(hdrlist[handle]->writemode))
+  if(!(edflib_hdr(handle)->writemode))
   {
     return(-1);
   }
 
-  if(hdrlist[handle]->edfsignals == 0)
+  if(edflib_hdr(handle)->edfsignals == 0)
   {
     return(-1);
   }
 
-  if(hdrlist[handle]->bdf == 1)
+  if(edflib_hdr(handle)->bdf == 1)
   {
     return(-1);
   }
 
-  hdr = hdrlist[handle];
+  hdr = edflib_hdr(handle);
 
   file = hdr->file_hdl;
 
@@ -3998,22 +4891,22 @@ int edfwrite_digital_samples(int handle, int *buf)
     return(-1);
   }
 
-  if(hdrlist[handle]==NULL)
+  if(edflib_hdr(handle)==NULL)
   {
     return(-1);
   }
 
-  if(!(hdrlist[handle]->writemode))
+  if(!(edflib_hdr(handle)->writemode))
   {
     return(-1);
   }
 
-  if(hdrlist[handle]->edfsignals == 0)
+  if(edflib_hdr(handle)->edfsignals == 0)
   {
     return(-1);
   }
 
-  hdr = hdrlist[handle];
+  hdr = edflib_hdr(handle);
 
   file = hdr->file_hdl;
 
@@ -4121,27 +5014,27 @@ int edf_blockwrite_digital_samples(int handle, int *buf)
     return(-1);
   }
 
-  if(hdrlist[handle]==NULL)
+  if(edflib_hdr(handle)==NULL)
   {
     return(-1);
   }
 
-  if(!(hdrlist[handle]->writemode))
+  if(!(edflib_hdr(handle)->writemode))
   {
     return(-1);
   }
 
-  if(hdrlist[handle]->signal_write_sequence_pos)
+  if(edflib_hdr(handle)->signal_write_sequence_pos)
   {
     return(-1);
   }
 
-  if(hdrlist[handle]->edfsignals == 0)
+  if(edflib_hdr(handle)->edfsignals == 0)
   {
     return(-1);
   }
 
-  hdr = hdrlist[handle];
+  hdr = edflib_hdr(handle);
 
   file = hdr->file_hdl;
 
@@ -4246,32 +5139,32 @@ int edf_blockwrite_digital_short_samples(int handle, short *buf)
     return(-1);
   }
 
-  if(hdrlist[handle]==NULL)
+  if(edflib_hdr(handle)==NULL)
   {
     return(-1);
   }
 
-  if(!(hdrlist[handle]->writemode))
+  if(!(edflib_hdr(handle)->writemode))
   {
     return(-1);
   }
 
-  if(hdrlist[handle]->signal_write_sequence_pos)
+  if(edflib_hdr(handle)->signal_write_sequence_pos)
   {
     return(-1);
   }
 
-  if(hdrlist[handle]->edfsignals == 0)
+  if(edflib_hdr(handle)->edfsignals == 0)
   {
     return(-1);
   }
 
-  if(hdrlist[handle]->bdf == 1)
+  if(edflib_hdr(handle)->bdf == 1)
   {
     return(-1);
   }
 
-  hdr = hdrlist[handle];
+  hdr = edflib_hdr(handle);
 
   file = hdr->file_hdl;
 
@@ -4372,32 +5265,32 @@ int edf_blockwrite_digital_3byte_samples(int handle, void *buf)
     return(-1);
   }
 
-  if(hdrlist[handle]==NULL)
+  if(edflib_hdr(handle)==NULL)
   {
     return(-1);
   }
 
-  if(!(hdrlist[handle]->writemode))
+  if(!(edflib_hdr(handle)->writemode))
   {
     return(-1);
   }
 
-  if(hdrlist[handle]->signal_write_sequence_pos)
+  if(edflib_hdr(handle)->signal_write_sequence_pos)
   {
     return(-1);
   }
 
-  if(hdrlist[handle]->edfsignals == 0)
+  if(edflib_hdr(handle)->edfsignals == 0)
   {
     return(-1);
   }
 
-  if(hdrlist[handle]->bdf != 1)
+  if(edflib_hdr(handle)->bdf != 1)
   {
     return(-1);
   }
 
-  hdr = hdrlist[handle];
+  hdr = edflib_hdr(handle);
 
   file = hdr->file_hdl;
 
@@ -4476,22 +5369,22 @@ int edfwrite_physical_samples(int handle, double *buf)
     return(-1);
   }
 
-  if(hdrlist[handle]==NULL)
+  if(edflib_hdr(handle)==NULL)
   {
     return(-1);
   }
 
-  if(!(hdrlist[handle]->writemode))
+  if(!(edflib_hdr(handle)->writemode))
   {
     return(-1);
   }
 
-  if(hdrlist[handle]->edfsignals == 0)
+  if(edflib_hdr(handle)->edfsignals == 0)
   {
     return(-1);
   }
 
-  hdr = hdrlist[handle];
+  hdr = edflib_hdr(handle);
 
   file = hdr->file_hdl;
 
@@ -4610,27 +5503,27 @@ int edf_blockwrite_physical_samples(int handle, double *buf)
     return(-1);
   }
 
-  if(hdrlist[handle]==NULL)
+  if(edflib_hdr(handle)==NULL)
   {
     return(-1);
   }
 
-  if(!(hdrlist[handle]->writemode))
+  if(!(edflib_hdr(handle)->writemode))
   {
     return(-1);
   }
 
-  if(hdrlist[handle]->signal_write_sequence_pos)
+  if(edflib_hdr(handle)->signal_write_sequence_pos)
   {
     return(-1);
   }
 
-  if(hdrlist[handle]->edfsignals == 0)
+  if(edflib_hdr(handle)->edfsignals == 0)
   {
     return(-1);
   }
 
-  hdr = hdrlist[handle];
+  hdr = edflib_hdr(handle);
 
   file = hdr->file_hdl;
 
@@ -5324,12 +6217,12 @@ int edf_set_label(int handle, int edfsignal, const char *label)
     return(-1);
   }
 
-  if(hdrlist[handle]==NULL)
+  if(edflib_hdr(handle)==NULL)
   {
     return(-1);
   }
 
-  if(!(hdrlist[handle]->writemode))
+  if(!(edflib_hdr(handle)->writemode))
   {
     return(-1);
   }
@@ -5339,21 +6232,21 @@ int edf_set_label(int handle, int edfsignal, const char *label)
     return(-1);
   }
 
-  if(edfsignal>=hdrlist[handle]->edfsignals)
+  if(edfsignal>=edflib_hdr(handle)->edfsignals)
   {
     return(-1);
   }
 
-  if(hdrlist[handle]->datarecords)
+  if(edflib_hdr(handle)->datarecords)
   {
     return(-1);
   }
 
-  strncpy(hdrlist[handle]->edfparam[edfsignal].label, label, 16);
+  strncpy(edflib_hdr(handle)->edfparam[edfsignal].label, label, 16);
 
-  hdrlist[handle]->edfparam[edfsignal].label[16] = 0;
+  edflib_hdr(handle)->edfparam[edfsignal].label[16] = 0;
 
-  edflib_remove_padding_trailing_spaces(hdrlist[handle]->edfparam[edfsignal].label);
+  edflib_remove_padding_trailing_spaces(edflib_hdr(handle)->edfparam[edfsignal].label);
 
   return(0);
 }
@@ -5371,12 +6264,12 @@ int edf_set_physical_dimension(int handle, int edfsignal, const char *phys_dim)
     return(-1);
   }
 
-  if(hdrlist[handle]==NULL)
+  if(edflib_hdr(handle)==NULL)
   {
     return(-1);
   }
 
-  if(!(hdrlist[handle]->writemode))
+  if(!(edflib_hdr(handle)->writemode))
   {
     return(-1);
   }
@@ -5386,21 +6279,21 @@ int edf_set_physical_dimension(int handle, int edfsignal, const char *phys_dim)
     return(-1);
   }
 
-  if(edfsignal>=hdrlist[handle]->edfsignals)
+  if(edfsignal>=edflib_hdr(handle)->edfsignals)
   {
     return(-1);
   }
 
-  if(hdrlist[handle]->datarecords)
+  if(edflib_hdr(handle)->datarecords)
   {
     return(-1);
   }
 
-  strncpy(hdrlist[handle]->edfparam[edfsignal].physdimension, phys_dim, 8);
+  strncpy(edflib_hdr(handle)->edfparam[edfsignal].physdimension, phys_dim, 8);
 
-  hdrlist[handle]->edfparam[edfsignal].physdimension[8] = 0;
+  edflib_hdr(handle)->edfparam[edfsignal].physdimension[8] = 0;
 
-  edflib_remove_padding_trailing_spaces(hdrlist[handle]->edfparam[edfsignal].physdimension);
+  edflib_remove_padding_trailing_spaces(edflib_hdr(handle)->edfparam[edfsignal].physdimension);
 
   return(0);
 }
@@ -5418,12 +6311,12 @@ int edf_set_physical_maximum(int handle, int edfsignal, double phys_max)
     return(-1);
   }
 
-  if(hdrlist[handle]==NULL)
+  if(edflib_hdr(handle)==NULL)
   {
     return(-1);
   }
 
-  if(!(hdrlist[handle]->writemode))
+  if(!(edflib_hdr(handle)->writemode))
   {
     return(-1);
   }
@@ -5433,17 +6326,17 @@ int edf_set_physical_maximum(int handle, int edfsignal, double phys_max)
     return(-1);
   }
 
-  if(edfsignal>=hdrlist[handle]->edfsignals)
+  if(edfsignal>=edflib_hdr(handle)->edfsignals)
   {
     return(-1);
   }
 
-  if(hdrlist[handle]->datarecords)
+  if(edflib_hdr(handle)->datarecords)
   {
     return(-1);
   }
 
-  hdrlist[handle]->edfparam[edfsignal].phys_max = phys_max;
+  edflib_hdr(handle)->edfparam[edfsignal].phys_max = phys_max;
 
   return(0);
 }
@@ -5461,12 +6354,12 @@ int edf_set_physical_minimum(int handle, int edfsignal, double phys_min)
     return(-1);
   }
 
-  if(hdrlist[handle]==NULL)
+  if(edflib_hdr(handle)==NULL)
   {
     return(-1);
   }
 
-  if(!(hdrlist[handle]->writemode))
+  if(!(edflib_hdr(handle)->writemode))
   {
     return(-1);
   }
@@ -5476,17 +6369,17 @@ int edf_set_physical_minimum(int handle, int edfsignal, double phys_min)
     return(-1);
   }
 
-  if(edfsignal>=hdrlist[handle]->edfsignals)
+  if(edfsignal>=edflib_hdr(handle)->edfsignals)
   {
     return(-1);
   }
 
-  if(hdrlist[handle]->datarecords)
+  if(edflib_hdr(handle)->datarecords)
   {
     return(-1);
   }
 
-  hdrlist[handle]->edfparam[edfsignal].phys_min = phys_min;
+  edflib_hdr(handle)->edfparam[edfsignal].phys_min = phys_min;
 
   return(0);
 }
@@ -5504,12 +6397,12 @@ int edf_set_digital_maximum(int handle, int edfsignal, int dig_max)
     return(-1);
   }
 
-  if(hdrlist[handle]==NULL)
+  if(edflib_hdr(handle)==NULL)
   {
     return(-1);
   }
 
-  if(!(hdrlist[handle]->writemode))
+  if(!(edflib_hdr(handle)->writemode))
   {
     return(-1);
   }
@@ -5519,12 +6412,12 @@ int edf_set_digital_maximum(int handle, int edfsignal, int dig_max)
     return(-1);
   }
 
-  if(edfsignal>=hdrlist[handle]->edfsignals)
+  if(edfsignal>=edflib_hdr(handle)->edfsignals)
   {
     return(-1);
   }
 
-  if(hdrlist[handle]->edf)
+  if(edflib_hdr(handle)->edf)
   {
     if(dig_max > 32767)
     {
@@ -5539,12 +6432,12 @@ int edf_set_digital_maximum(int handle, int edfsignal, int dig_max)
     }
   }
 
-  if(hdrlist[handle]->datarecords)
+  if(edflib_hdr(handle)->datarecords)
   {
     return(-1);
   }
 
-  hdrlist[handle]->edfparam[edfsignal].dig_max = dig_max;
+  edflib_hdr(handle)->edfparam[edfsignal].dig_max = dig_max;
 
   return(0);
 }
@@ -5562,12 +6455,12 @@ int edf_set_digital_minimum(int handle, int edfsignal, int dig_min)
     return(-1);
   }
 
-  if(hdrlist[handle]==NULL)
+  if(edflib_hdr(handle)==NULL)
   {
     return(-1);
   }
 
-  if(!(hdrlist[handle]->writemode))
+  if(!(edflib_hdr(handle)->writemode))
   {
     return(-1);
   }
@@ -5577,12 +6470,12 @@ int edf_set_digital_minimum(int handle, int edfsignal, int dig_min)
     return(-1);
   }
 
-  if(edfsignal>=hdrlist[handle]->edfsignals)
+  if(edfsignal>=edflib_hdr(handle)->edfsignals)
   {
     return(-1);
   }
 
-  if(hdrlist[handle]->edf)
+  if(edflib_hdr(handle)->edf)
   {
     if(dig_min < (-32768))
     {
@@ -5597,12 +6490,12 @@ int edf_set_digital_minimum(int handle, int edfsignal, int dig_min)
     }
   }
 
-  if(hdrlist[handle]->datarecords)
+  if(edflib_hdr(handle)->datarecords)
   {
     return(-1);
   }
 
-  hdrlist[handle]->edfparam[edfsignal].dig_min = dig_min;
+  edflib_hdr(handle)->edfparam[edfsignal].dig_min = dig_min;
 
   return(0);
 }
@@ -5620,26 +6513,26 @@ int edf_set_patientname(int handle, const char *patientname)
     return(-1);
   }
 
-  if(hdrlist[handle]==NULL)
+  if(edflib_hdr(handle)==NULL)
   {
     return(-1);
   }
 
-  if(!(hdrlist[handle]->writemode))
+  if(!(edflib_hdr(handle)->writemode))
   {
     return(-1);
   }
 
-  if(hdrlist[handle]->datarecords)
+  if(edflib_hdr(handle)->datarecords)
   {
     return(-1);
   }
 
-  strncpy(hdrlist[handle]->plus_patient_name, patientname, 80);
+  strncpy(edflib_hdr(handle)->plus_patient_name, patientname, 80);
 
-  hdrlist[handle]->plus_patient_name[80] = 0;
+  edflib_hdr(handle)->plus_patient_name[80] = 0;
 
-  edflib_remove_padding_trailing_spaces(hdrlist[handle]->plus_patient_name);
+  edflib_remove_padding_trailing_spaces(edflib_hdr(handle)->plus_patient_name);
 
   return(0);
 }
@@ -5657,26 +6550,26 @@ int edf_set_patientcode(int handle, const char *patientcode)
     return(-1);
   }
 
-  if(hdrlist[handle]==NULL)
+  if(edflib_hdr(handle)==NULL)
   {
     return(-1);
   }
 
-  if(!(hdrlist[handle]->writemode))
+  if(!(edflib_hdr(handle)->writemode))
   {
     return(-1);
   }
 
-  if(hdrlist[handle]->datarecords)
+  if(edflib_hdr(handle)->datarecords)
   {
     return(-1);
   }
 
-  strncpy(hdrlist[handle]->plus_patientcode, patientcode, 80);
+  strncpy(edflib_hdr(handle)->plus_patientcode, patientcode, 80);
 
-  hdrlist[handle]->plus_patientcode[80] = 0;
+  edflib_hdr(handle)->plus_patientcode[80] = 0;
 
-  edflib_remove_padding_trailing_spaces(hdrlist[handle]->plus_patientcode);
+  edflib_remove_padding_trailing_spaces(edflib_hdr(handle)->plus_patientcode);
 
   return(0);
 }
@@ -5694,17 +6587,17 @@ int edf_set_gender(int handle, int gender)
     return(-1);
   }
 
-  if(hdrlist[handle]==NULL)
+  if(edflib_hdr(handle)==NULL)
   {
     return(-1);
   }
 
-  if(!(hdrlist[handle]->writemode))
+  if(!(edflib_hdr(handle)->writemode))
   {
     return(-1);
   }
 
-  if(hdrlist[handle]->datarecords)
+  if(edflib_hdr(handle)->datarecords)
   {
     return(-1);
   }
@@ -5716,14 +6609,14 @@ int edf_set_gender(int handle, int gender)
 
   if(gender)
   {
-    hdrlist[handle]->plus_gender[0] = 'M';
+    edflib_hdr(handle)->plus_gender[0] = 'M';
   }
   else
   {
-    hdrlist[handle]->plus_gender[0] = 'F';
+    edflib_hdr(handle)->plus_gender[0] = 'F';
   }
 
-  hdrlist[handle]->plus_gender[1] = 0;
+  edflib_hdr(handle)->plus_gender[1] = 0;
 
   return(0);
 }
@@ -5741,17 +6634,17 @@ int edf_set_birthdate(int handle, int birthdate_year, int birthdate_month, int b
     return(-1);
   }
 
-  if(hdrlist[handle]==NULL)
+  if(edflib_hdr(handle)==NULL)
   {
     return(-1);
   }
 
-  if(!(hdrlist[handle]->writemode))
+  if(!(edflib_hdr(handle)->writemode))
   {
     return(-1);
   }
 
-  if(hdrlist[handle]->datarecords)
+  if(edflib_hdr(handle)->datarecords)
   {
     return(-1);
   }
@@ -5763,9 +6656,9 @@ int edf_set_birthdate(int handle, int birthdate_year, int birthdate_month, int b
     return(-1);
   }
 
-  sprintf(hdrlist[handle]->plus_birthdate, "%02i.%02i.%02i%02i", birthdate_day, birthdate_month, birthdate_year / 100, birthdate_year % 100);
+  sprintf(edflib_hdr(handle)->plus_birthdate, "%02i.%02i.%02i%02i", birthdate_day, birthdate_month, birthdate_year / 100, birthdate_year % 100);
 
-  hdrlist[handle]->plus_birthdate[10] = 0;
+  edflib_hdr(handle)->plus_birthdate[10] = 0;
 
   return(0);
 }
@@ -5783,26 +6676,26 @@ int edf_set_patient_additional(int handle, const char *patient_additional)
     return(-1);
   }
 
-  if(hdrlist[handle]==NULL)
+  if(edflib_hdr(handle)==NULL)
   {
     return(-1);
   }
 
-  if(!(hdrlist[handle]->writemode))
+  if(!(edflib_hdr(handle)->writemode))
   {
     return(-1);
   }
 
-  if(hdrlist[handle]->datarecords)
+  if(edflib_hdr(handle)->datarecords)
   {
     return(-1);
   }
 
-  strncpy(hdrlist[handle]->plus_patient_additional, patient_additional, 80);
+  strncpy(edflib_hdr(handle)->plus_patient_additional, patient_additional, 80);
 
-  hdrlist[handle]->plus_patient_additional[80] = 0;
+  edflib_hdr(handle)->plus_patient_additional[80] = 0;
 
-  edflib_remove_padding_trailing_spaces(hdrlist[handle]->plus_patient_additional);
+  edflib_remove_padding_trailing_spaces(edflib_hdr(handle)->plus_patient_additional);
 
   return(0);
 }
@@ -5820,26 +6713,26 @@ int edf_set_admincode(int handle, const char *admincode)
     return(-1);
   }
 
-  if(hdrlist[handle]==NULL)
+  if(edflib_hdr(handle)==NULL)
   {
     return(-1);
   }
 
-  if(!(hdrlist[handle]->writemode))
+  if(!(edflib_hdr(handle)->writemode))
   {
     return(-1);
   }
 
-  if(hdrlist[handle]->datarecords)
+  if(edflib_hdr(handle)->datarecords)
   {
     return(-1);
   }
 
-  strncpy(hdrlist[handle]->plus_admincode, admincode, 80);
+  strncpy(edflib_hdr(handle)->plus_admincode, admincode, 80);
 
-  hdrlist[handle]->plus_admincode[80] = 0;
+  edflib_hdr(handle)->plus_admincode[80] = 0;
 
-  edflib_remove_padding_trailing_spaces(hdrlist[handle]->plus_admincode);
+  edflib_remove_padding_trailing_spaces(edflib_hdr(handle)->plus_admincode);
 
   return(0);
 }
@@ -5857,26 +6750,26 @@ int edf_set_technician(int handle, const char *technician)
     return(-1);
   }
 
-  if(hdrlist[handle]==NULL)
+  if(edflib_hdr(handle)==NULL)
   {
     return(-1);
   }
 
-  if(!(hdrlist[handle]->writemode))
+  if(!(edflib_hdr(handle)->writemode))
   {
     return(-1);
   }
 
-  if(hdrlist[handle]->datarecords)
+  if(edflib_hdr(handle)->datarecords)
   {
     return(-1);
   }
 
-  strncpy(hdrlist[handle]->plus_technician, technician, 80);
+  strncpy(edflib_hdr(handle)->plus_technician, technician, 80);
 
-  hdrlist[handle]->plus_technician[80] = 0;
+  edflib_hdr(handle)->plus_technician[80] = 0;
 
-  edflib_remove_padding_trailing_spaces(hdrlist[handle]->plus_technician);
+  edflib_remove_padding_trailing_spaces(edflib_hdr(handle)->plus_technician);
 
   return(0);
 }
@@ -5894,26 +6787,26 @@ int edf_set_equipment(int handle, const char *equipment)
     return(-1);
   }
 
-  if(hdrlist[handle]==NULL)
+  if(edflib_hdr(handle)==NULL)
   {
     return(-1);
   }
 
-  if(!(hdrlist[handle]->writemode))
+  if(!(edflib_hdr(handle)->writemode))
   {
     return(-1);
   }
 
-  if(hdrlist[handle]->datarecords)
+  if(edflib_hdr(handle)->datarecords)
   {
     return(-1);
   }
 
-  strncpy(hdrlist[handle]->plus_equipment, equipment, 80);
+  strncpy(edflib_hdr(handle)->plus_equipment, equipment, 80);
 
-  hdrlist[handle]->plus_equipment[80] = 0;
+  edflib_hdr(handle)->plus_equipment[80] = 0;
 
-  edflib_remove_padding_trailing_spaces(hdrlist[handle]->plus_equipment);
+  edflib_remove_padding_trailing_spaces(edflib_hdr(handle)->plus_equipment);
 
   return(0);
 }
@@ -5931,26 +6824,26 @@ int edf_set_recording_additional(int handle, const char *recording_additional)
     return(-1);
   }
 
-  if(hdrlist[handle]==NULL)
+  if(edflib_hdr(handle)==NULL)
   {
     return(-1);
   }
 
-  if(!(hdrlist[handle]->writemode))
+  if(!(edflib_hdr(handle)->writemode))
   {
     return(-1);
   }
 
-  if(hdrlist[handle]->datarecords)
+  if(edflib_hdr(handle)->datarecords)
   {
     return(-1);
   }
 
-  strncpy(hdrlist[handle]->plus_recording_additional, recording_additional, 80);
+  strncpy(edflib_hdr(handle)->plus_recording_additional, recording_additional, 80);
 
-  hdrlist[handle]->plus_recording_additional[80] = 0;
+  edflib_hdr(handle)->plus_recording_additional[80] = 0;
 
-  edflib_remove_padding_trailing_spaces(hdrlist[handle]->plus_recording_additional);
+  edflib_remove_padding_trailing_spaces(edflib_hdr(handle)->plus_recording_additional);
 
   return(0);
 }
@@ -5969,17 +6862,17 @@ int edf_set_startdatetime(int handle, int startdate_year, int startdate_month, i
     return(-1);
   }
 
-  if(hdrlist[handle]==NULL)
+  if(edflib_hdr(handle)==NULL)
   {
     return(-1);
   }
 
-  if(!(hdrlist[handle]->writemode))
+  if(!(edflib_hdr(handle)->writemode))
   {
     return(-1);
   }
 
-  if(hdrlist[handle]->datarecords)
+  if(edflib_hdr(handle)->datarecords)
   {
     return(-1);
   }
@@ -5994,12 +6887,12 @@ int edf_set_startdatetime(int handle, int startdate_year, int startdate_month, i
     return(-1);
   }
 
-  hdrlist[handle]->startdate_year = startdate_year;
-  hdrlist[handle]->startdate_month = startdate_month;
-  hdrlist[handle]->startdate_day = startdate_day;
-  hdrlist[handle]->starttime_hour = starttime_hour;
-  hdrlist[handle]->starttime_minute = starttime_minute;
-  hdrlist[handle]->starttime_second = starttime_second;
+  edflib_hdr(handle)->startdate_year = startdate_year;
+  edflib_hdr(handle)->startdate_month = startdate_month;
+  edflib_hdr(handle)->startdate_day = startdate_day;
+  edflib_hdr(handle)->starttime_hour = starttime_hour;
+  edflib_hdr(handle)->starttime_minute = starttime_minute;
+  edflib_hdr(handle)->starttime_second = starttime_second;
 
   return(0);
 }
@@ -6022,12 +6915,12 @@ int edfwrite_annotation_utf8(int handle, long long onset, long long duration, co
     return(-1);
   }
 
-  if(hdrlist[handle]==NULL)
+  if(edflib_hdr(handle)==NULL)
   {
     return(-1);
   }
 
-  if(!(hdrlist[handle]->writemode))
+  if(!(edflib_hdr(handle)->writemode))
   {
     return(-1);
   }
@@ -6037,21 +6930,21 @@ int edfwrite_annotation_utf8(int handle, long long onset, long long duration, co
     return(-1);
   }
 
-  if(hdrlist[handle]->annots_in_file >= hdrlist[handle]->annotlist_sz)
+  if(edflib_hdr(handle)->annots_in_file >= edflib_hdr(handle)->annotlist_sz)
   {
-    malloc_list = (struct edf_write_annotationblock *)realloc(write_annotationslist[handle],
-                                                              sizeof(struct edf_write_annotationblock) * (hdrlist[handle]->annotlist_sz + EDFLIB_ANNOT_MEMBLOCKSZ));
+    malloc_list = (struct edf_write_annotationblock *)realloc(edflib_hdr(handle)->write_annotationslist,
+                                                              sizeof(struct edf_write_annotationblock) * (edflib_hdr(handle)->annotlist_sz + EDFLIB_ANNOT_MEMBLOCKSZ));
     if(malloc_list==NULL)
     {
       return(-1);
     }
 
-    write_annotationslist[handle] = malloc_list;
+    edflib_hdr(handle)->write_annotationslist = malloc_list;
 
-    hdrlist[handle]->annotlist_sz += EDFLIB_ANNOT_MEMBLOCKSZ;
+    edflib_hdr(handle)->annotlist_sz += EDFLIB_ANNOT_MEMBLOCKSZ;
   }
 
-  list_annot = write_annotationslist[handle] + hdrlist[handle]->annots_in_file;
+  list_annot = edflib_hdr(handle)->write_annotationslist + edflib_hdr(handle)->annots_in_file;
 
   list_annot->onset = onset;
   list_annot->duration = duration;
@@ -6071,7 +6964,7 @@ int edfwrite_annotation_utf8(int handle, long long onset, long long duration, co
     }
   }
 
-  hdrlist[handle]->annots_in_file++;
+  edflib_hdr(handle)->annots_in_file++;
 
   return(0);
 }
@@ -6094,12 +6987,12 @@ int edfwrite_annotation_latin1(int handle, long long onset, long long duration,
     return(-1);
   }
 
-  if(hdrlist[handle]==NULL)
+  if(edflib_hdr(handle)==NULL)
   {
     return(-1);
   }
 
-  if(!(hdrlist[handle]->writemode))
+  if(!(edflib_hdr(handle)->writemode))
   {
     return(-1);
   }
@@ -6109,21 +7002,21 @@ int edfwrite_annotation_latin1(int handle, long long onset, long long duration,
     return(-1);
   }
 
-  if(hdrlist[handle]->annots_in_file >= hdrlist[handle]->annotlist_sz)
+  if(edflib_hdr(handle)->annots_in_file >= edflib_hdr(handle)->annotlist_sz)
   {
-    malloc_list = (struct edf_write_annotationblock *)realloc(write_annotationslist[handle],
-                                                              sizeof(struct edf_write_annotationblock) * (hdrlist[handle]->annotlist_sz + EDFLIB_ANNOT_MEMBLOCKSZ));
+    malloc_list = (struct edf_write_annotationblock *)realloc(edflib_hdr(handle)->write_annotationslist,
+                                                              sizeof(struct edf_write_annotationblock) * (edflib_hdr(handle)->annotlist_sz + EDFLIB_ANNOT_MEMBLOCKSZ));
     if(malloc_list==NULL)
     {
       return(-1);
     }
 
-    write_annotationslist[handle] = malloc_list;
+    edflib_hdr(handle)->write_annotationslist = malloc_list;
 
-    hdrlist[handle]->annotlist_sz += EDFLIB_ANNOT_MEMBLOCKSZ;
+    edflib_hdr(handle)->annotlist_sz += EDFLIB_ANNOT_MEMBLOCKSZ;
   }
 
-  list_annot = write_annotationslist[handle] + hdrlist[handle]->annots_in_file;
+  list_annot = edflib_hdr(handle)->write_annotationslist + edflib_hdr(handle)->annots_in_file;
 
   list_annot->onset = onset;
   list_annot->duration = duration;
@@ -6133,7 +7026,7 @@ int edfwrite_annotation_latin1(int handle, long long onset, long long duration,
   strncpy(list_annot->annotation, str, EDFLIB_WRITE_MAX_ANNOTATION_LEN);
   list_annot->annotation[EDFLIB_WRITE_MAX_ANNOTATION_LEN] = 0;
 
-  hdrlist[handle]->annots_in_file++;
+  edflib_hdr(handle)->annots_in_file++;
 
   return(0);
 }
@@ -6182,12 +7075,12 @@ int edf_set_prefilter(int handle, int edfsignal, const char *prefilter)
     return(-1);
   }
 
-  if(hdrlist[handle]==NULL)
+  if(edflib_hdr(handle)==NULL)
   {
     return(-1);
   }
 
-  if(!(hdrlist[handle]->writemode))
+  if(!(edflib_hdr(handle)->writemode))
   {
     return(-1);
   }
@@ -6197,21 +7090,21 @@ int edf_set_prefilter(int handle, int edfsignal, const char *prefilter)
     return(-1);
   }
 
-  if(edfsignal>=hdrlist[handle]->edfsignals)
+  if(edfsignal>=edflib_hdr(handle)->edfsignals)
   {
     return(-1);
   }
 
-  if(hdrlist[handle]->datarecords)
+  if(edflib_hdr(handle)->datarecords)
   {
     return(-1);
   }
 
-  strncpy(hdrlist[handle]->edfparam[edfsignal].prefilter, prefilter, 80);
+  strncpy(edflib_hdr(handle)->edfparam[edfsignal].prefilter, prefilter, 80);
 
-  hdrlist[handle]->edfparam[edfsignal].prefilter[80] = 0;
+  edflib_hdr(handle)->edfparam[edfsignal].prefilter[80] = 0;
 
-  edflib_remove_padding_trailing_spaces(hdrlist[handle]->edfparam[edfsignal].prefilter);
+  edflib_remove_padding_trailing_spaces(edflib_hdr(handle)->edfparam[edfsignal].prefilter);
 
   return(0);
 }
@@ -6229,12 +7122,12 @@ int edf_set_transducer(int handle, int edfsignal, const char *transducer)
     return(-1);
   }
 
-  if(hdrlist[handle]==NULL)
+  if(edflib_hdr(handle)==NULL)
   {
     return(-1);
   }
 
-  if(!(hdrlist[handle]->writemode))
+  if(!(edflib_hdr(handle)->writemode))
   {
     return(-1);
   }
@@ -6244,21 +7137,21 @@ int edf_set_transducer(int handle, int edfsignal, const char *transducer)
     return(-1);
   }
 
-  if(edfsignal>=hdrlist[handle]->edfsignals)
+  if(edfsignal>=edflib_hdr(handle)->edfsignals)
   {
     return(-1);
   }
 
-  if(hdrlist[handle]->datarecords)
+  if(edflib_hdr(handle)->datarecords)
   {
     return(-1);
   }
 
-  strncpy(hdrlist[handle]->edfparam[edfsignal].transducer, transducer, 80);
+  strncpy(edflib_hdr(handle)->edfparam[edfsignal].transducer, transducer, 80);
 
-  hdrlist[handle]->edfparam[edfsignal].transducer[80] = 0;
+  edflib_hdr(handle)->edfparam[edfsignal].transducer[80] = 0;
 
-  edflib_remove_padding_trailing_spaces(hdrlist[handle]->edfparam[edfsignal].transducer);
+  edflib_remove_padding_trailing_spaces(edflib_hdr(handle)->edfparam[edfsignal].transducer);
 
   return(0);
 }
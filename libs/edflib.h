@@ -169,6 +169,7 @@ int edfopen_file_readonly(const char *path, struct edf_hdr_struct *edfhdr, int r
 
 /* returns 0 on success, in case of an error it returns -1 and an errorcode will be set in the member "filetype" of struct edf_hdr_struct */
 /* This function is required if you want to read a file */
+/* Files can be opened and closed from different threads, up to 65536 files can be open at the same time */
 
 
 
@@ -216,12 +217,74 @@ void edfrewind(int handle, int edfsignal);
 /* note that every signal has it's own independent sample position indicator and edfrewind() affects only one of them */
 
 
+long long edfread_physical_samples_at(int handle, int edfsignal, long long start, long long n, double *buf);
+
+/* reads n samples from edfsignal, starting from the sample start, into buf (edfsignal starts at 0) */
+/* the values are converted to their physical values e.g. microVolts, beats per minute, etc. */
+/* bufsize should be equal to or bigger than sizeof(double[n]) */
+/* the sample position indicator is not used and not changed, the file is read with positional reads */
+/* (pread) which do not share a file position, so many threads can read different signals or ranges */
+/* of the same handle at the same time, without opening the file more times */
+/* the handle must not be closed while another thread reads from it */
+/* on Windows, do not mix this function with edfread_physical_samples() on the same handle from different threads */
+/* returns the amount of samples read (this can be less than n or zero!) */
+/* or -1 in case of an error */
+
+
+long long edfread_digital_samples_at(int handle, int edfsignal, long long start, long long n, int *buf);
+
+/* reads n samples from edfsignal, starting from the sample start, into buf (edfsignal starts at 0) */
+/* the values are the "raw" digital values */
+/* bufsize should be equal to or bigger than sizeof(int[n]) */
+/* thread safety is the same as edfread_physical_samples_at() */
+/* returns the amount of samples read (this can be less than n or zero!) */
+/* or -1 in case of an error */
+
+
+struct edf_read_request_struct{    /* one range of samples of a vectored read, see edfread_physical_samples_vec() */
+  int       edfsignal;             /* the signal (edfsignal starts at 0) */
+  long long start;                 /* the first sample */
+  long long n;                     /* the amount of samples */
+  double   *buf;                   /* the samples, bufsize should be equal to or bigger than sizeof(double[n]) */
+  float    *fbuf;                  /* the samples as floats, used instead of buf when buf is NULL */
+  long long read;                  /* set by the read, the amount of samples read (this can be less than n or zero at the end of the signal) */
+       };
+
+long long edfread_physical_samples_vec(int handle, struct edf_read_request_struct *requests, int count);
+
+/* reads count ranges of samples of any signals, converted to their physical values, into their buffers */
+/* the ranges are sorted by their datarecords, the ranges which share datarecords or are less than 64 kB apart */
+/* are read together by positional reads of whole datarecords (at most 4 MB each), so every needed */
+/* datarecord is read once for all ranges, however many short ranges it holds */
+/* when the ranges need only a small part of long datarecords (a few of many signals), a group is read */
+/* by one positional read per datarecord and range instead, one read is counted as 64 kB */
+/* the ranges can be in any order and can overlap, the order of the requests is not changed */
+/* thread safety is the same as edfread_physical_samples_at() */
+/* returns the total amount of samples read */
+/* or -1 in case of an error */
+
+
 int edf_get_annotation(int handle, int n, struct edf_annotation_struct *annot);
 
 /* Fills the edf_annotation_struct with the annotation n, returns 0 on success, otherwise -1 */
 /* The string that describes the annotation/event is encoded in UTF-8 */
 /* To obtain the number of annotations in a file, check edf_hdr_struct -> annotations_in_file. */
 
+
+typedef void (*edf_annotation_callback)(const struct edf_annotation_struct *annot, void *userdata);
+
+long long edfread_annotations(int handle, long long first_datarecord, long long datarecords, edf_annotation_callback callback, void *userdata);
+
+/* Parses the annotations (TAL's) which are stored in the datarecords first_datarecord up to */
+/* first_datarecord + datarecords - 1 and calls callback for every annotation found, in file order */
+/* The annotations are not stored by the library, they are passed only to the callback */
+/* This makes it possible to open a large EDFplus or BDFplus file with EDFLIB_DO_NOT_READ_ANNOTATIONS */
+/* and to read the annotations later, on demand or in the background */
+/* The function uses its own file stream, it does not touch the sample position indicators */
+/* and it can be called from another thread while samples are being read */
+/* Returns the number of annotations found, or -1 in case of an error */
+
+
 /*
 Notes:
 
@@ -13,8 +13,19 @@
 #include "header.h"
 #include "help.h"
 #include <QPointF>
+#include <QDialog>
+#include <QVBoxLayout>
+#include <algorithm>
+#include <cmath>
 #include "libs/CInputEDF.h"
 #include "libs/CSpikeDetector.h"
+#include "libs/CProfiler.h"
+#include "libs/CSpectrum.h"
+
+//size of the spike markers (pixel), the spike rate is shown when the markers of a channel would overlap
+#define SPIKE_MARKER_SIZE 9
+//width of the cells of the spike rate (pixel)
+#define SPIKE_RATE_CELL 2
 
 MainWindow::MainWindow(QWidget *parent) :
   QMainWindow(parent),
@@ -24,12 +35,51 @@ MainWindow::MainWindow(QWidget *parent) :
   srand(QDateTime::currentDateTime().toTime_t());
   ui->setupUi(this);
   setupGraphArea();
+
+  //sensitivity of the detector, the spikes of the loaded windows are retuned while the slider moves
+  spikeK1 = detectionCache.GetSettings().m_k1;
+  kLabel = new QLabel(QString("k1 %1").arg(spikeK1, 0, 'f', 2), this);
+  kSlider = new QSlider(Qt::Horizontal, this);
+  kSlider->setRange(150, 600);
+  kSlider->setValue(qRound(spikeK1 * 100));
+  kSlider->setMaximumWidth(200);
+  kSlider->setToolTip("Threshold of the spike detector, higher - fewer spikes");
+  ui->statusBar->addPermanentWidget(kLabel);
+  ui->statusBar->addPermanentWidget(kSlider);
+  connect(kSlider, SIGNAL(valueChanged(int)), this, SLOT(kSliderChanged(int)));
+
+  //montage of the channels, the plot and the detector read the derivations
+  const char *montages[][2] = {{"Referential", "referential"}, {"Bipolar", "bipolar"}, {"Common average", "average"}, {"Custom...", ""}};
+  QMenu *montageMenu = ui->menuBar->addMenu("Montage");
+  montageGroup = new QActionGroup(this);
+  for (int i = 0; i < 4; i++)
+  {
+    QAction *action = montageMenu->addAction(montages[i][0]);
+    action->setCheckable(true);
+    action->setChecked(i == 0);
+    action->setData(QString(montages[i][1]));
+    montageGroup->addAction(action);
+  }
+  montageDefinition = "referential";
+  connect(montageGroup, SIGNAL(triggered(QAction*)), this, SLOT(montageTriggered(QAction*)));
+
+  //spectra of the visible time window, the line noise and the band before the settings of the detector
+  QMenu *spectrumMenu = ui->menuBar->addMenu("Spectrum");
+  connect(spectrumMenu->addAction("Power spectra"), SIGNAL(triggered()), this, SLOT(powerSpectraTriggered()));
+  connect(spectrumMenu->addAction("Spectrogram..."), SIGNAL(triggered()), this, SLOT(spectrogramTriggered()));
+
+  // stage timing of the detector, only in builds with CONFIG+=edf_profile
+  CProfiler::SetEnabled(CProfiler::IsCompiled());
+  ui->actionExport_Trace->setEnabled(CProfiler::IsCompiled());
   
 
 }
 
 MainWindow::~MainWindow()
 {
+  //the background threads report to this window
+  annotationIndex.Detach();
+  detectionCache.Detach();
   delete ui;
 }
 
@@ -72,6 +122,8 @@ void MainWindow::setupGraphArea(){
     // make bottom and left axes transfer their ranges to top and right axes:
     connect(ui->customPlot->xAxis, SIGNAL(rangeChanged(QCPRange)), ui->customPlot->xAxis2, SLOT(setRange(QCPRange)));
     connect(ui->customPlot->yAxis, SIGNAL(rangeChanged(QCPRange)), ui->customPlot->yAxis2, SLOT(setRange(QCPRange)));
+    //only the visible spikes are plotted, updated on every pan or zoom
+    connect(ui->customPlot->xAxis, SIGNAL(rangeChanged(QCPRange)), this, SLOT(xAxisRangeChanged(QCPRange)));
 
     // connect some interaction slots:
     connect(ui->customPlot, SIGNAL(titleDoubleClick(QMouseEvent*,QCPPlotTitle*)), this, SLOT(titleDoubleClick(QMouseEvent*,QCPPlotTitle*)));
@@ -233,6 +285,10 @@ void MainWindow::removeChannelByLabel(QCustomPlot *customPlot, QString label)
 void MainWindow::removeAllGraphs()
 {
   ui->customPlot->clearGraphs();
+  spikeOverlays.clear();
+  if (!spikeRateMap.isNull())
+    ui->customPlot->removePlottable(spikeRateMap);
+  ui->customPlot->clearItems();
   notshown.append(shown);
   shown.clear();
   notshown.sort();
@@ -277,6 +333,10 @@ void MainWindow::on_actionOpen_triggered()
                     "EEG Files (*.edf; *.bdf; *.rec; *.EDF; *.BDF; *.REC);;All files(*.*)");
   if (filenameg != NULL)
   {
+    annotationIndex.Clear();
+    detectionCache.Detach();
+    viewModel.CloseFile();
+    spikeHistogram.Clear();
     if ((hdr.filetype >= 0) && (hdr.filetype <= 3)){
       edfclose_file(hdr.handle);
     }
@@ -295,7 +355,8 @@ void MainWindow::on_actionOpen_triggered()
   notshown.clear();
 
   //read file and verify errors, check error code on edflib.h (if 0, no error found)
-  if(edfopen_file_readonly(filelocation, &hdr, EDFLIB_READ_ALL_ANNOTATIONS))
+  //annotations are not read here, they are parsed on demand and in the background by annotationIndex
+  if(edfopen_file_readonly(filelocation, &hdr, EDFLIB_DO_NOT_READ_ANNOTATIONS))
   {
     switch(hdr.filetype)
     {
@@ -321,6 +382,12 @@ void MainWindow::on_actionOpen_triggered()
   }
 
   hdl = hdr.handle;
+  annotationIndex.Attach(hdl, hdr);
+  annotationIndex.StartBackground([this]() {
+    //called from the parsing thread
+    QMetaObject::invokeMethod(this, "annotationsLoaded", Qt::QueuedConnection);
+  });
+  detectionCache.Attach(hdr);
 
   //SET HEADER:
   header.clear();
@@ -335,15 +402,276 @@ void MainWindow::on_actionOpen_triggered()
   header += "<b>Date: </b>" + day + "" + month + "" + year + "<br>";
   header += "<b>Equipment: </b>" + equipment + "<br>";
 
-  for (int i = 0;i < hdr.edfsignals;i++){
-    notshown.append(QString(hdr.signalparam[i].label));
-    labelchannel.insert(hdr.signalparam[i].label, i);
-    labelposition.insert(hdr.signalparam[i].label, totalGraphs);
+  //the channels are the derivations of the montage, the signals of the file if it does not fit the file
+  viewModel.AttachFile(hdr);
+  pageCache.reset(new CPageCache());
+  viewModel.SetPageCache(pageCache);
+  if (!applyMontage(montageDefinition))
+  {
+    montageGroup->actions().first()->setChecked(true);
+    applyMontage("referential");
+  }
+
+}
+
+bool MainWindow::applyMontage(const QString &definition)
+{
+  std::shared_ptr<CMontage> montage(new CMontage());
+
+  //kept for the next file
+  if (!viewModel.IsOpen())
+  {
+    montageDefinition = definition;
+    return true;
+  }
+
+  try
+  {
+    montage->Parse(definition.toStdString(), hdr);
+    viewModel.SetMontage(montage);
+    detectionCache.SetMontage(montage, pageCache);
+  }
+  catch (const char * error)
+  {
+    QMessageBox::warning(this, tr("Alert"), QString(error));
+    return false;
+  }
+  montageDefinition = definition;
+
+  //the derivations replace the channels, the shown ones stay if the montage has them
+  //the pages of the signals are in the cache, the file is not read again
+  QStringList shownbkp = shown;
+  removeAllGraphs();
+  spikeHistogram.Clear();
+  labelchannel.clear();
+  labelposition.clear();
+  shown.clear();
+  notshown.clear();
+
+  for (int i = 0; i < montage->GetCountDerivations(); i++){
+    notshown.append(QString(montage->GetLabel(i)));
+    labelchannel.insert(montage->GetLabel(i), i);
+    labelposition.insert(montage->GetLabel(i), totalGraphs);
+  }
+
+  foreach (QString str, shownbkp) {
+    if (labelchannel.contains(str)) {
+      shown.append(str);
+      notshown.removeOne(str);
+    }
   }
 
   notshown.sort();
   shown.sort();
 
+  foreach (QString str, shown) {
+    insertChannel(ui->customPlot, str);
+  }
+  insertAnnotations(ui->customPlot);
+  return true;
+}
+
+void MainWindow::montageTriggered(QAction *action)
+{
+  QString definition = action->data().toString();
+  bool ok = true;
+
+  if (definition.isEmpty())
+    definition = QInputDialog::getText(this, tr("Custom montage"), tr("Derivations, comma separated (e.g. Fp1-F3, C3-AVG, O1)"),
+                                       QLineEdit::Normal, montageDefinition, &ok);
+
+  if (!ok || definition.isEmpty() || !applyMontage(definition))
+  {
+    //the check mark stays at the montage in use
+    foreach (QAction *other, montageGroup->actions()) {
+      if (other->data().toString() == montageDefinition)
+        other->setChecked(true);
+    }
+  }
+}
+
+QCustomPlot *MainWindow::openSpectrumWindow(const QString &title)
+{
+  //non-modal, the traces stay usable while the spectra are compared
+  QDialog *window = new QDialog(this);
+  QVBoxLayout *layout = new QVBoxLayout(window);
+  QCustomPlot *plot = new QCustomPlot(window);
+
+  window->setAttribute(Qt::WA_DeleteOnClose);
+  window->setWindowTitle(title);
+  window->resize(800, 500);
+  layout->addWidget(plot);
+  plot->setInteractions(QCP::iRangeDrag | QCP::iRangeZoom);
+  plot->xAxis->setLabel("frequency(Hz)");
+  window->show();
+
+  return plot;
+}
+
+void MainWindow::addFrequencyLines(QCustomPlot *plot, double maximum, bool vertical)
+{
+  //the harmonics of the line noise (red) and the band of the detector (green)
+  const DETECTOR_SETTINGS &settings = detectionCache.GetSettings();
+  QVector<double> frequencies;
+  QVector<QColor> colors;
+  QPen pen;
+
+  for (int k = 1; settings.m_main_hum_freq > 0 && k * settings.m_main_hum_freq <= maximum; k++) {
+    frequencies.append(k * settings.m_main_hum_freq);
+    colors.append(QColor(255, 0, 0));
+  }
+  frequencies << settings.m_band_low << settings.m_band_high;
+  colors << QColor(0, 160, 0) << QColor(0, 160, 0);
+
+  pen.setStyle(Qt::DashLine);
+  for (int i = 0; i < frequencies.size(); i++)
+  {
+    QCPItemStraightLine *line = new QCPItemStraightLine(plot);
+    plot->addItem(line);
+    pen.setColor(colors[i]);
+    line->setPen(pen);
+    line->point1->setCoords(vertical ? frequencies[i] : 0, vertical ? 0 : frequencies[i]);
+    line->point2->setCoords(vertical ? frequencies[i] : 1, vertical ? 1 : frequencies[i]);
+  }
+}
+
+void MainWindow::powerSpectraTriggered()
+{
+  QCPRange range = ui->customPlot->xAxis->range();
+  std::vector<std::vector<double> > psd;
+  std::vector<int> channels;
+  CSpectrum spectrum(&viewModel);
+  double maximum = 0;
+
+  if (!viewModel.IsOpen() || shown.isEmpty()) {
+    ui->statusBar->showMessage("Add channels to the plot first.", 5000);
+    return;
+  }
+
+  foreach (QString str, shown) {
+    channels.push_back(labelchannel.value(str));
+  }
+
+  //the channels in parallel, read by blocks from the page cache
+  try
+  {
+    spectrum.WelchChannels(channels, qMax(range.lower, 0.0), range.upper, psd);
+  }
+  catch (const char *error)
+  {
+    QMessageBox::warning(this, tr("Alert"), QString(error));
+    return;
+  }
+
+  QCustomPlot *plot = openSpectrumWindow(QString("Power spectra %1 - %2 s").arg(qMax(range.lower, 0.0), 0, 'f', 1).arg(range.upper, 0, 'f', 1));
+  plot->yAxis->setLabel("PSD(uV^2/Hz)");
+  plot->yAxis->setScaleType(QCPAxis::stLogarithmic);
+  plot->yAxis->setScaleLogBase(10);
+  plot->legend->setVisible(true);
+
+  for (size_t i = 0; i < channels.size(); i++)
+  {
+    QVector<double> frequency, power;
+
+    //without the DC bin, the mean is removed
+    for (size_t bin = 1; bin < psd[i].size(); bin++) {
+      frequency.append(spectrum.GetFrequency(channels[i], bin));
+      power.append(qMax(psd[i][bin], 1e-12));
+    }
+
+    QCPGraph *graph = plot->addGraph();
+    graph->setName(shown[i]);
+    graph->setPen(QPen(QColor::fromHsv(i * 360 / channels.size(), 255, 200)));
+    graph->setData(frequency, power);
+    if (!frequency.isEmpty())
+      maximum = qMax(maximum, frequency.last());
+  }
+
+  plot->rescaleAxes();
+  addFrequencyLines(plot, maximum, true);
+  plot->replot();
+}
+
+void MainWindow::spectrogramTriggered()
+{
+  QCPRange range = ui->customPlot->xAxis->range();
+  std::vector<std::vector<double> > columns;
+  CSpectrum spectrum(&viewModel);
+  bool ok = false;
+
+  if (!viewModel.IsOpen() || shown.isEmpty()) {
+    ui->statusBar->showMessage("Add channels to the plot first.", 5000);
+    return;
+  }
+
+  QString label = QInputDialog::getItem(this, tr("Spectrogram"), tr("Channel"), shown, 0, false, &ok);
+  if (!ok)
+    return;
+
+  //one column per two pixels of the plot, a long window samples the windows of its columns
+  int channel = labelchannel.value(label);
+  int countColumns = qMax(ui->customPlot->axisRect()->width() / 2, 10);
+  double t0 = qMax(range.lower, 0.0), t1 = range.upper;
+
+  try
+  {
+    spectrum.Spectrogram(channel, t0, t1, countColumns, columns);
+  }
+  catch (const char *error)
+  {
+    QMessageBox::warning(this, tr("Alert"), QString(error));
+    return;
+  }
+
+  int bins = columns.empty() ? 0 : columns[0].size();
+  double nyquist = spectrum.GetFrequency(channel, bins - 1);
+  double width = (t1 - t0) / countColumns;
+
+  QCustomPlot *plot = openSpectrumWindow(QString("Spectrogram %1").arg(label));
+  plot->xAxis->setLabel("time(s)");
+  plot->yAxis->setLabel("frequency(Hz)");
+
+  QCPColorMap *map = new QCPColorMap(plot->xAxis, plot->yAxis);
+  plot->addPlottable(map);
+  map->data()->setSize(countColumns, bins);
+  map->data()->setRange(QCPRange(t0 + width / 2, t1 - width / 2), QCPRange(0, nyquist));
+  for (int i = 0; i < countColumns; i++)
+    for (int j = 0; j < bins; j++)
+      map->data()->setCell(i, j, 10 * log10(qMax(columns[i][j], 1e-12)));
+
+  //the scale in dB beside the map
+  QCPColorScale *scale = new QCPColorScale(plot);
+  plot->plotLayout()->addElement(0, 1, scale);
+  scale->axis()->setLabel("PSD(dB)");
+  map->setColorScale(scale);
+  map->setGradient(QCPColorGradient::gpJet);
+  map->setInterpolate(false);
+  map->rescaleDataRange(true);
+
+  plot->rescaleAxes();
+  addFrequencyLines(plot, nyquist, false);
+  plot->replot();
+}
+
+long long MainWindow::readSamples(int channel, long long start, long long count, double *buf)
+{
+  //the derivation of the montage, the pages are shared with the detector
+  std::unique_ptr<std::vector<SIGNALTYPE> > samples;
+
+  try
+  {
+    samples.reset(viewModel.GetSegmentFromChannel(channel, start, start + count));
+  }
+  catch (const char *)
+  {
+    return -1;
+  }
+
+  if (!samples)
+    return -1;
+
+  std::copy(samples->begin(), samples->end(), buf);
+  return samples->size();
 }
 
 void MainWindow::insertSpikeGraph(QCustomPlot *customPlot, QString label){
@@ -354,131 +682,338 @@ void MainWindow::insertSpikeGraph(QCustomPlot *customPlot, QString label){
     nsamples = (end_time - start_time)/time_interval;
     int channel = labelchannel[label];
     double nsec = hdr.datarecords_in_file;
-    double totalsamples = hdr.signalparam[channel].smp_in_file;
+    double totalsamples = viewModel.GetCountSamples(channel);
     time_interval = nsec/totalsamples;
 
     //memory allocated to store data
-    buf = (double *)malloc(sizeof(double[nsamples]));
+    buf = (double *)malloc(nsamples * sizeof(double));
     if(buf==NULL)
     {
       printf("\nmalloc error\n");
-      edfclose_file(hdl);
       return;
     }
 
     if ((hdr.filetype < 0) || (hdr.filetype > 3)){
       QMessageBox::warning(this, tr("Alert"),QString("No file chosen"));
+      free(buf);
       return;
     }
 
-    edfseek(hdl, channel, (long long) ( ((start_time) / ((double)hdr.file_duration / (double)EDFLIB_TIME_DIMENSION)) * ((double)hdr.signalparam[channel].smp_in_file)), EDFSEEK_SET);
+    long long firstSample = (long long) ( ((start_time) / ((double)hdr.file_duration / (double)EDFLIB_TIME_DIMENSION)) * ((double)viewModel.GetCountSamples(channel)));
 
     //CHECK ERROR IN READ FUNCTION
-    if(edfread_physical_samples(hdl, channel, nsamples, buf) == (-1))
+    if(readSamples(channel, firstSample, nsamples, buf) == (-1))
     {
       //show here error message TODO
-      edfclose_file(hdl);
       free(buf);
       return;
     }
 
     QVector<double> x(nsamples), y(nsamples);
-    for (int i=0; i<nsamples; ++i)
+    for (long long i=0; i<nsamples; ++i)
     {
       x[i] = start_time + i*time_interval; //
       y[i] = buf[i] + labelposition[label]*3000;  //
     }
 
-    edfclose_file(hdl);
     free(buf);
 
     //---------------------------------------------------------------------------------------------
     //SPIKE DATA AREA
-    if ((hdr.filetype >= 0) && (hdr.filetype <= 3)){
-      edfclose_file(hdr.handle);
-    }
-
-    CInputEDF * model = new CInputEDF();
-    CSpikeDetector * detector = NULL;
-    DETECTOR_SETTINGS * detectorSettings = new DETECTOR_SETTINGS(10, 60, 3.65, 3.65, 0, 5, 4, 300, 50, 0.005, 0.12, 200); // default settings
+    //the visible window is detected at once, the whole channel in the background for the next windows
+    std::unique_ptr<CDetectorOutput> output;
+    bool complete = false;
 
-    char* filelocation;
-
-    if (filenameg != NULL)
+    try
     {
-      filelocation = new char[filenameg.length() + 1];
-      strcpy(filelocation, filenameg.toLatin1().constData());
+      CProfiler::Reset();
+      complete = detectionCache.Query(channel, start_time, end_time, output);
+      if (CProfiler::IsEnabled())
+        ui->statusBar->showMessage("Detection: " + QString::fromStdString(CProfiler::FormatSummary()));
+
+      detectionCache.StartBackground(channel, [this](int channel) {
+        //called from the detection thread
+        QMetaObject::invokeMethod(this, "spikesDetected", Qt::QueuedConnection, Q_ARG(int, channel));
+      });
     }
-
-    // DISCHARGES
-    CDischarges * discharges = NULL;
-    // Output class containing output data from the detector.
-    CDetectorOutput * output = NULL;
-
-    model->OpenFile(filelocation);
-    detector = new CSpikeDetector(model, detectorSettings);
-    detector->AnalyseChannel(channel, &output, &discharges);
-    model->CloseFile();
-
-    //set spike data to the arrays
-    int sz = output->m_pos.size();
-    QVector<double> xspike(sz), yspike(sz);
-    qDebug() << "channel:" << channel;
-    for (int j = 0; j < sz; j++)
+    catch (const char * error)
     {
-        double d = output->m_pos.at(j)/time_interval - start_time/time_interval;
-        int number = (int)floor(d);
-        if ((number <= nsamples) && (d >= 0)  ){
-            xspike[j] = output->m_pos.at(j);
-            yspike[j] = y[number];
-            qDebug() << output->m_pos.at(j);
-        }
+      QMessageBox::warning(this, tr("Alert"), QString(error));
     }
+
+    //the detections of the loaded window are kept, the graph gets the visible ones
+    SpikeOverlay overlay;
+    overlay.channel = channel;
+    overlay.row = labelposition[label];
+    overlay.start = start_time;
+    overlay.interval = time_interval;
+    overlay.signal = y;
+    overlay.spikes = std::move(output);
+    if (!overlay.spikes)
+      overlay.spikes.reset(new CDetectorOutput());
+
     customPlot->addGraph();
-    customPlot->graph()->setData(xspike, yspike);
+    overlay.graph = customPlot->graph();
     customPlot->graph()->setName("Spike:" + label);
     QPen graphPen;
     graphPen.setColor(Qt::GlobalColor::black);
     ui->customPlot->graph()->setPen(graphPen);
     ui->customPlot->graph()->setLineStyle(QCPGraph::lsNone);
-    customPlot->graph()->setScatterStyle(QCPScatterStyle(QCPScatterStyle::ssSquare, 9));
+    customPlot->graph()->setScatterStyle(QCPScatterStyle(QCPScatterStyle::ssSquare, SPIKE_MARKER_SIZE));
+
+    //the detections of the cache have the k1 of the settings
+    if (spikeK1 != detectionCache.GetSettings().m_k1)
+      retuneSpikeOverlay(overlay);
+
+    //the rate of the whole channel when it is complete, the loaded window until then
+    if (complete && spikeK1 == detectionCache.GetSettings().m_k1)
+      addSpikeRate(channel);
+    else
+    {
+      spikeHistogram.ClearChannel(channel);
+      spikeHistogram.Add(channel, *overlay.spikes);
+    }
+
+    updateSpikeOverlay(overlay, customPlot->xAxis->range());
+    spikeOverlays.push_back(std::move(overlay));
+    updateSpikeRate(customPlot->xAxis->range());
     ui->customPlot->replot();
+}
 
-    delete output;
-    delete discharges;
-    delete model;
-    delete detector;
-    delete detectorSettings;
+void MainWindow::updateSpikeOverlay(SpikeOverlay &overlay, const QCPRange &range)
+{
+  //the visible part of the loaded window, O(log n + k) in the sorted detections
+  double t0 = qMax(range.lower, overlay.start);
+  double t1 = qMin(range.upper, overlay.start + overlay.signal.size() * overlay.interval);
+  int first, last;
 
-    if (filenameg != NULL)
+  overlay.spikes->FindRange(t0, t1, first, last);
+
+  QVector<double> xspike, yspike;
+  xspike.reserve(last - first);
+  yspike.reserve(last - first);
+  for (int j = first; j < last; j++)
+  {
+    double d = overlay.spikes->m_pos[j]/overlay.interval - overlay.start/overlay.interval;
+    long long number = (long long)floor(d);
+    if ((number < overlay.signal.size()) && (d >= 0)){
+      xspike.append(overlay.spikes->m_pos[j]);
+      yspike.append(overlay.signal[number]);
+    }
+  }
+
+  overlay.graph->setData(xspike, yspike);
+}
+
+void MainWindow::xAxisRangeChanged(const QCPRange &range)
+{
+  //removed spike graphs are forgotten
+  for (size_t i = 0; i < spikeOverlays.size(); )
+  {
+    if (spikeOverlays[i].graph.isNull())
     {
-      filelocation = new char[filenameg.length() + 1];
-      strcpy(filelocation, filenameg.toLatin1().constData());
+      spikeOverlays.erase(spikeOverlays.begin() + i);
+      continue;
     }
 
-    //read file and verify errors, check error code on edflib.h (if 0, no error found)
-    if(edfopen_file_readonly(filelocation, &hdr, EDFLIB_READ_ALL_ANNOTATIONS))
+    updateSpikeOverlay(spikeOverlays[i], range);
+    i++;
+  }
+
+  updateSpikeRate(range);
+}
+
+void MainWindow::kSliderChanged(int value)
+{
+  spikeK1 = value / 100.0;
+  kLabel->setText(QString("k1 %1").arg(spikeK1, 0, 'f', 2));
+
+  for (size_t i = 0; i < spikeOverlays.size(); i++)
+  {
+    if (spikeOverlays[i].graph.isNull())
+      continue;
+
+    retuneSpikeOverlay(spikeOverlays[i]);
+    spikeHistogram.ClearChannel(spikeOverlays[i].channel);
+    spikeHistogram.Add(spikeOverlays[i].channel, *spikeOverlays[i].spikes);
+    updateSpikeOverlay(spikeOverlays[i], ui->customPlot->xAxis->range());
+  }
+
+  updateSpikeRate(ui->customPlot->xAxis->range());
+  ui->customPlot->replot();
+}
+
+void MainWindow::retuneSpikeOverlay(SpikeOverlay &overlay)
+{
+  //the envelope and the lognormal fit of the loaded window are computed once, the thresholds for every k1
+  const DETECTOR_SETTINGS& settings = detectionCache.GetSettings();
+  std::unique_ptr<CDischarges> discharges;
+  double t0 = overlay.start;
+  double t1 = overlay.start + overlay.signal.size() * overlay.interval;
+
+  try
+  {
+    if (!overlay.retune)
     {
-      switch(hdr.filetype)
-      {
-        case EDFLIB_MALLOC_ERROR                : printf("\nmalloc error\n\n");
-                                                  break;
-        case EDFLIB_NO_SUCH_FILE_OR_DIRECTORY   : printf("\ncan not open file, no such file or directory\n\n");
-                                                  break;
-        case EDFLIB_FILE_CONTAINS_FORMAT_ERRORS : printf("\nthe file is not EDF(+) or BDF(+) compliant\n"
-                                                         "(it contains format errors)\n\n");
-                                                  break;
-        case EDFLIB_MAXFILES_REACHED            : printf("\nto many files opened\n\n");
-                                                  break;
-        case EDFLIB_FILE_READ_ERROR             : printf("\na read error occurred\n\n");
-                                                  break;
-        case EDFLIB_FILE_ALREADY_OPENED         : printf("\nfile has already been opened\n\n");
-                                                  break;
-        default                                 : printf("\nunknown error\n\n");
-                                                  break;
-      }
+      overlay.retune.reset(new CThresholdRetune(settings));
+      detectionCache.QueryRetune(overlay.channel, t0, t1, *overlay.retune);
+    }
+  }
+  catch (const char * error)
+  {
+    overlay.retune.reset();
+    QMessageBox::warning(this, tr("Alert"), QString(error));
+    return;
+  }
+
+  //k2 keeps its ratio to k1
+  overlay.retune->Retune(spikeK1, settings.m_k2 * spikeK1 / settings.m_k1, settings.m_k3, overlay.spikes, discharges);
+
+  //detections in the margins of the window
+  const CDetectorOutput& out = *overlay.spikes;
+  overlay.spikes->RemoveIf([&out, t0, t1](const int& i) {
+    return out.m_pos[i] < t0 || out.m_pos[i] > t1;
+  });
+}
+
+void MainWindow::addSpikeRate(int channel)
+{
+  //counts of the whole channel, replace the counts of the loaded window
+  std::unique_ptr<CDetectorOutput> output;
+  double duration = hdr.file_duration / (double)EDFLIB_TIME_DIMENSION;
+
+  //the background detection has the k1 of the settings, the retuned windows are kept
+  if (!detectionCache.IsComplete(channel) || spikeK1 != detectionCache.GetSettings().m_k1)
+    return;
+
+  detectionCache.Query(channel, 0, duration, output);
+  spikeHistogram.ClearChannel(channel);
+  spikeHistogram.Add(channel, *output);
+}
+
+void MainWindow::updateSpikeRate(const QCPRange &range)
+{
+  //the bins of the view, about one per SPIKE_RATE_CELL pixels
+  int width = qMax(ui->customPlot->axisRect()->width(), 1);
+  int level = spikeHistogram.GetLevel(range.lower, range.upper, qMax(width / SPIKE_RATE_CELL, 2));
+  double binWidth = spikeHistogram.GetBinWidth(level);
+  long long first, last;
+  bool dense = false;
 
+  spikeHistogram.GetBins(level, range.lower, range.upper, first, last);
+  last = qMax(last, first + 1);
+
+  for (size_t i = 0; i < spikeOverlays.size(); i++)
+  {
+    if (spikeOverlays[i].graph.isNull())
+      continue;
+    if (spikeHistogram.GetCount(spikeOverlays[i].channel, level, first, last) * SPIKE_MARKER_SIZE > width)
+      dense = true;
+  }
+
+  for (size_t i = 0; i < spikeOverlays.size(); i++)
+    if (!spikeOverlays[i].graph.isNull())
+      spikeOverlays[i].graph->setVisible(!dense);
+
+  if (!dense)
+  {
+    if (!spikeRateMap.isNull())
+      ui->customPlot->removePlottable(spikeRateMap);
+    return;
+  }
+
+  //the rate is drawn below the traces, one row per channel position
+  if (spikeRateMap.isNull())
+  {
+    if (ui->customPlot->layer("spikeRate") == NULL)
+      ui->customPlot->addLayer("spikeRate", ui->customPlot->layer("main"), QCustomPlot::limBelow);
+
+    QCPColorGradient gradient;
+    gradient.setColorStops(QMap<double, QColor>());
+    gradient.setColorStopAt(0, QColor(255, 255, 255));
+    gradient.setColorStopAt(0.3, QColor(255, 200, 0));
+    gradient.setColorStopAt(1, QColor(200, 0, 0));
+
+    spikeRateMap = new QCPColorMap(ui->customPlot->xAxis, ui->customPlot->yAxis);
+    ui->customPlot->addPlottable(spikeRateMap);
+    spikeRateMap->setLayer("spikeRate");
+    spikeRateMap->setName("Spike rate");
+    spikeRateMap->setGradient(gradient);
+    spikeRateMap->setInterpolate(false);
+  }
+
+  int rows = qMax(totalGraphs, 2);
+  int cells = last - first + 1;
+  double maximum = 0;
+  std::vector<int> counts;
+  QCPColorMapData *data = spikeRateMap->data();
+
+  data->setSize(cells, rows);
+  data->setRange(QCPRange((first + 0.5) * binWidth, (last + 0.5) * binWidth), QCPRange(0, (rows - 1) * 3000));
+  data->fill(0);
+  for (size_t i = 0; i < spikeOverlays.size(); i++)
+  {
+    if (spikeOverlays[i].graph.isNull() || spikeOverlays[i].row < 0 || spikeOverlays[i].row >= rows)
+      continue;
+
+    spikeHistogram.GetCounts(spikeOverlays[i].channel, level, first, last, counts);
+    for (int j = 0; j < cells; j++)
+    {
+      data->setCell(j, spikeOverlays[i].row, counts[j] / binWidth);
+      maximum = qMax(maximum, counts[j] / binWidth);
     }
+  }
+
+  spikeRateMap->setDataRange(QCPRange(0, maximum > 0 ? maximum : 1));
+}
+
+void MainWindow::spikesDetected(int channel)
+{
+  //the next windows of the channel are taken from the complete detection
+  ui->statusBar->showMessage(QString("Spike detection of %1 is complete.").arg(viewModel.GetLabel(channel)), 5000);
+
+  addSpikeRate(channel);
+  updateSpikeRate(ui->customPlot->xAxis->range());
+  ui->customPlot->replot();
+}
+
+void MainWindow::insertAnnotations(QCustomPlot *customPlot)
+{
+  std::vector<ANNOTATION> visible;
+  QPen annotationPen;
+
+  //only the annotations of the displayed time window are drawn
+  customPlot->clearItems();
+  annotationIndex.Query(start_time, end_time, visible);
+
+  annotationPen.setColor(QColor(0, 0, 255));
+  annotationPen.setStyle(Qt::DashLine);
+
+  for (size_t i = 0; i < visible.size(); i++)
+  {
+    QCPItemStraightLine *line = new QCPItemStraightLine(customPlot);
+    customPlot->addItem(line);
+    line->setPen(annotationPen);
+    line->point1->setCoords(visible[i].m_onset, 0);
+    line->point2->setCoords(visible[i].m_onset, 1);
+
+    QCPItemText *text = new QCPItemText(customPlot);
+    customPlot->addItem(text);
+    text->setPositionAlignment(Qt::AlignLeft|Qt::AlignTop);
+    text->position->setType(QCPItemPosition::ptPlotCoords);
+    text->position->setCoords(visible[i].m_onset, customPlot->yAxis->range().upper);
+    text->setText(QString::fromUtf8(visible[i].m_text.c_str()));
+    text->setColor(QColor(0, 0, 255));
+  }
+
+  customPlot->replot();
+}
+
+void MainWindow::annotationsLoaded()
+{
+  //annotations which are not stored at their onset are known only after the whole file is parsed
+  if (ui->customPlot->graphCount() > 0)
+    insertAnnotations(ui->customPlot);
 }
 
 void MainWindow::insertChannel(QCustomPlot *customPlot, QString label)
@@ -487,15 +1022,14 @@ void MainWindow::insertChannel(QCustomPlot *customPlot, QString label)
   nsamples = (end_time - start_time)/time_interval;
   int channel = labelchannel[label];
   double nsec = hdr.datarecords_in_file;
-  double totalsamples = hdr.signalparam[channel].smp_in_file;
+  double totalsamples = viewModel.GetCountSamples(channel);
   time_interval = nsec/totalsamples;
 
   //memory allocated to store data
-  buf = (double *)malloc(sizeof(double[nsamples]));
+  buf = (double *)malloc(nsamples * sizeof(double));
   if(buf==NULL)
   {
-    printf("\nmalloc error\n");
-    edfclose_file(hdl);
+    QMessageBox::warning(this, tr("Alert"),QString("Not enough memory for the samples"));
     return;
   }
 
@@ -505,20 +1039,19 @@ void MainWindow::insertChannel(QCustomPlot *customPlot, QString label)
 //    return;
 //  }
 
-  edfseek(hdl, channel, (long long) ( ((start_time) / ((double)hdr.file_duration / (double)EDFLIB_TIME_DIMENSION)) * ((double)hdr.signalparam[channel].smp_in_file)), EDFSEEK_SET);
+  long long firstSample = (long long) ( ((start_time) / ((double)hdr.file_duration / (double)EDFLIB_TIME_DIMENSION)) * ((double)viewModel.GetCountSamples(channel)));
 
   //CHECK ERROR IN READ FUNCTION
-  if(edfread_physical_samples(hdl, channel, nsamples, buf) == (-1))
+  if(readSamples(channel, firstSample, nsamples, buf) == (-1))
   {
-    //show here error message TODO
-    edfclose_file(hdl);
+    QMessageBox::warning(this, tr("Alert"),QString("Error reading samples from file!"));
     free(buf);
     return;
   }
 
   QVector<double> x(nsamples), y(nsamples);
   //SET DATA TO THE X AND Y AXES
-  for (int i=0; i<nsamples; ++i)
+  for (long long i=0; i<nsamples; ++i)
   {
     x[i] = start_time + i*time_interval; //
     y[i] = buf[i] + totalGraphs*3000;  //
@@ -567,6 +1100,7 @@ void MainWindow::on_actionChannel_Selector_triggered()
     if(showngraphs.contains(str))  removeChannelByLabel(ui->customPlot, str);
   }
 
+  insertAnnotations(ui->customPlot);
 }
 
 void MainWindow::on_actionSet_Time_triggered()
@@ -598,7 +1132,7 @@ void MainWindow::on_actionSet_Time_triggered()
         insertChannel(ui->customPlot, str);
       }
     }
-    else ui->customPlot->replot();
+    insertAnnotations(ui->customPlot);
 
 }
 
@@ -622,6 +1156,8 @@ void MainWindow::on_actionAdd_All_Channels_triggered()
     foreach (QString str, all) {
       if(!showngraphs.contains(str))  insertChannel(ui->customPlot, str);
     }
+
+    insertAnnotations(ui->customPlot);
 }
 
 void MainWindow::showPointToolTip(QMouseEvent *event)
@@ -630,6 +1166,12 @@ void MainWindow::showPointToolTip(QMouseEvent *event)
     double y = ui->customPlot->yAxis->pixelToCoord(event->pos().y());
     int position;
 
+    //the spike rate of the zoomed out view, not a trace
+    if (!spikeRateMap.isNull() && ui->customPlot->plottableAt(event->pos(), false) == spikeRateMap) {
+        setToolTip(QString("Spike rate: %1/s").arg(spikeRateMap->data()->data(x, y)));
+        return;
+    }
+
     if (ui->customPlot->plottableAt(event->pos(), false)) {
         QString label;
         if (ui->customPlot->plottableAt(event->pos(), false)->name().contains("Spike"))
@@ -670,6 +1212,20 @@ void MainWindow::on_actionFilter_triggered()
 
 }
 
+void MainWindow::on_actionExport_Trace_triggered()
+{
+    QString fileName = QFileDialog::getSaveFileName(
+                      this,
+                      tr("Export trace"),
+                      "trace.json",
+                      "Chrome trace (*.json);;All files(*.*)");
+    if (fileName.isEmpty())
+        return;
+
+    if (!CProfiler::WriteTrace(fileName.toLocal8Bit().constData()))
+        QMessageBox::warning(this, tr("Alert"), QString("Can not write the file"));
+}
+
 void MainWindow::on_actionAbout_triggered()
 {
     About aboutwindow;
@@ -3,7 +3,20 @@
 
 #include <QMainWindow>
 #include <QInputDialog>
+#include <QPointer>
+#include <QSlider>
+#include <QLabel>
+#include <QActionGroup>
+#include <vector>
+#include <memory>
 #include "libs/qcustomplot.h"
+#include "libs/CSpikeDetector.h"
+#include "libs/CSpikeHistogram.h"
+#include "libs/CThresholdRetune.h"
+#include "libs/CInputEDF.h"
+#include "libs/CMontage.h"
+#include "libs/CPageCache.h"
+#include "libs/CSpectrum.h"
 
 namespace Ui {
 class MainWindow;
@@ -32,6 +45,14 @@ private slots:
   void on_actionOpen_triggered();
   void insertChannel(QCustomPlot *customPlot, QString Label);
   void insertSpikeGraph(QCustomPlot *customPlot, QString label);
+  void insertAnnotations(QCustomPlot *customPlot);
+  void annotationsLoaded();
+  void spikesDetected(int channel);
+  void xAxisRangeChanged(const QCPRange &range);
+  void kSliderChanged(int value);
+  void montageTriggered(QAction *action);
+  void powerSpectraTriggered();
+  void spectrogramTriggered();
   void removeChannelByLabel(QCustomPlot *customPlot, QString label);
   void on_actionChannel_Selector_triggered();
   void on_actionSet_Time_triggered();
@@ -39,6 +60,7 @@ private slots:
   void showPointToolTip(QMouseEvent *event);
   void on_actionSet_Display_Time_triggered();
   void on_actionFilter_triggered();
+  void on_actionExport_Trace_triggered();
 
 
   void on_actionAbout_triggered();
@@ -48,7 +70,39 @@ private slots:
   void on_actionHelp_triggered();
 
 private:
+  //spike markers of one channel - the detections of the loaded time window, only the visible ones are plotted
+  struct SpikeOverlay
+  {
+    QPointer<QCPGraph> graph;
+    int channel;                              //number of the channel - the derivation of the montage
+    int row;                                  //position of the channel in the plot
+    double start;                             //start of the loaded window (second)
+    double interval;                          //sample interval of the channel (second)
+    QVector<double> signal;                   //samples of the loaded window, the height of the markers
+    std::unique_ptr<CDetectorOutput> spikes;  //detections of the loaded window, sorted by position
+    std::unique_ptr<CThresholdRetune> retune; //curves of the loaded window, kept at the first retuning
+  };
+
+  void updateSpikeOverlay(SpikeOverlay &overlay, const QCPRange &range);
+  void addSpikeRate(int channel);
+  void updateSpikeRate(const QCPRange &range);
+  void retuneSpikeOverlay(SpikeOverlay &overlay);
+  bool applyMontage(const QString &definition);
+  long long readSamples(int channel, long long start, long long count, double *buf);
+  QCustomPlot *openSpectrumWindow(const QString &title);
+  void addFrequencyLines(QCustomPlot *plot, double maximum, bool vertical);
+
   Ui::MainWindow *ui;
+  std::vector<SpikeOverlay> spikeOverlays;
+  CSpikeHistogram spikeHistogram;             //spike counts of the channels for the zoomed out view
+  QPointer<QCPColorMap> spikeRateMap;         //the spike rate, replaces the markers of a dense view
+  QSlider *kSlider;                           //threshold k1 of the detector (x100)
+  QLabel *kLabel;
+  double spikeK1;                             //k1 of the shown spikes
+  CInputEDF viewModel;                        //the open file for the plot, the channels are the derivations of the montage
+  std::shared_ptr<CPageCache> pageCache;      //decoded pages of the open file, shared by the plot and the detector
+  QString montageDefinition;                  //the montage (CMontage::Parse), kept for the next file
+  QActionGroup *montageGroup;
 };
 
 #endif // MAINWINDOW_H
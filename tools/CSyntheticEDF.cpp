@@ -0,0 +1,179 @@
+#include "CSyntheticEDF.h"
+
+#include <cmath>
+#include <cstdio>
+
+#include "edflib.h"
+
+using namespace std;
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+/// physical range of the signals (uV)
+#define SYNTHETIC_PHYS_RANGE 3000.0
+/// minimal distance of two spikes in one channel (second)
+#define SYNTHETIC_MIN_GAP    0.3
+/// distance of the spikes from the start and the end of the recording (second)
+#define SYNTHETIC_MARGIN     1.0
+/// half of the length of the spike waveform (second)
+#define SYNTHETIC_SPIKE_SPAN 0.25
+
+/// Waveform of a spike - a sharp peak followed by a slow wave of the opposite polarity.
+static double spikeWaveform(const double& t)
+{
+	return exp(-(t / 0.012) * (t / 0.012)) - 0.35 * exp(-((t - 0.07) / 0.045) * ((t - 0.07) / 0.045));
+}
+
+/// A constructor.
+CSyntheticEDF::CSyntheticEDF(const SYNTHETIC_SETTINGS& settings)
+	: m_settings(settings), m_state(0)
+{
+	/* empty */
+}
+
+/// A virtual desctructor.
+CSyntheticEDF::~CSyntheticEDF()
+{
+	/* empty */
+}
+
+/// Uniform random number [0, 1).
+double CSyntheticEDF::uniform()
+{
+	m_state ^= m_state >> 12;
+	m_state ^= m_state << 25;
+	m_state ^= m_state >> 27;
+
+	return ((m_state * 2685821657736338717ULL) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/// Normal random number (Box-Muller).
+double CSyntheticEDF::normal()
+{
+	double u1 = 1.0 - uniform(); // (0, 1]
+	double u2 = uniform();
+
+	return sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+}
+
+/// Write the recording.
+void CSyntheticEDF::Write(const char * fileName)
+{
+	int                     channels = m_settings.m_channels;
+	int                     fs = m_settings.m_fs;
+	int                     digMax = m_settings.m_bdf ? 8388607 : 32767;
+	int                     hdl, i, j, record;
+	size_t                  first;
+	double                  t, value, a, b;
+	char                    label[32];
+	vector<double>          buf(fs);
+	vector<double>          noise(channels, 0);
+	vector<double>          phase(channels);
+	vector<size_t>          spikeStart(channels);
+	vector<vector<double> > spikes(channels);
+
+	if (channels < 1 || fs < 1 || m_settings.m_duration < 1)
+		throw "Invalid settings of the synthetic recording.";
+
+	m_state = 0x9E3779B97F4A7C15ULL ^ m_settings.m_seed;
+	if (m_state == 0)
+		m_state = 1;
+
+	// positions of the spikes - Poisson process with a refractory gap
+	m_spikes.clear();
+	for (i = 0; i < channels; i++)
+	{
+		phase[i] = 2.0 * M_PI * uniform();
+
+		if (m_settings.m_spikeRate <= 0)
+			continue;
+
+		t = SYNTHETIC_MARGIN;
+		while (true)
+		{
+			t += SYNTHETIC_MIN_GAP - log(1.0 - uniform()) / m_settings.m_spikeRate;
+			if (t > m_settings.m_duration - SYNTHETIC_MARGIN)
+				break;
+
+			// peaks on whole samples, the annotations match the data exactly
+			double position = floor(t * fs + 0.5) / fs;
+			spikes[i].push_back(position);
+
+			SYNTHETIC_SPIKE spike;
+			spike.m_channel = i;
+			spike.m_position = position;
+			m_spikes.push_back(spike);
+		}
+	}
+
+	// header
+	hdl = edfopen_file_writeonly(fileName, m_settings.m_bdf ? EDFLIB_FILETYPE_BDFPLUS : EDFLIB_FILETYPE_EDFPLUS, channels);
+	if (hdl < 0)
+		throw "Can not create the output file.";
+
+	for (i = 0; i < channels; i++)
+	{
+		snprintf(label, sizeof(label), "SYN%d", i + 1);
+
+		edf_set_samplefrequency(hdl, i, fs);
+		edf_set_physical_maximum(hdl, i, SYNTHETIC_PHYS_RANGE);
+		edf_set_physical_minimum(hdl, i, -SYNTHETIC_PHYS_RANGE);
+		edf_set_digital_maximum(hdl, i, digMax);
+		edf_set_digital_minimum(hdl, i, -digMax - 1);
+		edf_set_label(hdl, i, label);
+		edf_set_physical_dimension(hdl, i, "uV");
+	}
+	edf_set_equipment(hdl, "synthetic");
+	edf_set_startdatetime(hdl, 2000, 1, 1, 0, 0, 0); // fixed, the same settings give the same file
+
+	// background noise - AR(1) process with the required standard deviation
+	a = 0.9;
+	b = m_settings.m_noise * sqrt(1.0 - a * a);
+
+	// data, one datarecord of 1 second after another, channel after channel
+	for (record = 0; record < m_settings.m_duration; record++)
+	{
+		for (i = 0; i < channels; i++)
+		{
+			first = spikeStart[i];
+			for (j = 0; j < fs; j++)
+			{
+				t = record + j / (double)fs;
+
+				noise[i] = a * noise[i] + b * normal();
+				value = noise[i];
+
+				if (m_settings.m_humFreq > 0)
+					value += m_settings.m_humAmplitude * sin(2.0 * M_PI * m_settings.m_humFreq * t + phase[i]);
+
+				while (first < spikes[i].size() && spikes[i][first] < t - SYNTHETIC_SPIKE_SPAN)
+					first++;
+				for (size_t s = first; s < spikes[i].size() && spikes[i][s] <= t + SYNTHETIC_SPIKE_SPAN; s++)
+					value += m_settings.m_spikeAmplitude * spikeWaveform(t - spikes[i][s]);
+
+				if (value > SYNTHETIC_PHYS_RANGE) value = SYNTHETIC_PHYS_RANGE;
+				if (value < -SYNTHETIC_PHYS_RANGE) value = -SYNTHETIC_PHYS_RANGE;
+				buf[j] = value;
+			}
+			spikeStart[i] = first;
+
+			if (edfwrite_physical_samples(hdl, buf.data()) != 0)
+			{
+				edfclose_file(hdl);
+				throw "Can not write samples to the output file.";
+			}
+		}
+	}
+
+	// annotations, onset in units of 100 us
+	for (i = 0; i < (int)m_spikes.size(); i++)
+	{
+		snprintf(label, sizeof(label), "spike %d", m_spikes[i].m_channel);
+		edfwrite_annotation_utf8(hdl, (long long)floor(m_spikes[i].m_position * 10000 + 0.5), -1, label);
+	}
+
+	if (edfclose_file(hdl) != 0)
+		throw "Can not close the output file.";
+}
@@ -0,0 +1,109 @@
+#ifndef CSyntheticEDF_H
+#define CSyntheticEDF_H
+
+#include <vector>
+
+/**
+ * Settings of a synthetic recording.
+ */
+typedef struct syntheticSettings
+{
+public:
+	/// count of channels
+	int       m_channels;
+	/// sample rate (Hz)
+	int       m_fs;
+	/// duration (second), whole datarecords of 1 second
+	int       m_duration;
+	/// BDF+ (24 bit) instead of EDF+ (16 bit)
+	bool      m_bdf;
+	/// mean count of injected spikes per second and channel
+	double    m_spikeRate;
+	/// amplitude of the spikes (uV)
+	double    m_spikeAmplitude;
+	/// frequency of the line noise (Hz), 0 - none
+	int       m_humFreq;
+	/// amplitude of the line noise (uV)
+	double    m_humAmplitude;
+	/// standard deviation of the background noise (uV)
+	double    m_noise;
+	/// seed of the random generator
+	unsigned  m_seed;
+
+	/// A constructor
+	syntheticSettings()
+		: m_channels(4), m_fs(512), m_duration(600), m_bdf(false), m_spikeRate(0.4), m_spikeAmplitude(400), m_humFreq(50),
+		  m_humAmplitude(30), m_noise(20), m_seed(1)
+	{
+		/* empty */
+	}
+} SYNTHETIC_SETTINGS;
+
+/**
+ * One injected spike.
+ */
+typedef struct syntheticSpike
+{
+public:
+	/// channel
+	int    m_channel;
+	/// position of the peak (second)
+	double m_position;
+} SYNTHETIC_SPIKE;
+
+/**
+ * Generator of synthetic EDF+ / BDF+ recordings with the edflib writer - background noise, line noise and
+ * sharp biphasic spikes at random positions. The output is bit-exact for the same settings on every platform.
+ */
+class CSyntheticEDF
+{
+// methods
+public:
+	/**
+	 * A constructor.
+	 * @param settings settings of the recording
+	 */
+	CSyntheticEDF(const SYNTHETIC_SETTINGS& settings);
+
+	/**
+	 * A virtual desctructor.
+	 */
+	virtual ~CSyntheticEDF();
+
+	/**
+	 * Write the recording. The injected spikes are stored as annotations "spike <channel>" too.
+	 * Throws an error message if the file can not be written.
+	 * @param fileName output file
+	 */
+	void Write(const char * fileName);
+
+	/**
+	 * Returns the injected spikes of the last \ref Write, sorted by channel and position.
+	 */
+	inline const std::vector<SYNTHETIC_SPIKE>& GetSpikes() const
+	{
+		return m_spikes;
+	}
+
+private:
+	/**
+	 * Uniform random number [0, 1).
+	 */
+	double uniform();
+
+	/**
+	 * Normal random number (Box-Muller).
+	 */
+	double normal();
+
+// variables
+private:
+	/// settings of the recording
+	SYNTHETIC_SETTINGS            m_settings;
+	/// state of the random generator (xorshift64*)
+	unsigned long long            m_state;
+	/// injected spikes
+	std::vector<SYNTHETIC_SPIKE>  m_spikes;
+};
+
+#endif
@@ -0,0 +1,196 @@
+#include "CToolArgs.h"
+#include "CMontage.h"
+
+#include <cstdlib>
+#include <memory>
+#include <chrono>
+#include <algorithm>
+
+using namespace std;
+
+/// Returns the default settings of the detector.
+DETECTOR_SETTINGS CToolArgs::GetDefaultSettings()
+{
+	return DETECTOR_SETTINGS(10, 60, 3.65, 3.65, 0, 5, 4, 300, 50, 0.005, 0.12, 200);
+}
+
+/// Apply one option of the detector settings.
+bool CToolArgs::ParseDetectorOption(const string& option, const char * value, DETECTOR_SETTINGS& settings, const bool& thresholds)
+{
+	if (option == "-fl")        settings.m_band_low = atoi(value);
+	else if (option == "-fh")   settings.m_band_high = atoi(value);
+	else if (option == "-w")    settings.m_winsize = atoi(value);
+	else if (option == "-n")    settings.m_noverlap = atof(value);
+	else if (option == "-buf")  settings.m_buffering = atoi(value);
+	else if (option == "-h")    settings.m_main_hum_freq = atoi(value);
+	else if (option == "-dec")  settings.m_decimation = atoi(value);
+	else if (!thresholds)       return false;
+	else if (option == "-k1")   settings.m_k1 = atof(value);
+	else if (option == "-k2")   settings.m_k2 = atof(value);
+	else if (option == "-k3")   settings.m_k3 = atof(value);
+	else if (option == "-dt")   settings.m_discharge_tol = atof(value);
+	else if (option == "-pt")   settings.m_polyspike_union_time = atof(value);
+	else return false;
+
+	return true;
+}
+
+/// Apply one option of the batch.
+bool CToolArgs::ParseBatchOption(const string& option, const char * value, BATCH_SETTINGS& batch, vector<int>& channels, bool& valid)
+{
+	valid = true;
+
+	if (option == "-c")              valid = ParseChannels(value, channels);
+	else if (option == "-montage")   batch.m_montage = value;
+	else if (option == "-j")         batch.m_workers = atoi(value);
+	else if (option == "-maxfiles")  batch.m_maxOpenFiles = max(1, atoi(value));
+	else if (option == "-mem")       batch.m_memoryBudget = atoll(value) * 1024 * 1024;
+	else return false;
+
+	return true;
+}
+
+/// Parse comma separated list of channels.
+bool CToolArgs::ParseChannels(const char * list, vector<int>& channels)
+{
+	char * end;
+	long   channel;
+
+	while (*list)
+	{
+		channel = strtol(list, &end, 10);
+		if (end == list || channel < 0)
+			return false;
+
+		channels.push_back((int)channel);
+		list = (*end == ',') ? end + 1 : end;
+	}
+
+	return !channels.empty();
+}
+
+/// Parse comma separated list of numbers.
+bool CToolArgs::ParseValues(const char * list, vector<double>& values, const bool& positiveOnly)
+{
+	char * end;
+	double value;
+
+	values.clear();
+	while (*list)
+	{
+		value = strtod(list, &end);
+		if (end == list || (positiveOnly && !(value > 0)))
+			return false;
+
+		values.push_back(value);
+		list = (*end == ',') ? end + 1 : end;
+	}
+
+	return !values.empty();
+}
+
+/// Print the usage of the detector options.
+void CToolArgs::PrintDetectorUsage(FILE * out, const bool& thresholds)
+{
+	fprintf(out,
+		"detector settings:\n"
+		"  -fl <Hz>     lower limit of filtering (10)\n"
+		"  -fh <Hz>     upper limit of filtering (60)\n");
+	if (thresholds)
+		fprintf(out,
+			"  -k1 <k>      threshold k1 (3.65)\n"
+			"  -k2 <k>      threshold k2 (3.65)\n"
+			"  -k3 <k>      threshold k3 (0)\n");
+	fprintf(out,
+		"  -w <s>       window size (5)\n"
+		"  -n <s>       window overlap (4)\n"
+		"  -buf <s>     buffering - length of one segment (300)\n"
+		"  -h <Hz>      main hum frequency (50)\n");
+	if (thresholds)
+		fprintf(out,
+			"  -dt <s>      discharge tolerance (0.005)\n"
+			"  -pt <s>      polyspike union time (0.12)\n");
+	fprintf(out,
+		"  -dec <Hz>    decimation (200)\n");
+}
+
+/// Print the usage of the batch options.
+void CToolArgs::PrintBatchUsage(FILE * out)
+{
+	fprintf(out,
+		"  -c <list>    channels to analyse, comma separated, starting at 0 (all)\n"
+		"  -montage <m> montage - referential, bipolar, average or a list of derivations like \"Fp1-F3,C3-AVG\",\n"
+		"               the channels are the derivations (referential)\n"
+		"  -j <count>   count of threads (all cores)\n"
+		"  -maxfiles <count>  maximal count of files open at once (16)\n"
+		"  -mem <MB>    memory budget - target resident set size, shortens the segments and limits the tasks\n"
+		"               running at once (unlimited)\n");
+}
+
+/// Open the file and set the montage of the batch.
+void CToolArgs::OpenFile(CInputEDF& model, const string& path, const BATCH_SETTINGS& batch)
+{
+	model.OpenFile(path.c_str());
+	if (batch.m_montage.empty())
+		return;
+
+	shared_ptr<CMontage> montage(new CMontage());
+	montage->Parse(batch.m_montage, model.GetHeader());
+	model.SetMontage(montage);
+}
+
+/// Print the errors of the files of a batch.
+bool CToolArgs::PrintFileErrors(const char * tool, const CBatchScheduler& scheduler)
+{
+	size_t i;
+
+	for (i = 0; i < scheduler.GetFileErrors().size(); i++)
+		fprintf(stderr, "%s: %s\n", tool, scheduler.GetFileErrors()[i].c_str());
+
+	return scheduler.GetFileErrors().empty();
+}
+
+/// The results of the channels of one file.
+bool CToolArgs::GetFileResults(const char * tool, const string& path, const vector<BATCH_CHANNEL_RESULT>& results, const int& file,
+							   vector<const BATCH_CHANNEL_RESULT*>& fileResults)
+{
+	bool   valid = true;
+	size_t i;
+
+	fileResults.clear();
+	for (i = 0; i < results.size(); i++)
+	{
+		if (results[i].m_file != file)
+			continue;
+
+		if (!results[i].m_error.empty())
+		{
+			fprintf(stderr, "%s: %s: channel %d: %s\n", tool, path.c_str(), results[i].m_channel, results[i].m_error.c_str());
+			valid = false;
+			continue;
+		}
+
+		fileResults.push_back(&results[i]);
+	}
+
+	return valid;
+}
+
+/// Write one CSV field with a string, quoted.
+void CToolArgs::WriteQuoted(FILE * out, const char * text)
+{
+	fputc('"', out);
+	for (; *text; text++)
+	{
+		if (*text == '"')
+			fputc('"', out);
+		fputc(*text, out);
+	}
+	fputc('"', out);
+}
+
+/// Wall time in seconds.
+double CToolArgs::Now()
+{
+	return chrono::duration<double>(chrono::steady_clock::now().time_since_epoch()).count();
+}
@@ -0,0 +1,120 @@
+#ifndef CToolArgs_H
+#define CToolArgs_H
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "CInputEDF.h"
+#include "CSpikeDetector.h"
+#include "CBatchScheduler.h"
+
+/**
+ * The pieces shared by the command-line tools - the default detector settings, the options of the detector and of
+ * the batch with their usage, the opening of the input files with the montage, the results of one file of a batch
+ * and the CSV output.
+ *
+ * The options are parsed one at a time, a tool tries its own options first and passes the others here:
+ *
+ *     if (arg == "-o") outputPath = value;
+ *     else if (!CToolArgs::ParseDetectorOption(arg, value, settings)) { usage(); return 2; }
+ */
+class CToolArgs
+{
+// methods
+public:
+	/**
+	 * Returns the default settings of the detector, the defaults of \ref PrintDetectorUsage.
+	 */
+	static DETECTOR_SETTINGS GetDefaultSettings();
+
+	/**
+	 * Apply one option of the detector settings: -fl -fh -k1 -k2 -k3 -w -n -buf -h -dt -pt -dec.
+	 * @param option the option
+	 * @param value its value
+	 * @param settings output - the changed settings
+	 * @param thresholds false - the thresholds (-k1 -k2 -k3 -dt -pt) are not detector options, the tool parses them
+	 * @return false if the option is not a detector option
+	 */
+	static bool ParseDetectorOption(const std::string& option, const char * value, DETECTOR_SETTINGS& settings,
+									const bool& thresholds = true);
+
+	/**
+	 * Apply one option of the batch: -c -montage -j -maxfiles -mem.
+	 * @param option the option
+	 * @param value its value
+	 * @param batch output - the changed settings of the batch
+	 * @param channels output - the channels of -c
+	 * @param valid output - false if the value is invalid
+	 * @return false if the option is not a batch option
+	 */
+	static bool ParseBatchOption(const std::string& option, const char * value, BATCH_SETTINGS& batch, std::vector<int>& channels,
+								 bool& valid);
+
+	/**
+	 * Parse comma separated list of channels, appended to the output.
+	 * @return false if the list is empty or invalid
+	 */
+	static bool ParseChannels(const char * list, std::vector<int>& channels);
+
+	/**
+	 * Parse comma separated list of numbers, the previous content of the output is removed.
+	 * @param list the list
+	 * @param values output - the numbers
+	 * @param positiveOnly true - every number must be positive
+	 * @return false if the list is empty or invalid
+	 */
+	static bool ParseValues(const char * list, std::vector<double>& values, const bool& positiveOnly = false);
+
+	/**
+	 * Print the usage of the detector options, a section "detector settings:".
+	 * @param out the output
+	 * @param thresholds false - without the thresholds (-k1 -k2 -k3 -dt -pt)
+	 */
+	static void PrintDetectorUsage(FILE * out, const bool& thresholds = true);
+
+	/**
+	 * Print the usage of the batch options, the lines of a section.
+	 */
+	static void PrintBatchUsage(FILE * out);
+
+	/**
+	 * Open the file and set the montage of the batch. Throws an error message.
+	 * @param model the reader
+	 * @param path path of the file
+	 * @param batch settings of the batch, \ref BATCH_SETTINGS::m_montage
+	 */
+	static void OpenFile(CInputEDF& model, const std::string& path, const BATCH_SETTINGS& batch);
+
+	/**
+	 * Print the errors of the files of a batch to stderr.
+	 * @param tool name of the tool, the prefix of the messages
+	 * @param scheduler the finished batch
+	 * @return false if a file failed
+	 */
+	static bool PrintFileErrors(const char * tool, const CBatchScheduler& scheduler);
+
+	/**
+	 * The results of the channels of one file, the errors of the channels printed to stderr.
+	 * @param tool name of the tool, the prefix of the messages
+	 * @param path path of the file
+	 * @param results results of the batch
+	 * @param file index of the file in the batch
+	 * @param fileResults output - the results of the file without an error
+	 * @return false if a channel failed
+	 */
+	static bool GetFileResults(const char * tool, const std::string& path, const std::vector<BATCH_CHANNEL_RESULT>& results,
+							   const int& file, std::vector<const BATCH_CHANNEL_RESULT*>& fileResults);
+
+	/**
+	 * Write one CSV field with a string, quoted.
+	 */
+	static void WriteQuoted(FILE * out, const char * text);
+
+	/**
+	 * Wall time in seconds, the differences are durations.
+	 */
+	static double Now();
+};
+
+#endif
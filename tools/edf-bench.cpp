@@ -0,0 +1,563 @@
+/**
+ * edf-bench - reproducible benchmark of the stages of the spike detector.
+ *
+ * Runs the stages of the detector (decoding, decimation, filtering, envelope, window statistics, thresholds,
+ * local maxima, union of detections, assembly of the discharges) separately over all segments and channels of
+ * a recording and writes the time of every stage as JSON, with the calls of the global allocator per detected segment
+ * (counted only in the EDF_PROFILE build) and the time of the retuning of the thresholds (\ref CThresholdRetune) against
+ * the whole detection with the same k-values, and the throughput of many short windows read by the vectored read
+ * (\ref CInputEDF::ReadWindows) against a seek and read per window. Without an input file a synthetic EDF+/BDF+ recording
+ * with known spikes is generated (\ref CSyntheticEDF), the same seed gives the same file.
+ *
+ * usage: edf-bench [options] [file.edf]
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <random>
+
+#include "CInputEDF.h"
+#include "CDSP.h"
+#include "CSpikeDetector.h"
+#include "CDetectorArena.h"
+#include "CThresholdRetune.h"
+#include "CProfiler.h"
+#include "CSyntheticEDF.h"
+#include "CToolArgs.h"
+
+using namespace std;
+
+/// Stages of the detector, in the order of the pipeline.
+enum benchStage
+{
+	STAGE_DECODE = 0,
+	STAGE_RESAMPLE,
+	STAGE_FILT50HZ,
+	STAGE_FILTERING,
+	STAGE_ENVELOPE,
+	STAGE_WINDOW_STATISTICS,
+	STAGE_THRESHOLDS,
+	STAGE_LOCAL_MAXIMA,
+	STAGE_DETECTION_UNION,
+	STAGE_ASSEMBLY,
+	STAGE_COUNT
+};
+
+/// Names of the stages in the report.
+static const char * stageNames[STAGE_COUNT] = {
+	"decode", "resample", "filt50hz", "filtering", "envelope", "window_statistics", "thresholds",
+	"local_maxima", "detection_union", "assembly"
+};
+
+/**
+ * Measurements of one stage.
+ */
+typedef struct benchStageResult
+{
+public:
+	/// count of calls in one repetition
+	long long      m_calls;
+	/// count of input samples in one repetition
+	long long      m_samples;
+	/// time of every repetition (second)
+	vector<double> m_times;
+
+	/// A constructor
+	benchStageResult()
+		: m_calls(0), m_samples(0)
+	{
+		/* empty */
+	}
+} BENCH_STAGE_RESULT;
+
+/// Print usage to stderr.
+static void usage()
+{
+	fprintf(stderr,
+		"usage: edf-bench [options] [file.edf]\n"
+		"\n"
+		"synthetic recording (used without an input file):\n"
+		"  -c <count>   count of channels (4)\n"
+		"  -fs <Hz>     sample rate (512)\n"
+		"  -t <s>       duration (600)\n"
+		"  -bdf         BDF+ instead of EDF+\n"
+		"  -spikes <r>  spikes per second and channel (0.4)\n"
+		"  -hum <Hz>    line noise frequency, 0 - none (50)\n"
+		"  -seed <n>    seed of the generator (1)\n"
+		"  -gen <file>  path of the generated file (edf-bench-synthetic.edf / .bdf)\n"
+		"\n"
+		"benchmark:\n"
+		"  -r <count>   count of repetitions (5)\n"
+		"  -k <k1>      k1 and k2 of the retuning (3)\n"
+		"  -windows <count>  count of the short windows of the vectored read (20000)\n"
+		"  -wlen <s>    length of one window (0.5)\n"
+		"  -o <file>    output JSON report (stdout)\n");
+}
+
+/// Median of the values.
+static double median(vector<double> values)
+{
+	if (values.empty())
+		return 0;
+
+	sort(values.begin(), values.end());
+	if (values.size() % 2)
+		return values[values.size() / 2];
+
+	return 0.5 * (values[values.size() / 2 - 1] + values[values.size() / 2]);
+}
+
+/// Write one JSON string, escaped.
+static void writeString(FILE * out, const char * text)
+{
+	fputc('"', out);
+	for (; *text; text++)
+	{
+		if (*text == '"' || *text == '\\')
+			fputc('\\', out);
+		if ((unsigned char)*text < 0x20)
+			fprintf(out, "\\u%04x", *text);
+		else fputc(*text, out);
+	}
+	fputc('"', out);
+}
+
+/**
+ * Run all stages over one segment, the same sequence as \ref CSpikeDetector::spikeDetector.
+ * @return count of detections in the segment
+ */
+static int benchSegment(CInputEDF& model, CSpikeDetector& detector, DETECTOR_SETTINGS& settings, const int& channel,
+						const SAMPLEINDEX& start, const SAMPLEINDEX& stop, BENCH_STAGE_RESULT * stages, vector<double>& times)
+{
+	BANDWIDTH            bandwidth(settings.m_band_low, settings.m_band_high);
+	int                  fs = model.GetFS(channel);
+	vector<SIGNALTYPE> * data;
+	vector<int>          index;
+	double               t;
+	int                  countRecords, detections;
+
+	// decoding
+	t = CToolArgs::Now();
+	data = model.GetSegmentFromChannel(channel, start, stop);
+	times[STAGE_DECODE] += CToolArgs::Now() - t;
+	if (data == NULL)
+		throw "Error reading samples from file!";
+	countRecords = data[0].size();
+	stages[STAGE_DECODE].m_calls++;
+	stages[STAGE_DECODE].m_samples += countRecords;
+
+	// decimation
+	if (fs > settings.m_decimation)
+	{
+		t = CToolArgs::Now();
+		CDSP::ResampleOneChannel(data, fs, settings.m_decimation);
+		times[STAGE_RESAMPLE] += CToolArgs::Now() - t;
+		stages[STAGE_RESAMPLE].m_calls++;
+		stages[STAGE_RESAMPLE].m_samples += countRecords;
+
+		fs = settings.m_decimation;
+		countRecords = data[0].size();
+	}
+
+	CSpikeDetector::GetWindowIndex(countRecords, settings.m_winsize * fs, settings.m_noverlap * fs, index);
+
+	// filtering
+	t = CToolArgs::Now();
+	CDSP::Filt50Hz(data, 1, fs, settings.m_main_hum_freq, bandwidth);
+	times[STAGE_FILT50HZ] += CToolArgs::Now() - t;
+	stages[STAGE_FILT50HZ].m_calls++;
+	stages[STAGE_FILT50HZ].m_samples += countRecords;
+
+	t = CToolArgs::Now();
+	CDSP::Filtering(data, 1, fs, bandwidth);
+	times[STAGE_FILTERING] += CToolArgs::Now() - t;
+	stages[STAGE_FILTERING].m_calls++;
+	stages[STAGE_FILTERING].m_samples += countRecords;
+
+	// detection of one channel
+	COneChannelDetect    detect(&data[0], &settings, fs, &index, 0);
+	vector<SIGNALTYPE>   envelope, phatMedian, phatStd;
+	vector<double>       prah_int[2], envelope_cdf, envelope_pdf;
+	vector<bool>         markersHigh;
+	vector<bool>         markersLow;
+	bool                 low;
+
+	t = CToolArgs::Now();
+	detect.Envelope(envelope);
+	times[STAGE_ENVELOPE] += CToolArgs::Now() - t;
+	stages[STAGE_ENVELOPE].m_calls++;
+	stages[STAGE_ENVELOPE].m_samples += countRecords;
+
+	t = CToolArgs::Now();
+	detect.WindowStatistics(envelope, phatMedian, phatStd);
+	times[STAGE_WINDOW_STATISTICS] += CToolArgs::Now() - t;
+	stages[STAGE_WINDOW_STATISTICS].m_calls++;
+	stages[STAGE_WINDOW_STATISTICS].m_samples += countRecords;
+
+	t = CToolArgs::Now();
+	bool thresholds = detect.Thresholds(envelope, phatMedian, phatStd, prah_int, envelope_cdf, envelope_pdf);
+	times[STAGE_THRESHOLDS] += CToolArgs::Now() - t;
+	stages[STAGE_THRESHOLDS].m_calls++;
+	stages[STAGE_THRESHOLDS].m_samples += countRecords;
+
+	delete data;
+	if (!thresholds)
+		throw "Interpolation of the thresholds failed.";
+
+	t = CToolArgs::Now();
+	markersHigh = detect.localMaximaDetection(envelope, prah_int[0], settings.m_polyspike_union_time);
+	low = settings.m_k2 != settings.m_k1 && prah_int[1].size() != 0;
+	if (low)
+		markersLow = detect.localMaximaDetection(envelope, prah_int[1], settings.m_polyspike_union_time);
+	times[STAGE_LOCAL_MAXIMA] += CToolArgs::Now() - t;
+	stages[STAGE_LOCAL_MAXIMA].m_calls++;
+	stages[STAGE_LOCAL_MAXIMA].m_samples += countRecords;
+
+	t = CToolArgs::Now();
+	detect.detectionUnion(&markersHigh, envelope, settings.m_polyspike_union_time * fs);
+	if (low)
+		detect.detectionUnion(&markersLow, envelope, settings.m_polyspike_union_time * fs);
+	times[STAGE_DETECTION_UNION] += CToolArgs::Now() - t;
+	stages[STAGE_DETECTION_UNION].m_calls++;
+	stages[STAGE_DETECTION_UNION].m_samples += countRecords;
+
+	// assembly of the spikes and discharges
+	ONECHANNELDETECTRET         result(&markersHigh, low ? &markersLow : &markersHigh, prah_int, std::move(envelope_cdf), std::move(envelope_pdf),
+									   std::move(envelope));
+	ONECHANNELDETECTRET *       ret = &result;
+	unique_ptr<CDetectorOutput> out;
+	unique_ptr<CDischarges>     discharges;
+
+	t = CToolArgs::Now();
+	detector.AssembleDetections(&ret, 1, countRecords, fs, out, discharges);
+	times[STAGE_ASSEMBLY] += CToolArgs::Now() - t;
+	stages[STAGE_ASSEMBLY].m_calls++;
+	stages[STAGE_ASSEMBLY].m_samples += countRecords;
+
+	detections = out->m_pos.size();
+
+	return detections;
+}
+
+int main(int argc, char ** argv)
+{
+	DETECTOR_SETTINGS    settings = CToolArgs::GetDefaultSettings();
+	SYNTHETIC_SETTINGS   synthetic;
+	string               input;
+	string               generated;
+	const char *         reportPath = NULL;
+	int                  reps = 5;
+	double               retuneK = 3;
+	int                  countWindows = 20000;
+	double               windowLength = 0.5;
+	int                  i, rep, channel, segment;
+	unsigned             j;
+	long long            totalSamples = 0;
+	BENCH_STAGE_RESULT   stages[STAGE_COUNT];
+	vector<SYNTHETIC_SPIKE> injected;
+
+	// ----------------------------------------------------------------------------
+	// arguments
+	for (i = 1; i < argc; i++)
+	{
+		string arg = argv[i];
+
+		if (arg[0] != '-')
+		{
+			input = argv[i];
+			continue;
+		}
+
+		if (arg == "-bdf")
+		{
+			synthetic.m_bdf = true;
+			continue;
+		}
+
+		if (i + 1 >= argc)
+		{
+			usage();
+			return 2;
+		}
+
+		const char * value = argv[++i];
+
+		if (arg == "-c")           synthetic.m_channels = atoi(value);
+		else if (arg == "-fs")     synthetic.m_fs = atoi(value);
+		else if (arg == "-t")      synthetic.m_duration = atoi(value);
+		else if (arg == "-spikes") synthetic.m_spikeRate = atof(value);
+		else if (arg == "-hum")    synthetic.m_humFreq = atoi(value);
+		else if (arg == "-seed")   synthetic.m_seed = strtoul(value, NULL, 10);
+		else if (arg == "-gen")    generated = value;
+		else if (arg == "-r")      reps = atoi(value);
+		else if (arg == "-k")      retuneK = atof(value);
+		else if (arg == "-windows") countWindows = atoi(value);
+		else if (arg == "-wlen")   windowLength = atof(value);
+		else if (arg == "-o")      reportPath = value;
+		else
+		{
+			usage();
+			return 2;
+		}
+	}
+
+	if (reps < 1)
+		reps = 1;
+	if (countWindows < 0)
+		countWindows = 0;
+
+	try
+	{
+		// ----------------------------------------------------------------------------
+		// synthetic recording
+		if (input.empty())
+		{
+			if (generated.empty())
+				generated = synthetic.m_bdf ? "edf-bench-synthetic.bdf" : "edf-bench-synthetic.edf";
+
+			CSyntheticEDF generator(synthetic);
+			generator.Write(generated.c_str());
+			injected = generator.GetSpikes();
+			input = generated;
+		}
+
+		CInputEDF model;
+		model.OpenFile(input.c_str());
+
+		int countChannels = model.GetCountChannels();
+
+		// ----------------------------------------------------------------------------
+		// stages
+		for (rep = 0; rep < reps; rep++)
+		{
+			vector<double> times(STAGE_COUNT, 0);
+
+			for (i = 0; i < STAGE_COUNT; i++)
+			{
+				stages[i].m_calls = 0;
+				stages[i].m_samples = 0;
+			}
+			totalSamples = 0;
+
+			for (channel = 0; channel < countChannels; channel++)
+			{
+				DETECTOR_SETTINGS   channelSettings = settings;
+				CSpikeDetector      detector(&model, &channelSettings);
+				vector<SAMPLEINDEX> indexStart, indexStop;
+
+				if (model.GetFS(channel) <= 0)
+					continue;
+
+				detector.GetSegments(channel, indexStart, indexStop);
+				for (segment = 0; segment < (int)indexStop.size(); segment++)
+				{
+					benchSegment(model, detector, channelSettings, channel, indexStart[segment], indexStop[segment], stages, times);
+					totalSamples += indexStop[segment] - indexStart[segment];
+				}
+			}
+
+			for (i = 0; i < STAGE_COUNT; i++)
+				stages[i].m_times.push_back(times[i]);
+		}
+
+		// ----------------------------------------------------------------------------
+		// detections of the whole pipeline, recall of the injected spikes
+		vector<int>      found(injected.size(), 0);
+		int              detections = 0;
+		CDetectorArena&  arena = CDetectorArena::GetThreadArena();
+
+		arena.ResetCounters();
+		double wholeTime = CToolArgs::Now();
+
+		for (channel = 0; channel < countChannels; channel++)
+		{
+			DETECTOR_SETTINGS channelSettings = settings;
+			CSpikeDetector    detector(&model, &channelSettings);
+			unique_ptr<CDetectorOutput> out;
+			unique_ptr<CDischarges>     discharges;
+
+			if (model.GetFS(channel) <= 0)
+				continue;
+
+			detector.AnalyseChannel(channel, out, discharges);
+			detections += out->m_pos.size();
+
+			for (j = 0; j < injected.size(); j++)
+			{
+				if (injected[j].m_channel != channel)
+					continue;
+
+				for (i = 0; i < (int)out->m_pos.size(); i++)
+				{
+					if (fabs(out->m_pos[i] - injected[j].m_position) <= 0.1)
+					{
+						found[j] = 1;
+						break;
+					}
+				}
+			}
+		}
+		wholeTime = CToolArgs::Now() - wholeTime;
+
+		// ----------------------------------------------------------------------------
+		// retuning of the thresholds against the whole detection with the same k-values
+		double collectTime = 0, retuneTime = 0, retunedTime = 0, t;
+		int    retuneDetections = 0, retunedDetections = 0;
+
+		for (channel = 0; channel < countChannels; channel++)
+		{
+			DETECTOR_SETTINGS           retunedSettings = settings;
+			CSpikeDetector              detector(&model, &retunedSettings);
+			CThresholdRetune            retune(settings);
+			CPipeline                   pipeline(&model, settings);
+			unique_ptr<CDetectorOutput> out;
+			unique_ptr<CDischarges>     discharges;
+
+			if (model.GetFS(channel) <= 0)
+				continue;
+
+			t = CToolArgs::Now();
+			pipeline.AddDetector(&retune);
+			pipeline.RunChannel(channel);
+			collectTime += CToolArgs::Now() - t;
+
+			t = CToolArgs::Now();
+			retune.Retune(retuneK, retuneK, settings.m_k3, out, discharges);
+			retuneTime += CToolArgs::Now() - t;
+			retuneDetections += out->m_pos.size();
+
+			retunedSettings.m_k1 = retuneK;
+			retunedSettings.m_k2 = retuneK;
+			t = CToolArgs::Now();
+			detector.AnalyseChannel(channel, out, discharges);
+			retunedTime += CToolArgs::Now() - t;
+			retunedDetections += out->m_pos.size();
+		}
+
+		// ----------------------------------------------------------------------------
+		// short windows - a seek and read per window, a positional read per window and the vectored read
+		vector<READ_WINDOW>          windows;
+		vector<vector<SIGNALTYPE> >  windowSamples(countWindows);
+		vector<double>               naiveSamples;
+		double                       naiveTime = 0, positionalTime = 0, vectoredTime = 0;
+		long long                    windowTotal = 0;
+		bool                         identical = true;
+		mt19937                      random(synthetic.m_seed);
+
+		for (i = 0; i < countWindows && countChannels > 0; i++)
+		{
+			channel = random() % countChannels;
+			SAMPLEINDEX length = max(1LL, (SAMPLEINDEX)round(windowLength * model.GetFS(channel)));
+			SAMPLEINDEX range = max(1LL, model.GetCountSamples(channel) - length);
+
+			windowSamples[i].assign(length, 0);
+			windows.push_back(READ_WINDOW(channel, (SAMPLEINDEX)(random() % range), length, windowSamples[i].data()));
+			windowTotal += length;
+		}
+
+		for (rep = 0; rep < reps; rep++)
+		{
+			t = CToolArgs::Now();
+			for (j = 0; j < windows.size(); j++)
+			{
+				naiveSamples.resize(windows[j].m_length);
+				edfseek(model.GetHeader().handle, windows[j].m_channel, windows[j].m_start, EDFSEEK_SET);
+				edfread_physical_samples(model.GetHeader().handle, windows[j].m_channel, windows[j].m_length, naiveSamples.data());
+			}
+			t = CToolArgs::Now() - t;
+			naiveTime = rep ? min(naiveTime, t) : t;
+
+			t = CToolArgs::Now();
+			for (j = 0; j < windows.size(); j++)
+				delete model.GetSegmentFromChannel(windows[j].m_channel, windows[j].m_start, windows[j].m_start + windows[j].m_length);
+			t = CToolArgs::Now() - t;
+			positionalTime = rep ? min(positionalTime, t) : t;
+
+			t = CToolArgs::Now();
+			model.ReadWindows(windows);
+			t = CToolArgs::Now() - t;
+			vectoredTime = rep ? min(vectoredTime, t) : t;
+		}
+
+		// the vectored read gives the samples of the seek and read
+		for (j = 0; j < windows.size() && identical; j++)
+		{
+			naiveSamples.resize(windows[j].m_length);
+			edfseek(model.GetHeader().handle, windows[j].m_channel, windows[j].m_start, EDFSEEK_SET);
+			edfread_physical_samples(model.GetHeader().handle, windows[j].m_channel, windows[j].m_length, naiveSamples.data());
+			identical = windows[j].m_read == windows[j].m_length;
+			for (SAMPLEINDEX k = 0; k < windows[j].m_read && identical; k++)
+				identical = windowSamples[j][k] == (SIGNALTYPE)naiveSamples[k];
+		}
+
+		model.CloseFile();
+
+		int countFound = 0;
+		for (j = 0; j < found.size(); j++)
+			countFound += found[j];
+
+		// ----------------------------------------------------------------------------
+		// report
+		FILE * report = reportPath ? fopen(reportPath, "w") : stdout;
+		if (report == NULL)
+		{
+			fprintf(stderr, "edf-bench: can not open the output file\n");
+			return 1;
+		}
+
+		fprintf(report, "{\n  \"input\": ");
+		writeString(report, input.c_str());
+		fprintf(report, ",\n  \"synthetic\": ");
+		if (generated.empty())
+			fprintf(report, "null,\n");
+		else
+		{
+			fprintf(report, "{\n    \"channels\": %d,\n    \"fs\": %d,\n    \"duration\": %d,\n    \"format\": \"%s\",\n"
+					"    \"spike_rate\": %g,\n    \"spike_amplitude\": %g,\n    \"hum_freq\": %d,\n    \"hum_amplitude\": %g,\n"
+					"    \"noise\": %g,\n    \"seed\": %u,\n    \"injected_spikes\": %d,\n    \"recalled_spikes\": %d\n  },\n",
+					synthetic.m_channels, synthetic.m_fs, synthetic.m_duration, synthetic.m_bdf ? "BDF+" : "EDF+",
+					synthetic.m_spikeRate, synthetic.m_spikeAmplitude, synthetic.m_humFreq, synthetic.m_humAmplitude,
+					synthetic.m_noise, synthetic.m_seed, (int)injected.size(), countFound);
+		}
+		fprintf(report, "  \"detector_allocations\": {\n    \"counted\": %s,\n    \"segments\": %lld,\n    \"per_segment\": %.1f,\n"
+				"    \"last_segment\": %lld,\n    \"arena_bytes\": %lld\n  },\n", CProfiler::IsCompiled() ? "true" : "false",
+				arena.GetCountSegments(), arena.GetCountSegments() ? arena.GetAllocations() / (double)arena.GetCountSegments() : 0.0,
+				arena.GetSegmentAllocations(), arena.GetCapacity());
+		fprintf(report, "  \"retune\": {\n    \"k\": %g,\n    \"collect_seconds\": %.6f,\n    \"retune_seconds\": %.6f,\n"
+				"    \"detection_seconds\": %.6f,\n    \"retune_detections\": %d,\n    \"detections\": %d\n  },\n", retuneK,
+				collectTime, retuneTime, retunedTime, retuneDetections, retunedDetections);
+		fprintf(report, "  \"windows\": {\n    \"count\": %d,\n    \"length_seconds\": %g,\n    \"samples\": %lld,\n"
+				"    \"naive_seconds\": %.6f,\n    \"positional_seconds\": %.6f,\n    \"vectored_seconds\": %.6f,\n"
+				"    \"naive_msamples_per_second\": %.3f,\n    \"vectored_msamples_per_second\": %.3f,\n    \"speedup\": %.2f,\n"
+				"    \"identical\": %s\n  },\n", (int)windows.size(), windowLength, windowTotal, naiveTime, positionalTime, vectoredTime,
+				naiveTime > 0 ? windowTotal / naiveTime / 1e6 : 0.0, vectoredTime > 0 ? windowTotal / vectoredTime / 1e6 : 0.0,
+				vectoredTime > 0 ? naiveTime / vectoredTime : 0.0, identical ? "true" : "false");
+		fprintf(report, "  \"repetitions\": %d,\n  \"samples\": %lld,\n  \"detections\": %d,\n  \"pipeline_seconds\": %.6f,\n  \"stages\": [\n",
+				reps, totalSamples, detections, wholeTime);
+
+		for (i = 0; i < STAGE_COUNT; i++)
+		{
+			double min = *min_element(stages[i].m_times.begin(), stages[i].m_times.end());
+			double med = median(stages[i].m_times);
+
+			fprintf(report, "    { \"stage\": \"%s\", \"calls\": %lld, \"samples\": %lld, \"min_seconds\": %.6f, \"median_seconds\": %.6f, "
+					"\"ns_per_sample\": %.3f }%s\n", stageNames[i], stages[i].m_calls, stages[i].m_samples, min, med,
+					stages[i].m_samples > 0 ? 1e9 * med / stages[i].m_samples : 0.0, i + 1 < STAGE_COUNT ? "," : "");
+		}
+		fprintf(report, "  ]\n}\n");
+
+		if (report != stdout)
+			fclose(report);
+	}
+	catch (const char * error)
+	{
+		fprintf(stderr, "edf-bench: %s\n", error);
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,24 @@
+#-------------------------------------------------
+#
+# edf-bench - benchmark of the stages of the spike detector
+# on real or synthetic EDF+/BDF+ recordings.
+#
+#-------------------------------------------------
+
+CONFIG -= qt app_bundle
+CONFIG += console
+
+TARGET = edf-bench
+TEMPLATE = app
+
+include(../libs/core.pri)
+
+SOURCES += edf-bench.cpp \
+    CSyntheticEDF.cpp \
+    CToolArgs.cpp
+
+HEADERS += CSyntheticEDF.h \
+    CToolArgs.h
+
+LIBS = -L$$OUT_PWD/.. -ledf-core $$LIBS
+PRE_TARGETDEPS += $$OUT_PWD/../libedf-core.a
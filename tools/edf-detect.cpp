@@ -0,0 +1,302 @@
+/**
+ * edf-detect - headless batch spike detection.
+ *
+ * Runs the spike detector over all (or selected) channels of one or more EDF/BDF files in parallel
+ * (\ref CBatchScheduler, one task per file, channel and segment) and writes the detections as CSV,
+ * optionally with the co-activation of the channels (\ref CCoactivation).
+ *
+ * usage: edf-detect [options] file1.edf [file2.edf ...]
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "CSpikeDetector.h"
+#include "CBatchScheduler.h"
+#include "CProfiler.h"
+#include "CCoactivation.h"
+#include "CToolArgs.h"
+
+using namespace std;
+
+/// Print usage to stderr.
+static void usage()
+{
+	fprintf(stderr,
+		"usage: edf-detect [options] file1.edf [file2.edf ...]\n"
+		"\n");
+	CToolArgs::PrintDetectorUsage(stderr);
+	fprintf(stderr,
+		"\n"
+		"other options:\n");
+	CToolArgs::PrintBatchUsage(stderr);
+	fprintf(stderr,
+		"  -o <file>    output CSV with spikes (stdout)\n"
+		"  -d <file>    output CSV with discharges (not written)\n"
+		"  -coact <file>   output CSV with the co-activation of the channels - the spikes of channel1 with a spike\n"
+		"                  of channel2 within dt (not written)\n"
+		"  -coact-dt <list> tolerances dt of the co-activation, comma separated (0.01,0.05)\n"
+		"  -timing <file>  output CSV with timing of every task (not written)\n"
+		"  -profile <file> output CSV with the summary of the instrumented stages (needs EDF_PROFILE)\n"
+		"  -trace <file>   output Chrome trace / Perfetto JSON timeline of the stages (needs EDF_PROFILE)\n");
+}
+
+int main(int argc, char ** argv)
+{
+	DETECTOR_SETTINGS     settings = CToolArgs::GetDefaultSettings();
+	BATCH_SETTINGS        batch;
+	vector<string>        files;
+	vector<int>           channels;
+	const char *          spikesPath = NULL;
+	const char *          dischargesPath = NULL;
+	const char *          timingPath = NULL;
+	const char *          profilePath = NULL;
+	const char *          tracePath = NULL;
+	const char *          coactivationPath = NULL;
+	vector<double>        tolerances = { 0.01, 0.05 };
+	int                   status = 0;
+	int                   i, j, k;
+
+	// ----------------------------------------------------------------------------
+	// arguments
+	for (i = 1; i < argc; i++)
+	{
+		string arg = argv[i];
+		bool   hasValue = (i + 1 < argc);
+		bool   valid = true;
+
+		if (arg[0] != '-')
+		{
+			files.push_back(argv[i]);
+			continue;
+		}
+
+		if (!hasValue)
+		{
+			usage();
+			return 2;
+		}
+
+		const char * value = argv[++i];
+
+		if (arg == "-o")        spikesPath = value;
+		else if (arg == "-d")   dischargesPath = value;
+		else if (arg == "-timing") timingPath = value;
+		else if (arg == "-profile") profilePath = value;
+		else if (arg == "-trace") tracePath = value;
+		else if (arg == "-coact") coactivationPath = value;
+		else if (arg == "-coact-dt")
+		{
+			if (!CToolArgs::ParseValues(value, tolerances, true))
+			{
+				fprintf(stderr, "edf-detect: invalid list of tolerances '%s'\n", value);
+				return 2;
+			}
+		}
+		else if (!CToolArgs::ParseDetectorOption(arg, value, settings) && !CToolArgs::ParseBatchOption(arg, value, batch, channels, valid))
+		{
+			usage();
+			return 2;
+		}
+
+		if (!valid)
+		{
+			fprintf(stderr, "edf-detect: invalid channel list '%s'\n", value);
+			return 2;
+		}
+	}
+
+	if (files.empty())
+	{
+		usage();
+		return 2;
+	}
+
+	if (profilePath || tracePath)
+	{
+		if (CProfiler::IsCompiled())
+			CProfiler::SetEnabled(true);
+		else fprintf(stderr, "edf-detect: built without EDF_PROFILE, -profile and -trace are ignored\n");
+	}
+
+	// ----------------------------------------------------------------------------
+	// detection - the results are sorted by file and channel, the output does not depend on scheduling
+	CBatchScheduler scheduler(settings, batch);
+	scheduler.Run(files, channels);
+
+	const vector<BATCH_CHANNEL_RESULT>& results = scheduler.GetResults();
+
+	if (!CToolArgs::PrintFileErrors("edf-detect", scheduler))
+		status = 1;
+
+	// ----------------------------------------------------------------------------
+	// output
+	FILE * spikesFile = spikesPath ? fopen(spikesPath, "w") : stdout;
+	FILE * dischargesFile = dischargesPath ? fopen(dischargesPath, "w") : NULL;
+
+	if (spikesFile == NULL || (dischargesPath && dischargesFile == NULL))
+	{
+		fprintf(stderr, "edf-detect: can not open the output file\n");
+		return 1;
+	}
+
+	fprintf(spikesFile, "file,channel,label,position,duration,condition,weight,pdf\n");
+	if (dischargesFile)
+		fprintf(dischargesFile, "file,channel,label,type,amplitude,position,duration,weight,pdf\n");
+
+	for (i = 0; i < (int)results.size(); i++)
+	{
+		const char * file = files[results[i].m_file].c_str();
+		const char * label = results[i].m_label.c_str();
+		int          channel = results[i].m_channel;
+
+		if (!results[i].m_error.empty())
+		{
+			fprintf(stderr, "edf-detect: %s: channel %d: %s\n", file, channel, results[i].m_error.c_str());
+			status = 1;
+			continue;
+		}
+
+		const CDetectorOutput * out = results[i].m_out.get();
+		for (j = 0; j < (int)out->m_pos.size(); j++)
+		{
+			CToolArgs::WriteQuoted(spikesFile, file);
+			fprintf(spikesFile, ",%d,", channel);
+			CToolArgs::WriteQuoted(spikesFile, label);
+			fprintf(spikesFile, ",%.6f,%.6f,%.2f,%.6g,%.6g\n", out->m_pos[j], out->m_dur[j], out->m_con[j], out->m_weight[j], out->m_pdf[j]);
+		}
+
+		if (dischargesFile)
+		{
+			const CDischarges * dis = results[i].m_discharges.get();
+			for (k = 0; k < (int)dis->GetCountChannels(); k++)
+			{
+				for (j = 0; j < (int)dis->m_MP[k].size(); j++)
+				{
+					CToolArgs::WriteQuoted(dischargesFile, file);
+					fprintf(dischargesFile, ",%d,", channel);
+					CToolArgs::WriteQuoted(dischargesFile, label);
+					fprintf(dischargesFile, ",%.2f,%.6g,%.6f,%.6f,%.6g,%.6g\n", dis->m_MV[k][j], dis->m_MA[k][j], dis->m_MP[k][j],
+							dis->m_MD[k][j], dis->m_MW[k][j], dis->m_MPDF[k][j]);
+				}
+			}
+		}
+	}
+
+	if (spikesFile != stdout)
+		fclose(spikesFile);
+	if (dischargesFile)
+		fclose(dischargesFile);
+
+	// ----------------------------------------------------------------------------
+	// co-activation - one matrix per file and tolerance, the channels of one file are neighbours in the results
+	if (coactivationPath)
+	{
+		FILE * coactivationFile = fopen(coactivationPath, "w");
+
+		if (coactivationFile == NULL)
+		{
+			fprintf(stderr, "edf-detect: can not open the output file\n");
+			return 1;
+		}
+
+		fprintf(coactivationFile, "file,channel1,label1,channel2,label2,dt,count,spikes1\n");
+		for (i = 0; i < (int)results.size(); i = j)
+		{
+			int            countChannels = 0;
+			vector<string> labels;
+
+			for (j = i; j < (int)results.size() && results[j].m_file == results[i].m_file; j++)
+				countChannels = max(countChannels, results[j].m_channel + 1);
+
+			CCoactivation coactivation(countChannels, tolerances);
+			labels.assign(countChannels, "");
+			for (k = i; k < j; k++)
+			{
+				if (!results[k].m_error.empty())
+					continue;
+
+				coactivation.Add(results[k].m_channel, *results[k].m_out);
+				labels[results[k].m_channel] = results[k].m_label;
+			}
+
+			for (k = 0; k < (int)tolerances.size(); k++)
+			{
+				Eigen::SparseMatrix<int, Eigen::RowMajor> matrix = coactivation.GetMatrix(k);
+
+				for (int row = 0; row < matrix.outerSize(); row++)
+				{
+					for (Eigen::SparseMatrix<int, Eigen::RowMajor>::InnerIterator it(matrix, row); it; ++it)
+					{
+						CToolArgs::WriteQuoted(coactivationFile, files[results[i].m_file].c_str());
+						fprintf(coactivationFile, ",%d,", row);
+						CToolArgs::WriteQuoted(coactivationFile, labels[row].c_str());
+						fprintf(coactivationFile, ",%d,", (int)it.col());
+						CToolArgs::WriteQuoted(coactivationFile, labels[it.col()].c_str());
+						fprintf(coactivationFile, ",%.6f,%d,%lld\n", tolerances[k], it.value(), coactivation.GetCountSpikes(row));
+					}
+				}
+			}
+		}
+
+		fclose(coactivationFile);
+	}
+
+	// ----------------------------------------------------------------------------
+	// timing
+	if (timingPath)
+	{
+		const vector<BATCH_TASK_TIMING>& timings = scheduler.GetTimings();
+		FILE * timingFile = fopen(timingPath, "w");
+
+		if (timingFile == NULL)
+		{
+			fprintf(stderr, "edf-detect: can not open the output file\n");
+			return 1;
+		}
+
+		fprintf(timingFile, "file,channel,segment,worker,stolen,samples,start,end\n");
+		for (i = 0; i < (int)timings.size(); i++)
+		{
+			CToolArgs::WriteQuoted(timingFile, files[timings[i].m_file].c_str());
+			fprintf(timingFile, ",%d,%d,%d,%d,%lld,%.6f,%.6f\n", timings[i].m_channel, timings[i].m_segment, timings[i].m_worker,
+					timings[i].m_stolen ? 1 : 0, timings[i].m_samples, timings[i].m_start, timings[i].m_end);
+		}
+		fclose(timingFile);
+	}
+
+	// ----------------------------------------------------------------------------
+	// instrumentation
+	if (CProfiler::IsEnabled())
+	{
+		if ((profilePath && !CProfiler::WriteSummary(profilePath)) || (tracePath && !CProfiler::WriteTrace(tracePath)))
+		{
+			fprintf(stderr, "edf-detect: can not open the output file\n");
+			return 1;
+		}
+	}
+
+	fprintf(stderr, "edf-detect: %d tasks, %d workers, %.3f s, utilization %.1f %%, %d steals\n", (int)scheduler.GetTimings().size(),
+			scheduler.GetCountWorkers(), scheduler.GetWallTime(), 100 * scheduler.GetUtilization(), scheduler.GetCountSteals());
+
+	// memory - the estimate of the scheduler and the measured resident set
+	int minBuffering = 0, maxBuffering = 0;
+	for (i = 0; i < (int)results.size(); i++)
+	{
+		if (i == 0 || results[i].m_buffering < minBuffering)
+			minBuffering = results[i].m_buffering;
+		if (results[i].m_buffering > maxBuffering)
+			maxBuffering = results[i].m_buffering;
+	}
+
+	fprintf(stderr, "edf-detect: peak RSS %.1f MB", CProfiler::GetPeakRSS() / 1048576.0);
+	if (batch.m_memoryBudget > 0)
+		fprintf(stderr, " (budget %.1f MB, %.1f MB at start)", batch.m_memoryBudget / 1048576.0, scheduler.GetBaseMemory() / 1048576.0);
+	fprintf(stderr, ", at most %d tasks at once using %.1f MB (estimated), segments %d-%d s\n", scheduler.GetPeakTasks(),
+			scheduler.GetPeakTaskMemory() / 1048576.0, minBuffering, maxBuffering);
+
+	return status;
+}
@@ -0,0 +1,21 @@
+#-------------------------------------------------
+#
+# edf-detect - headless batch spike detection.
+#
+#-------------------------------------------------
+
+CONFIG -= qt app_bundle
+CONFIG += console
+
+TARGET = edf-detect
+TEMPLATE = app
+
+include(../libs/core.pri)
+
+SOURCES += edf-detect.cpp \
+    CToolArgs.cpp
+
+HEADERS += CToolArgs.h
+
+LIBS = -L$$OUT_PWD/.. -ledf-core $$LIBS
+PRE_TARGETDEPS += $$OUT_PWD/../libedf-core.a
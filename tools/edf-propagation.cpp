@@ -0,0 +1,247 @@
+/**
+ * edf-propagation - lags of the discharges between the channels.
+ *
+ * Detects the spikes of all (or selected) channels (\ref CBatchScheduler), joins the discharges of the channels with
+ * close onsets to multichannel discharges (\ref CPropagation::Combine) and estimates the lags of every pair of channels
+ * of every discharge by the cross-correlation of their envelopes (\ref CPropagation). Writes one CSV row per file and
+ * pair of channels with the distribution of the lags.
+ *
+ * usage: edf-propagation [options] file1.edf [file2.edf ...]
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "CInputEDF.h"
+#include "CSpikeDetector.h"
+#include "CBatchScheduler.h"
+#include "CPropagation.h"
+#include "CToolArgs.h"
+
+using namespace std;
+
+/// Print usage to stderr.
+static void usage()
+{
+	fprintf(stderr,
+		"usage: edf-propagation [options] file1.edf [file2.edf ...]\n"
+		"\n"
+		"lag analysis:\n"
+		"  -win <s>     envelope window around the onset of a discharge (0.25)\n"
+		"  -lag <s>     the largest lag (0.05)\n"
+		"  -tol <s>     the largest gap between the onsets of the channels of one discharge (0.05)\n"
+		"  -minc <r>    the smallest peak correlation of a lag in the distributions (0)\n"
+		"\n");
+	CToolArgs::PrintDetectorUsage(stderr);
+	fprintf(stderr,
+		"\n"
+		"other options:\n");
+	CToolArgs::PrintBatchUsage(stderr);
+	fprintf(stderr,
+		"  -o <file>    output CSV with the lags of the pairs of channels (stdout)\n"
+		"  -e <file>    output CSV with every lag (not written)\n");
+}
+
+/// Quantile of sorted values, linear interpolation.
+static double quantile(const vector<double>& sorted, const double& q)
+{
+	double position = q * (sorted.size() - 1);
+	size_t below = (size_t)floor(position);
+
+	if (below + 1 >= sorted.size())
+		return sorted.back();
+
+	return sorted[below] + (position - below) * (sorted[below + 1] - sorted[below]);
+}
+
+int main(int argc, char ** argv)
+{
+	DETECTOR_SETTINGS     settings = CToolArgs::GetDefaultSettings();
+	PROPAGATION_SETTINGS  propagation;
+	BATCH_SETTINGS        batch;
+	vector<string>        files;
+	vector<int>           channels;
+	const char *          outputPath = NULL;
+	const char *          lagsPath = NULL;
+	double                tolerance = 0.05, minCorrelation = 0;
+	double                detectTime, lagTime = 0, t;
+	int                   status = 0, countEvents = 0, countPairs = 0;
+	int                   i, j;
+
+	// ----------------------------------------------------------------------------
+	// arguments
+	for (i = 1; i < argc; i++)
+	{
+		string arg = argv[i];
+		bool   hasValue = (i + 1 < argc);
+		bool   valid = true;
+
+		if (arg[0] != '-')
+		{
+			files.push_back(argv[i]);
+			continue;
+		}
+
+		if (!hasValue)
+		{
+			usage();
+			return 2;
+		}
+
+		const char * value = argv[++i];
+
+		if (arg == "-win")      propagation.m_window = atof(value);
+		else if (arg == "-lag") propagation.m_maxLag = atof(value);
+		else if (arg == "-tol") tolerance = atof(value);
+		else if (arg == "-minc") minCorrelation = atof(value);
+		else if (arg == "-o")   outputPath = value;
+		else if (arg == "-e")   lagsPath = value;
+		else if (!CToolArgs::ParseDetectorOption(arg, value, settings) && !CToolArgs::ParseBatchOption(arg, value, batch, channels, valid))
+		{
+			usage();
+			return 2;
+		}
+
+		if (!valid)
+		{
+			fprintf(stderr, "edf-propagation: invalid channel list '%s'\n", value);
+			return 2;
+		}
+	}
+
+	if (files.empty() || propagation.m_window <= 0 || propagation.m_maxLag < 0)
+	{
+		usage();
+		return 2;
+	}
+
+	// ----------------------------------------------------------------------------
+	// detection of all channels
+	t = CToolArgs::Now();
+	CBatchScheduler scheduler(settings, batch);
+	scheduler.Run(files, channels);
+	detectTime = CToolArgs::Now() - t;
+
+	if (!CToolArgs::PrintFileErrors("edf-propagation", scheduler))
+		status = 1;
+
+	FILE * output = outputPath ? fopen(outputPath, "w") : stdout;
+	FILE * lagsFile = lagsPath ? fopen(lagsPath, "w") : NULL;
+
+	if (output == NULL || (lagsPath && lagsFile == NULL))
+	{
+		fprintf(stderr, "edf-propagation: can not open the output file\n");
+		return 1;
+	}
+
+	fprintf(output, "file,channel1,label1,channel2,label2,count,lag_q25,lag_median,lag_q75,correlation_median\n");
+	if (lagsFile)
+		fprintf(lagsFile, "file,discharge,onset,channel1,channel2,lag,correlation\n");
+
+	// ----------------------------------------------------------------------------
+	// lags - the discharges of the channels of one file joined and analysed together
+	for (i = 0; i < (int)files.size(); i++)
+	{
+		CInputEDF                            model;
+		vector<const BATCH_CHANNEL_RESULT*>  fileResults;
+		vector<const CDischarges*>           channelDischarges;
+		vector<string>                       labels;
+		CDischarges                          discharges(0);
+
+		try
+		{
+			CToolArgs::OpenFile(model, files[i], batch);
+		}
+		catch (const char * e)
+		{
+			// reported by the scheduler
+			continue;
+		}
+
+		if (!CToolArgs::GetFileResults("edf-propagation", files[i], scheduler.GetResults(), i, fileResults))
+			status = 1;
+
+		channelDischarges.assign(model.GetCountChannels(), NULL);
+		labels.assign(model.GetCountChannels(), "");
+		for (j = 0; j < (int)fileResults.size(); j++)
+		{
+			if (fileResults[j]->m_channel < (int)channelDischarges.size())
+			{
+				channelDischarges[fileResults[j]->m_channel] = fileResults[j]->m_discharges.get();
+				labels[fileResults[j]->m_channel] = fileResults[j]->m_label;
+			}
+		}
+
+		CPropagation::Combine(channelDischarges, tolerance, discharges);
+
+		CPropagation analysis(&model, settings, propagation);
+		try
+		{
+			t = CToolArgs::Now();
+			analysis.Analyse(discharges, batch.m_workers);
+			lagTime += CToolArgs::Now() - t;
+		}
+		catch (const char * e)
+		{
+			fprintf(stderr, "edf-propagation: %s: %s\n", files[i].c_str(), e);
+			status = 1;
+			continue;
+		}
+
+		countEvents += analysis.GetCountEvents();
+
+		map<pair<int, int>, LAG_DISTRIBUTION>::const_iterator it;
+		for (it = analysis.GetPairs().begin(); it != analysis.GetPairs().end(); it++)
+		{
+			const LAG_DISTRIBUTION& distribution = it->second;
+			vector<double>          lags, correlations;
+			size_t                  k;
+
+			for (k = 0; k < distribution.m_lags.size(); k++)
+			{
+				if (distribution.m_correlations[k] < minCorrelation)
+					continue;
+
+				lags.push_back(distribution.m_lags[k]);
+				correlations.push_back(distribution.m_correlations[k]);
+
+				if (lagsFile)
+				{
+					CToolArgs::WriteQuoted(lagsFile, files[i].c_str());
+					fprintf(lagsFile, ",%d,%.6f,%d,%d,%.6f,%.4f\n", distribution.m_events[k], discharges.GetOnset(distribution.m_events[k]),
+							it->first.first, it->first.second, distribution.m_lags[k], distribution.m_correlations[k]);
+				}
+			}
+
+			if (lags.empty())
+				continue;
+
+			sort(lags.begin(), lags.end());
+			sort(correlations.begin(), correlations.end());
+
+			CToolArgs::WriteQuoted(output, files[i].c_str());
+			fprintf(output, ",%d,", it->first.first);
+			CToolArgs::WriteQuoted(output, labels[it->first.first].c_str());
+			fprintf(output, ",%d,", it->first.second);
+			CToolArgs::WriteQuoted(output, labels[it->first.second].c_str());
+			fprintf(output, ",%d,%.6f,%.6f,%.6f,%.4f\n", (int)lags.size(), quantile(lags, 0.25), quantile(lags, 0.5), quantile(lags, 0.75),
+					quantile(correlations, 0.5));
+			countPairs++;
+		}
+
+		model.CloseFile();
+	}
+
+	if (output != stdout)
+		fclose(output);
+	if (lagsFile)
+		fclose(lagsFile);
+
+	fprintf(stderr, "edf-propagation: %d multichannel discharges, %d pairs of channels, detection %.3f s, lags %.3f s\n",
+			countEvents, countPairs, detectTime, lagTime);
+
+	return status;
+}
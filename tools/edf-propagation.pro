@@ -0,0 +1,22 @@
+#-------------------------------------------------
+#
+# edf-propagation - lags of the discharges between the channels
+# from the cross-correlation of the envelopes.
+#
+#-------------------------------------------------
+
+CONFIG -= qt app_bundle
+CONFIG += console
+
+TARGET = edf-propagation
+TEMPLATE = app
+
+include(../libs/core.pri)
+
+SOURCES += edf-propagation.cpp \
+    CToolArgs.cpp
+
+HEADERS += CToolArgs.h
+
+LIBS = -L$$OUT_PWD/.. -ledf-core $$LIBS
+PRE_TARGETDEPS += $$OUT_PWD/../libedf-core.a
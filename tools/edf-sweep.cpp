@@ -0,0 +1,299 @@
+/**
+ * edf-sweep - sensitivity of the spike detector to its parameters.
+ *
+ * Runs the stages which do not depend on the thresholds (reading, filtering, the envelope and the lognormal fit) once
+ * per channel and derives the detections of every combination of the parameter grid from the kept curves
+ * (\ref CThresholdRetune::Sweep). The channels of one file run in parallel, every channel with its own retuner.
+ * Writes one CSV row per file, channel and combination with the counts of spikes and discharges, optionally one row per
+ * detection of every combination to score the combinations against reference marks.
+ *
+ * usage: edf-sweep [options] file1.edf [file2.edf ...]
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <memory>
+
+#include "CInputEDF.h"
+#include "CSpikeDetector.h"
+#include "CPipeline.h"
+#include "CThresholdRetune.h"
+#include "CParallel.h"
+#include "CToolArgs.h"
+
+using namespace std;
+
+/**
+ * The sweep of one channel.
+ */
+typedef struct sweepChannel
+{
+public:
+	/// the channel
+	int                                       m_channel;
+	/// error message of the channel, empty - none
+	string                                    m_error;
+	/// detections of the combinations, in the order of the grid
+	vector<unique_ptr<CDetectorOutput> >      m_outputs;
+	/// discharges of the combinations, in the order of the grid
+	vector<unique_ptr<CDischarges> >          m_discharges;
+	/// count of the threshold curves
+	int                                       m_countThresholds;
+	/// count of the marker passes
+	int                                       m_countMarkers;
+	/// time of the pipeline pass (second)
+	double                                    m_collectTime;
+	/// time of the sweep (second)
+	double                                    m_sweepTime;
+
+	/// A constructor
+	sweepChannel(const int& channel = 0)
+		: m_channel(channel), m_countThresholds(0), m_countMarkers(0), m_collectTime(0), m_sweepTime(0)
+	{
+		/* empty */
+	}
+} SWEEP_CHANNEL;
+
+/// Print usage to stderr.
+static void usage()
+{
+	fprintf(stderr,
+		"usage: edf-sweep [options] file1.edf [file2.edf ...]\n"
+		"\n"
+		"parameter grid, comma separated lists, every combination is evaluated:\n"
+		"  -k1 <list>   threshold k1 (3.65)\n"
+		"  -k2 <list>   threshold k2 (equal to k1)\n"
+		"  -k3 <list>   threshold k3 (0)\n"
+		"  -pt <list>   polyspike union time (0.12)\n"
+		"  -dt <list>   discharge tolerance (0.005)\n"
+		"\n");
+	CToolArgs::PrintDetectorUsage(stderr, false);
+	fprintf(stderr,
+		"\n"
+		"other options:\n"
+		"  -c <list>    channels to analyse, comma separated, starting at 0 (all)\n"
+		"  -j <count>   count of threads (all cores)\n"
+		"  -o <file>    output CSV with the counts of the combinations (stdout)\n"
+		"  -d <file>    output CSV with the detections of every combination (not written)\n");
+}
+
+int main(int argc, char ** argv)
+{
+	DETECTOR_SETTINGS         settings = CToolArgs::GetDefaultSettings();
+	vector<double>            k1(1, settings.m_k1), k2, k3(1, settings.m_k3);
+	vector<double>            pt(1, settings.m_polyspike_union_time), dt(1, settings.m_discharge_tol);
+	vector<DETECTOR_SETTINGS> grid;
+	vector<string>            files;
+	vector<int>               channels;
+	const char *              outputPath = NULL;
+	const char *              detectionsPath = NULL;
+	int                       workers = 0;
+	int                       status = 0;
+	int                       countChannels = 0, countThresholds = 0, countMarkers = 0;
+	double                    collectTime = 0, sweepTime = 0, wallTime;
+	size_t                    i, j, a, b, c, d, e;
+
+	// ----------------------------------------------------------------------------
+	// arguments
+	for (i = 1; i < (size_t)argc; i++)
+	{
+		string arg = argv[i];
+		bool   hasValue = (i + 1 < (size_t)argc);
+		bool   valid = true;
+
+		if (arg[0] != '-')
+		{
+			files.push_back(argv[i]);
+			continue;
+		}
+
+		if (!hasValue)
+		{
+			usage();
+			return 2;
+		}
+
+		const char * value = argv[++i];
+
+		if (arg == "-k1")       valid = CToolArgs::ParseValues(value, k1);
+		else if (arg == "-k2")  valid = CToolArgs::ParseValues(value, k2);
+		else if (arg == "-k3")  valid = CToolArgs::ParseValues(value, k3);
+		else if (arg == "-pt")  valid = CToolArgs::ParseValues(value, pt);
+		else if (arg == "-dt")  valid = CToolArgs::ParseValues(value, dt);
+		else if (arg == "-o")   outputPath = value;
+		else if (arg == "-d")   detectionsPath = value;
+		else if (arg == "-j")   workers = atoi(value);
+		else if (arg == "-c")   valid = CToolArgs::ParseChannels(value, channels);
+		else if (!CToolArgs::ParseDetectorOption(arg, value, settings, false))
+		{
+			usage();
+			return 2;
+		}
+
+		if (!valid)
+		{
+			fprintf(stderr, "edf-sweep: invalid list '%s'\n", value);
+			return 2;
+		}
+	}
+
+	if (files.empty())
+	{
+		usage();
+		return 2;
+	}
+
+	// ----------------------------------------------------------------------------
+	// grid - k2 follows k1 if not given
+	for (a = 0; a < k1.size(); a++)
+		for (b = 0; b < (k2.empty() ? 1 : k2.size()); b++)
+			for (c = 0; c < k3.size(); c++)
+				for (d = 0; d < pt.size(); d++)
+					for (e = 0; e < dt.size(); e++)
+					{
+						DETECTOR_SETTINGS combination = settings;
+
+						combination.m_k1 = k1[a];
+						combination.m_k2 = k2.empty() ? k1[a] : k2[b];
+						combination.m_k3 = k3[c];
+						combination.m_polyspike_union_time = pt[d];
+						combination.m_discharge_tol = dt[e];
+						grid.push_back(combination);
+					}
+
+	FILE * output = outputPath ? fopen(outputPath, "w") : stdout;
+	FILE * detectionsFile = detectionsPath ? fopen(detectionsPath, "w") : NULL;
+
+	if (output == NULL || (detectionsPath && detectionsFile == NULL))
+	{
+		fprintf(stderr, "edf-sweep: can not open the output file\n");
+		return 1;
+	}
+
+	fprintf(output, "combination,file,channel,label,k1,k2,k3,pt,dt,spikes,discharges\n");
+	if (detectionsFile)
+		fprintf(detectionsFile, "combination,file,channel,label,position,duration,condition,weight\n");
+
+	// ----------------------------------------------------------------------------
+	// sweep - one pipeline pass per channel, all combinations from the kept curves, the channels of one file in parallel
+	wallTime = CToolArgs::Now();
+	for (i = 0; i < files.size(); i++)
+	{
+		CInputEDF               model;
+		vector<SWEEP_CHANNEL>   sweeps;
+
+		try
+		{
+			model.OpenFile(files[i].c_str());
+		}
+		catch (const char * e)
+		{
+			fprintf(stderr, "edf-sweep: %s: %s\n", files[i].c_str(), e);
+			status = 1;
+			continue;
+		}
+
+		if (channels.empty())
+			for (j = 0; j < (size_t)model.GetCountChannels(); j++)
+				sweeps.push_back(SWEEP_CHANNEL(j));
+		else for (j = 0; j < channels.size(); j++)
+			sweeps.push_back(SWEEP_CHANNEL(channels[j]));
+
+		CParallel::Run(sweeps.size(), workers, [&](int index) {
+			SWEEP_CHANNEL&   sweep = sweeps[index];
+			CThresholdRetune retune(settings);
+			double           t;
+
+			try
+			{
+				if (sweep.m_channel >= model.GetCountChannels())
+					throw "channel does not exist";
+				if (model.GetFS(sweep.m_channel) <= 0)
+					throw "channel has no samples";
+
+				CPipeline pipeline(&model, settings);
+
+				t = CToolArgs::Now();
+				pipeline.AddDetector(&retune);
+				pipeline.RunChannel(sweep.m_channel);
+				sweep.m_collectTime = CToolArgs::Now() - t;
+
+				t = CToolArgs::Now();
+				retune.Sweep(grid, sweep.m_outputs, sweep.m_discharges);
+				sweep.m_sweepTime = CToolArgs::Now() - t;
+			}
+			catch (const char * e)
+			{
+				sweep.m_error = e;
+				return;
+			}
+
+			sweep.m_countThresholds = retune.GetCountThresholds();
+			sweep.m_countMarkers = retune.GetCountMarkers();
+		});
+
+		// the rows in the order of the channels, the output does not depend on scheduling
+		for (j = 0; j < sweeps.size(); j++)
+		{
+			const SWEEP_CHANNEL& sweep = sweeps[j];
+			int                  channelDischarges, l;
+			size_t               k, m;
+
+			if (!sweep.m_error.empty())
+			{
+				fprintf(stderr, "edf-sweep: %s: channel %d: %s\n", files[i].c_str(), sweep.m_channel, sweep.m_error.c_str());
+				status = 1;
+				continue;
+			}
+
+			countChannels++;
+			countThresholds += sweep.m_countThresholds;
+			countMarkers += sweep.m_countMarkers;
+			collectTime += sweep.m_collectTime;
+			sweepTime += sweep.m_sweepTime;
+
+			for (k = 0; k < grid.size(); k++)
+			{
+				const CDetectorOutput * out = sweep.m_outputs[k].get();
+
+				channelDischarges = 0;
+				for (l = 0; l < (int)sweep.m_discharges[k]->GetCountChannels(); l++)
+					channelDischarges += sweep.m_discharges[k]->m_MP[l].size();
+
+				fprintf(output, "%d,", (int)k);
+				CToolArgs::WriteQuoted(output, files[i].c_str());
+				fprintf(output, ",%d,", sweep.m_channel);
+				CToolArgs::WriteQuoted(output, model.GetLabel(sweep.m_channel));
+				fprintf(output, ",%g,%g,%g,%g,%g,%d,%d\n", grid[k].m_k1, grid[k].m_k2, grid[k].m_k3, grid[k].m_polyspike_union_time,
+						grid[k].m_discharge_tol, (int)out->m_pos.size(), channelDischarges);
+
+				if (!detectionsFile)
+					continue;
+
+				for (m = 0; m < out->m_pos.size(); m++)
+				{
+					fprintf(detectionsFile, "%d,", (int)k);
+					CToolArgs::WriteQuoted(detectionsFile, files[i].c_str());
+					fprintf(detectionsFile, ",%d,", sweep.m_channel);
+					CToolArgs::WriteQuoted(detectionsFile, model.GetLabel(sweep.m_channel));
+					fprintf(detectionsFile, ",%.6f,%.6f,%.2f,%.6g\n", out->m_pos[m], out->m_dur[m], out->m_con[m], out->m_weight[m]);
+				}
+			}
+		}
+
+		model.CloseFile();
+	}
+
+	if (output != stdout)
+		fclose(output);
+	if (detectionsFile)
+		fclose(detectionsFile);
+
+	wallTime = CToolArgs::Now() - wallTime;
+
+	fprintf(stderr, "edf-sweep: %d channels, %d combinations, %.3f s, pipeline %.3f s, sweep %.3f s (all threads), %d threshold curves, "
+			"%d marker passes\n", countChannels, (int)grid.size(), wallTime, collectTime, sweepTime, countThresholds, countMarkers);
+
+	return status;
+}
@@ -0,0 +1,22 @@
+#-------------------------------------------------
+#
+# edf-sweep - detections of the spike detector for a grid of parameters
+# from one pass of the shared stages per channel.
+#
+#-------------------------------------------------
+
+CONFIG -= qt app_bundle
+CONFIG += console
+
+TARGET = edf-sweep
+TEMPLATE = app
+
+include(../libs/core.pri)
+
+SOURCES += edf-sweep.cpp \
+    CToolArgs.cpp
+
+HEADERS += CToolArgs.h
+
+LIBS = -L$$OUT_PWD/.. -ledf-core $$LIBS
+PRE_TARGETDEPS += $$OUT_PWD/../libedf-core.a
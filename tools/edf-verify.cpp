@@ -0,0 +1,621 @@
+/**
+ * edf-verify - reference equivalence of the fast DSP kernels.
+ *
+ * Runs every stage of the detector (decimation, 50 Hz filter, band filter, envelope, window statistics, thresholds,
+ * local maxima) with the reference kernels and with the selected fast kernels (\ref CDSP::SetFastPaths) on the same
+ * reference input, reports the maximal error of every stage and compares the spikes and discharges of the whole
+ * pipeline. Without an input file a synthetic recording is generated (\ref CSyntheticEDF).
+ *
+ * With -large a synthetic recording longer than 2^31 samples per channel is generated instead and the recall of the
+ * injected spikes past sample 2^31 is checked - the sample indices of the reader and the detector must not overflow.
+ *
+ * Exit code 0 - all stages within the tolerances, 1 - a tolerance is exceeded or an error, 2 - bad arguments.
+ *
+ * usage: edf-verify [options] [file.edf]
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <memory>
+
+#include "CInputEDF.h"
+#include "CDSP.h"
+#include "CSpikeDetector.h"
+#include "CSyntheticEDF.h"
+#include "CToolArgs.h"
+
+using namespace std;
+
+/// The large recording has more samples per channel than this (2^31).
+#define VERIFY_LARGE_SAMPLES 2147483648LL
+/// The large recording continues this long past \ref VERIFY_LARGE_SAMPLES (second).
+#define VERIFY_LARGE_TAIL    600
+/// Sample rate of the large recording (Hz).
+#define VERIFY_LARGE_FS      30000
+/// Largest distance of a detection from an injected spike to recall it (second).
+#define VERIFY_RECALL_TOL    0.1
+
+/// Stages compared on the reference input.
+enum verifyStage
+{
+	VERIFY_RESAMPLE = 0,
+	VERIFY_FILT50HZ,
+	VERIFY_FILTERING,
+	VERIFY_ENVELOPE,
+	VERIFY_WINDOW_STATISTICS,
+	VERIFY_THRESHOLDS,
+	VERIFY_LOCAL_MAXIMA,
+	VERIFY_COUNT
+};
+
+/// Names of the stages in the report.
+static const char * verifyNames[VERIFY_COUNT] = {
+	"resample", "filt50hz", "filtering", "envelope", "window_statistics", "thresholds", "local_maxima"
+};
+
+/// Names of the fast paths, the order of the \ref DSP_FAST_PATH bits.
+static const char * fastNames[] = { "filtfilt", "hilbert", "resample", "spline", "maxima" };
+
+/**
+ * Maximal error of one stage.
+ */
+typedef struct verifyError
+{
+public:
+	/// maximal absolute error
+	double    m_abs;
+	/// maximal absolute error relative to the peak of the reference
+	double    m_rel;
+	/// count of different markers / positions
+	long long m_mismatches;
+	/// count of compared values
+	long long m_count;
+
+	/// A constructor
+	verifyError()
+		: m_abs(0), m_rel(0), m_mismatches(0), m_count(0)
+	{
+		/* empty */
+	}
+} VERIFY_ERROR;
+
+/// Print usage to stderr.
+static void usage()
+{
+	fprintf(stderr,
+		"usage: edf-verify [options] [file.edf]\n"
+		"\n"
+		"verification:\n"
+		"  -fast <list>  fast paths, comma separated: filtfilt,hilbert,resample,spline,maxima or all (all)\n"
+		"  -tol <e>      maximal error of a stage relative to the peak of the reference (1e-4)\n"
+		"  -rtol <e>     the same for the resample stage (1e-2)\n"
+		"  -ptol <s>     maximal shift of a spike or a discharge (0.005)\n"
+		"  -wtol <e>     maximal error of the weight and the pdf of a spike (1e-3)\n"
+		"  -miss <f>     maximal fraction of unmatched spikes and discharges (0.01)\n"
+		"  -ch <list>    channels, comma separated, starting at 0 (all)\n"
+		"  -o <file>     output CSV report (not written)\n"
+		"  -large        only the recall past sample 2^31 of a synthetic recording of 1 channel at 30 kHz longer\n"
+		"                than 2^31 samples (4.3 GB, 8.6 GB with -bdf), removed after the check unless -gen is given\n"
+		"\n"
+		"synthetic recording (used without an input file):\n"
+		"  -c <count>    count of channels (4)\n"
+		"  -fs <Hz>      sample rate (512)\n"
+		"  -t <s>        duration (600)\n"
+		"  -bdf          BDF+ instead of EDF+\n"
+		"  -seed <n>     seed of the generator (1)\n"
+		"  -gen <file>   path of the generated file (edf-verify-synthetic.edf / .bdf)\n");
+}
+
+/// Parse comma separated list of fast paths.
+static bool parseFast(const char * list, int& mask)
+{
+	string item;
+	int    i;
+
+	mask = 0;
+	for (const char * p = list; ; p++)
+	{
+		if (*p && *p != ',')
+		{
+			item += *p;
+			continue;
+		}
+
+		if (item == "all")
+			mask |= DSP_FAST_ALL;
+		else
+		{
+			for (i = 0; i < 5 && item != fastNames[i]; i++)
+				;
+			if (i == 5)
+				return false;
+			mask |= 1 << i;
+		}
+
+		item.clear();
+		if (*p == 0)
+			break;
+	}
+
+	return mask != 0;
+}
+
+/// Add the difference of two signals to the error of a stage.
+template <typename T>
+static void compare(const vector<T>& reference, const vector<T>& fast, VERIFY_ERROR& error)
+{
+	double peak = 0, diff = 0;
+	size_t i, count = min(reference.size(), fast.size());
+
+	if (reference.size() != fast.size())
+		error.m_mismatches += max(reference.size(), fast.size()) - count;
+
+	for (i = 0; i < count; i++)
+	{
+		peak = max(peak, fabs((double)reference[i]));
+		diff = max(diff, fabs((double)reference[i] - (double)fast[i]));
+	}
+
+	error.m_abs = max(error.m_abs, diff);
+	if (peak > 0)
+		error.m_rel = max(error.m_rel, diff / peak);
+	else if (diff > 0)
+		error.m_rel = HUGE_VAL;
+	error.m_count += count;
+}
+
+/// Add the different markers to the error of a stage.
+static void compareMarkers(const vector<bool>& reference, const vector<bool>& fast, VERIFY_ERROR& error)
+{
+	size_t i, count = min(reference.size(), fast.size());
+
+	error.m_mismatches += max(reference.size(), fast.size()) - count;
+	for (i = 0; i < count; i++)
+		if (reference[i] != fast[i])
+			error.m_mismatches++;
+	error.m_count += count;
+}
+
+/**
+ * Compare the stages of one segment. Every stage gets the output of the reference previous stage.
+ */
+static void verifySegment(CInputEDF& model, DETECTOR_SETTINGS& settings, const int& channel, const SAMPLEINDEX& start, const SAMPLEINDEX& stop,
+						  const int& mask, VERIFY_ERROR * errors)
+{
+	BANDWIDTH            bandwidth(settings.m_band_low, settings.m_band_high);
+	int                  fs = model.GetFS(channel);
+	vector<SIGNALTYPE> * data;
+	vector<SIGNALTYPE> * fast;
+	vector<int>          index;
+	int                  i;
+
+	data = model.GetSegmentFromChannel(channel, start, stop);
+	if (data == NULL)
+		throw "Error reading samples from file!";
+
+	// decimation
+	if (fs > settings.m_decimation)
+	{
+		fast = new vector<SIGNALTYPE>(*data);
+
+		CDSP::SetFastPaths(0);
+		CDSP::ResampleOneChannel(data, fs, settings.m_decimation);
+		CDSP::SetFastPaths(mask);
+		CDSP::ResampleOneChannel(fast, fs, settings.m_decimation);
+		compare(*data, *fast, errors[VERIFY_RESAMPLE]);
+		delete fast;
+
+		fs = settings.m_decimation;
+	}
+
+	CSpikeDetector::GetWindowIndex(data->size(), settings.m_winsize * fs, settings.m_noverlap * fs, index);
+
+	// filtering
+	fast = new vector<SIGNALTYPE>(*data);
+	CDSP::SetFastPaths(0);
+	CDSP::Filt50Hz(data, 1, fs, settings.m_main_hum_freq, bandwidth);
+	CDSP::SetFastPaths(mask);
+	CDSP::Filt50Hz(fast, 1, fs, settings.m_main_hum_freq, bandwidth);
+	compare(*data, *fast, errors[VERIFY_FILT50HZ]);
+
+	fast->assign(data->begin(), data->end());
+	CDSP::SetFastPaths(0);
+	CDSP::Filtering(data, 1, fs, bandwidth);
+	CDSP::SetFastPaths(mask);
+	CDSP::Filtering(fast, 1, fs, bandwidth);
+	compare(*data, *fast, errors[VERIFY_FILTERING]);
+	delete fast;
+
+	// detection of one channel
+	COneChannelDetect    detect(data, &settings, fs, &index, 0);
+	vector<SIGNALTYPE>   envelope[2], phatMedian[2], phatStd[2];
+	vector<double>       prah_int[2][2], envelope_cdf[2], envelope_pdf[2];
+	vector<bool>         markers[2];
+	bool                 thresholds[2];
+
+	// i = 0 - reference, i = 1 - fast
+	for (i = 0; i < 2; i++)
+	{
+		CDSP::SetFastPaths(i ? mask : 0);
+		detect.Envelope(envelope[i]);
+	}
+	compare(envelope[0], envelope[1], errors[VERIFY_ENVELOPE]);
+
+	for (i = 0; i < 2; i++)
+	{
+		CDSP::SetFastPaths(i ? mask : 0);
+		detect.WindowStatistics(envelope[0], phatMedian[i], phatStd[i]);
+	}
+	compare(phatMedian[0], phatMedian[1], errors[VERIFY_WINDOW_STATISTICS]);
+	compare(phatStd[0], phatStd[1], errors[VERIFY_WINDOW_STATISTICS]);
+
+	for (i = 0; i < 2; i++)
+	{
+		CDSP::SetFastPaths(i ? mask : 0);
+		thresholds[i] = detect.Thresholds(envelope[0], phatMedian[0], phatStd[0], prah_int[i], envelope_cdf[i], envelope_pdf[i]);
+	}
+	delete data;
+	if (!thresholds[0] || !thresholds[1])
+		throw "Interpolation of the thresholds failed.";
+
+	compare(prah_int[0][0], prah_int[1][0], errors[VERIFY_THRESHOLDS]);
+	compare(prah_int[0][1], prah_int[1][1], errors[VERIFY_THRESHOLDS]);
+	compare(envelope_cdf[0], envelope_cdf[1], errors[VERIFY_THRESHOLDS]);
+	compare(envelope_pdf[0], envelope_pdf[1], errors[VERIFY_THRESHOLDS]);
+
+	for (i = 0; i < 2; i++)
+	{
+		CDSP::SetFastPaths(i ? mask : 0);
+		markers[i] = detect.localMaximaDetection(envelope[0], prah_int[0][0], settings.m_polyspike_union_time);
+	}
+	compareMarkers(markers[0], markers[1], errors[VERIFY_LOCAL_MAXIMA]);
+
+	CDSP::SetFastPaths(0);
+}
+
+/**
+ * Count the events of the reference without an event of the other output within the tolerance.
+ * @param valueError maximal difference of the values of the matched events
+ */
+static int countUnmatched(const vector<double>& refPos, const vector<int>& refChan, const vector<double>& refValue,
+						  const vector<double>& pos, const vector<int>& chan, const vector<double>& value, const double& tolerance,
+						  double& valueError)
+{
+	int    unmatched = 0;
+	size_t i, j, best;
+
+	for (i = 0; i < refPos.size(); i++)
+	{
+		best = pos.size();
+		for (j = 0; j < pos.size(); j++)
+		{
+			if (chan[j] != refChan[i] || fabs(pos[j] - refPos[i]) > tolerance)
+				continue;
+			if (best == pos.size() || fabs(pos[j] - refPos[i]) < fabs(pos[best] - refPos[i]))
+				best = j;
+		}
+
+		if (best == pos.size())
+			unmatched++;
+		else if (!refValue.empty())
+			valueError = max(valueError, fabs(refValue[i] - value[best]));
+	}
+
+	return unmatched;
+}
+
+/**
+ * Recall of the injected spikes past sample \ref VERIFY_LARGE_SAMPLES of a synthetic recording. The whole channel is
+ * segmented, only the segments reaching past \ref VERIFY_LARGE_SAMPLES are detected. Throws an error message.
+ * @return true if the count of the samples is right and the recall is within the tolerance
+ */
+static bool verifyLarge(SYNTHETIC_SETTINGS synthetic, const string& path, DETECTOR_SETTINGS settings, const double& missTolerance)
+{
+	vector<SAMPLEINDEX>         indexStart, indexStop;
+	unique_ptr<CDetectorOutput> out(new CDetectorOutput()), subOut;
+	unique_ptr<CDischarges>     discharges(new CDischarges(1)), subDischarges;
+	CInputEDF                   model;
+	int                         segment, checked = 0, missed = 0;
+	size_t                      i, j;
+
+	synthetic.m_channels = 1;
+	synthetic.m_fs = VERIFY_LARGE_FS;
+	synthetic.m_duration = (int)(VERIFY_LARGE_SAMPLES / VERIFY_LARGE_FS) + 1 + VERIFY_LARGE_TAIL;
+
+	CSyntheticEDF generator(synthetic);
+	generator.Write(path.c_str());
+
+	model.OpenFile(path.c_str());
+
+	SAMPLEINDEX countSamples = model.GetCountSamples(0);
+	bool        countOk = countSamples == (SAMPLEINDEX)synthetic.m_duration * synthetic.m_fs;
+
+	CSpikeDetector detector(&model, &settings);
+	detector.GetSegments(0, indexStart, indexStop);
+	for (segment = 0; segment < (int)indexStop.size(); segment++)
+	{
+		if (indexStop[segment] <= VERIFY_LARGE_SAMPLES)
+			continue;
+
+		if (!detector.AnalyseSegment(0, indexStart, indexStop, segment, subOut, subDischarges))
+			throw "Error reading samples from file!";
+		CSpikeDetector::AppendSegment(*out, *discharges, std::move(*subOut), std::move(*subDischarges));
+	}
+	model.CloseFile();
+
+	const vector<SYNTHETIC_SPIKE>& injected = generator.GetSpikes();
+	for (i = 0; i < injected.size(); i++)
+	{
+		if (injected[i].m_position * synthetic.m_fs < VERIFY_LARGE_SAMPLES)
+			continue;
+
+		checked++;
+		for (j = 0; j < out->m_pos.size() && fabs(out->m_pos[j] - injected[i].m_position) > VERIFY_RECALL_TOL; j++)
+			;
+		if (j == out->m_pos.size())
+			missed++;
+	}
+
+	bool recallOk = checked > 0 && missed <= missTolerance * checked;
+
+	printf("input: %s\n\n", path.c_str());
+	printf("samples:    %lld, expected %lld  %s\n", countSamples, (SAMPLEINDEX)synthetic.m_duration * synthetic.m_fs,
+		   countOk ? "ok" : "FAILED");
+	printf("recall:     injected past sample %lld %d, detected %zu, missed %d  %s\n", VERIFY_LARGE_SAMPLES, checked,
+		   out->m_pos.size(), missed, recallOk ? "ok" : "FAILED");
+
+	return countOk && recallOk;
+}
+
+int main(int argc, char ** argv)
+{
+	DETECTOR_SETTINGS    settings = CToolArgs::GetDefaultSettings();
+	SYNTHETIC_SETTINGS   synthetic;
+	string               input;
+	string               generated;
+	const char *         reportPath = NULL;
+	int                  mask = DSP_FAST_ALL;
+	double               tolerance = 1e-4, resampleTolerance = 1e-2, positionTolerance = 0.005;
+	double               weightTolerance = 1e-3, missTolerance = 0.01;
+	vector<int>          channels;
+	VERIFY_ERROR         errors[VERIFY_COUNT];
+	int                  i, segment;
+	bool                 failed = false;
+	bool                 large = false;
+
+	// ----------------------------------------------------------------------------
+	// arguments
+	for (i = 1; i < argc; i++)
+	{
+		string arg = argv[i];
+
+		if (arg[0] != '-')
+		{
+			input = argv[i];
+			continue;
+		}
+
+		if (arg == "-bdf")
+		{
+			synthetic.m_bdf = true;
+			continue;
+		}
+
+		if (arg == "-large")
+		{
+			large = true;
+			continue;
+		}
+
+		if (i + 1 >= argc)
+		{
+			usage();
+			return 2;
+		}
+
+		const char * value = argv[++i];
+
+		if (arg == "-fast")
+		{
+			if (!parseFast(value, mask))
+			{
+				usage();
+				return 2;
+			}
+		}
+		else if (arg == "-tol")    tolerance = atof(value);
+		else if (arg == "-rtol")   resampleTolerance = atof(value);
+		else if (arg == "-ptol")   positionTolerance = atof(value);
+		else if (arg == "-wtol")   weightTolerance = atof(value);
+		else if (arg == "-miss")   missTolerance = atof(value);
+		else if (arg == "-ch")
+		{
+			if (!CToolArgs::ParseChannels(value, channels))
+			{
+				usage();
+				return 2;
+			}
+		}
+		else if (arg == "-o")      reportPath = value;
+		else if (arg == "-c")      synthetic.m_channels = atoi(value);
+		else if (arg == "-fs")     synthetic.m_fs = atoi(value);
+		else if (arg == "-t")      synthetic.m_duration = atoi(value);
+		else if (arg == "-seed")   synthetic.m_seed = strtoul(value, NULL, 10);
+		else if (arg == "-gen")    generated = value;
+		else
+		{
+			usage();
+			return 2;
+		}
+	}
+
+	if (large && !input.empty())
+	{
+		usage();
+		return 2;
+	}
+
+	try
+	{
+		// ----------------------------------------------------------------------------
+		// sample indices past 2^31
+		if (large)
+		{
+			string path = !generated.empty() ? generated : (synthetic.m_bdf ? "edf-verify-large.bdf" : "edf-verify-large.edf");
+
+			failed = !verifyLarge(synthetic, path, settings, missTolerance);
+			if (generated.empty())
+				remove(path.c_str());
+
+			return failed ? 1 : 0;
+		}
+
+		// ----------------------------------------------------------------------------
+		// synthetic recording
+		if (input.empty())
+		{
+			if (generated.empty())
+				generated = synthetic.m_bdf ? "edf-verify-synthetic.bdf" : "edf-verify-synthetic.edf";
+
+			CSyntheticEDF generator(synthetic);
+			generator.Write(generated.c_str());
+			input = generated;
+		}
+
+		CInputEDF model;
+		model.OpenFile(input.c_str());
+
+		if (channels.empty())
+			for (i = 0; i < model.GetCountChannels(); i++)
+				channels.push_back(i);
+
+		// ----------------------------------------------------------------------------
+		// stages on the reference input, whole pipeline
+		vector<double> refPos, refWeight, refPdf, fastPos, fastWeight, fastPdf;
+		vector<double> refDisPos, fastDisPos, noValue;
+		vector<int>    refChan, fastChan, refDisChan, fastDisChan;
+
+		for (size_t c = 0; c < channels.size(); c++)
+		{
+			int channel = channels[c];
+
+			if (channel >= model.GetCountChannels())
+				throw "Channel out of range.";
+			if (model.GetFS(channel) <= 0)
+				continue;
+
+			DETECTOR_SETTINGS   channelSettings = settings;
+			CSpikeDetector      detector(&model, &channelSettings);
+			vector<SAMPLEINDEX> indexStart, indexStop;
+
+			detector.GetSegments(channel, indexStart, indexStop);
+			for (segment = 0; segment < (int)indexStop.size(); segment++)
+				verifySegment(model, channelSettings, channel, indexStart[segment], indexStop[segment], mask, errors);
+
+			// i = 0 - reference, i = 1 - fast
+			for (i = 0; i < 2; i++)
+			{
+				DETECTOR_SETTINGS runSettings = settings;
+				CSpikeDetector    run(&model, &runSettings);
+				unique_ptr<CDetectorOutput> out;
+				unique_ptr<CDischarges>     discharges;
+
+				CDSP::SetFastPaths(i ? mask : 0);
+				run.AnalyseChannel(channel, out, discharges);
+
+				vector<double>& pos = i ? fastPos : refPos;
+				vector<int>&    chan = i ? fastChan : refChan;
+				for (size_t j = 0; j < out->m_pos.size(); j++)
+				{
+					pos.push_back(out->m_pos[j]);
+					chan.push_back(channel);
+					(i ? fastWeight : refWeight).push_back(out->m_weight[j]);
+					(i ? fastPdf : refPdf).push_back(out->m_pdf[j]);
+				}
+
+				vector<double>& disPos = i ? fastDisPos : refDisPos;
+				vector<int>&    disChan = i ? fastDisChan : refDisChan;
+				for (size_t j = 0; j < discharges->m_MP[0].size(); j++)
+				{
+					disPos.push_back(discharges->m_MP[0][j]);
+					disChan.push_back(channel);
+				}
+			}
+			CDSP::SetFastPaths(0);
+		}
+
+		model.CloseFile();
+
+		// ----------------------------------------------------------------------------
+		// report
+		FILE * report = NULL;
+		if (reportPath)
+		{
+			report = fopen(reportPath, "w");
+			if (report == NULL)
+				throw "Can not open the output file.";
+			fprintf(report, "stage,max_abs,max_rel,mismatches,count,tolerance,result\n");
+		}
+
+		printf("input: %s\nfast paths:", input.c_str());
+		for (i = 0; i < 5; i++)
+			if (mask & (1 << i))
+				printf(" %s", fastNames[i]);
+		printf("\n\n%-18s %12s %12s %10s %12s  %s\n", "stage", "max_abs", "max_rel", "mismatches", "tolerance", "result");
+
+		for (i = 0; i < VERIFY_COUNT; i++)
+		{
+			double stageTolerance = (i == VERIFY_RESAMPLE) ? resampleTolerance : tolerance;
+			bool   ok = errors[i].m_rel <= stageTolerance && errors[i].m_mismatches == 0;
+
+			failed |= !ok;
+			printf("%-18s %12.3e %12.3e %10lld %12.3e  %s\n", verifyNames[i], errors[i].m_abs, errors[i].m_rel,
+				   errors[i].m_mismatches, stageTolerance, ok ? "ok" : "FAILED");
+			if (report)
+			{
+				fprintf(report, "%s,%.6e,%.6e,%lld,%lld,%.6e,%s\n", verifyNames[i], errors[i].m_abs, errors[i].m_rel,
+						errors[i].m_mismatches, errors[i].m_count, stageTolerance, ok ? "ok" : "failed");
+			}
+		}
+
+		// spikes and discharges, unmatched in both directions
+		double weightError = 0, pdfError = 0, unused = 0;
+		int    missedSpikes = countUnmatched(refPos, refChan, refWeight, fastPos, fastChan, fastWeight, positionTolerance, weightError)
+							+ countUnmatched(fastPos, fastChan, noValue, refPos, refChan, noValue, positionTolerance, unused);
+		int    missedDischarges = countUnmatched(refDisPos, refDisChan, noValue, fastDisPos, fastDisChan, noValue, positionTolerance, unused)
+								+ countUnmatched(fastDisPos, fastDisChan, noValue, refDisPos, refDisChan, noValue, positionTolerance, unused);
+
+		countUnmatched(refPos, refChan, refPdf, fastPos, fastChan, fastPdf, positionTolerance, pdfError);
+
+		size_t countSpikes = max(refPos.size(), fastPos.size());
+		size_t countDischarges = max(refDisPos.size(), fastDisPos.size());
+		bool   spikesOk = missedSpikes <= missTolerance * countSpikes && weightError <= weightTolerance && pdfError <= weightTolerance;
+		bool   dischargesOk = missedDischarges <= missTolerance * countDischarges;
+
+		failed |= !spikesOk || !dischargesOk;
+		printf("\nspikes:     reference %zu, fast %zu, unmatched %d, max weight error %.3e, max pdf error %.3e  %s\n",
+			   refPos.size(), fastPos.size(), missedSpikes, weightError, pdfError, spikesOk ? "ok" : "FAILED");
+		printf("discharges: reference %zu, fast %zu, unmatched %d  %s\n",
+			   refDisPos.size(), fastDisPos.size(), missedDischarges, dischargesOk ? "ok" : "FAILED");
+
+		if (report)
+		{
+			fprintf(report, "spikes,%.6e,%.6e,%d,%zu,%.6e,%s\n", weightError, pdfError, missedSpikes, countSpikes, missTolerance,
+					spikesOk ? "ok" : "failed");
+			fprintf(report, "discharges,0,0,%d,%zu,%.6e,%s\n", missedDischarges, countDischarges, missTolerance,
+					dischargesOk ? "ok" : "failed");
+			fclose(report);
+		}
+	}
+	catch (const char * error)
+	{
+		fprintf(stderr, "edf-verify: %s\n", error);
+		return 1;
+	}
+
+	return failed ? 1 : 0;
+}
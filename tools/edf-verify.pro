@@ -0,0 +1,24 @@
+#-------------------------------------------------
+#
+# edf-verify - reference equivalence of the fast DSP kernels
+# on real or synthetic EDF+/BDF+ recordings.
+#
+#-------------------------------------------------
+
+CONFIG -= qt app_bundle
+CONFIG += console
+
+TARGET = edf-verify
+TEMPLATE = app
+
+include(../libs/core.pri)
+
+SOURCES += edf-verify.cpp \
+    CSyntheticEDF.cpp \
+    CToolArgs.cpp
+
+HEADERS += CSyntheticEDF.h \
+    CToolArgs.h
+
+LIBS = -L$$OUT_PWD/.. -ledf-core $$LIBS
+PRE_TARGETDEPS += $$OUT_PWD/../libedf-core.a
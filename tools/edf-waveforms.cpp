@@ -0,0 +1,231 @@
+/**
+ * edf-waveforms - waveforms of the detected spikes and their clusters by the shape.
+ *
+ * Detects the spikes of all (or selected) channels (\ref CBatchScheduler), extracts the aligned waveform of every
+ * spike, projects the waveforms to their principal components and clusters them by k-means, every channel on its own
+ * (\ref CWaveforms). Writes one CSV row per spike with its cluster and features, optionally the mean waveforms of the
+ * clusters.
+ *
+ * usage: edf-waveforms [options] file1.edf [file2.edf ...]
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "CInputEDF.h"
+#include "CSpikeDetector.h"
+#include "CBatchScheduler.h"
+#include "CWaveforms.h"
+#include "CToolArgs.h"
+
+using namespace std;
+
+/// Print usage to stderr.
+static void usage()
+{
+	fprintf(stderr,
+		"usage: edf-waveforms [options] file1.edf [file2.edf ...]\n"
+		"\n"
+		"waveforms and clusters:\n"
+		"  -before <s>  length of the waveform before the peak (0.05)\n"
+		"  -after <s>   length of the waveform after the peak (0.1)\n"
+		"  -align <s>   the peak is searched within this distance of the detection (0.01)\n"
+		"  -pc <count>  count of the principal components (3)\n"
+		"  -k <count>   count of the clusters of one channel (3)\n"
+		"  -restarts <count>  restarts of k-means (5)\n"
+		"  -maxit <count>     the largest count of iterations of k-means, 0 - until convergence (0)\n"
+		"\n");
+	CToolArgs::PrintDetectorUsage(stderr);
+	fprintf(stderr,
+		"\n"
+		"other options:\n");
+	CToolArgs::PrintBatchUsage(stderr);
+	fprintf(stderr,
+		"  -o <file>    output CSV with the cluster and features of every spike (stdout)\n"
+		"  -m <file>    output CSV with the mean waveforms of the clusters (not written)\n");
+}
+
+int main(int argc, char ** argv)
+{
+	DETECTOR_SETTINGS     settings = CToolArgs::GetDefaultSettings();
+	WAVEFORM_SETTINGS     waveform;
+	BATCH_SETTINGS        batch;
+	vector<string>        files;
+	vector<int>           channels;
+	const char *          outputPath = NULL;
+	const char *          meansPath = NULL;
+	double                detectTime, clusterTime = 0, t;
+	int                   status = 0, countSpikes = 0, countReads = 0;
+	int                   i, j, k;
+	size_t                s;
+
+	// ----------------------------------------------------------------------------
+	// arguments
+	for (i = 1; i < argc; i++)
+	{
+		string arg = argv[i];
+		bool   hasValue = (i + 1 < argc);
+		bool   valid = true;
+
+		if (arg[0] != '-')
+		{
+			files.push_back(argv[i]);
+			continue;
+		}
+
+		if (!hasValue)
+		{
+			usage();
+			return 2;
+		}
+
+		const char * value = argv[++i];
+
+		if (arg == "-before")   waveform.m_before = atof(value);
+		else if (arg == "-after") waveform.m_after = atof(value);
+		else if (arg == "-align") waveform.m_align = atof(value);
+		else if (arg == "-pc")  waveform.m_components = atoi(value);
+		else if (arg == "-k")   waveform.m_clusters = atoi(value);
+		else if (arg == "-restarts") waveform.m_restarts = atoi(value);
+		else if (arg == "-maxit") waveform.m_maxIterations = atoi(value);
+		else if (arg == "-o")   outputPath = value;
+		else if (arg == "-m")   meansPath = value;
+		else if (!CToolArgs::ParseDetectorOption(arg, value, settings) && !CToolArgs::ParseBatchOption(arg, value, batch, channels, valid))
+		{
+			usage();
+			return 2;
+		}
+
+		if (!valid)
+		{
+			fprintf(stderr, "edf-waveforms: invalid channel list '%s'\n", value);
+			return 2;
+		}
+	}
+
+	if (files.empty() || waveform.m_before < 0 || waveform.m_after <= 0 || waveform.m_align < 0 || waveform.m_components < 1
+		|| waveform.m_clusters < 1 || waveform.m_restarts < 1 || waveform.m_maxIterations < 0)
+	{
+		usage();
+		return 2;
+	}
+
+	// ----------------------------------------------------------------------------
+	// detection of all channels
+	t = CToolArgs::Now();
+	CBatchScheduler scheduler(settings, batch);
+	scheduler.Run(files, channels);
+	detectTime = CToolArgs::Now() - t;
+
+	if (!CToolArgs::PrintFileErrors("edf-waveforms", scheduler))
+		status = 1;
+
+	FILE * output = outputPath ? fopen(outputPath, "w") : stdout;
+	FILE * meansFile = meansPath ? fopen(meansPath, "w") : NULL;
+
+	if (output == NULL || (meansPath && meansFile == NULL))
+	{
+		fprintf(stderr, "edf-waveforms: can not open the output file\n");
+		return 1;
+	}
+
+	fprintf(output, "file,channel,label,position,peak,cluster");
+	for (k = 0; k < waveform.m_components; k++)
+		fprintf(output, ",pc%d", k + 1);
+	fprintf(output, "\n");
+	if (meansFile)
+		fprintf(meansFile, "file,channel,label,cluster,size,time,value\n");
+
+	// ----------------------------------------------------------------------------
+	// waveforms - the channels of one file in parallel
+	for (i = 0; i < (int)files.size(); i++)
+	{
+		CInputEDF                            model;
+		vector<const BATCH_CHANNEL_RESULT*>  fileResults;
+		vector<int>                          fileChannels;
+		vector<const vector<double>*>        positions;
+		vector<WAVEFORM_CLUSTERS>            clusters;
+
+		if (!CToolArgs::GetFileResults("edf-waveforms", files[i], scheduler.GetResults(), i, fileResults))
+			status = 1;
+
+		if (fileResults.empty())
+			continue;
+
+		for (j = 0; j < (int)fileResults.size(); j++)
+		{
+			fileChannels.push_back(fileResults[j]->m_channel);
+			positions.push_back(&fileResults[j]->m_out->m_pos);
+		}
+
+		try
+		{
+			CToolArgs::OpenFile(model, files[i], batch);
+
+			CWaveforms analysis(&model, waveform);
+
+			t = CToolArgs::Now();
+			analysis.Analyse(fileChannels, positions, clusters, batch.m_workers);
+			clusterTime += CToolArgs::Now() - t;
+		}
+		catch (const char * e)
+		{
+			fprintf(stderr, "edf-waveforms: %s: %s\n", files[i].c_str(), e);
+			status = 1;
+			continue;
+		}
+
+		for (j = 0; j < (int)fileChannels.size(); j++)
+		{
+			const WAVEFORM_CLUSTERS& result = clusters[j];
+
+			countSpikes += result.m_peaks.size();
+			countReads += result.m_countReads;
+
+			for (s = 0; s < result.m_peaks.size(); s++)
+			{
+				CToolArgs::WriteQuoted(output, files[i].c_str());
+				fprintf(output, ",%d,", fileChannels[j]);
+				CToolArgs::WriteQuoted(output, fileResults[j]->m_label.c_str());
+				fprintf(output, ",%.6f,%.6f,%d", (*positions[j])[s], (double)result.m_peaks[s] / result.m_fs, result.m_labels[s]);
+				for (k = 0; k < waveform.m_components; k++)
+				{
+					if (k < result.m_countFeatures)
+						fprintf(output, ",%.6g", result.m_features[s * result.m_countFeatures + k]);
+					else fprintf(output, ",");
+				}
+				fprintf(output, "\n");
+			}
+
+			if (!meansFile)
+				continue;
+
+			int before = (int)round(waveform.m_before * result.m_fs);
+			for (k = 0; k < (int)result.m_sizes.size(); k++)
+			{
+				for (s = 0; s < (size_t)result.m_length; s++)
+				{
+					CToolArgs::WriteQuoted(meansFile, files[i].c_str());
+					fprintf(meansFile, ",%d,", fileChannels[j]);
+					CToolArgs::WriteQuoted(meansFile, fileResults[j]->m_label.c_str());
+					fprintf(meansFile, ",%d,%d,%.6f,%.6g\n", k, result.m_sizes[k], ((int)s - before) / (double)result.m_fs,
+							result.m_centers[k * result.m_length + s]);
+				}
+			}
+		}
+
+		model.CloseFile();
+	}
+
+	if (output != stdout)
+		fclose(output);
+	if (meansFile)
+		fclose(meansFile);
+
+	fprintf(stderr, "edf-waveforms: %d spikes, %d reads, detection %.3f s, waveforms and clusters %.3f s\n",
+			countSpikes, countReads, detectTime, clusterTime);
+
+	return status;
+}
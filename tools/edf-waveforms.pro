@@ -0,0 +1,22 @@
+#-------------------------------------------------
+#
+# edf-waveforms - waveforms of the detected spikes and their clusters
+# by the shape.
+#
+#-------------------------------------------------
+
+CONFIG -= qt app_bundle
+CONFIG += console
+
+TARGET = edf-waveforms
+TEMPLATE = app
+
+include(../libs/core.pri)
+
+SOURCES += edf-waveforms.cpp \
+    CToolArgs.cpp
+
+HEADERS += CToolArgs.h
+
+LIBS = -L$$OUT_PWD/.. -ledf-core $$LIBS
+PRE_TARGETDEPS += $$OUT_PWD/../libedf-core.a